@@ -1,5 +1,14 @@
+use std::collections::HashMap;
+use std::ffi::{c_void, CStr};
+use std::os::raw::c_char;
 use std::ptr;
 use std::mem;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{mpsc, Arc};
+use std::thread;
+use std::time::{Duration, Instant};
+
+pub mod transport;
 
 extern "C" {
     fn OutputDebugStringA(s: *const u8);
@@ -119,6 +128,64 @@ fn do_redirect_stdout_stderr() -> Result<(), ()> {
 
 #[no_mangle]
 pub extern "C" fn run() {
+    run_with(None, None);
+}
+
+/// Same as `run()`, but the embedding engine draws each eye straight into the acquired swapchain image.
+#[no_mangle]
+pub extern "C" fn run_with_engine(callbacks: *const EngineCallbacks) {
+    assert!(!callbacks.is_null());
+    run_with(Some(Engine(unsafe { *callbacks })), None);
+}
+
+/// Same as `run()`, but each eye shows the latest frame a content process published through the frame transport
+/// created under `name`, see `transport`. Content opens it by that name and renders at the swapchain size. The
+/// eyes are cleared until its first frame arrives.
+#[no_mangle]
+pub extern "C" fn run_with_transport(name: *const c_char) {
+    assert!(!name.is_null());
+    let name = unsafe { CStr::from_ptr(name) }.to_str().unwrap().to_owned();
+    run_with(None, Some(name));
+}
+
+/// Renders one frame through `callbacks` into images in system memory and copies the left eye to `pixels`,
+/// which must hold `width * height` BGRA pixels. Lets an embedder check its renderer without a runtime or GPU.
+/// Returns whether the engine drew anything.
+#[no_mangle]
+pub extern "C" fn render_test_frame(
+    callbacks: *const EngineCallbacks,
+    width: u32,
+    height: u32,
+    pixels: *mut u32,
+) -> bool {
+    assert!(!callbacks.is_null() && !pixels.is_null());
+    let engine = Engine(unsafe { *callbacks });
+    let mut images = CpuImages::new(width, height);
+    let view = test_view();
+    let drawn = render_eyes(&mut images, Some(&engine), &[view, view]);
+    unsafe {
+        ptr::copy_nonoverlapping(images.buffers[0].as_ptr(), pixels, images.buffers[0].len());
+    }
+    drawn
+}
+
+/// A view at the origin looking down -Z, for rendering without a runtime.
+fn test_view() -> openxr::View {
+    openxr::View {
+        pose: Posef {
+            orientation: Quaternionf { x: 0., y: 0., z: 0., w: 1. },
+            position: Vector3f { x: 0., y: 0., z: 0. },
+        },
+        fov: openxr::Fovf {
+            angle_left: -0.8,
+            angle_right: 0.8,
+            angle_up: 0.8,
+            angle_down: -0.8,
+        },
+    }
+}
+
+fn run_with(engine: Option<Engine>, transport_name: Option<String>) {
     std::panic::set_hook(Box::new(|info| {
         let msg = match info.payload().downcast_ref::<&'static str>() {
             Some(s) => *s,
@@ -145,7 +212,97 @@ pub extern "C" fn run() {
     let _ = do_redirect_stdout_stderr();
     
     let entry = Entry::load().unwrap();
-    run2(&entry);
+    run2(&entry, engine.as_ref(), transport_name.as_deref());
+}
+
+/// One acquired swapchain image, handed to the embedding engine for the duration of `render_eye`.
+#[repr(C)]
+pub struct EyeImage {
+    /// 0 for the left eye, 1 for the right eye.
+    pub eye: u32,
+    pub width: u32,
+    pub height: u32,
+    /// DXGI_FORMAT of the image.
+    pub format: u32,
+    /// The runtime's ID3D11Texture2D, owned by the device passed to `device_created`. Null for CPU-backed images.
+    pub texture: *mut c_void,
+    /// First row of a CPU-backed image, and the distance between rows in bytes. Null for swapchain images.
+    pub pixels: *mut u8,
+    pub row_pitch: u32,
+    pub pose: Posef,
+    pub fov: openxr::Fovf,
+}
+
+/// Lets an embedding engine render into the swapchain images directly, instead of into its own texture that
+/// is then copied. The images belong to the session's device, so the engine must draw with that device.
+#[repr(C)]
+#[derive(Copy, Clone)]
+pub struct EngineCallbacks {
+    pub context: *mut c_void,
+    /// Called once before the first frame with the ID3D11Device owning the swapchain images.
+    pub device_created: Option<extern "C" fn(context: *mut c_void, device: *mut c_void)>,
+    /// Called for each eye between acquire and release. The image was waited on before the call, so the engine
+    /// may write to it right away. All of its work must be submitted to the device's immediate context before
+    /// returning: the context is flushed and the image released to the compositor as soon as this returns.
+    /// Return false when nothing was drawn, the image is cleared instead.
+    pub render_eye: Option<extern "C" fn(context: *mut c_void, image: *const EyeImage) -> bool>,
+}
+
+/// Draws an eye into its acquired image. Returns false when nothing was drawn, the image is cleared instead.
+trait EyeRenderer {
+    fn render_eye(&self, image: &EyeImage) -> bool;
+}
+
+struct Engine(EngineCallbacks);
+
+impl Engine {
+    fn device_created(&self, device: *mut ID3D11Device) {
+        if let Some(device_created) = self.0.device_created {
+            device_created(self.0.context, device as *mut c_void);
+        }
+    }
+}
+
+impl EyeRenderer for Engine {
+    fn render_eye(&self, image: &EyeImage) -> bool {
+        match self.0.render_eye {
+            Some(render_eye) => render_eye(self.0.context, image),
+            None => false,
+        }
+    }
+}
+
+/// How long the frame loop waits for content to answer the request it just published, before it shows the
+/// previous frame again.
+const TRANSPORT_FRAME_WAIT: Duration = Duration::from_millis(4);
+
+/// Shows a frame received through the transport by uploading each eye into its swapchain image.
+struct TransportedFrame<'a> {
+    frame: transport::ReceivedFrame<'a>,
+    width: u32,
+    height: u32,
+    device_context: &'a ComPtr<ID3D11DeviceContext>,
+}
+
+impl<'a> EyeRenderer for TransportedFrame<'a> {
+    fn render_eye(&self, image: &EyeImage) -> bool {
+        // Swapchain images are always B8G8R8A8 like the transport, so only the size can differ.
+        if image.texture.is_null() || image.width != self.width || image.height != self.height {
+            return false;
+        }
+        let pixels = self.frame.eye(image.eye as usize);
+        unsafe {
+            self.device_context.UpdateSubresource(
+                image.texture as *mut d3d11::ID3D11Resource,
+                0,
+                ptr::null(),
+                pixels.as_ptr() as *const _,
+                self.frame.row_pitch(),
+                0,
+            );
+        }
+        true
+    }
 }
 
 use openxr::d3d::{Requirements, SessionCreateInfo, D3D11};
@@ -161,7 +318,6 @@ use openxr::{
 
 use winapi::shared::dxgi;
 use winapi::shared::dxgiformat;
-use winapi::shared::dxgitype;
 use winapi::shared::winerror::{DXGI_ERROR_NOT_FOUND, S_OK};
 use winapi::um::d3d11::{self, ID3D11DeviceContext};
 use winapi::um::d3dcommon::*;
@@ -284,7 +440,7 @@ fn init_device_for_adapter(
 }
 
 
-fn run2(entry: &Entry) {
+fn run2(entry: &Entry, engine: Option<&Engine>, transport_name: Option<&str>) {
     let instance = create_instance(entry);
 
     let system = instance
@@ -296,6 +452,9 @@ fn run2(entry: &Entry) {
     let adapter = get_matching_adapter(&requirements).unwrap();
     let feature_levels = select_feature_levels(&requirements);
     let (d3d11_device, device_context) = init_device_for_adapter(adapter, &feature_levels).unwrap();
+    if let Some(engine) = engine {
+        engine.device_created(d3d11_device.as_raw());
+    }
 
     let (session, mut frame_waiter, mut frame_stream) = unsafe {
         instance
@@ -367,97 +526,250 @@ fn run2(entry: &Entry) {
         mip_count: 1,
     };
 
-    let mut left_swapchain = session.create_swapchain(&swapchain_create_info).unwrap();
+    let left_swapchain = session.create_swapchain(&swapchain_create_info).unwrap();
     let left_images = left_swapchain.enumerate_images().unwrap();
-    let mut right_swapchain = session.create_swapchain(&swapchain_create_info).unwrap();
+    let right_swapchain = session.create_swapchain(&swapchain_create_info).unwrap();
     let right_images = right_swapchain.enumerate_images().unwrap();
+    let mut images = SwapchainImages {
+        swapchains: [left_swapchain, right_swapchain],
+        textures: [left_images, right_images],
+        extents: [left_extent, right_extent],
+        format,
+        instance: instance.clone(),
+        device: d3d11_device.clone(),
+        device_context: device_context.clone(),
+        render_target_views: HashMap::new(),
+        acquired: [None, None],
+    };
     
-    let mut state = State::NotReady;
+    // Content renders at the size both swapchains are created with.
+    let mut compositor = transport_name.map(|name| {
+        transport::Compositor::create(name, swapchain_create_info.width, swapchain_create_info.height).unwrap()
+    });
+
+    let event_pump = EventPump::new(instance.clone());
+    let mut tracker = SessionTracker::new();
 
     while let Some((frame_state, views)) = wait_for_animation_frame(
-        &instance, &session, &mut frame_waiter, &mut frame_stream, &viewer_space, &space, &mut state,
+        &event_pump, &session, &mut frame_waiter, &mut frame_stream, &viewer_space, &space, &mut tracker,
     ) {
-        render_animation_frame(
-            &mut left_swapchain,
-            &mut right_swapchain,
-            &left_images,
-            &right_images,
-            &view_configurations,
-            format,
-            d3d11_device.clone(),
-            device_context.clone(),
-            &mut frame_stream,
-            &frame_state,
-            &space,
-            &views,
-            &left_extent,
-            &right_extent,
-        );
+        match compositor.as_mut() {
+            Some(compositor) => {
+                compositor.request_frame(
+                    frame_state.predicted_display_time.as_nanos(),
+                    [views[0].pose, views[1].pose],
+                    [views[0].fov, views[1].fov],
+                );
+                let (width, height) = (compositor.width(), compositor.height());
+                let frame = compositor.acquire_frame(TRANSPORT_FRAME_WAIT).map(|frame| TransportedFrame {
+                    frame,
+                    width,
+                    height,
+                    device_context: &device_context,
+                });
+                let renderer = frame.as_ref().map(|frame| frame as &dyn EyeRenderer);
+                render_animation_frame(&mut images, renderer, &mut frame_stream, &frame_state, &space, &views);
+            }
+            None => {
+                let renderer = engine.map(|engine| engine as &dyn EyeRenderer);
+                render_animation_frame(&mut images, renderer, &mut frame_stream, &frame_state, &space, &views);
+            }
+        }
+        tracker.frame_ended();
     }
 }
 
-#[derive(Copy, Clone, PartialEq)]
+/// Events copied out of the runtime's event buffer, so they can be sent across threads.
+enum PumpedEvent {
+    SessionStateChanged(openxr::SessionState),
+    InstanceLossPending,
+    /// xrPollEvent failed. The pump thread stops after sending this.
+    PollFailed(openxr::sys::Result),
+}
+
+const MIN_POLL_BACKOFF: Duration = Duration::from_millis(1);
+const MAX_POLL_BACKOFF: Duration = Duration::from_millis(100);
+
+/// Polls OpenXR events on a background thread, backing off exponentially while nothing arrives,
+/// so a frame loop with nothing to render can block on the channel instead of sleeping.
+struct EventPump {
+    receiver: mpsc::Receiver<PumpedEvent>,
+    stop: Arc<AtomicBool>,
+    thread: Option<thread::JoinHandle<()>>,
+}
+
+impl EventPump {
+    fn new(instance: Instance) -> EventPump {
+        let (sender, receiver) = mpsc::channel();
+        let stop = Arc::new(AtomicBool::new(false));
+        let thread_stop = stop.clone();
+        let thread = thread::Builder::new()
+            .name("openxr-events".to_owned())
+            .spawn(move || {
+                let mut buffer = openxr::EventDataBuffer::new();
+                let mut backoff = MIN_POLL_BACKOFF;
+                while !thread_stop.load(Ordering::Relaxed) {
+                    let polled = match instance.poll_event(&mut buffer) {
+                        Ok(polled) => polled,
+                        Err(error) => {
+                            // The frame loop ends the session once it receives this.
+                            let _ = sender.send(PumpedEvent::PollFailed(error));
+                            break;
+                        }
+                    };
+                    let event = match polled {
+                        Some(openxr::Event::SessionStateChanged(session_change)) => {
+                            Some(PumpedEvent::SessionStateChanged(session_change.state()))
+                        }
+                        Some(openxr::Event::InstanceLossPending(_)) => Some(PumpedEvent::InstanceLossPending),
+                        Some(_) => {
+                            // FIXME: Handle other events
+                            None
+                        }
+                        None => {
+                            thread::sleep(backoff);
+                            backoff = std::cmp::min(backoff * 2, MAX_POLL_BACKOFF);
+                            continue;
+                        }
+                    };
+                    // Events tend to arrive in bursts, so poll again right away.
+                    backoff = MIN_POLL_BACKOFF;
+                    if let Some(event) = event {
+                        if sender.send(event).is_err() {
+                            break;
+                        }
+                    }
+                }
+            })
+            .unwrap();
+        EventPump {
+            receiver,
+            stop,
+            thread: Some(thread),
+        }
+    }
+}
+
+impl Drop for EventPump {
+    fn drop(&mut self) {
+        self.stop.store(true, Ordering::Relaxed);
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+#[derive(Copy, Clone, PartialEq, Debug)]
 enum State {
-    NotReady,
-    Ready,
+    /// No frame loop: before READY, or after the session was ended.
+    Idle,
+    /// Between begin and end, frames must be waited on and submitted.
+    Running,
     ShutDown,
 }
 
-fn handle_openxr_events(instance: &Instance, mut state: State) -> State {
-    use openxr::Event::*;
+/// Explicit handling of every session state, plus time-to-first-frame measurement after READY.
+struct SessionTracker {
+    state: State,
+    ready_at: Option<Instant>,
+}
+
+impl SessionTracker {
+    fn new() -> SessionTracker {
+        SessionTracker {
+            state: State::Idle,
+            ready_at: None,
+        }
+    }
+
+    fn session_state_changed(&mut self, session: &Session<D3D11>, session_state: openxr::SessionState) {
+        match session_state {
+            openxr::SessionState::READY => {
+                session.begin(ViewConfigurationType::PRIMARY_STEREO).unwrap();
+                self.ready_at = Some(Instant::now());
+                self.state = State::Running;
+            }
+            openxr::SessionState::SYNCHRONIZED
+            | openxr::SessionState::VISIBLE
+            | openxr::SessionState::FOCUSED => {
+                // Still running, only should_render and input focus change.
+            }
+            openxr::SessionState::STOPPING => {
+                session.end().unwrap();
+                self.ready_at = None;
+                self.state = State::Idle;
+            }
+            openxr::SessionState::EXITING | openxr::SessionState::LOSS_PENDING => {
+                self.state = State::ShutDown;
+            }
+            openxr::SessionState::IDLE => {}
+            other => {
+                eprintln!("Ignoring unknown session state {:?}", other);
+            }
+        }
+    }
+
+    fn frame_ended(&mut self) {
+        if let Some(ready_at) = self.ready_at.take() {
+            let elapsed = ready_at.elapsed();
+            debug(&format!(
+                "Time to first frame after READY: {:.2} ms",
+                elapsed.as_secs_f64() * 1000.
+            ));
+        }
+    }
+}
+
+fn handle_openxr_events(event_pump: &EventPump, session: &Session<D3D11>, tracker: &mut SessionTracker) {
     loop {
-        let mut buffer = openxr::EventDataBuffer::new();
-        println!("polling");
-        let event = instance.poll_event(&mut buffer).unwrap();
-        println!("poll result: {}", event.is_some());
+        let event = if tracker.state == State::Idle {
+            // Nothing to render, so block until the runtime reports the next state change.
+            event_pump.receiver.recv().ok()
+        } else {
+            match event_pump.receiver.try_recv() {
+                Ok(event) => Some(event),
+                // No more events to process
+                Err(mpsc::TryRecvError::Empty) => return,
+                Err(mpsc::TryRecvError::Disconnected) => None,
+            }
+        };
+
         match event {
-            Some(SessionStateChanged(session_change)) => match session_change.state() {
-                openxr::SessionState::EXITING | openxr::SessionState::LOSS_PENDING => {
-                    return State::ShutDown;
-                }
-                openxr::SessionState::READY => state = State::Ready,
-                _ => {
-                    // FIXME: Handle other states
+            Some(PumpedEvent::SessionStateChanged(session_state)) => {
+                tracker.session_state_changed(session, session_state);
+                if tracker.state == State::ShutDown {
+                    return;
                 }
-            },
-            Some(InstanceLossPending(_)) => {
-                return State::ShutDown;
             }
-            Some(_) => {
-                // FIXME: Handle other events
+            Some(PumpedEvent::PollFailed(error)) => {
+                debug(&format!("Polling OpenXR events failed: {:?}, ending the session", error));
+                tracker.state = State::ShutDown;
+                return;
             }
-            None => {
-                // No more events to process
-                return state;
+            Some(PumpedEvent::InstanceLossPending) | None => {
+                tracker.state = State::ShutDown;
+                return;
             }
         }
     }
 }
 
 fn wait_for_animation_frame(
-    instance: &Instance,
+    event_pump: &EventPump,
     session: &Session<D3D11>,
     frame_waiter: &mut FrameWaiter,
     frame_stream: &mut FrameStream<D3D11>,
     viewer_space: &Space,
     space: &Space,
-    state: &mut State,
+    tracker: &mut SessionTracker,
 ) -> Option<(FrameState, Vec<openxr::View>)> {
     let frame_state = loop {
-        let old_state = *state;
-        *state = handle_openxr_events(instance, old_state);
-        if *state == State::ShutDown {
+        handle_openxr_events(event_pump, session, tracker);
+        if tracker.state == State::ShutDown {
             // Session is not running anymore.
             return None;
         }
 
-        if *state == State::NotReady {
-            std::thread::sleep(std::time::Duration::from_millis(250));
-            continue;
-        } else if old_state == State::NotReady && *state == State::Ready {
-            session.begin(ViewConfigurationType::PRIMARY_STEREO).unwrap();
-        }
-
         let frame_state = frame_waiter.wait().expect("error waiting for frame");
 
         frame_stream
@@ -474,6 +786,7 @@ fn wait_for_animation_frame(
             EnvironmentBlendMode::ADDITIVE,
             &[],
         ).unwrap();
+        tracker.frame_ended();
     };
 
     let (_view_flags, views) = session
@@ -489,122 +802,181 @@ fn wait_for_animation_frame(
     Some((frame_state, views))
 }
 
-fn render_animation_frame(
-    left_swapchain: &mut Swapchain<D3D11>,
-    right_swapchain: &mut Swapchain<D3D11>,
-    left_images: &[<D3D11 as Graphics>::SwapchainImage],
-    right_images: &[<D3D11 as Graphics>::SwapchainImage],
-    view_configurations: &[openxr::ViewConfigurationView],
+/// Swapchain images the engine draws into, acquired and released per eye around each frame.
+trait EyeImages {
+    /// Acquire the eye's next image. It may only be written after `wait`.
+    fn acquire(&mut self, eye: u32, view: &openxr::View) -> EyeImage;
+    /// Wait until the compositor is done reading the eye's acquired image.
+    fn wait(&mut self, eye: u32);
+    fn clear(&mut self, eye: u32, color: [f32; 4]);
+    /// Hand the image to the compositor. Everything drawn into it must have been submitted.
+    fn release(&mut self, eye: u32);
+}
+
+const CLEAR_COLOR: [f32; 4] = [1., 1., 1., 1.];
+
+/// Lets the renderer draw each eye in place, clearing the images it leaves empty so the compositor never shows
+/// stale content. Returns whether the renderer drew anything.
+fn render_eyes(images: &mut dyn EyeImages, renderer: Option<&dyn EyeRenderer>, views: &[openxr::View]) -> bool {
+    // Every eye is acquired before the first wait, so the compositor finishes reading one eye's image while the
+    // other eye is drawn.
+    let acquired: Vec<EyeImage> = views.iter().enumerate().map(|(eye, view)| images.acquire(eye as u32, view)).collect();
+    let mut drawn_any = false;
+    for (eye, image) in acquired.iter().enumerate() {
+        images.wait(eye as u32);
+        let drawn = renderer.map_or(false, |renderer| renderer.render_eye(image));
+        if !drawn {
+            images.clear(eye as u32, CLEAR_COLOR);
+        }
+        images.release(eye as u32);
+        drawn_any |= drawn;
+    }
+    drawn_any
+}
+
+const SWAPCHAIN_WAIT_TIMEOUT_NANOS: i64 = 1_000_000;
+/// A wait this long means the compositor stalled, a frame is only 11 ms at 90Hz.
+const SWAPCHAIN_STALL_REPORT: Duration = Duration::from_millis(100);
+
+/// One single-layer swapchain per eye. Images are passed to the engine as they are, without an intermediate texture.
+struct SwapchainImages {
+    swapchains: [Swapchain<D3D11>; 2],
+    textures: [Vec<<D3D11 as Graphics>::SwapchainImage>; 2],
+    extents: [Extent2Di; 2],
     format: dxgiformat::DXGI_FORMAT,
-    d3d11_device: ComPtr<ID3D11Device>,
+    /// For xrWaitSwapchainImage, whose timeout the safe wrapper reports as success.
+    instance: Instance,
+    device: ComPtr<ID3D11Device>,
     device_context: ComPtr<ID3D11DeviceContext>,
+    /// Created on first use, one per swapchain image.
+    render_target_views: HashMap<<D3D11 as Graphics>::SwapchainImage, ComPtr<d3d11::ID3D11RenderTargetView>>,
+    acquired: [Option<<D3D11 as Graphics>::SwapchainImage>; 2],
+}
+
+impl EyeImages for SwapchainImages {
+    fn acquire(&mut self, eye: u32, view: &openxr::View) -> EyeImage {
+        let index = self.swapchains[eye as usize].acquire_image().unwrap();
+        let texture = self.textures[eye as usize][index as usize];
+        self.acquired[eye as usize] = Some(texture);
+        let extent = self.extents[eye as usize];
+        EyeImage {
+            eye,
+            width: extent.width as u32,
+            height: extent.height as u32,
+            format: self.format,
+            texture: texture as *mut c_void,
+            pixels: ptr::null_mut(),
+            row_pitch: 0,
+            pose: view.pose,
+            fov: view.fov,
+        }
+    }
+
+    fn wait(&mut self, eye: u32) {
+        // Acquire fence: the compositor may still be reading the image until the wait returns. Short timeouts,
+        // so a stalled compositor is reported instead of silently hanging the frame loop.
+        let info = openxr::sys::SwapchainImageWaitInfo {
+            ty: openxr::sys::StructureType::SWAPCHAIN_IMAGE_WAIT_INFO,
+            next: ptr::null(),
+            timeout: openxr::Duration::from_nanos(SWAPCHAIN_WAIT_TIMEOUT_NANOS),
+        };
+        let started = Instant::now();
+        let mut reported = false;
+        loop {
+            let swapchain = self.swapchains[eye as usize].as_raw();
+            match unsafe { (self.instance.fp().wait_swapchain_image)(swapchain, &info) } {
+                openxr::sys::Result::SUCCESS => break,
+                openxr::sys::Result::TIMEOUT_EXPIRED => {
+                    if !reported && started.elapsed() >= SWAPCHAIN_STALL_REPORT {
+                        debug(&format!("Still waiting for the eye {} swapchain image after {:?}", eye, started.elapsed()));
+                        reported = true;
+                    }
+                }
+                error => panic!("xrWaitSwapchainImage failed: {:?}", error),
+            }
+        }
+    }
+
+    fn clear(&mut self, eye: u32, color: [f32; 4]) {
+        let texture = self.acquired[eye as usize].expect("image is not acquired");
+        let device = &self.device;
+        let view = self.render_target_views.entry(texture).or_insert_with(|| unsafe {
+            let mut view_ptr = ptr::null_mut();
+            let hr = device.CreateRenderTargetView(texture as *mut d3d11::ID3D11Resource, ptr::null(), &mut view_ptr);
+            assert_eq!(hr, S_OK);
+            ComPtr::from_raw(view_ptr)
+        });
+        unsafe {
+            self.device_context.ClearRenderTargetView(view.as_raw(), &color);
+        }
+    }
+
+    fn release(&mut self, eye: u32) {
+        // Release fence: the compositor only sees work that reached the GPU, so submit it before releasing.
+        unsafe {
+            self.device_context.Flush();
+        }
+        self.acquired[eye as usize] = None;
+        self.swapchains[eye as usize].release_image().unwrap();
+    }
+}
+
+/// Images in system memory, to drive an engine's renderer without a runtime or GPU.
+struct CpuImages {
+    width: u32,
+    height: u32,
+    buffers: [Vec<u32>; 2],
+}
+
+impl CpuImages {
+    fn new(width: u32, height: u32) -> CpuImages {
+        let len = width as usize * height as usize;
+        CpuImages {
+            width,
+            height,
+            buffers: [vec![0; len], vec![0; len]],
+        }
+    }
+}
+
+impl EyeImages for CpuImages {
+    fn acquire(&mut self, eye: u32, view: &openxr::View) -> EyeImage {
+        EyeImage {
+            eye,
+            width: self.width,
+            height: self.height,
+            format: dxgiformat::DXGI_FORMAT_B8G8R8A8_UNORM,
+            texture: ptr::null_mut(),
+            pixels: self.buffers[eye as usize].as_mut_ptr() as *mut u8,
+            row_pitch: self.width * mem::size_of::<u32>() as u32,
+            pose: view.pose,
+            fov: view.fov,
+        }
+    }
+
+    fn wait(&mut self, _eye: u32) {}
+
+    fn clear(&mut self, eye: u32, color: [f32; 4]) {
+        let channel = |value: f32| (value.max(0.).min(1.) * 255. + 0.5) as u32;
+        let pixel = channel(color[3]) << 24 | channel(color[0]) << 16 | channel(color[1]) << 8 | channel(color[2]);
+        for value in self.buffers[eye as usize].iter_mut() {
+            *value = pixel;
+        }
+    }
+
+    fn release(&mut self, _eye: u32) {}
+}
+
+fn render_animation_frame(
+    images: &mut SwapchainImages,
+    renderer: Option<&dyn EyeRenderer>,
     frame_stream: &mut FrameStream<D3D11>,
     frame_state: &FrameState,
     space: &Space,
     openxr_views: &[openxr::View],
-    left_extent: &Extent2Di,
-    right_extent: &Extent2Di,
 ) {
-    let left_image = left_swapchain.acquire_image().unwrap();
-    left_swapchain
-        .wait_image(openxr::Duration::INFINITE)
-        .unwrap();
-    let right_image = right_swapchain.acquire_image().unwrap();
-    right_swapchain
-        .wait_image(openxr::Duration::INFINITE)
-        .unwrap();
+    render_eyes(images, renderer, openxr_views);
 
-    let left_image = left_images[left_image as usize];
-    let right_image = right_images[right_image as usize];
-    
-    let width = view_configurations[0].recommended_image_rect_width + view_configurations[1].recommended_image_rect_width;
-    let height = view_configurations[0].recommended_image_rect_height;
-    let texture_desc = d3d11::D3D11_TEXTURE2D_DESC {
-        Width: (width / 2) as u32,
-        Height: height as u32,
-        Format: format,
-        MipLevels: 1,
-        ArraySize: 1,
-        SampleDesc: dxgitype::DXGI_SAMPLE_DESC {
-            Count: 1,
-            Quality: 0,
-        },
-        Usage: d3d11::D3D11_USAGE_DEFAULT,
-        BindFlags: d3d11::D3D11_BIND_RENDER_TARGET | d3d11::D3D11_BIND_SHADER_RESOURCE,
-        CPUAccessFlags: 0,
-        MiscFlags: 0,
-    };
-    let byte_len = (width as usize / 2) * height as usize * mem::size_of::<u32>();
-    let left_data = vec![0xFF; byte_len];
-    let init = d3d11::D3D11_SUBRESOURCE_DATA {
-        pSysMem: left_data.as_ptr() as *const _,
-        SysMemPitch: (width / 2) as u32 * mem::size_of::<u32>() as u32,
-        SysMemSlicePitch: byte_len as u32,
-    };
-    let mut d3dtex_ptr = ptr::null_mut();
-    println!("creating solid texture");
-    let hr = unsafe { d3d11_device.CreateTexture2D(&texture_desc, &init, &mut d3dtex_ptr) };
-    let solid_texture = unsafe { ComPtr::from_raw(d3dtex_ptr) };
-    let solid_resource = solid_texture.up::<d3d11::ID3D11Resource>();
-    assert_eq!(hr, S_OK);
-
-   unsafe {
-        // from_raw adopts instead of retaining, so we need to manually addref
-        // alternatively we can just forget after the CopySubresourceRegion call,
-        // since these images are guaranteed to live at least as long as the frame
-        let left_resource = ComPtr::from_raw(left_image).up::<d3d11::ID3D11Resource>();
-        mem::forget(left_resource.clone());
-        let right_resource = ComPtr::from_raw(right_image).up::<d3d11::ID3D11Resource>();
-        mem::forget(right_resource.clone());
-        println!("copying solid texture");
-        device_context.CopyResource(left_resource.as_raw(), solid_resource.as_raw());
-        device_context.CopyResource(right_resource.as_raw(), solid_resource.as_raw());
-        device_context.Flush();
-        println!("flushed");
-    
-        let texture_desc = d3d11::D3D11_TEXTURE2D_DESC {
-            Width: (width / 2) as u32,
-            Height: height as u32,
-            Format: format,
-            MipLevels: 1,
-            ArraySize: 1,
-            SampleDesc: dxgitype::DXGI_SAMPLE_DESC {
-                Count: 1,
-                Quality: 0,
-            },
-            Usage: d3d11::D3D11_USAGE_STAGING,
-            BindFlags: 0,
-            CPUAccessFlags: d3d11::D3D11_CPU_ACCESS_READ,
-            MiscFlags: 0,
-        };
-        let initial_data = vec![0xFF0000FFu32; byte_len / mem::size_of::<u32>()];
-        let init = d3d11::D3D11_SUBRESOURCE_DATA {
-            pSysMem: initial_data.as_ptr() as *const _ as *const _,
-            SysMemPitch: (width / 2) as u32 * mem::size_of::<u32>() as u32,
-            SysMemSlicePitch: byte_len as u32,
-        };
-        println!("creating mapped texture");
-        let hr = d3d11_device.CreateTexture2D(&texture_desc, &init, &mut d3dtex_ptr);
-        assert_eq!(hr, S_OK);
-        let solid_texture = ComPtr::from_raw(d3dtex_ptr);
-        let solid_resource = solid_texture.up::<d3d11::ID3D11Resource>();
-        device_context.CopyResource(solid_resource.as_raw(), left_resource.as_raw());
-        println!("copied mapped texture");
-        
-        let mut mapped = d3d11::D3D11_MAPPED_SUBRESOURCE {
-            pData: ptr::null_mut(),
-            RowPitch: 0,
-            DepthPitch: 0,
-        };
-        
-        let hr = device_context.Map(solid_resource.as_raw(), 0, d3d11::D3D11_MAP_READ, 0, &mut mapped);
-        assert_eq!(hr, S_OK);
-        println!("finished mapped texture");
-        assert_eq!(*(mapped.pData as *const u32), 0xFFFFFFFF);
-    }
-    
-    left_swapchain.release_image().unwrap();
-    right_swapchain.release_image().unwrap();
     println!("ending the frame");
     frame_stream
         .end(
@@ -620,11 +992,11 @@ fn render_animation_frame(
                         .sub_image(
                             // XXXManishearth is this correct?
                             openxr::SwapchainSubImage::new()
-                                .swapchain(&left_swapchain)
+                                .swapchain(&images.swapchains[0])
                                 .image_array_index(0)
                                 .image_rect(openxr::Rect2Di {
                                     offset: openxr::Offset2Di { x: 0, y: 0 },
-                                    extent: *left_extent,
+                                    extent: images.extents[0],
                                 }),
                         ),
                     openxr::CompositionLayerProjectionView::new()
@@ -632,11 +1004,11 @@ fn render_animation_frame(
                         .fov(openxr_views[1].fov)
                         .sub_image(
                             openxr::SwapchainSubImage::new()
-                                .swapchain(&right_swapchain)
+                                .swapchain(&images.swapchains[1])
                                 .image_array_index(0)
                                 .image_rect(openxr::Rect2Di {
                                     offset: openxr::Offset2Di { x: 0, y: 0 },
-                                    extent: *right_extent,
+                                    extent: images.extents[1],
                                 }),
                         ),
                 ])],
@@ -644,3 +1016,107 @@ fn render_animation_frame(
         .unwrap();
         println!("ended");
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::slice;
+
+    const WIDTH: u32 = 8;
+    const HEIGHT: u32 = 4;
+    const ENGINE_COLOR: u32 = 0xff20_4060;
+    /// CLEAR_COLOR as a B8G8R8A8 pixel.
+    const CLEARED: u32 = 0xffff_ffff;
+
+    /// Fills the left eye row by row through the pitch, and leaves the right eye to the fallback.
+    extern "C" fn draw_left_eye(context: *mut c_void, image: *const EyeImage) -> bool {
+        let image = unsafe { &*image };
+        if image.eye != 0 {
+            return false;
+        }
+        let color = unsafe { *(context as *const u32) };
+        for row in 0..image.height as usize {
+            let pixels = unsafe {
+                slice::from_raw_parts_mut(image.pixels.add(row * image.row_pitch as usize) as *mut u32, image.width as usize)
+            };
+            pixels.fill(color);
+        }
+        true
+    }
+
+    #[test]
+    fn engine_draws_its_eyes_and_the_rest_are_cleared() {
+        let mut color = ENGINE_COLOR;
+        let engine = Engine(EngineCallbacks {
+            context: &mut color as *mut u32 as *mut c_void,
+            device_created: None,
+            render_eye: Some(draw_left_eye),
+        });
+        let mut images = CpuImages::new(WIDTH, HEIGHT);
+        for buffer in images.buffers.iter_mut() {
+            buffer.fill(0x1234_5678); // Stale content of an earlier frame
+        }
+
+        assert!(render_eyes(&mut images, Some(&engine), &[test_view(), test_view()]));
+        assert!(images.buffers[0].iter().all(|&pixel| pixel == ENGINE_COLOR));
+        assert!(images.buffers[1].iter().all(|&pixel| pixel == CLEARED));
+    }
+
+    #[test]
+    fn every_eye_is_cleared_without_a_renderer() {
+        let mut images = CpuImages::new(WIDTH, HEIGHT);
+        assert!(!render_eyes(&mut images, None, &[test_view(), test_view()]));
+        for buffer in &images.buffers {
+            assert!(buffer.iter().all(|&pixel| pixel == CLEARED));
+        }
+    }
+
+    /// CpuImages that records the order of the calls render_eyes makes.
+    struct RecordingImages {
+        images: CpuImages,
+        calls: Vec<(&'static str, u32)>,
+    }
+
+    impl EyeImages for RecordingImages {
+        fn acquire(&mut self, eye: u32, view: &openxr::View) -> EyeImage {
+            self.calls.push(("acquire", eye));
+            self.images.acquire(eye, view)
+        }
+
+        fn wait(&mut self, eye: u32) {
+            self.calls.push(("wait", eye));
+        }
+
+        fn clear(&mut self, eye: u32, color: [f32; 4]) {
+            self.calls.push(("clear", eye));
+            self.images.clear(eye, color);
+        }
+
+        fn release(&mut self, eye: u32) {
+            self.calls.push(("release", eye));
+        }
+    }
+
+    /// Both images are acquired before the first wait, and each is waited on right before it is written.
+    #[test]
+    fn eyes_are_acquired_before_the_first_wait() {
+        let mut images = RecordingImages {
+            images: CpuImages::new(WIDTH, HEIGHT),
+            calls: Vec::new(),
+        };
+        render_eyes(&mut images, None, &[test_view(), test_view()]);
+        assert_eq!(
+            images.calls,
+            [
+                ("acquire", 0),
+                ("acquire", 1),
+                ("wait", 0),
+                ("clear", 0),
+                ("release", 0),
+                ("wait", 1),
+                ("clear", 1),
+                ("release", 1),
+            ]
+        );
+    }
+}
@@ -0,0 +1,840 @@
+//! Frame transport between a content process and the process that owns the OpenXR session and runs the frame loop.
+//!
+//! Eye buffers live in shared memory, so content renders into them in place and the compositor reads them where
+//! they are. Only slot indices and the small per-frame records below are exchanged.
+//!
+//! Each frame the compositor publishes a `FrameRequest` with the predicted display time and the views to render.
+//! Content renders into a free slot and publishes it as the latest frame. Three slots are enough for neither side
+//! to ever wait on the other: one being written, one being read, and the latest one. A newer frame replaces a
+//! latest frame the compositor has not picked up yet.
+//!
+//! `run_with_transport` runs the OpenXR frame loop as the compositor: it requests a frame with each frame's views
+//! and uploads the latest eye buffers into the swapchain images.
+//!
+//! Content is untrusted. It can write anything into the shared header, so the compositor never takes sizes,
+//! offsets or slot indices from it: the layout is kept from creation, and slot indices are checked before use.
+
+use openxr::{Fovf, Posef};
+use std::collections::VecDeque;
+use std::io;
+use std::sync::atomic::{fence, AtomicU32, Ordering};
+use std::time::{Duration, Instant};
+use std::{mem, ptr, slice};
+
+pub use self::platform::TransportHandles;
+
+pub const EYE_COUNT: usize = 2;
+/// B8G8R8A8, the format the swapchains are created with.
+pub const BYTES_PER_PIXEL: u32 = 4;
+
+const SLOT_COUNT: usize = 3;
+const NO_SLOT: u32 = u32::MAX;
+const MAGIC: u32 = 0x5846_5254; // "TRFX"
+const VERSION: u32 = 1;
+const PAGE_SIZE: usize = 4096;
+/// Rows are aligned like D3D11 texture uploads expect.
+const ROW_ALIGNMENT: u32 = 256;
+
+const SLOT_FREE: u32 = 0;
+const SLOT_WRITING: u32 = 1;
+const SLOT_READY: u32 = 2;
+const SLOT_READING: u32 = 3;
+
+/// What the compositor asks content to render.
+#[repr(C)]
+#[derive(Copy, Clone)]
+pub struct FrameRequest {
+    pub frame_id: u64,
+    pub predicted_display_time: i64,
+    pub poses: [Posef; EYE_COUNT],
+    pub fovs: [Fovf; EYE_COUNT],
+}
+
+/// A rendered frame: the request it answers and how long content spent on it.
+#[repr(C)]
+#[derive(Copy, Clone)]
+pub struct FrameInfo {
+    pub request: FrameRequest,
+    pub render_nanos: u64,
+}
+
+#[repr(C)]
+struct Header {
+    magic: u32,
+    version: u32,
+    width: u32,
+    height: u32,
+    row_pitch: u32,
+    slot_offset: u32,
+    slot_size: u64,
+    /// Seqlock over `request`, odd while the compositor writes it.
+    request_sequence: AtomicU32,
+    latest: AtomicU32,
+    slot_states: [AtomicU32; SLOT_COUNT],
+    request: FrameRequest,
+    /// Written by whoever owns the slot's state.
+    infos: [FrameInfo; SLOT_COUNT],
+}
+
+/// Where the eye buffers are in the mapping. Each end keeps its own copy rather than reading the header again.
+#[derive(Copy, Clone, PartialEq)]
+struct Layout {
+    width: u32,
+    height: u32,
+    row_pitch: u32,
+    slot_offset: usize,
+    slot_size: usize,
+}
+
+impl Layout {
+    fn new(width: u32, height: u32) -> Layout {
+        let row_pitch = (width * BYTES_PER_PIXEL + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+        Layout {
+            width,
+            height,
+            row_pitch,
+            slot_offset: (mem::size_of::<Header>() + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE,
+            slot_size: row_pitch as usize * height as usize * EYE_COUNT,
+        }
+    }
+
+    fn eye_len(&self) -> usize {
+        self.row_pitch as usize * self.height as usize
+    }
+
+    fn memory_len(&self) -> usize {
+        self.slot_offset + self.slot_size * SLOT_COUNT
+    }
+}
+
+/// The mapping and the two signals, shared by both ends.
+struct Channel {
+    layout: Layout,
+    memory: platform::SharedMemory,
+    /// Set by the compositor after publishing a request.
+    request_signal: platform::Signal,
+    /// Set by content after publishing a frame.
+    frame_signal: platform::Signal,
+}
+
+impl Channel {
+    fn header(&self) -> &Header {
+        unsafe { &*(self.memory.as_ptr() as *const Header) }
+    }
+
+    fn info(&self, slot: u32) -> *mut FrameInfo {
+        let header = self.memory.as_ptr() as *mut Header;
+        unsafe { ptr::addr_of_mut!((*header).infos[slot as usize]) }
+    }
+
+    /// Slots come from our own checked state, so only the eye is checked here.
+    fn eye_ptr(&self, slot: u32, eye: usize) -> *mut u8 {
+        assert!(eye < EYE_COUNT, "eye {} out of range", eye);
+        debug_assert!((slot as usize) < SLOT_COUNT);
+        let offset = self.layout.slot_offset + slot as usize * self.layout.slot_size + eye * self.layout.eye_len();
+        unsafe { self.memory.as_ptr().add(offset) }
+    }
+}
+
+/// The end in the process running the OpenXR frame loop. It owns the shared memory and the signals.
+pub struct Compositor {
+    channel: Channel,
+    next_frame_id: u64,
+    /// When recent requests were published, to report the latency of the frames answering them.
+    requested_at: VecDeque<(u64, Instant)>,
+    reading: u32,
+    reading_latency: Option<Duration>,
+}
+
+impl Compositor {
+    /// Create the shared memory for eye buffers of the given size. `name` identifies the transport to the
+    /// content process on Windows, and names the memory for diagnostics on Linux.
+    pub fn create(name: &str, width: u32, height: u32) -> io::Result<Compositor> {
+        let layout = Layout::new(width, height);
+        let memory = platform::SharedMemory::create(name, layout.memory_len())?;
+        let request_signal = platform::Signal::create(name, "request")?;
+        let frame_signal = platform::Signal::create(name, "frame")?;
+
+        unsafe {
+            let header = memory.as_ptr() as *mut Header;
+            ptr::write_bytes(header, 0, 1);
+            (*header).magic = MAGIC;
+            (*header).version = VERSION;
+            (*header).width = width;
+            (*header).height = height;
+            (*header).row_pitch = layout.row_pitch;
+            (*header).slot_offset = layout.slot_offset as u32;
+            (*header).slot_size = layout.slot_size as u64;
+            (*header).latest = AtomicU32::new(NO_SLOT);
+        }
+
+        Ok(Compositor {
+            channel: Channel {
+                layout,
+                memory,
+                request_signal,
+                frame_signal,
+            },
+            next_frame_id: 1,
+            requested_at: VecDeque::new(),
+            reading: NO_SLOT,
+            reading_latency: None,
+        })
+    }
+
+    /// What the content process needs to open its end.
+    pub fn handles(&self) -> TransportHandles {
+        platform::handles(&self.channel.memory, &self.channel.request_signal, &self.channel.frame_signal)
+    }
+
+    /// Ask content to render the next frame. Returns the id its `FrameInfo` will carry.
+    pub fn request_frame(&mut self, predicted_display_time: i64, poses: [Posef; EYE_COUNT], fovs: [Fovf; EYE_COUNT]) -> u64 {
+        let frame_id = self.next_frame_id;
+        self.next_frame_id += 1;
+
+        let header = self.channel.header();
+        let sequence = header.request_sequence.load(Ordering::Relaxed);
+        header.request_sequence.store(sequence.wrapping_add(1), Ordering::Relaxed);
+        fence(Ordering::Release);
+        unsafe {
+            let request = ptr::addr_of!(header.request) as *mut FrameRequest;
+            ptr::write_volatile(
+                request,
+                FrameRequest {
+                    frame_id,
+                    predicted_display_time,
+                    poses,
+                    fovs,
+                },
+            );
+        }
+        header.request_sequence.store(sequence.wrapping_add(2), Ordering::Release);
+        self.channel.request_signal.notify();
+
+        self.requested_at.push_back((frame_id, Instant::now()));
+        if self.requested_at.len() > 16 {
+            self.requested_at.pop_front();
+        }
+        frame_id
+    }
+
+    pub fn width(&self) -> u32 {
+        self.channel.layout.width
+    }
+
+    pub fn height(&self) -> u32 {
+        self.channel.layout.height
+    }
+
+    /// Switch to the newest frame content published since the last call, waiting up to `timeout` for one.
+    /// When content fell behind, the previous frame is returned again. None until the first frame arrives.
+    /// A slot index out of range, or the slot already being read, is not a new frame and is ignored.
+    pub fn acquire_frame(&mut self, timeout: Duration) -> Option<ReceivedFrame<'_>> {
+        let deadline = Instant::now() + timeout;
+        loop {
+            let slot = self.channel.header().latest.swap(NO_SLOT, Ordering::AcqRel);
+            if slot != NO_SLOT && (slot as usize) < SLOT_COUNT && slot != self.reading {
+                let header = self.channel.header();
+                header.slot_states[slot as usize].store(SLOT_READING, Ordering::Relaxed);
+                if self.reading != NO_SLOT {
+                    header.slot_states[self.reading as usize].store(SLOT_FREE, Ordering::Release);
+                }
+                self.reading = slot;
+
+                let frame_id = unsafe { (*self.channel.info(slot)).request.frame_id };
+                self.reading_latency = self
+                    .requested_at
+                    .iter()
+                    .find(|(id, _)| *id == frame_id)
+                    .map(|(_, requested_at)| requested_at.elapsed());
+                break;
+            }
+
+            let now = Instant::now();
+            if now >= deadline || !self.channel.frame_signal.wait(deadline - now) {
+                break;
+            }
+        }
+
+        if self.reading == NO_SLOT {
+            return None;
+        }
+        Some(ReceivedFrame {
+            channel: &self.channel,
+            slot: self.reading,
+            info: unsafe { *self.channel.info(self.reading) },
+            latency: self.reading_latency,
+        })
+    }
+}
+
+/// A frame the compositor may read until it acquires the next one.
+pub struct ReceivedFrame<'a> {
+    channel: &'a Channel,
+    slot: u32,
+    pub info: FrameInfo,
+    /// Time from publishing the request to receiving this frame, when the request was recent enough to be known.
+    pub latency: Option<Duration>,
+}
+
+impl<'a> ReceivedFrame<'a> {
+    /// Panics unless `eye < EYE_COUNT`.
+    pub fn eye(&self, eye: usize) -> &[u8] {
+        unsafe { slice::from_raw_parts(self.channel.eye_ptr(self.slot, eye), self.channel.layout.eye_len()) }
+    }
+
+    pub fn row_pitch(&self) -> u32 {
+        self.channel.layout.row_pitch
+    }
+}
+
+/// The end in the content process.
+pub struct Content {
+    channel: Channel,
+    last_frame_id: u64,
+}
+
+impl Content {
+    /// Open the transport created by the compositor. Takes ownership of the handles.
+    pub fn open(handles: TransportHandles) -> io::Result<Content> {
+        let (memory, request_signal, frame_signal) = platform::open(handles)?;
+        let header = unsafe { &*(memory.as_ptr() as *const Header) };
+        if header.magic != MAGIC || header.version != VERSION {
+            return Err(io::Error::new(io::ErrorKind::InvalidData, "Not a frame transport of this version"));
+        }
+        let layout = Layout::new(header.width, header.height);
+        if header.row_pitch != layout.row_pitch
+            || header.slot_offset as usize != layout.slot_offset
+            || header.slot_size as usize != layout.slot_size
+        {
+            return Err(io::Error::new(io::ErrorKind::InvalidData, "Unexpected frame transport layout"));
+        }
+        Ok(Content {
+            channel: Channel {
+                layout,
+                memory,
+                request_signal,
+                frame_signal,
+            },
+            last_frame_id: 0,
+        })
+    }
+
+    pub fn width(&self) -> u32 {
+        self.channel.layout.width
+    }
+
+    pub fn height(&self) -> u32 {
+        self.channel.layout.height
+    }
+
+    /// Wait up to `timeout` for a request newer than the last one returned.
+    pub fn wait_for_request(&mut self, timeout: Duration) -> Option<FrameRequest> {
+        let deadline = Instant::now() + timeout;
+        loop {
+            if let Some(request) = self.read_request() {
+                if request.frame_id > self.last_frame_id {
+                    self.last_frame_id = request.frame_id;
+                    return Some(request);
+                }
+            }
+            let now = Instant::now();
+            if now >= deadline || !self.channel.request_signal.wait(deadline - now) {
+                return None;
+            }
+        }
+    }
+
+    fn read_request(&self) -> Option<FrameRequest> {
+        let header = self.channel.header();
+        loop {
+            let before = header.request_sequence.load(Ordering::Acquire);
+            if before == 0 {
+                return None;
+            }
+            if before % 2 == 1 {
+                std::hint::spin_loop();
+                continue;
+            }
+            let request = unsafe { ptr::read_volatile(ptr::addr_of!(header.request)) };
+            fence(Ordering::Acquire);
+            if header.request_sequence.load(Ordering::Relaxed) == before {
+                return Some(request);
+            }
+        }
+    }
+
+    /// A free slot to render the next frame into. One is always free unless the compositor holds more than one.
+    pub fn begin_frame(&mut self) -> Option<FrameWriter<'_>> {
+        let channel = &self.channel;
+        let header = channel.header();
+        (0..SLOT_COUNT as u32)
+            .find(|&slot| {
+                header.slot_states[slot as usize]
+                    .compare_exchange(SLOT_FREE, SLOT_WRITING, Ordering::Acquire, Ordering::Relaxed)
+                    .is_ok()
+            })
+            .map(|slot| FrameWriter {
+                channel,
+                slot,
+                published: false,
+            })
+    }
+}
+
+/// A slot content renders into. Dropping it without publishing returns the slot unused.
+pub struct FrameWriter<'a> {
+    channel: &'a Channel,
+    slot: u32,
+    published: bool,
+}
+
+impl<'a> FrameWriter<'a> {
+    /// Panics unless `eye < EYE_COUNT`.
+    pub fn eye_mut(&mut self, eye: usize) -> &mut [u8] {
+        unsafe { slice::from_raw_parts_mut(self.channel.eye_ptr(self.slot, eye), self.channel.layout.eye_len()) }
+    }
+
+    pub fn row_pitch(&self) -> u32 {
+        self.channel.layout.row_pitch
+    }
+
+    /// Make this the latest frame, replacing one the compositor did not pick up yet.
+    pub fn publish(mut self, request: &FrameRequest, render_time: Duration) {
+        unsafe {
+            ptr::write(
+                self.channel.info(self.slot),
+                FrameInfo {
+                    request: *request,
+                    render_nanos: render_time.as_nanos() as u64,
+                },
+            );
+        }
+        let header = self.channel.header();
+        header.slot_states[self.slot as usize].store(SLOT_READY, Ordering::Release);
+        let replaced = header.latest.swap(self.slot, Ordering::AcqRel);
+        if (replaced as usize) < SLOT_COUNT {
+            header.slot_states[replaced as usize].store(SLOT_FREE, Ordering::Release);
+        }
+        self.published = true;
+        self.channel.frame_signal.notify();
+    }
+}
+
+impl<'a> Drop for FrameWriter<'a> {
+    fn drop(&mut self) {
+        if !self.published {
+            self.channel.header().slot_states[self.slot as usize].store(SLOT_FREE, Ordering::Release);
+        }
+    }
+}
+
+#[cfg(target_os = "linux")]
+mod platform {
+    use std::io;
+    use std::os::unix::io::RawFd;
+    use std::ptr;
+    use std::time::Duration;
+
+    /// File descriptors to pass to the content process, by inheritance or SCM_RIGHTS.
+    pub struct TransportHandles {
+        pub memory: RawFd,
+        pub request: RawFd,
+        pub frame: RawFd,
+    }
+
+    fn check(result: libc::c_int) -> io::Result<libc::c_int> {
+        if result < 0 {
+            Err(io::Error::last_os_error())
+        } else {
+            Ok(result)
+        }
+    }
+
+    pub struct SharedMemory {
+        fd: RawFd,
+        ptr: *mut u8,
+        len: usize,
+    }
+
+    impl SharedMemory {
+        pub fn create(name: &str, len: usize) -> io::Result<SharedMemory> {
+            let name = std::ffi::CString::new(name).unwrap();
+            unsafe {
+                let fd = check(libc::memfd_create(name.as_ptr(), libc::MFD_CLOEXEC | libc::MFD_ALLOW_SEALING))?;
+                if let Err(error) = check(libc::ftruncate(fd, len as libc::off_t)) {
+                    libc::close(fd);
+                    return Err(error);
+                }
+                // Content is sandboxed and untrusted: it must not be able to shrink the memory under the compositor.
+                check(libc::fcntl(fd, libc::F_ADD_SEALS, libc::F_SEAL_SHRINK | libc::F_SEAL_GROW | libc::F_SEAL_SEAL))?;
+                SharedMemory::map(fd, len)
+            }
+        }
+
+        pub fn open(fd: RawFd) -> io::Result<SharedMemory> {
+            unsafe {
+                let mut stat: libc::stat = std::mem::zeroed();
+                check(libc::fstat(fd, &mut stat))?;
+                SharedMemory::map(fd, stat.st_size as usize)
+            }
+        }
+
+        unsafe fn map(fd: RawFd, len: usize) -> io::Result<SharedMemory> {
+            let ptr = libc::mmap(ptr::null_mut(), len, libc::PROT_READ | libc::PROT_WRITE, libc::MAP_SHARED, fd, 0);
+            if ptr == libc::MAP_FAILED {
+                let error = io::Error::last_os_error();
+                libc::close(fd);
+                return Err(error);
+            }
+            Ok(SharedMemory {
+                fd,
+                ptr: ptr as *mut u8,
+                len,
+            })
+        }
+
+        pub fn as_ptr(&self) -> *mut u8 {
+            self.ptr
+        }
+    }
+
+    impl Drop for SharedMemory {
+        fn drop(&mut self) {
+            unsafe {
+                libc::munmap(self.ptr as *mut _, self.len);
+                libc::close(self.fd);
+            }
+        }
+    }
+
+    /// An eventfd, so waiting costs nothing while the other side is busy.
+    pub struct Signal {
+        fd: RawFd,
+    }
+
+    impl Signal {
+        pub fn create(_name: &str, _purpose: &str) -> io::Result<Signal> {
+            let fd = check(unsafe { libc::eventfd(0, libc::EFD_CLOEXEC | libc::EFD_NONBLOCK) })?;
+            Ok(Signal { fd })
+        }
+
+        pub fn notify(&self) {
+            let one: u64 = 1;
+            unsafe {
+                libc::write(self.fd, &one as *const u64 as *const _, 8);
+            }
+        }
+
+        /// Returns false on timeout.
+        pub fn wait(&self, timeout: Duration) -> bool {
+            let mut poll_fd = libc::pollfd {
+                fd: self.fd,
+                events: libc::POLLIN,
+                revents: 0,
+            };
+            let timeout_ms = timeout.as_millis().min(libc::c_int::MAX as u128) as libc::c_int;
+            if unsafe { libc::poll(&mut poll_fd, 1, timeout_ms) } <= 0 {
+                return false;
+            }
+            let mut count: u64 = 0;
+            unsafe {
+                libc::read(self.fd, &mut count as *mut u64 as *mut _, 8);
+            }
+            true
+        }
+    }
+
+    impl Drop for Signal {
+        fn drop(&mut self) {
+            unsafe {
+                libc::close(self.fd);
+            }
+        }
+    }
+
+    /// The compositor keeps its descriptors, so the content process gets duplicates.
+    pub fn handles(memory: &SharedMemory, request: &Signal, frame: &Signal) -> TransportHandles {
+        unsafe {
+            TransportHandles {
+                memory: libc::dup(memory.fd),
+                request: libc::dup(request.fd),
+                frame: libc::dup(frame.fd),
+            }
+        }
+    }
+
+    pub fn open(handles: TransportHandles) -> io::Result<(SharedMemory, Signal, Signal)> {
+        let request = Signal { fd: handles.request };
+        let frame = Signal { fd: handles.frame };
+        Ok((SharedMemory::open(handles.memory)?, request, frame))
+    }
+}
+
+#[cfg(windows)]
+mod platform {
+    use std::ffi::OsStr;
+    use std::io;
+    use std::os::windows::ffi::OsStrExt;
+    use std::ptr;
+    use std::time::Duration;
+    use winapi::shared::minwindef::FALSE;
+    use winapi::um::handleapi::{CloseHandle, INVALID_HANDLE_VALUE};
+    use winapi::um::memoryapi::{CreateFileMappingW, MapViewOfFile, OpenFileMappingW, UnmapViewOfFile, FILE_MAP_ALL_ACCESS};
+    use winapi::um::synchapi::{CreateEventW, OpenEventW, SetEvent, WaitForSingleObject};
+    use winapi::um::winbase::WAIT_OBJECT_0;
+    use winapi::um::winnt::{EVENT_MODIFY_STATE, HANDLE, PAGE_READWRITE, SYNCHRONIZE};
+
+    /// Named objects the content process opens by name.
+    pub struct TransportHandles {
+        pub name: String,
+    }
+
+    fn wide(name: &str, purpose: &str) -> Vec<u16> {
+        OsStr::new(&format!("{}.{}", name, purpose)).encode_wide().chain(Some(0)).collect()
+    }
+
+    fn check(handle: HANDLE) -> io::Result<HANDLE> {
+        if handle.is_null() {
+            Err(io::Error::last_os_error())
+        } else {
+            Ok(handle)
+        }
+    }
+
+    pub struct SharedMemory {
+        name: String,
+        mapping: HANDLE,
+        ptr: *mut u8,
+    }
+
+    impl SharedMemory {
+        pub fn create(name: &str, len: usize) -> io::Result<SharedMemory> {
+            let mapping = check(unsafe {
+                CreateFileMappingW(
+                    INVALID_HANDLE_VALUE,
+                    ptr::null_mut(),
+                    PAGE_READWRITE,
+                    (len as u64 >> 32) as u32,
+                    len as u32,
+                    wide(name, "frames").as_ptr(),
+                )
+            })?;
+            SharedMemory::map(name, mapping)
+        }
+
+        pub fn open(name: &str) -> io::Result<SharedMemory> {
+            let mapping = check(unsafe { OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, wide(name, "frames").as_ptr()) })?;
+            SharedMemory::map(name, mapping)
+        }
+
+        fn map(name: &str, mapping: HANDLE) -> io::Result<SharedMemory> {
+            let ptr = unsafe { MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) };
+            if ptr.is_null() {
+                let error = io::Error::last_os_error();
+                unsafe {
+                    CloseHandle(mapping);
+                }
+                return Err(error);
+            }
+            Ok(SharedMemory {
+                name: name.to_owned(),
+                mapping,
+                ptr: ptr as *mut u8,
+            })
+        }
+
+        pub fn as_ptr(&self) -> *mut u8 {
+            self.ptr
+        }
+    }
+
+    impl Drop for SharedMemory {
+        fn drop(&mut self) {
+            unsafe {
+                UnmapViewOfFile(self.ptr as *const _);
+                CloseHandle(self.mapping);
+            }
+        }
+    }
+
+    /// An auto-reset event, so waiting costs nothing while the other side is busy.
+    pub struct Signal {
+        event: HANDLE,
+    }
+
+    impl Signal {
+        pub fn create(name: &str, purpose: &str) -> io::Result<Signal> {
+            let event = check(unsafe { CreateEventW(ptr::null_mut(), FALSE, FALSE, wide(name, purpose).as_ptr()) })?;
+            Ok(Signal { event })
+        }
+
+        fn open(name: &str, purpose: &str) -> io::Result<Signal> {
+            let event = check(unsafe {
+                OpenEventW(SYNCHRONIZE | EVENT_MODIFY_STATE, FALSE, wide(name, purpose).as_ptr())
+            })?;
+            Ok(Signal { event })
+        }
+
+        pub fn notify(&self) {
+            unsafe {
+                SetEvent(self.event);
+            }
+        }
+
+        /// Returns false on timeout.
+        pub fn wait(&self, timeout: Duration) -> bool {
+            let timeout_ms = timeout.as_millis().min(u32::MAX as u128 - 1) as u32;
+            unsafe { WaitForSingleObject(self.event, timeout_ms) == WAIT_OBJECT_0 }
+        }
+    }
+
+    impl Drop for Signal {
+        fn drop(&mut self) {
+            unsafe {
+                CloseHandle(self.event);
+            }
+        }
+    }
+
+    pub fn handles(memory: &SharedMemory, _request: &Signal, _frame: &Signal) -> TransportHandles {
+        TransportHandles {
+            name: memory.name.clone(),
+        }
+    }
+
+    pub fn open(handles: TransportHandles) -> io::Result<(SharedMemory, Signal, Signal)> {
+        Ok((
+            SharedMemory::open(&handles.name)?,
+            Signal::open(&handles.name, "request")?,
+            Signal::open(&handles.name, "frame")?,
+        ))
+    }
+}
+
+#[cfg(all(test, target_os = "linux"))]
+mod tests {
+    use super::*;
+    use openxr::{Quaternionf, Vector3f};
+    use std::thread;
+
+    const WIDTH: u32 = 256;
+    const HEIGHT: u32 = 128;
+    const FRAME_COUNT: u64 = 10000;
+
+    fn pattern(frame_id: u64, eye: usize) -> u8 {
+        (frame_id as u8).wrapping_mul(2).wrapping_add(eye as u8)
+    }
+
+    fn views() -> ([Posef; EYE_COUNT], [Fovf; EYE_COUNT]) {
+        let pose = Posef {
+            orientation: Quaternionf { x: 0., y: 0., z: 0., w: 1. },
+            position: Vector3f { x: 0., y: 0., z: 0. },
+        };
+        let fov = Fovf {
+            angle_left: -0.8,
+            angle_right: 0.8,
+            angle_up: 0.8,
+            angle_down: -0.8,
+        };
+        ([pose; EYE_COUNT], [fov; EYE_COUNT])
+    }
+
+    /// Returns the id of the frame after checking it is whole and not older than the last one received.
+    fn check_frame(frame: &ReceivedFrame, last_received: u64) -> u64 {
+        let frame_id = frame.info.request.frame_id;
+        assert!(frame_id >= last_received, "frame {} after frame {}", frame_id, last_received);
+        assert_eq!(frame.info.render_nanos, frame_id);
+        for eye in 0..EYE_COUNT {
+            let expected = vec![pattern(frame_id, eye); frame.eye(eye).len()];
+            assert!(frame.eye(eye) == &expected[..], "frame {} eye {} is torn", frame_id, eye);
+        }
+        frame_id
+    }
+
+    /// Content fills every byte of a frame from its request, the compositor checks each frame it receives is whole.
+    #[test]
+    fn frames_are_never_torn() {
+        let mut compositor = Compositor::create("transport-test", WIDTH, HEIGHT).unwrap();
+        let handles = compositor.handles();
+
+        let content = thread::spawn(move || {
+            let mut content = Content::open(handles).unwrap();
+            while let Some(request) = content.wait_for_request(Duration::from_secs(5)) {
+                let mut writer = content.begin_frame().expect("a free slot");
+                for eye in 0..EYE_COUNT {
+                    writer.eye_mut(eye).fill(pattern(request.frame_id, eye));
+                }
+                writer.publish(&request, Duration::from_nanos(request.frame_id));
+                if request.frame_id == FRAME_COUNT {
+                    break;
+                }
+            }
+        });
+
+        let (poses, fovs) = views();
+        let mut last_received = 0;
+        for _ in 0..FRAME_COUNT {
+            compositor.request_frame(0, poses, fovs);
+            if let Some(frame) = compositor.acquire_frame(Duration::from_micros(100)) {
+                last_received = check_frame(&frame, last_received);
+            }
+        }
+
+        // The last request is the latest one content sees, so it is always answered.
+        let deadline = Instant::now() + Duration::from_secs(5);
+        while last_received != FRAME_COUNT && Instant::now() < deadline {
+            if let Some(frame) = compositor.acquire_frame(Duration::from_millis(10)) {
+                last_received = check_frame(&frame, last_received);
+            }
+        }
+        assert_eq!(last_received, FRAME_COUNT);
+        content.join().unwrap();
+    }
+
+    /// Opens both ends in this thread and publishes one frame answering the first request.
+    fn publish_one_frame(name: &str) -> (Compositor, Content, FrameRequest) {
+        let mut compositor = Compositor::create(name, WIDTH, HEIGHT).unwrap();
+        let mut content = Content::open(compositor.handles()).unwrap();
+        let (poses, fovs) = views();
+        compositor.request_frame(0, poses, fovs);
+        let request = content.wait_for_request(Duration::from_secs(5)).unwrap();
+        let mut writer = content.begin_frame().unwrap();
+        for eye in 0..EYE_COUNT {
+            writer.eye_mut(eye).fill(pattern(request.frame_id, eye));
+        }
+        writer.publish(&request, Duration::from_nanos(request.frame_id));
+        (compositor, content, request)
+    }
+
+    /// Content can write anything into the header. The compositor keeps the layout it created and ignores
+    /// published slots that are out of range.
+    #[test]
+    fn compositor_ignores_corrupt_header() {
+        let (mut compositor, content, request) = publish_one_frame("transport-corrupt-test");
+        unsafe {
+            let header = content.channel.memory.as_ptr() as *mut Header;
+            (*header).height = u32::MAX;
+            (*header).row_pitch = u32::MAX;
+            (*header).slot_offset = u32::MAX;
+            (*header).slot_size = u64::MAX;
+        }
+        let frame = compositor.acquire_frame(Duration::from_secs(5)).expect("the published frame");
+        assert_eq!(frame.row_pitch(), WIDTH * BYTES_PER_PIXEL);
+        assert_eq!(check_frame(&frame, 0), request.frame_id);
+
+        for slot in [SLOT_COUNT as u32, NO_SLOT - 1] {
+            content.channel.header().latest.store(slot, Ordering::Release);
+            let frame = compositor.acquire_frame(Duration::from_millis(1)).expect("the previous frame");
+            assert_eq!(check_frame(&frame, 0), request.frame_id);
+        }
+    }
+
+    #[test]
+    #[should_panic(expected = "out of range")]
+    fn eye_out_of_range_panics() {
+        let (mut compositor, _content, _request) = publish_one_frame("transport-eye-test");
+        let frame = compositor.acquire_frame(Duration::from_secs(5)).expect("the published frame");
+        frame.eye(EYE_COUNT);
+    }
+}
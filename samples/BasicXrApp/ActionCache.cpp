@@ -0,0 +1,176 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "ActionCache.h"
+
+namespace sample::input {
+    template <typename StateType, typename CallbackType>
+    uint32_t ActionCache::Table<StateType, CallbackType>::Add(XrAction action,
+                                                               XrPath subactionPath,
+                                                               StateType initialState,
+                                                               CallbackType callback) {
+        XrActionStateGetInfo getInfo{XR_TYPE_ACTION_STATE_GET_INFO};
+        getInfo.action = action;
+        getInfo.subactionPath = subactionPath;
+
+        GetInfos.push_back(getInfo);
+        States.push_back(initialState);
+        Callbacks.push_back(std::move(callback));
+        Changed.reserve(GetInfos.size());
+        return (uint32_t)GetInfos.size() - 1;
+    }
+
+    template <typename StateType, typename CallbackType>
+    void ActionCache::Table<StateType, CallbackType>::Reserve(uint32_t count) {
+        GetInfos.reserve(count);
+        States.reserve(count);
+        Callbacks.reserve(count);
+        Changed.reserve(count);
+    }
+
+    void ActionCache::Reserve(uint32_t booleanCount, uint32_t floatCount, uint32_t vector2fCount, uint32_t poseCount) {
+        m_booleans.Reserve(booleanCount);
+        m_floats.Reserve(floatCount);
+        m_vector2fs.Reserve(vector2fCount);
+        m_poses.Reserve(poseCount);
+    }
+
+    void ActionCache::AddActiveActionSet(XrActionSet actionSet, XrPath subactionPath) {
+        m_activeActionSets.push_back({actionSet, subactionPath});
+    }
+
+    BooleanSlot ActionCache::RegisterBoolean(XrAction action, XrPath subactionPath, BooleanCallback onChanged) {
+        return {m_booleans.Add(action, subactionPath, {XR_TYPE_ACTION_STATE_BOOLEAN}, std::move(onChanged))};
+    }
+
+    FloatSlot ActionCache::RegisterFloat(XrAction action, XrPath subactionPath, FloatCallback onChanged) {
+        return {m_floats.Add(action, subactionPath, {XR_TYPE_ACTION_STATE_FLOAT}, std::move(onChanged))};
+    }
+
+    Vector2fSlot ActionCache::RegisterVector2f(XrAction action, XrPath subactionPath, Vector2fCallback onChanged) {
+        return {m_vector2fs.Add(action, subactionPath, {XR_TYPE_ACTION_STATE_VECTOR2F}, std::move(onChanged))};
+    }
+
+    PoseSlot ActionCache::RegisterPose(XrAction action, XrPath subactionPath, PoseCallback onChanged) {
+        return {m_poses.Add(action, subactionPath, {XR_TYPE_ACTION_STATE_POSE}, std::move(onChanged))};
+    }
+
+    void ActionCache::Sync(const dispatch::DispatchTable& dispatch, XrSession session) {
+        SyncAndRefresh(dispatch, session);
+        Dispatch();
+    }
+
+    void ActionCache::SyncAndRefresh(const dispatch::DispatchTable& dispatch, XrSession session) {
+        CHECK(!m_activeActionSets.empty());
+
+        XrActionsSyncInfo syncInfo{XR_TYPE_ACTIONS_SYNC_INFO};
+        syncInfo.countActiveActionSets = (uint32_t)m_activeActionSets.size();
+        syncInfo.activeActionSets = m_activeActionSets.data();
+        CHECK_XRCMD(dispatch.xrSyncActions(session, &syncInfo));
+
+        // The get-info structs are prebuilt at registration, so each refresh is a straight walk over flat arrays.
+        // Changed indices are appended within the capacity reserved at registration and never allocate. Every changed
+        // slot is recorded, slots without a callback are only skipped at dispatch.
+        m_booleans.Changed.clear();
+        for (uint32_t i = 0; i < (uint32_t)m_booleans.States.size(); i++) {
+            XrActionStateBoolean& state = m_booleans.States[i];
+            CHECK_XRCMD(dispatch.xrGetActionStateBoolean(session, &m_booleans.GetInfos[i], &state));
+            if (state.changedSinceLastSync) {
+                m_booleans.Changed.push_back(i);
+            }
+        }
+
+        m_floats.Changed.clear();
+        for (uint32_t i = 0; i < (uint32_t)m_floats.States.size(); i++) {
+            XrActionStateFloat& state = m_floats.States[i];
+            CHECK_XRCMD(dispatch.xrGetActionStateFloat(session, &m_floats.GetInfos[i], &state));
+            if (state.changedSinceLastSync) {
+                m_floats.Changed.push_back(i);
+            }
+        }
+
+        m_vector2fs.Changed.clear();
+        for (uint32_t i = 0; i < (uint32_t)m_vector2fs.States.size(); i++) {
+            XrActionStateVector2f& state = m_vector2fs.States[i];
+            CHECK_XRCMD(dispatch.xrGetActionStateVector2f(session, &m_vector2fs.GetInfos[i], &state));
+            if (state.changedSinceLastSync) {
+                m_vector2fs.Changed.push_back(i);
+            }
+        }
+
+        // Pose actions have no changedSinceLastSync, so compare isActive against the previous refresh instead.
+        m_poses.Changed.clear();
+        for (uint32_t i = 0; i < (uint32_t)m_poses.States.size(); i++) {
+            XrActionStatePose& state = m_poses.States[i];
+            const XrBool32 wasActive = state.isActive;
+            CHECK_XRCMD(dispatch.xrGetActionStatePose(session, &m_poses.GetInfos[i], &state));
+            if (state.isActive != wasActive) {
+                m_poses.Changed.push_back(i);
+            }
+        }
+    }
+
+    void ActionCache::Dispatch() {
+        ForEachChange([this](const ActionChange& change) { Dispatch(change); });
+
+        m_booleans.Changed.clear();
+        m_floats.Changed.clear();
+        m_vector2fs.Changed.clear();
+        m_poses.Changed.clear();
+    }
+
+    void ActionCache::Dispatch(const ActionChange& change) const {
+        if (m_dispatchObserver) {
+            m_dispatchObserver(change);
+        }
+
+        switch (change.Kind) {
+        case ActionChange::ActionKind::Boolean:
+            if (m_booleans.Callbacks[change.Index]) {
+                m_booleans.Callbacks[change.Index](change.Boolean);
+            }
+            break;
+        case ActionChange::ActionKind::Float:
+            if (m_floats.Callbacks[change.Index]) {
+                m_floats.Callbacks[change.Index](change.Float);
+            }
+            break;
+        case ActionChange::ActionKind::Vector2f:
+            if (m_vector2fs.Callbacks[change.Index]) {
+                m_vector2fs.Callbacks[change.Index](change.Vector2f);
+            }
+            break;
+        case ActionChange::ActionKind::Pose:
+            if (m_poses.Callbacks[change.Index]) {
+                m_poses.Callbacks[change.Index](change.Pose);
+            }
+            break;
+        }
+    }
+
+    void ActionCache::ResetStates() {
+        std::fill(m_booleans.States.begin(), m_booleans.States.end(), XrActionStateBoolean{XR_TYPE_ACTION_STATE_BOOLEAN});
+        std::fill(m_floats.States.begin(), m_floats.States.end(), XrActionStateFloat{XR_TYPE_ACTION_STATE_FLOAT});
+        std::fill(m_vector2fs.States.begin(), m_vector2fs.States.end(), XrActionStateVector2f{XR_TYPE_ACTION_STATE_VECTOR2F});
+        std::fill(m_poses.States.begin(), m_poses.States.end(), XrActionStatePose{XR_TYPE_ACTION_STATE_POSE});
+
+        m_booleans.Changed.clear();
+        m_floats.Changed.clear();
+        m_vector2fs.Changed.clear();
+        m_poses.Changed.clear();
+    }
+} // namespace sample::input
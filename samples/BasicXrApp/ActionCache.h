@@ -0,0 +1,152 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <functional>
+#include "XrDispatch.h"
+
+namespace sample::input {
+
+    // Typed handles into the cache. They are plain indices, so lookups never search.
+    struct BooleanSlot {
+        uint32_t Index;
+    };
+    struct FloatSlot {
+        uint32_t Index;
+    };
+    struct Vector2fSlot {
+        uint32_t Index;
+    };
+    struct PoseSlot {
+        uint32_t Index;
+    };
+
+    // A state change found by SyncAndRefresh. It carries a copy of the new state, so it can be dispatched
+    // on another thread while the cache is already refreshing again.
+    struct ActionChange {
+        enum class ActionKind : uint8_t { Boolean, Float, Vector2f, Pose };
+        ActionKind Kind;
+        uint32_t Index;
+        union {
+            XrActionStateBoolean Boolean;
+            XrActionStateFloat Float;
+            XrActionStateVector2f Vector2f;
+            XrActionStatePose Pose;
+        };
+    };
+
+    // Holds the state of every registered action/subaction pair in flat arrays. All states are refreshed
+    // once per Sync() call, and callbacks only run for states that changed since the previous sync.
+    class ActionCache {
+    public:
+        using BooleanCallback = std::function<void(const XrActionStateBoolean&)>;
+        using FloatCallback = std::function<void(const XrActionStateFloat&)>;
+        using Vector2fCallback = std::function<void(const XrActionStateVector2f&)>;
+        using PoseCallback = std::function<void(const XrActionStatePose&)>; // Runs when isActive flips
+
+        // Registration is expected at startup. Reserve up front to avoid reallocation when binding many actions.
+        void Reserve(uint32_t booleanCount, uint32_t floatCount, uint32_t vector2fCount, uint32_t poseCount);
+
+        void AddActiveActionSet(XrActionSet actionSet, XrPath subactionPath = XR_NULL_PATH);
+
+        BooleanSlot RegisterBoolean(XrAction action, XrPath subactionPath, BooleanCallback onChanged = {});
+        FloatSlot RegisterFloat(XrAction action, XrPath subactionPath, FloatCallback onChanged = {});
+        Vector2fSlot RegisterVector2f(XrAction action, XrPath subactionPath, Vector2fCallback onChanged = {});
+        PoseSlot RegisterPose(XrAction action, XrPath subactionPath, PoseCallback onChanged = {});
+
+        // Calls xrSyncActions for all active action sets, refreshes every slot and dispatches edge callbacks.
+        void Sync(const dispatch::DispatchTable& dispatch, XrSession session);
+
+        // Refresh and dispatch are also available separately, so the two halves can run on different threads.
+        // In that case the refreshing thread copies changes out with ForEachChange and the other thread
+        // dispatches each of them, and Get() must only be called from the refreshing thread.
+        void SyncAndRefresh(const dispatch::DispatchTable& dispatch, XrSession session);
+        void Dispatch();
+        void Dispatch(const ActionChange& change) const;
+
+        // Called with every change before its callback runs, also for slots registered without a callback, e.g. to
+        // record the input a session consumed.
+        using DispatchObserver = std::function<void(const ActionChange&)>;
+        void SetDispatchObserver(DispatchObserver observer) {
+            m_dispatchObserver = std::move(observer);
+        }
+
+        template <typename Function>
+        void ForEachChange(Function&& function) const {
+            ActionChange change{};
+            change.Kind = ActionChange::ActionKind::Boolean;
+            for (uint32_t i : m_booleans.Changed) {
+                change.Index = i;
+                change.Boolean = m_booleans.States[i];
+                function(change);
+            }
+            change.Kind = ActionChange::ActionKind::Float;
+            for (uint32_t i : m_floats.Changed) {
+                change.Index = i;
+                change.Float = m_floats.States[i];
+                function(change);
+            }
+            change.Kind = ActionChange::ActionKind::Vector2f;
+            for (uint32_t i : m_vector2fs.Changed) {
+                change.Index = i;
+                change.Vector2f = m_vector2fs.States[i];
+                function(change);
+            }
+            change.Kind = ActionChange::ActionKind::Pose;
+            for (uint32_t i : m_poses.Changed) {
+                change.Index = i;
+                change.Pose = m_poses.States[i];
+                function(change);
+            }
+        }
+
+        const XrActionStateBoolean& Get(BooleanSlot slot) const {
+            return m_booleans.States[slot.Index];
+        }
+        const XrActionStateFloat& Get(FloatSlot slot) const {
+            return m_floats.States[slot.Index];
+        }
+        const XrActionStateVector2f& Get(Vector2fSlot slot) const {
+            return m_vector2fs.States[slot.Index];
+        }
+        const XrActionStatePose& Get(PoseSlot slot) const {
+            return m_poses.States[slot.Index];
+        }
+
+        // Drops the cached states, e.g. when the session they were read from is destroyed.
+        void ResetStates();
+
+    private:
+        template <typename StateType, typename CallbackType>
+        struct Table {
+            std::vector<XrActionStateGetInfo> GetInfos;
+            std::vector<StateType> States;
+            std::vector<CallbackType> Callbacks;
+            std::vector<uint32_t> Changed; // Indices changed in the last refresh, capacity reserved at registration.
+
+            uint32_t Add(XrAction action, XrPath subactionPath, StateType initialState, CallbackType callback);
+            void Reserve(uint32_t count);
+        };
+
+        std::vector<XrActiveActionSet> m_activeActionSets;
+        Table<XrActionStateBoolean, BooleanCallback> m_booleans;
+        Table<XrActionStateFloat, FloatCallback> m_floats;
+        Table<XrActionStateVector2f, Vector2fCallback> m_vector2fs;
+        Table<XrActionStatePose, PoseCallback> m_poses;
+        DispatchObserver m_dispatchObserver;
+    };
+
+} // namespace sample::input
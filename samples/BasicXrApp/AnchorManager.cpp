@@ -0,0 +1,380 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "AnchorManager.h"
+#include "HologramStore.h"
+#include <cfloat>
+#include <cmath>
+
+namespace {
+    constexpr uint32_t NoCluster = UINT32_MAX;
+
+    // Clusters without an anchor are where they were placed, as certain as the scene space itself.
+    constexpr XrSpaceLocationFlags FixedLocationFlags = XR_SPACE_LOCATION_ORIENTATION_VALID_BIT | XR_SPACE_LOCATION_POSITION_VALID_BIT |
+                                                        XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT | XR_SPACE_LOCATION_POSITION_TRACKED_BIT;
+
+    // Creating an anchor fails while positional tracking is lost, so fixed clusters are not retried every frame.
+    constexpr XrDuration CreateRetryInterval = 1'000'000'000; // 1s
+
+    float Length(const XrVector3f& v) {
+        return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    }
+
+    float Distance(const XrVector3f& a, const XrVector3f& b) {
+        return Length({a.x - b.x, a.y - b.y, a.z - b.z});
+    }
+
+    // The pose relative to a space at basePose, both in the scene.
+    XrPosef Relative(const XrPosef& poseInScene, const XrPosef& basePose) {
+        return xr::math::Pose::Multiply(poseInScene, xr::math::Pose::Invert(basePose));
+    }
+} // namespace
+
+namespace sample::anchors {
+    AnchorManager::AnchorManager(const dispatch::DispatchTable& dispatch,
+                                 XrSession session,
+                                 XrSpace sceneSpace,
+                                 bool anchorsSupported,
+                                 persistence::AnchorStore* store,
+                                 const Options& options)
+        : m_dispatch(dispatch)
+        , m_session(session)
+        , m_sceneSpace(sceneSpace)
+        , m_anchorsSupported(anchorsSupported)
+        , m_store(store)
+        , m_options(options) {
+        CHECK_MSG(m_options.MaxAnchors > 0, "At least one anchor is needed");
+        CHECK(m_store == nullptr || m_anchorsSupported);
+    }
+
+    AttachmentId AnchorManager::Place(const XrPosef& poseInScene, XrTime time) {
+        float distance = 0;
+        uint32_t cluster = FindNearestCluster(poseInScene.position, &distance);
+        if (cluster == NoCluster || (distance > m_options.ClusterRadius && HasAnchorBudget())) {
+            cluster = AddCluster(poseInScene);
+            if (m_anchorsSupported) {
+                CreateAnchor(cluster, time);
+            }
+        }
+        return Attach(cluster, Relative(poseInScene, m_clusters[cluster].PoseInScene), time);
+    }
+
+    AttachmentId AnchorManager::Restore(
+        uint64_t anchorId, const XrPosef& poseInAnchor, const XrPosef& poseInScene, XrTime time, bool* requestAnchor) {
+        *requestAnchor = false;
+        if (anchorId != 0 && m_store != nullptr) {
+            const auto it = m_persistedClusters.find(anchorId);
+            if (it != m_persistedClusters.end()) {
+                return Attach(it->second, poseInAnchor, 0);
+            }
+            if (HasAnchorBudget()) {
+                // Until it resolves, the anchor is expected where it was relative to the saved hologram.
+                const uint32_t cluster = AddCluster(xr::math::Pose::Multiply(xr::math::Pose::Invert(poseInAnchor), poseInScene));
+                m_clusters[cluster].State = ClusterState::Pending;
+                m_clusters[cluster].PersistedId = anchorId;
+                m_persistedClusters.emplace(anchorId, cluster);
+                m_anchorCount++;
+                *requestAnchor = true;
+                return Attach(cluster, poseInAnchor, 0);
+            }
+        }
+        return Place(poseInScene, time);
+    }
+
+    void AnchorManager::ResolvePersisted(uint64_t anchorId, XrSpatialAnchorMSFT anchor) {
+        const auto it = m_persistedClusters.find(anchorId);
+        if (it == m_persistedClusters.end()) {
+            if (anchor != XR_NULL_HANDLE) {
+                m_dispatch.xrDestroySpatialAnchorMSFT(anchor);
+            }
+            return;
+        }
+
+        const uint32_t cluster = it->second;
+        CHECK(m_clusters[cluster].State == ClusterState::Pending);
+        if (anchor == XR_NULL_HANDLE) {
+            // Its holograms stay where they were saved until Update anchors the cluster again.
+            m_persistedClusters.erase(it);
+            m_clusters[cluster].State = ClusterState::Fixed;
+            m_clusters[cluster].PersistedId = 0;
+            m_anchorCount--;
+            return;
+        }
+        *m_clusters[cluster].Anchor.Put(m_dispatch.xrDestroySpatialAnchorMSFT) = anchor;
+        CreateAnchorSpace(cluster);
+    }
+
+    void AnchorManager::Update(XrTime predictedDisplayTime, XrTime displayTime, const prediction::PredictionOptions& options) {
+        // One anchor created or destroyed per frame at most, a large change settles over a few frames.
+        if (m_anchorsSupported && !AnchorFixedCluster(predictedDisplayTime) && !SplitCluster(predictedDisplayTime)) {
+            MergeClusters();
+        }
+
+        m_stats.Clusters = m_stats.LocateCalls = m_stats.UnclusteredLocateCalls = m_stats.PendingAnchors = 0;
+        for (Cluster& cluster : m_clusters) {
+            if (cluster.State != ClusterState::Free) {
+                m_stats.Clusters++;
+            }
+            if (cluster.State == ClusterState::Pending) {
+                m_stats.PendingAnchors++;
+            }
+            if (cluster.State != ClusterState::Anchored) {
+                continue;
+            }
+
+            XrPosef pose;
+            cluster.LocateTime = predictedDisplayTime;
+            if (predictedDisplayTime - cluster.PlacementTime < options.RecentPlacementWindow) {
+                prediction::LocateAndPredict(m_dispatch,
+                                             cluster.Space.Get(),
+                                             m_sceneSpace,
+                                             predictedDisplayTime,
+                                             displayTime,
+                                             options,
+                                             cluster.Velocity,
+                                             &cluster.Location,
+                                             &cluster.LocatedVelocity,
+                                             &pose);
+            } else {
+                cluster.Location = {XR_TYPE_SPACE_LOCATION};
+                cluster.LocatedVelocity = {XR_TYPE_SPACE_VELOCITY};
+                CHECK_XRCMD(m_dispatch.xrLocateSpace(cluster.Space.Get(), m_sceneSpace, predictedDisplayTime, &cluster.Location));
+                pose = cluster.Location.pose;
+            }
+            if (xr::math::Pose::IsPoseValid(cluster.Location)) {
+                cluster.PoseInScene = pose;
+            }
+            m_stats.LocateCalls++;
+            m_stats.UnclusteredLocateCalls += cluster.Members;
+        }
+    }
+
+    XrSpaceLocationFlags AnchorManager::Locate(AttachmentId attachment, XrPosef* poseInScene) const {
+        const Attachment& placed = m_attachments[attachment];
+        const Cluster& cluster = m_clusters[placed.Cluster];
+        *poseInScene = xr::math::Pose::Multiply(placed.PoseInAnchor, cluster.PoseInScene);
+        return cluster.State == ClusterState::Anchored ? cluster.Location.locationFlags : FixedLocationFlags;
+    }
+
+    uint64_t AnchorManager::PersistedAnchorId(AttachmentId attachment) const {
+        return m_clusters[m_attachments[attachment].Cluster].PersistedId;
+    }
+
+    XrPosef AnchorManager::PoseInAnchor(AttachmentId attachment) const {
+        return m_attachments[attachment].PoseInAnchor;
+    }
+
+    bool AnchorManager::HasAnchorBudget() const {
+        return !m_anchorsSupported || m_anchorCount < m_options.MaxAnchors;
+    }
+
+    uint32_t AnchorManager::FindNearestCluster(const XrVector3f& position, float* distance) const {
+        uint32_t nearest = NoCluster;
+        *distance = FLT_MAX;
+        for (uint32_t i = 0; i < m_clusters.size(); i++) {
+            if (m_clusters[i].State != ClusterState::Free) {
+                const float clusterDistance = Distance(position, m_clusters[i].PoseInScene.position);
+                if (clusterDistance < *distance) {
+                    *distance = clusterDistance;
+                    nearest = i;
+                }
+            }
+        }
+        return nearest;
+    }
+
+    uint32_t AnchorManager::AddCluster(const XrPosef& poseInScene) {
+        uint32_t cluster;
+        if (!m_freeClusters.empty()) {
+            cluster = m_freeClusters.back();
+            m_freeClusters.pop_back();
+            m_clusters[cluster] = {};
+        } else {
+            cluster = (uint32_t)m_clusters.size();
+            m_clusters.emplace_back();
+        }
+        m_clusters[cluster].State = ClusterState::Fixed;
+        m_clusters[cluster].PoseInScene = poseInScene;
+        return cluster;
+    }
+
+    void AnchorManager::FreeCluster(uint32_t cluster) {
+        Cluster& freed = m_clusters[cluster];
+        if (freed.State == ClusterState::Anchored || freed.State == ClusterState::Pending) {
+            m_anchorCount--;
+        }
+        if (freed.PersistedId != 0) {
+            m_persistedClusters.erase(freed.PersistedId); // The store forgets it when the scene is saved without it
+        }
+        freed = {};
+        m_freeClusters.push_back(cluster);
+    }
+
+    bool AnchorManager::CreateAnchor(uint32_t cluster, XrTime time) {
+        Cluster& anchored = m_clusters[cluster];
+        XrSpatialAnchorCreateInfoMSFT createInfo{XR_TYPE_SPATIAL_ANCHOR_CREATE_INFO_MSFT};
+        createInfo.space = m_sceneSpace;
+        createInfo.pose = anchored.PoseInScene;
+        createInfo.time = time;
+        const XrResult result =
+            m_dispatch.xrCreateSpatialAnchorMSFT(m_session, &createInfo, anchored.Anchor.Put(m_dispatch.xrDestroySpatialAnchorMSFT));
+        if (result == XR_ERROR_CREATE_SPATIAL_ANCHOR_FAILED_MSFT) {
+            DEBUG_PRINT("Anchor cannot be created, likely due to lost positional tracking.");
+            m_lastCreateFailure = time;
+            return false;
+        }
+        CHECK_XRRESULT(result, "xrCreateSpatialAnchorMSFT");
+
+        m_anchorCount++;
+        anchored.PlacementTime = time;
+        CreateAnchorSpace(cluster);
+        if (m_store != nullptr) {
+            anchored.PersistedId = std::max<uint64_t>(1, m_anchorIds()); // Zero means no anchor
+            m_store->Persist(anchored.PersistedId, anchored.Anchor.Get());
+            m_persistedClusters.emplace(anchored.PersistedId, cluster);
+        }
+        return true;
+    }
+
+    void AnchorManager::CreateAnchorSpace(uint32_t cluster) {
+        Cluster& anchored = m_clusters[cluster];
+        XrSpatialAnchorSpaceCreateInfoMSFT createSpaceInfo{XR_TYPE_SPATIAL_ANCHOR_SPACE_CREATE_INFO_MSFT};
+        createSpaceInfo.anchor = anchored.Anchor.Get();
+        createSpaceInfo.poseInAnchorSpace = xr::math::Pose::Identity();
+        CHECK_XRCMD(m_dispatch.xrCreateSpatialAnchorSpaceMSFT(m_session, &createSpaceInfo, anchored.Space.Put(m_dispatch.xrDestroySpace)));
+        anchored.State = ClusterState::Anchored;
+        anchored.Location = {XR_TYPE_SPACE_LOCATION}; // Invalid until the next Update locates it
+        anchored.Velocity.Reset();
+    }
+
+    AttachmentId AnchorManager::Attach(uint32_t cluster, const XrPosef& poseInAnchor, XrTime time) {
+        Cluster& joined = m_clusters[cluster];
+        joined.Members++;
+        joined.Extent = std::max(joined.Extent, Length(poseInAnchor.position));
+        joined.PlacementTime = std::max(joined.PlacementTime, time);
+        m_attachments.push_back({cluster, poseInAnchor});
+        return (AttachmentId)(m_attachments.size() - 1);
+    }
+
+    void AnchorManager::Move(Attachment& attachment, uint32_t cluster, const XrPosef& poseInScene) {
+        m_clusters[attachment.Cluster].Members--;
+        Cluster& joined = m_clusters[cluster];
+        attachment.Cluster = cluster;
+        attachment.PoseInAnchor = Relative(poseInScene, joined.PoseInScene);
+        joined.Members++;
+        joined.Extent = std::max(joined.Extent, Length(attachment.PoseInAnchor.position));
+    }
+
+    bool AnchorManager::AnchorFixedCluster(XrTime time) {
+        if (!HasAnchorBudget() || time - m_lastCreateFailure < CreateRetryInterval) {
+            return false;
+        }
+        for (uint32_t i = 0; i < m_clusters.size(); i++) {
+            if (m_clusters[i].State == ClusterState::Fixed && m_clusters[i].Members > 0) {
+                // The anchor is created at the cluster's pose, so its holograms keep their poses relative to it.
+                CreateAnchor(i, time);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool AnchorManager::SplitCluster(XrTime time) {
+        if (!HasAnchorBudget() || time - m_lastCreateFailure < CreateRetryInterval) {
+            return false;
+        }
+        for (uint32_t i = 0; i < m_clusters.size(); i++) {
+            if (m_clusters[i].State != ClusterState::Anchored || m_clusters[i].Extent <= m_options.ClusterRadius ||
+                !xr::math::Pose::IsPoseValid(m_clusters[i].Location)) {
+                continue;
+            }
+
+            // The extent only bounds the farthest member once members moved away, so find it.
+            AttachmentId farthest = NoAttachment;
+            float farthestDistance = 0;
+            for (AttachmentId a = 0; a < m_attachments.size(); a++) {
+                const float distance = Length(m_attachments[a].PoseInAnchor.position);
+                if (m_attachments[a].Cluster == i && distance > farthestDistance) {
+                    farthest = a;
+                    farthestDistance = distance;
+                }
+            }
+            m_clusters[i].Extent = farthestDistance;
+            if (farthestDistance <= m_options.ClusterRadius) {
+                continue;
+            }
+
+            // A new anchor at the farthest member takes the members closer to it than to the old anchor.
+            const uint32_t split = AddCluster(xr::math::Pose::Multiply(m_attachments[farthest].PoseInAnchor, m_clusters[i].PoseInScene));
+            if (!CreateAnchor(split, time)) {
+                FreeCluster(split);
+                return true;
+            }
+            const XrPosef sourcePose = m_clusters[i].PoseInScene;
+            const XrVector3f splitPosition = m_clusters[split].PoseInScene.position;
+            m_clusters[i].Extent = 0;
+            for (Attachment& attachment : m_attachments) {
+                if (attachment.Cluster != i) {
+                    continue;
+                }
+                const XrPosef poseInScene = xr::math::Pose::Multiply(attachment.PoseInAnchor, sourcePose);
+                const float sourceDistance = Length(attachment.PoseInAnchor.position);
+                if (Distance(poseInScene.position, splitPosition) < sourceDistance) {
+                    Move(attachment, split, poseInScene);
+                } else {
+                    m_clusters[i].Extent = std::max(m_clusters[i].Extent, sourceDistance);
+                }
+            }
+            if (m_clusters[i].Members == 0) {
+                FreeCluster(i);
+            }
+            m_stats.Splits++;
+            return true;
+        }
+        return false;
+    }
+
+    bool AnchorManager::MergeClusters() {
+        auto IsLocated = [](const Cluster& cluster) {
+            return cluster.State == ClusterState::Anchored && xr::math::Pose::IsPoseValid(cluster.Location);
+        };
+        for (uint32_t from = 0; from < m_clusters.size(); from++) {
+            if (!IsLocated(m_clusters[from])) {
+                continue;
+            }
+            for (uint32_t into = 0; into < m_clusters.size(); into++) {
+                // The smaller cluster moves, when the other anchor is within the radius of all its members.
+                const Cluster& source = m_clusters[from];
+                const Cluster& target = m_clusters[into];
+                if (into == from || !IsLocated(target) || source.Members > target.Members ||
+                    Distance(source.PoseInScene.position, target.PoseInScene.position) + source.Extent > m_options.ClusterRadius) {
+                    continue;
+                }
+
+                const XrPosef sourcePose = source.PoseInScene;
+                for (Attachment& attachment : m_attachments) {
+                    if (attachment.Cluster == from) {
+                        Move(attachment, into, xr::math::Pose::Multiply(attachment.PoseInAnchor, sourcePose));
+                    }
+                }
+                FreeCluster(from);
+                m_stats.Merges++;
+                return true;
+            }
+        }
+        return false;
+    }
+} // namespace sample::anchors
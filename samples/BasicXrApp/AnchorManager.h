@@ -0,0 +1,160 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <random>
+#include "PosePrediction.h"
+
+namespace sample::persistence {
+    class AnchorStore;
+}
+
+namespace sample::anchors {
+
+    // Names one hologram placed with the manager, valid for the manager's lifetime.
+    using AttachmentId = uint32_t;
+    constexpr AttachmentId NoAttachment = UINT32_MAX;
+
+    struct FrameStats {
+        uint32_t Clusters{0};               // Groups of holograms sharing one pose, anchored or not
+        uint32_t LocateCalls{0};            // Anchors located by the last Update
+        uint32_t UnclusteredLocateCalls{0}; // What an anchor per hologram would have located: one per anchored hologram
+        uint32_t PendingAnchors{0};         // Persisted anchors not resolved yet
+        uint32_t Splits{0};                 // Since the manager was created
+        uint32_t Merges{0};
+    };
+
+    // Places holograms on spatial anchors shared by the holograms near them, so the runtime tracks and the frame loop
+    // locates one anchor per cluster rather than one per hologram. Each hologram keeps its pose relative to its cluster's
+    // anchor. A cluster is split when it holds a hologram farther than ClusterRadius from its anchor and an anchor is
+    // available, and merged into another when that anchor is close enough to all of its holograms. Without
+    // XR_MSFT_spatial_anchor, or while an anchor cannot be created, a cluster stays at a fixed pose in the scene space.
+    // Locate is safe to call from several threads, everything else belongs to the frame loop thread.
+    class AnchorManager {
+    public:
+        struct Options {
+            float ClusterRadius{1.0f}; // Holograms within this distance of an anchor share it
+            uint32_t MaxAnchors{64};   // Hard cap on live anchors. At the cap, holograms join the nearest anchor at any distance
+        };
+
+        // Anchors are created in the session when anchorsSupported, and persisted in the store when it is not null. The
+        // store must outlive the manager.
+        AnchorManager(const dispatch::DispatchTable& dispatch,
+                      XrSession session,
+                      XrSpace sceneSpace,
+                      bool anchorsSupported,
+                      persistence::AnchorStore* store,
+                      const Options& options);
+
+        AnchorManager(const AnchorManager&) = delete;
+        AnchorManager& operator=(const AnchorManager&) = delete;
+
+        // Attaches a hologram placed at poseInScene at time to the nearest cluster within ClusterRadius, or to a new one.
+        AttachmentId Place(const XrPosef& poseInScene, XrTime time);
+
+        // Attaches a saved hologram to the cluster of the anchor persisted under anchorId, at its saved pose in the scene
+        // until the anchor resolves. requestAnchor is set when the caller should request that anchor from the store. Without
+        // a store, or when the cap is reached, the hologram is placed as new.
+        AttachmentId Restore(uint64_t anchorId, const XrPosef& poseInAnchor, const XrPosef& poseInScene, XrTime time, bool* requestAnchor);
+
+        // Takes ownership of an anchor requested after Restore, XR_NULL_HANDLE when the store has no anchor of that id.
+        void ResolvePersisted(uint64_t anchorId, XrSpatialAnchorMSFT anchor);
+
+        // Splits or merges at most one cluster, then locates each anchor once for the frame. Anchors created within the
+        // recent placement window are predicted to displayTime, as their pose may still be settling.
+        void Update(XrTime predictedDisplayTime, XrTime displayTime, const prediction::PredictionOptions& options);
+
+        // Pose of the hologram in the scene as of the last Update, and the location flags of its anchor.
+        XrSpaceLocationFlags Locate(AttachmentId attachment, XrPosef* poseInScene) const;
+
+        // Id of the persisted anchor the hologram is relative to, zero without one, and its pose relative to that anchor.
+        uint64_t PersistedAnchorId(AttachmentId attachment) const;
+        XrPosef PoseInAnchor(AttachmentId attachment) const;
+
+        // Calls visit(space, locateTime, location, velocity) for each anchor located by the last Update, e.g. to record it.
+        // The location and velocity are as the runtime reported them, before prediction. The velocity is only valid for
+        // recently placed anchors, which are predicted.
+        template <typename Visit>
+        void ForEachLocatedAnchor(Visit&& visit) const {
+            for (const Cluster& cluster : m_clusters) {
+                if (cluster.State == ClusterState::Anchored) {
+                    visit(cluster.Space.Get(), cluster.LocateTime, cluster.Location, cluster.LocatedVelocity);
+                }
+            }
+        }
+
+        const FrameStats& Stats() const {
+            return m_stats;
+        }
+
+    private:
+        enum class ClusterState {
+            Free,     // Slot to reuse
+            Fixed,    // At a fixed pose in the scene, without an anchor
+            Pending,  // Waiting for its persisted anchor, at the pose its holograms were saved at
+            Anchored, // Located every frame
+        };
+
+        struct Cluster {
+            ClusterState State{ClusterState::Free};
+            xr::SpatialAnchorHandle Anchor;
+            xr::SpaceHandle Space;
+            uint64_t PersistedId{0};
+            XrPosef PoseInScene{};                           // Last valid location of the anchor, predicted, or where it is expected
+            XrSpaceLocation Location{XR_TYPE_SPACE_LOCATION}; // As of the last Update, as the runtime reported it
+            XrSpaceVelocity LocatedVelocity{XR_TYPE_SPACE_VELOCITY};
+            XrTime LocateTime{0};
+            XrTime PlacementTime{0}; // Latest anchor creation or hologram placement, which restarts prediction
+            prediction::VelocityFilter Velocity;
+            uint32_t Members{0};
+            float Extent{0}; // At least the distance of the farthest member from the anchor
+        };
+
+        struct Attachment {
+            uint32_t Cluster;
+            XrPosef PoseInAnchor;
+        };
+
+        bool HasAnchorBudget() const;
+        uint32_t FindNearestCluster(const XrVector3f& position, float* distance) const;
+        uint32_t AddCluster(const XrPosef& poseInScene);
+        void FreeCluster(uint32_t cluster);
+        bool CreateAnchor(uint32_t cluster, XrTime time);
+        void CreateAnchorSpace(uint32_t cluster);
+        AttachmentId Attach(uint32_t cluster, const XrPosef& poseInAnchor, XrTime time);
+        void Move(Attachment& attachment, uint32_t cluster, const XrPosef& poseInScene);
+        bool AnchorFixedCluster(XrTime time);
+        bool SplitCluster(XrTime time);
+        bool MergeClusters();
+
+        const dispatch::DispatchTable& m_dispatch;
+        const XrSession m_session;
+        const XrSpace m_sceneSpace;
+        const bool m_anchorsSupported;
+        persistence::AnchorStore* const m_store;
+        const Options m_options;
+
+        std::vector<Cluster> m_clusters;
+        std::vector<uint32_t> m_freeClusters;
+        std::vector<Attachment> m_attachments;
+        std::unordered_map<uint64_t, uint32_t> m_persistedClusters; // Cluster of each persisted anchor id
+        uint32_t m_anchorCount{0};                                  // Anchored and pending clusters
+        XrTime m_lastCreateFailure{0};
+        std::mt19937_64 m_anchorIds{std::random_device{}()};
+        FrameStats m_stats;
+    };
+
+} // namespace sample::anchors
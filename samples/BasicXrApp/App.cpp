@@ -17,14 +17,16 @@
 #include "pch.h"
 #include "App.h"
 #include <cstdlib>
+#include <sstream>
 #include <vector>
-
-#define XR_USE_PLATFORM_WIN32
-#define XR_USE_GRAPHICS_API_D3D11
-#include <openxr/openxr.h>
-#include <openxr/openxr_platform.h>
+#include "XrDispatch.h"
+#include "SessionEvents.h"
+#include "SwapchainWait.h"
+#include "ResourceTracker.h"
 
 #if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
+#include "JobSystem.h"
+#include "SessionHost.h"
 constexpr const char* ProgramName = "BasicXrApp_win32";
 #else
 constexpr const char* ProgramName = "BasicXrApp_uwp";
@@ -33,231 +35,174 @@ constexpr const char* ProgramName = "BasicXrApp_uwp";
 //extern "C" void run();
 void run();
 
-int __stdcall wWinMain(HINSTANCE, HINSTANCE, LPWSTR, int) {
-    run();
-    return 0;
-}
-
-
-#include <openxr/openxr.h>
-#include <openxr/openxr_reflection.h>
-
-#include <string>
-
-// Macro to generate stringify functions for OpenXR enumerations based data provided in openxr_reflection.h
-// clang-format off
-#define ENUM_CASE_STR(name, val) case name: return #name;
-
-// Returns C string pointing to a string literal. Unknown values are returned as 'Unknown <type>'.
-#define MAKE_TO_CSTRING_FUNC(enumType)                      \
-    constexpr const char* ToCString(enumType e) noexcept {  \
-        switch (e) {                                        \
-            XR_LIST_ENUM_##enumType(ENUM_CASE_STR)          \
-            default: return "Unknown " #enumType;           \
-        }                                                   \
-    }
-
-// Returns a STL string. Unknown values are stringified as an integer.
-#define MAKE_TO_STRING_FUNC(enumType)                  \
-    inline std::string ToString(enumType e) {          \
-        switch (e) {                                   \
-            XR_LIST_ENUM_##enumType(ENUM_CASE_STR)     \
-            default: return std::to_string(e);         \
-        }                                              \
-    }
-
-#define MAKE_TO_STRING_FUNCS(enumType) \
-    MAKE_TO_CSTRING_FUNC(enumType) \
-    MAKE_TO_STRING_FUNC(enumType)
-// clang-format on
-
-namespace xr {
-    MAKE_TO_STRING_FUNCS(XrReferenceSpaceType);
-    MAKE_TO_STRING_FUNCS(XrViewConfigurationType);
-    MAKE_TO_STRING_FUNCS(XrEnvironmentBlendMode);
-    MAKE_TO_STRING_FUNCS(XrSessionState);
-    MAKE_TO_STRING_FUNCS(XrResult);
-    MAKE_TO_STRING_FUNCS(XrStructureType);
-    MAKE_TO_STRING_FUNCS(XrFormFactor);
-    MAKE_TO_STRING_FUNCS(XrEyeVisibility);
-    MAKE_TO_STRING_FUNCS(XrObjectType);
-    MAKE_TO_STRING_FUNCS(XrActionType);
-} // namespace xr
-
-#define CHECK_XRCMD(cmd) xr::detail::_CheckXrResult(cmd, #cmd, FILE_AND_LINE);
-#define CHECK_XRRESULT(res, cmdStr) xr::detail::_CheckXrResult(res, cmdStr, FILE_AND_LINE);
-
-#define CHECK_HRCMD(cmd) xr::detail::_CheckHResult(cmd, #cmd, FILE_AND_LINE);
-#define CHECK_HRESULT(res, cmdStr) xr::detail::_CheckHResult(res, cmdStr, FILE_AND_LINE);
-
-#define DEBUG_PRINT(...) ::OutputDebugStringA((xr::detail::_Fmt(__VA_ARGS__) + "\n").c_str())
-
-namespace xr::detail {
-#define CHK_STRINGIFY(x) #x
-#define TOSTRING(x) CHK_STRINGIFY(x)
-#define FILE_AND_LINE __FILE__ ":" TOSTRING(__LINE__)
-
-    inline std::string _Fmt(const char* fmt, ...) {
-        va_list vl;
-        va_start(vl, fmt);
-        int size = std::vsnprintf(nullptr, 0, fmt, vl);
-        va_end(vl);
-
-        if (size != -1) {
-            std::unique_ptr<char[]> buffer(new char[size + 1]);
-
-            va_start(vl, fmt);
-            size = std::vsnprintf(buffer.get(), size + 1, fmt, vl);
-            va_end(vl);
-            if (size != -1) {
-                return std::string(buffer.get(), size);
-            }
-        }
-
-        throw std::runtime_error("Unexpected vsnprintf failure");
-    }
-
-    [[noreturn]] inline void _Throw(std::string failureMessage, const char* originator = nullptr, const char* sourceLocation = nullptr) {
-        if (originator != nullptr) {
-            failureMessage += _Fmt("\n    Origin: %s", originator);
-        }
-        if (sourceLocation != nullptr) {
-            failureMessage += _Fmt("\n    Source: %s", sourceLocation);
+#if !WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
+// The UWP build only has the plain frame loop in run(). It rejects the win32 options instead of silently ignoring them.
+int __stdcall wWinMain(HINSTANCE, HINSTANCE, LPWSTR commandLine, int) {
+    std::wistringstream arguments(commandLine != nullptr ? commandLine : L"");
+    std::wstring argument;
+    while (arguments >> argument) {
+        if (argument.rfind(L"--", 0) == 0) {
+            ::OutputDebugStringA((std::string(ProgramName) + " takes no options, they need the win32 build\n").c_str());
+            return 1;
         }
-
-        throw std::logic_error(failureMessage);
-    }
-
-#define THROW(msg) xr::detail::_Throw(msg, nullptr, FILE_AND_LINE);
-#define CHECK(exp)                                                   \
-    {                                                                \
-        if (!(exp)) {                                                \
-            xr::detail::_Throw("Check failed", #exp, FILE_AND_LINE); \
-        }                                                            \
-    }
-#define CHECK_MSG(exp, msg)                               \
-    {                                                     \
-        if (!(exp)) {                                     \
-            xr::detail::_Throw(msg, #exp, FILE_AND_LINE); \
-        }                                                 \
-    }
-
-    [[noreturn]] inline void _ThrowXrResult(XrResult res, const char* originator = nullptr, const char* sourceLocation = nullptr) {
-        xr::detail::_Throw(_Fmt("XrResult failure [%s]", xr::ToCString(res)), originator, sourceLocation);
     }
 
-    inline XrResult _CheckXrResult(XrResult res, const char* originator = nullptr, const char* sourceLocation = nullptr) {
-        if (XR_FAILED(res)) {
-            xr::detail::_ThrowXrResult(res, originator, sourceLocation);
+    run();
+    return 0;
+}
+#else
+// Host mode: "--sessions N [--seconds S] [--capture-port P] [--record PATH] [--mesh GLB]... [--holograms PATH]" drives N
+// sessions in this process and reports how many keep the frame budget. With a capture port, session i streams its frames
+// to port P + i, with a record path, session i writes its trace to PATH.i, with meshes, placed holograms render those
+// glTF binaries as levels of detail, finest first, and with a holograms path, session i restores and saves its placed
+// holograms at PATH.i.
+// Sweep mode: "--sweep N [--seconds S]" runs host mode with 1, 2, ... up to N sessions, S seconds each (10 by default), and
+// reports the largest session count at which every session keeps the frame budget, and that count per physical core. It
+// takes the other host mode options.
+// Replay mode: "--replay PATH [--fast]" runs the app against a recorded trace instead of the OpenXR runtime, at its recorded
+// pace or as fast as possible. Combined with host or sweep mode, every session replays the trace, so the sweep needs no
+// headset.
+// Without host or sweep mode, "--capture-port P", "--record PATH", "--mesh GLB", "--holograms PATH" and "--pipeline-depth N"
+// run one session of the full program with them, streaming to port P and using the paths as given. Without any of them,
+// the app runs the plain frame loop in run().
+// In any mode, "--memory-budget MB" sets the graphics memory budget over which resource creation logs a warning.
+// Except in the plain frame loop, "--pipeline-depth N" predicts poses at least N display periods past the runtime's
+// prediction.
+int __stdcall wWinMain(HINSTANCE, HINSTANCE, LPWSTR commandLine, int) {
+    sample::host::SessionHost::Options hostOptions;
+    bool hostMode = false;
+    uint32_t sweepSessionCount = 0;
+    uint16_t capturePort = 0;
+    std::wstring recordPath;
+    std::vector<std::wstring> meshPaths;
+    std::wstring hologramsPath;
+    std::wstring replayPath;
+    bool replayFast = false;
+    uint32_t pipelineDepth = 0;
+
+    std::wistringstream arguments(commandLine);
+    std::wstring argument;
+    while (arguments >> argument) {
+        if (argument == L"--sessions") {
+            arguments >> hostOptions.SessionCount;
+            hostMode = true;
+        } else if (argument == L"--sweep") {
+            arguments >> sweepSessionCount;
+            hostMode = true;
+        } else if (argument == L"--seconds") {
+            unsigned seconds = 0;
+            arguments >> seconds;
+            hostOptions.Duration = std::chrono::seconds(seconds);
+        } else if (argument == L"--capture-port") {
+            arguments >> capturePort;
+        } else if (argument == L"--record") {
+            arguments >> recordPath;
+        } else if (argument == L"--mesh") {
+            arguments >> meshPaths.emplace_back();
+        } else if (argument == L"--holograms") {
+            arguments >> hologramsPath;
+        } else if (argument == L"--replay") {
+            arguments >> replayPath;
+        } else if (argument == L"--fast") {
+            replayFast = true;
+        } else if (argument == L"--pipeline-depth") {
+            arguments >> pipelineDepth;
+        } else if (argument == L"--memory-budget") {
+            uint64_t megabytes = 0;
+            arguments >> megabytes;
+            sample::memory::ResourceTracker::Process().SetBudget(megabytes << 20);
         }
-
-        return res;
     }
 
-    [[noreturn]] inline void _ThrowHResult(HRESULT hr, const char* originator = nullptr, const char* sourceLocation = nullptr) {
-        xr::detail::_Throw(xr::detail::_Fmt("HRESULT failure [%x]", hr), originator, sourceLocation);
+    // run() takes none of the options, so any of them launches the full program instead.
+    const bool programOptions = !replayPath.empty() || capturePort != 0 || !recordPath.empty() || !meshPaths.empty() ||
+                                !hologramsPath.empty() || pipelineDepth != 0;
+    if (!hostMode && !programOptions) {
+        run();
+        return 0;
     }
 
-    inline HRESULT _CheckHResult(HRESULT hr, const char* originator = nullptr, const char* sourceLocation = nullptr) {
-        if (FAILED(hr)) {
-            xr::detail::_ThrowHResult(hr, originator, sourceLocation);
+    // Each session's frame thread also runs jobs while it waits for them, so the workers leave a core to each of them.
+    const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    const uint32_t maxSessionCount = std::max(hostOptions.SessionCount, sweepSessionCount);
+    sample::jobs::JobSystem::ConfigureProcess({std::max(1u, hardwareThreads + 1 - std::min(hardwareThreads, maxSessionCount))});
+
+    const sample::host::SessionHost::ProgramFactory factory =
+        [hostMode, capturePort, recordPath, meshPaths, hologramsPath, replayPath, replayFast, pipelineDepth](uint32_t sessionIndex) {
+        // Hosted sessions each get their own files, a single session uses the paths as given.
+        const std::wstring fileSuffix = hostMode ? L"." + std::to_wstring(sessionIndex) : std::wstring();
+        auto program = sample::CreateOpenXrProgram(ProgramName, sample::CreateCubeGraphics());
+        if (!replayPath.empty()) {
+            program->EnableReplay(replayPath, replayFast);
         }
-
-        return hr;
-    }
-} // namespace xr::detail
-
-
-namespace xr {
-    template <typename HandleType, XrResult(XRAPI_PTR* DestroyFunction)(HandleType)>
-    class UniqueHandle {
-    public:
-        UniqueHandle() = default;
-        UniqueHandle(const UniqueHandle&) = delete;
-        UniqueHandle(UniqueHandle&& other) noexcept {
-            *this = std::move(other);
+        program->SetPipelineDepth(pipelineDepth);
+        if (!recordPath.empty()) {
+            program->EnableTraceRecording(recordPath + fileSuffix);
         }
-
-        ~UniqueHandle() noexcept {
-            Reset();
+        if (capturePort != 0) {
+            program->EnableFrameCapture((uint16_t)(capturePort + sessionIndex));
         }
-
-        UniqueHandle& operator=(const UniqueHandle&) = delete;
-        UniqueHandle& operator=(UniqueHandle&& other) noexcept {
-            if (m_handle != other.m_handle) {
-                Reset();
-
-                m_handle = other.m_handle;
-                other.m_handle = XR_NULL_HANDLE;
-            }
-            return *this;
+        if (!meshPaths.empty()) {
+            program->SetHologramMeshLods(meshPaths);
         }
-
-        HandleType Get() const noexcept {
-            return m_handle;
+        if (!hologramsPath.empty()) {
+            program->EnableHologramPersistence(hologramsPath + fileSuffix);
         }
+        return program;
+    };
 
-        HandleType* Put() noexcept {
-            Reset();
-            return &m_handle;
+    char message[256];
+    if (!hostMode) {
+        const auto start = std::chrono::steady_clock::now();
+        factory(0)->Run();
+        if (!replayPath.empty()) {
+            const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            snprintf(message, sizeof(message), "Replayed %ls in %.2f ms\n", replayPath.c_str(), duration.count() / 1000.0);
+            ::OutputDebugStringA(message);
         }
+        sample::memory::ResourceTracker::Process().LogSnapshot();
+        return 0;
+    }
 
-        void Reset(HandleType newHandle = XR_NULL_HANDLE) noexcept {
-            if (m_handle != XR_NULL_HANDLE) {
-                DestroyFunction(m_handle);
-            }
-            m_handle = newHandle;
+    if (sweepSessionCount > 0) {
+        if (hostOptions.Duration.count() == 0) {
+            hostOptions.Duration = std::chrono::seconds(10);
         }
-
-    private:
-        HandleType m_handle{XR_NULL_HANDLE};
-    };
-
-    using ActionHandle = UniqueHandle<XrAction, xrDestroyAction>;
-    using ActionSetHandle = UniqueHandle<XrActionSet, xrDestroyActionSet>;
-    using InstanceHandle = UniqueHandle<XrInstance, xrDestroyInstance>;
-    using SessionHandle = UniqueHandle<XrSession, xrDestroySession>;
-    using SpaceHandle = UniqueHandle<XrSpace, xrDestroySpace>;
-    using SwapchainHandle = UniqueHandle<XrSwapchain, xrDestroySwapchain>;
-    using SpatialAnchorHandle = UniqueHandle<XrSpatialAnchorMSFT, xrDestroySpatialAnchorMSFT>;
-} // namespace xr
-
-namespace xr {
-    namespace math {
-        namespace Pose {
-            constexpr XrPosef Identity() {
-                return { {0, 0, 0, 1}, {0, 0, 0} };
-            }
-        };
-        struct NearFar {
-            float Near;
-            float Far;
-        };
-        struct ViewProjection {
-            XrPosef Pose;
-            XrFovf Fov;
-            NearFar NearFar;
-        };
+        const sample::host::SessionHost::SweepReport sweep = sample::host::SessionHost::Sweep(factory, hostOptions, sweepSessionCount);
+        const sample::host::SessionHost::Report& last = sweep.Steps.back();
+        snprintf(message,
+                 sizeof(message),
+                 "Sweep: budget kept up to %u sessions, %.2f per core, %u of %u within budget at the last step, %.2f ms average frame\n",
+                 sweep.MaxSessionsWithinBudget,
+                 sweep.SessionsPerCore,
+                 last.SessionsWithinBudget,
+                 last.SessionCount,
+                 last.AverageFrameMilliseconds);
+    } else {
+        const sample::host::SessionHost::Report report = sample::host::SessionHost(factory, hostOptions).Run();
+        snprintf(message,
+                 sizeof(message),
+                 "Final: %u sessions, %u within budget, %.2f ms average frame\n",
+                 report.SessionCount,
+                 report.SessionsWithinBudget,
+                 report.AverageFrameMilliseconds);
     }
+    ::OutputDebugStringA(message);
+    sample::memory::ResourceTracker::Process().LogSnapshot();
+    return 0;
 }
+#endif
+
+
 
-bool TryReadNextEvent(XrEventDataBuffer* buffer, const xr::InstanceHandle& m_instance) {
-    // Reset buffer header for every xrPollEvent function call.
-    *buffer = { XR_TYPE_EVENT_DATA_BUFFER };
-    const XrResult xr = CHECK_XRCMD(xrPollEvent(m_instance.Get(), buffer));
-    if (xr == XR_EVENT_UNAVAILABLE) {
-        return false;
-    }
-    else {
-        return true;
-    }
-}
 void run() {
             constexpr static XrFormFactor m_formFactor{XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY};
         constexpr static XrViewConfigurationType m_primaryViewConfigType{XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO};
         constexpr static uint32_t m_stereoViewCount = 2; // PRIMARY_STEREO view configuration always has 2 views
 
         xr::InstanceHandle m_instance;
+        sample::dispatch::DispatchTable m_dispatch;
+        sample::swapchain::ImageWaiter m_imageWaiter{m_dispatch, {}};
         xr::SessionHandle m_session;
         uint64_t m_systemId{XR_NULL_SYSTEM_ID};
         xr::SpaceHandle m_sceneSpace;
@@ -282,6 +227,7 @@ void run() {
             std::vector<XrView> Views;
             std::vector<XrViewConfigurationView> ConfigViews;
             SwapchainD3D11 ColorSwapchain;
+            std::vector<winrt::com_ptr<ID3D11RenderTargetView>> ColorViews; // Per image and array slice, created on first use
             //SwapchainD3D11 DepthSwapchain;
             std::vector<XrCompositionLayerProjectionView> ProjectionLayerViews;
             //std::vector<XrCompositionLayerDepthInfoKHR> DepthInfoViews;
@@ -303,7 +249,8 @@ void run() {
 
     createInfo.applicationInfo = {"", 1, "OpenXR Sample", 1, XR_CURRENT_API_VERSION};
     strcpy_s(createInfo.applicationInfo.applicationName, "firefox.reality");
-    CHECK_XRCMD(xrCreateInstance(&createInfo, m_instance.Put()));
+    CHECK_XRCMD(xrCreateInstance(&createInfo, m_instance.Put(xrDestroyInstance)));
+    m_dispatch.Load(m_instance.Get());
 
 
     CHECK(m_instance.Get() != XR_NULL_HANDLE);
@@ -312,7 +259,7 @@ void run() {
     XrSystemGetInfo systemInfo{ XR_TYPE_SYSTEM_GET_INFO };
     systemInfo.formFactor = m_formFactor;
     while (true) {
-        XrResult result = xrGetSystem(m_instance.Get(), &systemInfo, &m_systemId);
+        XrResult result = m_dispatch.xrGetSystem(m_instance.Get(), &systemInfo, &m_systemId);
         if (SUCCEEDED(result)) {
             break;
         }
@@ -330,11 +277,11 @@ void run() {
     {
         // Query the list of supported environment blend modes for the current system
         uint32_t count;
-        CHECK_XRCMD(xrEnumerateEnvironmentBlendModes(m_instance.Get(), m_systemId, m_primaryViewConfigType, 0, &count, nullptr));
+        CHECK_XRCMD(m_dispatch.xrEnumerateEnvironmentBlendModes(m_instance.Get(), m_systemId, m_primaryViewConfigType, 0, &count, nullptr));
         CHECK(count > 0); // A system must support at least one environment blend mode.
 
         std::vector<XrEnvironmentBlendMode> environmentBlendModes(count);
-        CHECK_XRCMD(xrEnumerateEnvironmentBlendModes(
+        CHECK_XRCMD(m_dispatch.xrEnumerateEnvironmentBlendModes(
             m_instance.Get(), m_systemId, m_primaryViewConfigType, count, &count, environmentBlendModes.data()));
 
         // This sample supports all modes, pick the system's preferred one.
@@ -352,7 +299,7 @@ void run() {
 
             // Create the D3D11 device for the adapter associated with the system.
             XrGraphicsRequirementsD3D11KHR graphicsRequirements{XR_TYPE_GRAPHICS_REQUIREMENTS_D3D11_KHR};
-            CHECK_XRCMD(xrGetD3D11GraphicsRequirementsKHR(m_instance.Get(), m_systemId, &graphicsRequirements));
+            CHECK_XRCMD(m_dispatch.xrGetD3D11GraphicsRequirementsKHR(m_instance.Get(), m_systemId, &graphicsRequirements));
 
             // Create a list of feature levels which are both supported by the OpenXR runtime and this application.
             std::vector<D3D_FEATURE_LEVEL> featureLevels = {D3D_FEATURE_LEVEL_12_1,
@@ -435,13 +382,13 @@ void run() {
             XrSessionCreateInfo createInfo2{XR_TYPE_SESSION_CREATE_INFO};
             createInfo2.next = &graphicsBinding;
             createInfo2.systemId = m_systemId;
-            CHECK_XRCMD(xrCreateSession(m_instance.Get(), &createInfo2, m_session.Put()));
+            CHECK_XRCMD(m_dispatch.xrCreateSession(m_instance.Get(), &createInfo2, m_session.Put(m_dispatch.xrDestroySession)));
 
             /*XrSessionActionSetsAttachInfo attachInfo{XR_TYPE_SESSION_ACTION_SETS_ATTACH_INFO};
             std::vector<XrActionSet> actionSets = {m_actionSet.Get()};
             attachInfo.countActionSets = (uint32_t)actionSets.size();
             attachInfo.actionSets = actionSets.data();
-            CHECK_XRCMD(xrAttachSessionActionSets(m_session.Get(), &attachInfo));*/
+            CHECK_XRCMD(m_dispatch.xrAttachSessionActionSets(m_session.Get(), &attachInfo));*/
 
             CHECK(m_session.Get() != XR_NULL_HANDLE);
 
@@ -449,7 +396,7 @@ void run() {
             m_sceneSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
             spaceCreateInfo.referenceSpaceType = m_sceneSpaceType;
             spaceCreateInfo.poseInReferenceSpace = xr::math::Pose::Identity();
-            CHECK_XRCMD(xrCreateReferenceSpace(m_session.Get(), &spaceCreateInfo, m_sceneSpace.Put()));
+            CHECK_XRCMD(m_dispatch.xrCreateReferenceSpace(m_session.Get(), &spaceCreateInfo, m_sceneSpace.Put(m_dispatch.xrDestroySpace)));
 
             
             
@@ -462,17 +409,17 @@ void run() {
 
             // Read graphics properties for preferred swapchain length and logging.
             XrSystemProperties systemProperties{XR_TYPE_SYSTEM_PROPERTIES};
-            CHECK_XRCMD(xrGetSystemProperties(m_instance.Get(), m_systemId, &systemProperties));
+            CHECK_XRCMD(m_dispatch.xrGetSystemProperties(m_instance.Get(), m_systemId, &systemProperties));
 
 
             CHECK(m_session.Get() != XR_NULL_HANDLE);
 
             // Query runtime preferred swapchain formats.
             uint32_t swapchainFormatCount;
-            CHECK_XRCMD(xrEnumerateSwapchainFormats(m_session.Get(), 0, &swapchainFormatCount, nullptr));
+            CHECK_XRCMD(m_dispatch.xrEnumerateSwapchainFormats(m_session.Get(), 0, &swapchainFormatCount, nullptr));
 
             std::vector<int64_t> swapchainFormats(swapchainFormatCount);
-            CHECK_XRCMD(xrEnumerateSwapchainFormats(
+            CHECK_XRCMD(m_dispatch.xrEnumerateSwapchainFormats(
                 m_session.Get(), (uint32_t)swapchainFormats.size(), &swapchainFormatCount, swapchainFormats.data()));
 
             const static std::vector<DXGI_FORMAT> SupportedColorFormats = {
@@ -499,11 +446,11 @@ void run() {
 
             // Query and cache view configuration views.
             uint32_t viewCount;
-            CHECK_XRCMD(xrEnumerateViewConfigurationViews(m_instance.Get(), m_systemId, m_primaryViewConfigType, 0, &viewCount, nullptr));
+            CHECK_XRCMD(m_dispatch.xrEnumerateViewConfigurationViews(m_instance.Get(), m_systemId, m_primaryViewConfigType, 0, &viewCount, nullptr));
             CHECK(viewCount == m_stereoViewCount);
 
             m_renderResources->ConfigViews.resize(viewCount, {XR_TYPE_VIEW_CONFIGURATION_VIEW});
-            CHECK_XRCMD(xrEnumerateViewConfigurationViews(
+            CHECK_XRCMD(m_dispatch.xrEnumerateViewConfigurationViews(
                 m_instance.Get(), m_systemId, m_primaryViewConfigType, viewCount, &viewCount, m_renderResources->ConfigViews.data()));
 
             // Using texture array for better performance, but requiring left/right views have identical sizes.
@@ -541,31 +488,41 @@ void run() {
             swapchainCreateInfo.createFlags = 0;
             swapchainCreateInfo.usageFlags = XR_SWAPCHAIN_USAGE_SAMPLED_BIT | XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
 
-            CHECK_XRCMD(xrCreateSwapchain(m_session.Get(), &swapchainCreateInfo, swapchain.Handle.Put()));
+            CHECK_XRCMD(m_dispatch.xrCreateSwapchain(m_session.Get(), &swapchainCreateInfo, swapchain.Handle.Put(m_dispatch.xrDestroySwapchain)));
 
             uint32_t chainLength;
-            CHECK_XRCMD(xrEnumerateSwapchainImages(swapchain.Handle.Get(), 0, &chainLength, nullptr));
+            CHECK_XRCMD(m_dispatch.xrEnumerateSwapchainImages(swapchain.Handle.Get(), 0, &chainLength, nullptr));
 
             swapchain.Images.resize(chainLength, {XR_TYPE_SWAPCHAIN_IMAGE_D3D11_KHR});
-            CHECK_XRCMD(xrEnumerateSwapchainImages(swapchain.Handle.Get(),
-                                                   (uint32_t)swapchain.Images.size(),
-                                                   &chainLength,
-                                                   reinterpret_cast<XrSwapchainImageBaseHeader*>(swapchain.Images.data())));
-
+            CHECK_XRCMD(m_dispatch.xrEnumerateSwapchainImages(swapchain.Handle.Get(),
+                                                              (uint32_t)swapchain.Images.size(),
+                                                              &chainLength,
+                                                              reinterpret_cast<XrSwapchainImageBaseHeader*>(swapchain.Images.data())));
+
+            // The runtime owns the images, they are accounted until it destroys them with the swapchain.
+            for (const XrSwapchainImageD3D11KHR& image : swapchain.Images) {
+                sample::memory::ResourceTracker::Process().Track(image.texture, sample::memory::ResourceCategory::SwapchainImages, "color swapchain");
+            }
 
             m_renderResources->ColorSwapchain = std::move(swapchain);
+            m_renderResources->ColorViews.resize(chainLength * textureArraySize);
 
             // Preallocate view buffers for xrLocateViews later inside frame loop.
             m_renderResources->Views.resize(viewCount, {XR_TYPE_VIEW});
 
-            while (true) {
+            // Events are polled on a background thread, so the loop can block while there is no frame to render.
+            sample::session::EventPump eventPump(m_dispatch, m_instance.Get(), {});
+
+            constexpr uint64_t WaitReportFrames = 450; // Every 5 seconds at 90Hz
+            uint64_t renderedFrames = 0;
+
+            bool exitRenderLoop = false;
+            while (!exitRenderLoop) {
                 XrEventDataBuffer buffer{ XR_TYPE_EVENT_DATA_BUFFER };
                 XrEventDataBaseHeader* header = reinterpret_cast<XrEventDataBaseHeader*>(&buffer);
 
-
                 // Process all pending messages.
-                while (TryReadNextEvent(&buffer, m_instance)) {
-                    bool exitRenderLoop = false;
+                while (!exitRenderLoop && eventPump.TryReadNextEvent(&buffer)) {
                     switch (header->type) {
                     case XR_TYPE_EVENT_DATA_INSTANCE_LOSS_PENDING: {
                         exitRenderLoop = true;
@@ -580,13 +537,13 @@ void run() {
                             CHECK(m_session.Get() != XR_NULL_HANDLE);
                             XrSessionBeginInfo sessionBeginInfo{ XR_TYPE_SESSION_BEGIN_INFO };
                             sessionBeginInfo.primaryViewConfigurationType = m_primaryViewConfigType;
-                            CHECK_XRCMD(xrBeginSession(m_session.Get(), &sessionBeginInfo));
+                            CHECK_XRCMD(m_dispatch.xrBeginSession(m_session.Get(), &sessionBeginInfo));
                             m_sessionRunning = true;
                             break;
                         }
                         case XR_SESSION_STATE_STOPPING: {
                             m_sessionRunning = false;
-                            CHECK_XRCMD(xrEndSession(m_session.Get()))
+                            CHECK_XRCMD(m_dispatch.xrEndSession(m_session.Get()))
                                 break;
                         }
                         case XR_SESSION_STATE_EXITING: {
@@ -609,139 +566,139 @@ void run() {
                         break;
                     }
                     }
-                    if (exitRenderLoop) {
-                        break;
-                    }
-
-                    if (m_sessionRunning) {
-                        CHECK(m_session.Get() != XR_NULL_HANDLE);
-
-                        XrFrameWaitInfo frameWaitInfo{ XR_TYPE_FRAME_WAIT_INFO };
-                        XrFrameState frameState{ XR_TYPE_FRAME_STATE };
-                        CHECK_XRCMD(xrWaitFrame(m_session.Get(), &frameWaitInfo, &frameState));
-
-                        XrFrameBeginInfo frameBeginInfo{ XR_TYPE_FRAME_BEGIN_INFO };
-                        CHECK_XRCMD(xrBeginFrame(m_session.Get(), &frameBeginInfo));
-
-                        // EndFrame can submit mutiple layers
-                        std::vector<XrCompositionLayerBaseHeader*> layers;
-
-                        // The projection layer consists of projection layer views.
-                        XrCompositionLayerProjection layer{ XR_TYPE_COMPOSITION_LAYER_PROJECTION };
-
-                        // Inform the runtime to consider alpha channel during composition
-                        // The primary display on Hololens has additive environment blend mode. It will ignore alpha channel.
-                        // But mixed reality capture has alpha blend mode display and use alpha channel to blend content to environment.
-                        layer.layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT;
-
-                        // Only render when session is visible. otherwise submit zero layers
-                        if (frameState.shouldRender) {
-                            // First update the viewState and views using latest predicted display time.
-                            {
-                                XrViewLocateInfo viewLocateInfo{ XR_TYPE_VIEW_LOCATE_INFO };
-                                viewLocateInfo.viewConfigurationType = m_primaryViewConfigType;
-                                viewLocateInfo.displayTime = frameState.predictedDisplayTime;
-                                viewLocateInfo.space = m_sceneSpace.Get();
-
-                                // The output view count of xrLocateViews is always same as xrEnumerateViewConfigurationViews
-                                // Therefore Views can be preallocated and avoid two call idiom here.
-                                uint32_t viewCapacityInput = (uint32_t)m_renderResources->Views.size();
-                                uint32_t viewCountOutput;
-                                CHECK_XRCMD(xrLocateViews(m_session.Get(),
-                                    &viewLocateInfo,
-                                    &m_renderResources->ViewState,
-                                    viewCapacityInput,
-                                    &viewCountOutput,
-                                    m_renderResources->Views.data()));
-
-                                CHECK(viewCountOutput == viewCapacityInput);
-                                CHECK(viewCountOutput == m_renderResources->ConfigViews.size());
-                                CHECK(viewCountOutput == m_renderResources->ColorSwapchain.ArraySize);
-                            }
+                }
+                if (exitRenderLoop) {
+                    break;
+                }
 
-                            const uint32_t viewCount = (uint32_t)m_renderResources->ConfigViews.size();
-                            m_renderResources->ProjectionLayerViews.resize(viewCount);
-                            const SwapchainD3D11& colorSwapchain = m_renderResources->ColorSwapchain;
-                            // Use the full range of recommended image size to achieve optimum resolution
-                            const XrRect2Di imageRect = { {0, 0}, {(int32_t)colorSwapchain.Width, (int32_t)colorSwapchain.Height} };
+                if (m_sessionRunning) {
+                    CHECK(m_session.Get() != XR_NULL_HANDLE);
+
+                    XrFrameWaitInfo frameWaitInfo{ XR_TYPE_FRAME_WAIT_INFO };
+                    XrFrameState frameState{ XR_TYPE_FRAME_STATE };
+                    CHECK_XRCMD(m_dispatch.xrWaitFrame(m_session.Get(), &frameWaitInfo, &frameState));
+
+                    XrFrameBeginInfo frameBeginInfo{ XR_TYPE_FRAME_BEGIN_INFO };
+                    CHECK_XRCMD(m_dispatch.xrBeginFrame(m_session.Get(), &frameBeginInfo));
+
+                    // EndFrame can submit mutiple layers
+                    std::vector<XrCompositionLayerBaseHeader*> layers;
+
+                    // The projection layer consists of projection layer views.
+                    XrCompositionLayerProjection layer{ XR_TYPE_COMPOSITION_LAYER_PROJECTION };
+
+                    // Inform the runtime to consider alpha channel during composition
+                    // The primary display on Hololens has additive environment blend mode. It will ignore alpha channel.
+                    // But mixed reality capture has alpha blend mode display and use alpha channel to blend content to environment.
+                    layer.layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT;
+
+                    // Only render when session is visible. otherwise submit zero layers
+                    if (frameState.shouldRender) {
+                        const SwapchainD3D11& colorSwapchain = m_renderResources->ColorSwapchain;
+
+                        // Acquired before the views are located, so the compositor finishes reading the image while the
+                        // frame is prepared. It is only waited for right before it is cleared.
+                        const uint32_t colorSwapchainImageIndex = m_imageWaiter.Acquire(colorSwapchain.Handle.Get());
+
+                        // First update the viewState and views using latest predicted display time.
+                        {
+                            XrViewLocateInfo viewLocateInfo{ XR_TYPE_VIEW_LOCATE_INFO };
+                            viewLocateInfo.viewConfigurationType = m_primaryViewConfigType;
+                            viewLocateInfo.displayTime = frameState.predictedDisplayTime;
+                            viewLocateInfo.space = m_sceneSpace.Get();
+
+                            // The output view count of xrLocateViews is always same as xrEnumerateViewConfigurationViews
+                            // Therefore Views can be preallocated and avoid two call idiom here.
+                            uint32_t viewCapacityInput = (uint32_t)m_renderResources->Views.size();
+                            uint32_t viewCountOutput;
+                            CHECK_XRCMD(m_dispatch.xrLocateViews(m_session.Get(),
+                                &viewLocateInfo,
+                                &m_renderResources->ViewState,
+                                viewCapacityInput,
+                                &viewCountOutput,
+                                m_renderResources->Views.data()));
+
+                            CHECK(viewCountOutput == viewCapacityInput);
+                            CHECK(viewCountOutput == m_renderResources->ConfigViews.size());
+                            CHECK(viewCountOutput == m_renderResources->ColorSwapchain.ArraySize);
+                        }
+                        m_imageWaiter.Poll();
 
-                            uint32_t colorSwapchainImageIndex;
-                            XrSwapchainImageAcquireInfo acquireInfo{ XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
-                            CHECK_XRCMD(xrAcquireSwapchainImage(colorSwapchain.Handle.Get(), &acquireInfo, &colorSwapchainImageIndex));
+                        const uint32_t viewCount = (uint32_t)m_renderResources->ConfigViews.size();
+                        m_renderResources->ProjectionLayerViews.resize(viewCount);
+                        // Use the full range of recommended image size to achieve optimum resolution
+                        const XrRect2Di imageRect = { {0, 0}, {(int32_t)colorSwapchain.Width, (int32_t)colorSwapchain.Height} };
 
-                            XrSwapchainImageWaitInfo waitInfo{ XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
-                            waitInfo.timeout = XR_INFINITE_DURATION;
-                            CHECK_XRCMD(xrWaitSwapchainImage(colorSwapchain.Handle.Get(), &waitInfo));
+                        // Prepare rendering parameters of each view for swapchain texture arrays
+                        std::vector<xr::math::ViewProjection> viewProjections(viewCount);
+                        for (uint32_t i = 0; i < viewCount; i++) {
+                            viewProjections[i] = { m_renderResources->Views[i].pose, m_renderResources->Views[i].fov, m_nearFar };
 
-                            // Prepare rendering parameters of each view for swapchain texture arrays
-                            std::vector<xr::math::ViewProjection> viewProjections(viewCount);
-                            for (uint32_t i = 0; i < viewCount; i++) {
-                                viewProjections[i] = { m_renderResources->Views[i].pose, m_renderResources->Views[i].fov, m_nearFar };
+                            m_renderResources->ProjectionLayerViews[i] = { XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW };
+                            m_renderResources->ProjectionLayerViews[i].pose = m_renderResources->Views[i].pose;
+                            m_renderResources->ProjectionLayerViews[i].fov = m_renderResources->Views[i].fov;
+                            m_renderResources->ProjectionLayerViews[i].subImage.swapchain = colorSwapchain.Handle.Get();
+                            m_renderResources->ProjectionLayerViews[i].subImage.imageRect = imageRect;
+                            m_renderResources->ProjectionLayerViews[i].subImage.imageArrayIndex = i;
 
-                                m_renderResources->ProjectionLayerViews[i] = { XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW };
-                                m_renderResources->ProjectionLayerViews[i].pose = m_renderResources->Views[i].pose;
-                                m_renderResources->ProjectionLayerViews[i].fov = m_renderResources->Views[i].fov;
-                                m_renderResources->ProjectionLayerViews[i].subImage.swapchain = colorSwapchain.Handle.Get();
-                                m_renderResources->ProjectionLayerViews[i].subImage.imageRect = imageRect;
-                                m_renderResources->ProjectionLayerViews[i].subImage.imageArrayIndex = i;
+                        }
 
+                        // Views don't read the image, so they are created on first use before it is ready.
+                        ID3D11Texture2D* colorTexture = colorSwapchain.Images[colorSwapchainImageIndex].texture;
+                        winrt::com_ptr<ID3D11RenderTargetView>* renderTargetViews =
+                            &m_renderResources->ColorViews[colorSwapchainImageIndex * colorSwapchain.ArraySize];
+                        for (uint32_t i = 0; i < viewCount; i++) {
+                            if (!renderTargetViews[i]) {
+                                const CD3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc(
+                                    D3D11_RTV_DIMENSION_TEXTURE2DARRAY, colorSwapchain.Format, 0, i, 1);
+                                CHECK_HRCMD(m_device->CreateRenderTargetView(colorTexture, &renderTargetViewDesc, renderTargetViews[i].put()));
                             }
+                        }
+                        m_imageWaiter.Wait();
 
-                            std::vector<char> pixels;
-                            int byteLen = imageRect.extent.width * imageRect.extent.height * 4;
-                            pixels.resize(byteLen);
-                            memset(pixels.data(), 0xFF, byteLen);
-                            D3D11_SUBRESOURCE_DATA data[2] = {
-                                {pixels.data(), imageRect.extent.width * 4, byteLen},
-                                {pixels.data(), imageRect.extent.width * 4, byteLen}
-                            };
-
-                            D3D11_TEXTURE2D_DESC desc;
-                            desc.Width = imageRect.extent.width;
-                            desc.Height = imageRect.extent.height;
-                            desc.Format = colorSwapchainFormat;
-                            desc.MipLevels = 1;
-                            desc.ArraySize = 2;
-                            desc.SampleDesc = DXGI_SAMPLE_DESC{ 1, 0 };
-                            desc.Usage = D3D11_USAGE_DEFAULT;
-                            desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-                            desc.CPUAccessFlags = 0;
-                            desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
-
-                            winrt::com_ptr<ID3D11Texture2D> solidTexture;
-                            CHECK_HRCMD(m_device->CreateTexture2D(&desc, &data[0], solidTexture.put()));
-
-                            m_deviceContext->CopyResource(colorSwapchain.Images[colorSwapchainImageIndex].texture, solidTexture.get());
-
-                            XrSwapchainImageReleaseInfo releaseInfo{ XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
-                            CHECK_XRCMD(xrReleaseSwapchainImage(colorSwapchain.Handle.Get(), &releaseInfo));
-
-                            layer.space = m_sceneSpace.Get();
-                            layer.viewCount = (uint32_t)m_renderResources->ProjectionLayerViews.size();
-                            layer.views = m_renderResources->ProjectionLayerViews.data();
-                            layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&layer));
+                        // Clear each view's slice of the acquired image in place, rather than filling a separate
+                        // texture and copying it over the whole swapchain image every frame.
+                        const float clearColor[4] = { 1, 1, 1, 1 };
+                        for (uint32_t i = 0; i < viewCount; i++) {
+                            m_deviceContext->ClearRenderTargetView(renderTargetViews[i].get(), clearColor);
+                        }
 
-                            /*// Then render projection layer into each view.
-                            if (RenderLayer(frameState.predictedDisplayTime, layer)) {
-                                layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&layer));
-                            }*/
+                        XrSwapchainImageReleaseInfo releaseInfo{ XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
+                        CHECK_XRCMD(m_dispatch.xrReleaseSwapchainImage(colorSwapchain.Handle.Get(), &releaseInfo));
+
+                        layer.space = m_sceneSpace.Get();
+                        layer.viewCount = (uint32_t)m_renderResources->ProjectionLayerViews.size();
+                        layer.views = m_renderResources->ProjectionLayerViews.data();
+                        layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&layer));
+
+                        if (++renderedFrames % WaitReportFrames == 0) {
+                            const sample::swapchain::WaitStats waits = m_imageWaiter.TakeStats();
+                            DEBUG_PRINT("Swapchain wait: %llu of %llu images ready early, blocked %.2f ms per frame, %.2f ms max, polls %.2f ms",
+                                        (unsigned long long)waits.ImagesReadyEarly,
+                                        (unsigned long long)(waits.ImagesReadyEarly + waits.ImagesWaited),
+                                        waits.Frames > 0 ? waits.BlockedTime.count() / 1000.0 / waits.Frames : 0.0,
+                                        waits.MaxBlockedTime.count() / 1000.0,
+                                        waits.PollTime.count() / 1000.0);
                         }
 
-                        // Submit the composition layers for the predicted display time.
-                        XrFrameEndInfo frameEndInfo{ XR_TYPE_FRAME_END_INFO };
-                        frameEndInfo.displayTime = frameState.predictedDisplayTime;
-                        frameEndInfo.environmentBlendMode = m_environmentBlendMode;
-                        frameEndInfo.layerCount = (uint32_t)layers.size();
-                        frameEndInfo.layers = layers.data();
-                        CHECK_XRCMD(xrEndFrame(m_session.Get(), &frameEndInfo));
-
-                    } else {
-                        // Throttle loop since xrWaitFrame won't be called.
-                        using namespace std::chrono_literals;
-                        std::this_thread::sleep_for(250ms);
+                        /*// Then render projection layer into each view.
+                        if (RenderLayer(frameState.predictedDisplayTime, layer)) {
+                            layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&layer));
+                        }*/
                     }
-                }
 
+                    // Submit the composition layers for the predicted display time.
+                    XrFrameEndInfo frameEndInfo{ XR_TYPE_FRAME_END_INFO };
+                    frameEndInfo.displayTime = frameState.predictedDisplayTime;
+                    frameEndInfo.environmentBlendMode = m_environmentBlendMode;
+                    frameEndInfo.layerCount = (uint32_t)layers.size();
+                    frameEndInfo.layers = layers.data();
+                    CHECK_XRCMD(m_dispatch.xrEndFrame(m_session.Get(), &frameEndInfo));
+                    eventPump.OnFrameEnded();
+                } else {
+                    // xrWaitFrame won't be called, so block until the runtime reports the next state change.
+                    eventPump.WaitForEvent();
+                }
             }
 }
 
@@ -16,42 +16,84 @@
 
 #pragma once
 
-/*namespace sample {
-    struct Cube {
-        xr::SpaceHandle Space{};
-        std::optional<XrPosef> PoseInSpace{}; // Cube pose in above Space. Default to identity.
-        XrVector3f Scale{0.1f, 0.1f, 0.1f};
-
-        XrPosef PoseInScene = xr::math::Pose::Identity(); // Cube pose in the scene.  Got updated every frame
-    };
+#include <functional>
+#include <optional>
+#include "SceneSnapshot.h"
+#include "SceneUpdate.h"
 
+namespace sample {
     struct IOpenXrProgram {
         virtual ~IOpenXrProgram() = default;
         virtual void Run() = 0;
+
+        // Ask Run() to end the session and return. Callable from any thread.
+        virtual void RequestExit() = 0;
+
+        // Called on the frame loop thread with the CPU time spent between xrWaitFrame and xrEndFrame.
+        using FrameObserver = std::function<void(std::chrono::microseconds frameTime)>;
+        virtual void SetFrameObserver(FrameObserver observer) = 0;
+
+        // Record everything the session consumes from the runtime to a trace file for offline replay. Call before Run().
+        virtual void EnableTraceRecording(const std::wstring& path) = 0;
+
+        // Run against a trace recorded with EnableTraceRecording instead of the OpenXR runtime, at its recorded pace or as
+        // fast as possible. The session ends with the trace. Call before Run().
+        virtual void EnableReplay(const std::wstring& path, bool asFastAsPossible) = 0;
+
+        // Stream rendered frames to a receiver listening on the loopback port. Call before Run().
+        virtual void EnableFrameCapture(uint16_t port) = 0;
+
+        // Render placed holograms with glTF binary (.glb) meshes instead of a cube, one file per level of detail, finest
+        // first. Each frame the level is selected by the hologram's size on screen. Call before Run().
+        virtual void SetHologramMeshLods(const std::vector<std::wstring>& paths) = 0;
+
+        // Restore the holograms saved at path when a session starts, a batch per frame, and save placed holograms back
+        // when it ends. Anchors are persisted in the runtime's anchor store where supported. Call before Run().
+        virtual void EnableHologramPersistence(const std::wstring& path) = 0;
+
+        // Predict poses this many display periods past the runtime's predicted display time, at least. The frame loop
+        // adds more when it measures frames submitted too late to be shown on time. Call before Run().
+        virtual void SetPipelineDepth(uint32_t frames) = 0;
     };
 
     struct IGraphicsPluginD3D11 {
         virtual ~IGraphicsPluginD3D11() = default;
 
         // Create an instance of this graphics api for the provided instance and systemId.
+        // Returns the existing device when it is still compatible, e.g. when a session is recreated.
         virtual ID3D11Device* InitializeDevice(LUID adapterLuid, const std::vector<D3D_FEATURE_LEVEL>& featureLevels) = 0;
 
+        // Release views cached for swapchain images. Must be called before the swapchains are destroyed.
+        virtual void ReleaseSwapchainViews() = 0;
+
+        // Release transient allocations while the session is idle. They are recreated on demand by the next RenderView.
+        virtual void Trim() = 0;
+
+        // Start loading a glTF binary (.glb) file on a background thread. Holograms using the handle render as cubes until
+        // it is loaded. The same path returns the same handle, which stays valid when the device is recreated.
+        virtual sample::mesh::MeshHandle LoadMesh(const std::wstring& path) = 0;
+
+        // Triangle count and bounds of a loaded mesh, or nothing while it is loading or when it failed to load.
+        virtual std::optional<sample::mesh::MeshInfo> FindMeshInfo(sample::mesh::MeshHandle mesh) const = 0;
+
         // List of color pixel formats supported by this app.
         virtual const std::vector<DXGI_FORMAT>& SupportedColorFormats() const = 0;
         virtual const std::vector<DXGI_FORMAT>& SupportedDepthFormats() const = 0;
 
-        // Render to swapchain images using stereo image array
+        // Render to swapchain images using an image array with a slice per view. Only reads the snapshot, never the live
+        // cubes, so simulation of the next frame may run concurrently.
         virtual void RenderView(const XrRect2Di& imageRect,
                                 const float renderTargetClearColor[4],
-                                const std::vector<xr::math::ViewProjection>& viewProjections,
+                                const xr::math::ViewProjection* viewProjections,
+                                uint32_t viewCount,
                                 DXGI_FORMAT colorSwapchainFormat,
                                 ID3D11Texture2D* colorTexture,
                                 DXGI_FORMAT depthSwapchainFormat,
                                 ID3D11Texture2D* depthTexture,
-                                const std::vector<const sample::Cube*>& cubes) = 0;
+                                const sample::scene::SceneSnapshot& scene) = 0;
     };
 
     std::unique_ptr<IGraphicsPluginD3D11> CreateCubeGraphics();
     std::unique_ptr<IOpenXrProgram> CreateOpenXrProgram(std::string applicationName, std::unique_ptr<IGraphicsPluginD3D11> graphicsPlugin);
 
-}*/ // namespace sample
+} // namespace sample
@@ -0,0 +1,51 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "Benchmarks.h"
+#include <cstdio>
+#include <filesystem>
+
+// Runs the benchmarks of the frame loop's CPU paths outside the app, so they run wherever the portable sources build.
+// Usage: BasicXrAppBenchmarks [--filter NAME] [--json PATH]
+// Each result is printed as it completes. With a JSON path, results are also written there to compare across commits.
+int main(int argc, char* argv[]) {
+    sample::bench::Options options;
+    std::wstring jsonPath;
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--filter" && i + 1 < argc) {
+            options.Filter = argv[++i];
+        } else if (argument == "--json" && i + 1 < argc) {
+            jsonPath = std::filesystem::path(argv[++i]).wstring();
+        } else {
+            std::fprintf(stderr, "Usage: %s [--filter NAME] [--json PATH]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    try {
+        const std::vector<sample::bench::Result> results = sample::bench::RunAll(options);
+        if (!jsonPath.empty()) {
+            sample::bench::WriteJson(results, jsonPath);
+        }
+        std::printf("Ran %zu benchmarks\n", results.size());
+    } catch (const std::exception& ex) {
+        std::fprintf(stderr, "Benchmarks failed: %s\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,1001 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "Benchmarks.h"
+#include "AnchorManager.h"
+#include "HologramStore.h"
+#include "JobSystem.h"
+#include "LodSelector.h"
+#include "OcclusionCuller.h"
+#include "MeshLibrary.h"
+#include "MeshOptimizer.h"
+#include "PosePrediction.h"
+#include "ReplayRuntime.h"
+#include "ResourceTracker.h"
+#include "SceneUpdate.h"
+#include "SessionEvents.h"
+#include "SessionTrace.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace {
+    constexpr uint32_t FixtureSeed = 1234;
+    constexpr uint32_t JsonSchemaVersion = 1;
+    constexpr XrDuration FramePeriod = 11'111'111; // 90Hz
+
+    // Results are folded into this, so the compiler cannot drop the measured work.
+    volatile float g_sink = 0;
+    void Consume(float value) {
+        g_sink = g_sink + value;
+    }
+
+    // DEBUG_PRINT lines of the measured code are formatted as usual but dropped, so the code under test pays its logging
+    // cost without flooding the output with thousands of repetitions.
+    void DiscardDebugPrint(const char* line) {
+        Consume(line[0]);
+    }
+
+    class Suite {
+    public:
+        explicit Suite(const sample::bench::Options& options)
+            : m_options(options) {
+            CHECK(m_options.Repetitions > 0);
+        }
+
+        bool Enabled(const std::string& name) const {
+            return m_options.Filter.empty() || name.find(m_options.Filter) != std::string::npos;
+        }
+
+        // Times calls to function, each of which performs operationsPerCall operations.
+        template <typename Function>
+        void Run(const std::string& name, uint64_t operationsPerCall, Function&& function) {
+            Measure(name, operationsPerCall, [&](uint64_t calls) {
+                const auto start = std::chrono::steady_clock::now();
+                for (uint64_t i = 0; i < calls; i++) {
+                    function();
+                }
+                return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            });
+        }
+
+        // Same as Run, but every call gets a fixture freshly made by setup. Only function(fixture) is timed, making and
+        // destroying the fixture is not.
+        template <typename Setup, typename Function>
+        void RunWithSetup(const std::string& name, uint64_t operationsPerCall, Setup&& setup, Function&& function) {
+            Measure(name, operationsPerCall, [&](uint64_t calls) {
+                double nanoseconds = 0;
+                for (uint64_t i = 0; i < calls; i++) {
+                    auto fixture = setup();
+                    const auto start = std::chrono::steady_clock::now();
+                    function(*fixture);
+                    nanoseconds += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                }
+                return nanoseconds;
+            });
+        }
+
+        std::vector<sample::bench::Result> TakeResults() {
+            return std::move(m_results);
+        }
+
+    private:
+        // timeCalls(calls) makes that many calls and returns the nanoseconds they took.
+        template <typename TimeCalls>
+        void Measure(const std::string& name, uint64_t operationsPerCall, TimeCalls&& timeCalls) {
+            if (!Enabled(name)) {
+                return;
+            }
+
+            const xr::DebugPrintSink previousSink = xr::SetDebugPrintSink(&DiscardDebugPrint);
+
+            // Calibrating the call count also warms caches and branch predictors before anything is recorded.
+            const double minTime = std::chrono::duration<double, std::nano>(m_options.MinRepetitionTime).count();
+            uint64_t calls = 1;
+            while (timeCalls(calls) < minTime && calls < (1ull << 40)) {
+                calls *= 2;
+            }
+
+            std::vector<double> samples(m_options.Repetitions);
+            for (double& sample : samples) {
+                sample = timeCalls(calls) / (double)(calls * operationsPerCall);
+            }
+            std::sort(samples.begin(), samples.end());
+            xr::SetDebugPrintSink(previousSink);
+
+            sample::bench::Result result;
+            result.Name = name;
+            result.Iterations = calls * operationsPerCall;
+            result.Repetitions = m_options.Repetitions;
+            result.MedianNanoseconds = samples[samples.size() / 2];
+            result.MinNanoseconds = samples.front();
+            result.MaxNanoseconds = samples.back();
+            DEBUG_PRINT("%-32s %12.1f ns (min %.1f, max %.1f)",
+                        name.c_str(),
+                        result.MedianNanoseconds,
+                        result.MinNanoseconds,
+                        result.MaxNanoseconds);
+            m_results.push_back(std::move(result));
+        }
+
+        const sample::bench::Options m_options;
+        std::vector<sample::bench::Result> m_results;
+    };
+
+    XrPosef RandomPose(std::mt19937& random) {
+        std::uniform_real_distribution<float> unit(-1, 1);
+        XrQuaternionf q{unit(random), unit(random), unit(random), unit(random)};
+        const float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        q = length > 1e-6f ? XrQuaternionf{q.x / length, q.y / length, q.z / length, q.w / length} : XrQuaternionf{0, 0, 0, 1};
+        return {q, {2 * unit(random), 2 * unit(random), 2 * unit(random)}};
+    }
+
+    XrVector3f RandomVector(std::mt19937& random, float scale) {
+        std::uniform_real_distribution<float> unit(-scale, scale);
+        return {unit(random), unit(random), unit(random)};
+    }
+
+    std::vector<XrView> MakeStereoViews(std::mt19937& random) {
+        std::uniform_real_distribution<float> jitter(-0.05f, 0.05f);
+        std::vector<XrView> views(2, {XR_TYPE_VIEW});
+        for (XrView& view : views) {
+            view.pose = RandomPose(random);
+            view.fov = {-0.8f + jitter(random), 0.8f + jitter(random), 0.75f + jitter(random), -0.75f + jitter(random)};
+        }
+        return views;
+    }
+
+    constexpr XrTime FixtureDisplayTime = 1'000'000'000'000;
+
+    XrEventDataBuffer MakeStateChangedEvent(XrSessionState state, XrTime time) {
+        XrEventDataBuffer buffer{XR_TYPE_EVENT_DATA_BUFFER};
+        auto* stateEvent = reinterpret_cast<XrEventDataSessionStateChanged*>(&buffer);
+        *stateEvent = {XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED};
+        stateEvent->state = state;
+        stateEvent->time = time;
+        return buffer;
+    }
+
+    // One full lifecycle, so draining it repeatedly never reaches an unexpected state.
+    constexpr XrSessionState SessionLifecycle[] = {
+        XR_SESSION_STATE_READY,
+        XR_SESSION_STATE_SYNCHRONIZED,
+        XR_SESSION_STATE_VISIBLE,
+        XR_SESSION_STATE_FOCUSED,
+        XR_SESSION_STATE_VISIBLE,
+        XR_SESSION_STATE_SYNCHRONIZED,
+        XR_SESSION_STATE_STOPPING,
+        XR_SESSION_STATE_IDLE,
+    };
+
+    void BenchmarkPoseMath(Suite& suite) {
+        std::mt19937 random(FixtureSeed);
+
+        constexpr size_t PoseCount = 1024;
+        std::vector<XrPosef> poses(PoseCount + 1);
+        for (XrPosef& pose : poses) {
+            pose = RandomPose(random);
+        }
+        suite.Run("pose/multiply", PoseCount, [&] {
+            for (size_t i = 0; i < PoseCount; i++) {
+                Consume(xr::math::Pose::Multiply(poses[i], poses[i + 1]).position.x);
+            }
+        });
+
+        std::vector<sample::prediction::VelocityFilter> velocities(PoseCount);
+        for (auto& velocity : velocities) {
+            velocity.LinearVelocity = RandomVector(random, 0.5f);
+            velocity.AngularVelocity = RandomVector(random, 2.0f);
+            velocity.LinearValid = velocity.AngularValid = true;
+        }
+        suite.Run("pose/extrapolate", PoseCount, [&] {
+            for (size_t i = 0; i < PoseCount; i++) {
+                Consume(sample::prediction::Extrapolate(poses[i], velocities[i], 20'000'000).orientation.w);
+            }
+        });
+    }
+
+    // The eyes of a user at the origin looking down -Z, 64mm apart.
+    std::vector<XrView> MakeForwardViews() {
+        std::vector<XrView> views(2, {XR_TYPE_VIEW});
+        for (uint32_t i = 0; i < views.size(); i++) {
+            views[i].pose = {{0, 0, 0, 1}, {i == 0 ? -0.032f : 0.032f, 0, 0}};
+            views[i].fov = {-0.8f, 0.8f, 0.75f, -0.75f};
+        }
+        return views;
+    }
+
+    // A space of the stub runtime below, at a fixed location and moving at a fixed velocity. Handles are pointers to these.
+    struct StubSpace {
+        XrPosef Pose;
+        XrVector3f LinearVelocity;
+        XrVector3f AngularVelocity;
+    };
+
+    XrResult XRAPI_CALL StubLocateSpace(XrSpace space, XrSpace, XrTime, XrSpaceLocation* location) {
+        const StubSpace& located = *reinterpret_cast<const StubSpace*>(space);
+        location->locationFlags = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT |
+                                  XR_SPACE_LOCATION_POSITION_TRACKED_BIT | XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT;
+        location->pose = located.Pose;
+        auto* velocity = reinterpret_cast<XrSpaceVelocity*>(location->next);
+        if (velocity != nullptr && velocity->type == XR_TYPE_SPACE_VELOCITY) {
+            velocity->velocityFlags = XR_SPACE_VELOCITY_LINEAR_VALID_BIT | XR_SPACE_VELOCITY_ANGULAR_VALID_BIT;
+            velocity->linearVelocity = located.LinearVelocity;
+            velocity->angularVelocity = located.AngularVelocity;
+        }
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL StubDestroySpace(XrSpace) {
+        return XR_SUCCESS;
+    }
+
+    // The simulation of a session with two tracked hands and holograms placed up to 10 meters in front of the user, as
+    // UpdateScene runs it, given the dispatch table and spaces of the hands to locate them with.
+    class SceneFixture {
+    public:
+        SceneFixture(const sample::dispatch::DispatchTable& dispatch,
+                     sample::jobs::JobSystem& jobSystem,
+                     XrSpace sceneSpace,
+                     const std::array<XrSpace, 2>& handSpaces,
+                     size_t hologramCount)
+            : m_anchorManager(dispatch, XR_NULL_HANDLE, sceneSpace, false, nullptr, {}) // Anchors unsupported, as on a desktop runtime
+            , m_sceneUpdater(dispatch, jobSystem, m_lodSelector, {})
+            , m_sceneSpace(sceneSpace)
+            , m_views(MakeForwardViews()) {
+            for (size_t side = 0; side < handSpaces.size(); side++) {
+                *m_cubesInHand[side].Space.Put(dispatch.xrDestroySpace) = handSpaces[side];
+            }
+
+            std::mt19937 random(FixtureSeed);
+            std::uniform_real_distribution<float> unit(0, 1);
+            m_holograms.resize(hologramCount);
+            for (Hologram& hologram : m_holograms) {
+                XrPosef pose = RandomPose(random);
+                pose.position = {10 * unit(random) - 5, 4 * unit(random) - 2, -1 - 9 * unit(random)};
+                hologram.Attachment = m_anchorManager.Place(pose, FixtureDisplayTime);
+                hologram.Cube.PoseInScene = pose;
+            }
+        }
+
+        SceneFixture(const SceneFixture&) = delete;
+        SceneFixture& operator=(const SceneFixture&) = delete;
+
+        // Replaces the fixed views, e.g. with the views located for this frame.
+        void SetViews(const XrView* views, uint32_t viewCount) {
+            m_views.assign(views, views + viewCount);
+        }
+
+        const sample::scene::SceneSnapshot& Update(XrTime predictedDisplayTime) {
+            for (size_t side = 0; side < m_cubesInHand.size(); side++) {
+                m_sceneUpdater.Add(&m_cubesInHand[side], &m_handVelocityFilters[side]);
+            }
+            for (Hologram& hologram : m_holograms) {
+                m_sceneUpdater.Add(&hologram.Cube, nullptr, hologram.Attachment);
+            }
+
+            m_snapshot.FrameIndex++;
+            m_sceneUpdater.Update({m_sceneSpace, predictedDisplayTime, m_views.data(), (uint32_t)m_views.size(), NearFar},
+                                  m_predictionOptions,
+                                  m_anchorManager,
+                                  &m_snapshot);
+            return m_snapshot;
+        }
+
+    private:
+        struct Hologram {
+            sample::Cube Cube;
+            sample::anchors::AttachmentId Attachment{sample::anchors::NoAttachment};
+        };
+
+        constexpr static xr::math::NearFar NearFar{20.f, 0.1f}; // Reversed z, same as the program
+
+        sample::anchors::AnchorManager m_anchorManager;
+        sample::lod::LodSelector m_lodSelector{{}};
+        sample::scene::SceneUpdater m_sceneUpdater;
+        const XrSpace m_sceneSpace;
+        std::vector<XrView> m_views;
+        std::array<sample::Cube, 2> m_cubesInHand{};
+        std::array<sample::prediction::VelocityFilter, 2> m_handVelocityFilters{};
+        std::vector<Hologram> m_holograms;
+        sample::prediction::PredictionOptions m_predictionOptions;
+        sample::scene::SceneSnapshot m_snapshot;
+    };
+
+    // A dispatch table that only locates stub spaces, which is all the scene update calls without anchors.
+    sample::dispatch::DispatchTable MakeStubDispatch() {
+        sample::dispatch::DispatchTable dispatch;
+        dispatch.xrLocateSpace = StubLocateSpace;
+        dispatch.xrDestroySpace = StubDestroySpace;
+        return dispatch;
+    }
+
+    // UpdateScene's work for a frame: locating the hands with prediction and the holograms through their anchor clusters,
+    // selecting levels of detail and culling holograms hidden by the holograms in front of them.
+    void BenchmarkSceneUpdate(Suite& suite) {
+        const sample::dispatch::DispatchTable dispatch = MakeStubDispatch();
+        std::array<StubSpace, 3> spaces{};
+        std::mt19937 random(FixtureSeed);
+        for (StubSpace& space : spaces) {
+            space = {RandomPose(random), RandomVector(random, 0.5f), RandomVector(random, 2.0f)};
+        }
+        const XrSpace sceneSpace = reinterpret_cast<XrSpace>(&spaces[2]);
+        const std::array<XrSpace, 2> handSpaces{reinterpret_cast<XrSpace>(&spaces[0]), reinterpret_cast<XrSpace>(&spaces[1])};
+
+        sample::jobs::JobSystem jobSystem({});
+        for (const size_t count : {10, 1'000, 100'000}) {
+            const std::string name = "scene/update_" + std::to_string(count);
+            if (suite.Enabled(name)) {
+                SceneFixture scene(dispatch, jobSystem, sceneSpace, handSpaces, count);
+                suite.Run(name, 1, [&] { Consume((float)scene.Update(FixtureDisplayTime).Cubes.size()); });
+            }
+        }
+
+        // The same update from one thread up to every hardware thread, to show how far locating the holograms in parallel
+        // scales and where fork-join overhead starts to dominate.
+        const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+            const std::string name = "jobs/scene_update_100000/threads_" + std::to_string(threads);
+            if (suite.Enabled(name)) {
+                sample::jobs::JobSystem threadJobSystem({threads});
+                SceneFixture scene(dispatch, threadJobSystem, sceneSpace, handSpaces, 100'000);
+                suite.Run(name, 1, [&] { Consume((float)scene.Update(FixtureDisplayTime).Cubes.size()); });
+            }
+            if (threads == maxThreads) {
+                break;
+            }
+        }
+    }
+
+    // Events of a stub runtime, returned by xrPollEvent on the instance handle pointing to it.
+    struct StubEvents {
+        std::mutex Mutex;
+        std::deque<XrEventDataBuffer> Queue;
+    };
+
+    XrResult XRAPI_CALL StubPollEvent(XrInstance instance, XrEventDataBuffer* buffer) {
+        StubEvents& events = *reinterpret_cast<StubEvents*>(instance);
+        std::lock_guard lock(events.Mutex);
+        if (events.Queue.empty()) {
+            return XR_EVENT_UNAVAILABLE;
+        }
+        *buffer = events.Queue.front();
+        events.Queue.pop_front();
+        return XR_SUCCESS;
+    }
+
+    // A burst of state changes from the runtime until ProcessEvents has handled them all: polled by the EventPump thread,
+    // handed to the frame loop thread and run through the session state machine.
+    void BenchmarkEventPump(Suite& suite) {
+        const std::string name = "events/pump_64";
+        if (!suite.Enabled(name)) {
+            return;
+        }
+
+        constexpr size_t EventCount = 64;
+        StubEvents events;
+        sample::dispatch::DispatchTable dispatch;
+        dispatch.xrPollEvent = StubPollEvent;
+        sample::session::EventPump pump(dispatch, reinterpret_cast<XrInstance>(&events), {});
+        sample::session::SessionStateMachine stateMachine;
+
+        suite.Run(name, EventCount, [&] {
+            {
+                std::lock_guard lock(events.Mutex);
+                for (size_t i = 0; i < EventCount; i++) {
+                    const XrSessionState state = SessionLifecycle[i % std::size(SessionLifecycle)];
+                    events.Queue.push_back(MakeStateChangedEvent(state, FixtureDisplayTime + i));
+                }
+            }
+            pump.Wake();
+
+            XrEventDataBuffer buffer{XR_TYPE_EVENT_DATA_BUFFER};
+            const auto* header = reinterpret_cast<const XrEventDataBaseHeader*>(&buffer);
+            for (size_t handled = 0; handled < EventCount;) {
+                if (!pump.TryReadNextEvent(&buffer)) {
+                    pump.WaitForEvent();
+                    continue;
+                }
+                if (header->type == XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED) {
+                    const auto* stateEvent = reinterpret_cast<const XrEventDataSessionStateChanged*>(header);
+                    Consume((float)(int)stateMachine.OnStateChanged(stateEvent->state));
+                }
+                handled++;
+            }
+        });
+    }
+
+    void BenchmarkFormatting(Suite& suite) {
+        suite.Run("format/fmt", 1, [] {
+            Consume((float)xr::detail::_Fmt("Frame %llu took %.2f ms", 1234ull, 8.5).size());
+        });
+
+        // Formatting and dispatch to the sink, which drops the line while measuring. Writing it out depends on where it goes.
+        suite.Run("format/debug_print", 1, [] { DEBUG_PRINT("Frame %llu took %.2f ms", 1234ull, 8.5); });
+    }
+
+    // Writes a trace of a focused session with two tracked hands, as recorded from a runtime.
+    void WriteFrameLoopTrace(const std::wstring& path, uint32_t frameCount) {
+        std::mt19937 random(FixtureSeed);
+        sample::trace::TraceWriter writer(path);
+        const XrSpace handSpaces[] = {reinterpret_cast<XrSpace>(uintptr_t(1)), reinterpret_cast<XrSpace>(uintptr_t(2))};
+        for (uint32_t side = 0; side < std::size(handSpaces); side++) {
+            writer.DeclareSpace(handSpaces[side], side); // In the order the replay hands out action spaces
+        }
+
+        for (const XrSessionState state : {XR_SESSION_STATE_READY, XR_SESSION_STATE_SYNCHRONIZED, XR_SESSION_STATE_VISIBLE, XR_SESSION_STATE_FOCUSED}) {
+            writer.RecordEvent(MakeStateChangedEvent(state, FixtureDisplayTime));
+        }
+
+        XrPosef handPoses[] = {RandomPose(random), RandomPose(random)};
+        std::vector<XrView> views = MakeForwardViews();
+        std::normal_distribution<float> motion(0, 0.002f);
+
+        XrViewState viewState{XR_TYPE_VIEW_STATE};
+        viewState.viewStateFlags = XR_VIEW_STATE_POSITION_VALID_BIT | XR_VIEW_STATE_ORIENTATION_VALID_BIT;
+
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            XrFrameState frameState{XR_TYPE_FRAME_STATE};
+            frameState.predictedDisplayTime = FixtureDisplayTime + frame * FramePeriod;
+            frameState.predictedDisplayPeriod = FramePeriod;
+            frameState.shouldRender = XR_TRUE;
+            writer.RecordFrameState(frameState);
+
+            for (XrView& view : views) {
+                view.pose.position.x += motion(random);
+                view.pose.position.y += motion(random);
+                view.pose.position.z += motion(random);
+            }
+            writer.RecordViews(frameState.predictedDisplayTime, viewState, views.data(), (uint32_t)views.size());
+
+            for (size_t hand = 0; hand < std::size(handSpaces); hand++) {
+                handPoses[hand].position.x += motion(random);
+                handPoses[hand].position.y += motion(random);
+                XrSpaceLocation location{XR_TYPE_SPACE_LOCATION};
+                location.locationFlags = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT;
+                location.pose = handPoses[hand];
+                writer.RecordSpaceLocation(frameState.predictedDisplayTime, handSpaces[hand], location);
+            }
+        }
+    }
+
+    // A replayed session up to its first event: the runtime, instance, session, spaces, scene and event pump.
+    struct FrameLoopFixture {
+        FrameLoopFixture(const std::wstring& tracePath, sample::jobs::JobSystem& jobSystem)
+            : Runtime(tracePath, {sample::trace::TraceReplayer::Pace::AsFastAsPossible}) {
+            XrInstanceCreateInfo instanceInfo{XR_TYPE_INSTANCE_CREATE_INFO};
+            CHECK_XRCMD(Runtime.CreateInstance(&instanceInfo, &Instance));
+            sample::replay::ReplayRuntime::Load(&Dispatch);
+
+            XrSystemGetInfo systemInfo{XR_TYPE_SYSTEM_GET_INFO};
+            systemInfo.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId systemId;
+            CHECK_XRCMD(Dispatch.xrGetSystem(Instance, &systemInfo, &systemId));
+            XrSessionCreateInfo sessionInfo{XR_TYPE_SESSION_CREATE_INFO};
+            sessionInfo.systemId = systemId;
+            CHECK_XRCMD(Dispatch.xrCreateSession(Instance, &sessionInfo, Session.Put(Dispatch.xrDestroySession)));
+
+            XrReferenceSpaceCreateInfo sceneSpaceInfo{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            sceneSpaceInfo.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            sceneSpaceInfo.poseInReferenceSpace = xr::math::Pose::Identity();
+            CHECK_XRCMD(Dispatch.xrCreateReferenceSpace(Session.Get(), &sceneSpaceInfo, SceneSpace.Put(Dispatch.xrDestroySpace)));
+            std::array<XrSpace, 2> handSpaces{};
+            for (XrSpace& handSpace : handSpaces) {
+                XrActionSpaceCreateInfo handSpaceInfo{XR_TYPE_ACTION_SPACE_CREATE_INFO};
+                handSpaceInfo.poseInActionSpace = xr::math::Pose::Identity();
+                CHECK_XRCMD(Dispatch.xrCreateActionSpace(Session.Get(), &handSpaceInfo, &handSpace)); // Owned by the scene
+            }
+            Scene.emplace(Dispatch, jobSystem, SceneSpace.Get(), handSpaces, 10);
+            Pump.emplace(Dispatch, Instance, sample::session::EventPump::Options{});
+        }
+
+        sample::replay::ReplayRuntime Runtime;
+        XrInstance Instance{XR_NULL_HANDLE};
+        sample::dispatch::DispatchTable Dispatch;
+        xr::SessionHandle Session;
+        xr::SpaceHandle SceneSpace;
+        std::optional<SceneFixture> Scene;
+        std::optional<sample::session::EventPump> Pump;
+    };
+
+    // Replays a recorded session as fast as possible through the replay runtime, running the frame loop's CPU side for
+    // each frame: events through the EventPump and the session state machine, xrWaitFrame, xrBeginFrame, xrLocateViews,
+    // the scene update with 10 holograms and xrEndFrame. Only the D3D11 rendering is left out, so the result is the app's
+    // own per frame overhead plus that of the replay. Creating and destroying the session is not timed.
+    void BenchmarkFrameLoop(Suite& suite) {
+        const std::string name = "frame_loop/replay_10_holograms";
+        if (!suite.Enabled(name)) {
+            return;
+        }
+
+        constexpr uint32_t FrameCount = 1000;
+        const std::wstring tracePath = (std::filesystem::temp_directory_path() / L"BasicXrApp_benchmark.trace").wstring();
+        WriteFrameLoopTrace(tracePath, FrameCount);
+
+        sample::jobs::JobSystem jobSystem({});
+        const auto setup = [&] { return std::make_unique<FrameLoopFixture>(tracePath, jobSystem); };
+        suite.RunWithSetup(name, FrameCount, setup, [&](FrameLoopFixture& fixture) {
+            const sample::dispatch::DispatchTable& dispatch = fixture.Dispatch;
+            const xr::SessionHandle& session = fixture.Session;
+            const xr::SpaceHandle& sceneSpace = fixture.SceneSpace;
+            SceneFixture& scene = *fixture.Scene;
+            sample::session::EventPump& pump = *fixture.Pump;
+            sample::session::SessionStateMachine stateMachine;
+            bool running = false;
+            for (bool exit = false; !exit;) {
+                XrEventDataBuffer buffer{XR_TYPE_EVENT_DATA_BUFFER};
+                const auto* header = reinterpret_cast<const XrEventDataBaseHeader*>(&buffer);
+                while (pump.TryReadNextEvent(&buffer)) {
+                    if (header->type != XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED) {
+                        continue;
+                    }
+                    switch (stateMachine.OnStateChanged(reinterpret_cast<const XrEventDataSessionStateChanged*>(header)->state)) {
+                    case sample::session::SessionTransition::BeginSession: {
+                        XrSessionBeginInfo beginInfo{XR_TYPE_SESSION_BEGIN_INFO};
+                        beginInfo.primaryViewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+                        CHECK_XRCMD(dispatch.xrBeginSession(session.Get(), &beginInfo));
+                        running = true;
+                        break;
+                    }
+                    case sample::session::SessionTransition::EndSession:
+                        CHECK_XRCMD(dispatch.xrEndSession(session.Get()));
+                        running = false;
+                        break;
+                    case sample::session::SessionTransition::ExitRenderLoop:
+                    case sample::session::SessionTransition::RestartSession:
+                        exit = true;
+                        break;
+                    case sample::session::SessionTransition::None:
+                        break;
+                    }
+                }
+                if (exit) {
+                    break;
+                }
+                if (!running) {
+                    pump.WaitForEvent();
+                    continue;
+                }
+
+                XrFrameWaitInfo waitInfo{XR_TYPE_FRAME_WAIT_INFO};
+                XrFrameState frameState{XR_TYPE_FRAME_STATE};
+                CHECK_XRCMD(dispatch.xrWaitFrame(session.Get(), &waitInfo, &frameState));
+                XrFrameBeginInfo beginInfo{XR_TYPE_FRAME_BEGIN_INFO};
+                CHECK_XRCMD(dispatch.xrBeginFrame(session.Get(), &beginInfo));
+
+                if (frameState.shouldRender) {
+                    XrViewLocateInfo viewLocateInfo{XR_TYPE_VIEW_LOCATE_INFO};
+                    viewLocateInfo.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+                    viewLocateInfo.displayTime = frameState.predictedDisplayTime;
+                    viewLocateInfo.space = sceneSpace.Get();
+                    XrViewState viewState{XR_TYPE_VIEW_STATE};
+                    std::array<XrView, 2> views{{{XR_TYPE_VIEW}, {XR_TYPE_VIEW}}};
+                    uint32_t viewCount;
+                    CHECK_XRCMD(dispatch.xrLocateViews(
+                        session.Get(), &viewLocateInfo, &viewState, (uint32_t)views.size(), &viewCount, views.data()));
+                    if (xr::math::Pose::IsPoseValid(viewState)) {
+                        scene.SetViews(views.data(), viewCount);
+                        Consume((float)scene.Update(frameState.predictedDisplayTime).Cubes.size());
+                    }
+                }
+
+                XrFrameEndInfo endInfo{XR_TYPE_FRAME_END_INFO};
+                endInfo.displayTime = frameState.predictedDisplayTime;
+                endInfo.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+                CHECK_XRCMD(dispatch.xrEndFrame(session.Get(), &endInfo));
+                pump.OnFrameEnded();
+                stateMachine.OnFrameEnded();
+            }
+            CHECK(fixture.Runtime.Frames() == FrameCount);
+        });
+
+        std::error_code error;
+        std::filesystem::remove(tracePath, error);
+    }
+
+    // Writes a glTF binary of one grid mesh with interleaved positions and normals, as exported by common tools.
+    void WriteGridGlb(const std::wstring& path, uint32_t gridSize) {
+        std::vector<float> vertices;
+        for (uint32_t y = 0; y < gridSize; y++) {
+            for (uint32_t x = 0; x < gridSize; x++) {
+                vertices.insert(vertices.end(), {(float)x / gridSize, (float)y / gridSize, 0, 0, 0, 1});
+            }
+        }
+        std::vector<uint32_t> indices;
+        for (uint32_t y = 0; y + 1 < gridSize; y++) {
+            for (uint32_t x = 0; x + 1 < gridSize; x++) {
+                const uint32_t i = y * gridSize + x;
+                indices.insert(indices.end(), {i, i + 1, i + gridSize, i + 1, i + gridSize + 1, i + gridSize});
+            }
+        }
+
+        const uint32_t vertexBytes = (uint32_t)(vertices.size() * sizeof(float));
+        const uint32_t indexBytes = (uint32_t)(indices.size() * sizeof(uint32_t));
+        std::string json = xr::detail::_Fmt(
+            R"({"asset":{"version":"2.0"},"buffers":[{"byteLength":%u}],)"
+            R"("bufferViews":[{"buffer":0,"byteLength":%u,"byteStride":24},{"buffer":0,"byteOffset":%u,"byteLength":%u}],)"
+            R"("accessors":[{"bufferView":0,"componentType":5126,"count":%u,"type":"VEC3","min":[0,0,0],"max":[1,1,0]},)"
+            R"({"bufferView":0,"byteOffset":12,"componentType":5126,"count":%u,"type":"VEC3"},)"
+            R"({"bufferView":1,"componentType":5125,"count":%zu,"type":"SCALAR"}],)"
+            R"("meshes":[{"primitives":[{"attributes":{"POSITION":0,"NORMAL":1},"indices":2}]}]})",
+            vertexBytes + indexBytes,
+            vertexBytes,
+            vertexBytes,
+            indexBytes,
+            gridSize * gridSize,
+            gridSize * gridSize,
+            indices.size());
+        json.resize((json.size() + 3) & ~size_t(3), ' ');
+
+        const uint32_t header[] = {0x46546C67, 2, (uint32_t)(12 + 8 + json.size() + 8 + vertexBytes + indexBytes)};
+        const uint32_t jsonChunk[] = {(uint32_t)json.size(), 0x4E4F534A};
+        const uint32_t binaryChunk[] = {vertexBytes + indexBytes, 0x004E4942};
+        std::ofstream file(std::filesystem::path(path), std::ios::binary);
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(jsonChunk), sizeof(jsonChunk));
+        file.write(json.data(), json.size());
+        file.write(reinterpret_cast<const char*>(binaryChunk), sizeof(binaryChunk));
+        file.write(reinterpret_cast<const char*>(vertices.data()), vertexBytes);
+        file.write(reinterpret_cast<const char*>(indices.data()), indexBytes);
+    }
+
+    // Mapping, parsing and validating a mesh, everything a loader thread does before handing the mapping to the driver.
+    void BenchmarkMeshOpen(Suite& suite) {
+        const std::string name = "mesh/open_glb_100k_vertices";
+        if (!suite.Enabled(name)) {
+            return;
+        }
+
+        const std::wstring meshPath = (std::filesystem::temp_directory_path() / L"BasicXrApp_benchmark.glb").wstring();
+        WriteGridGlb(meshPath, 317); // 100489 vertices
+
+        suite.Run(name, 1, [&] {
+            const sample::mesh::GlbFile file(meshPath);
+            Consume((float)file.Primitives().size());
+        });
+
+        std::error_code error;
+        std::filesystem::remove(meshPath, error);
+    }
+
+    // A wavy grid authored like the cube: every triangle has its own vertices, and triangles come in random order.
+    struct MeshFixture {
+        std::vector<sample::mesh::SourceVertex> Vertices;
+        std::vector<uint32_t> Indices;
+    };
+
+    MeshFixture MakeUnindexedGrid(std::mt19937& random, uint32_t gridSize) {
+        auto GridVertex = [gridSize](uint32_t x, uint32_t y) {
+            const float u = (float)x / gridSize;
+            const float v = (float)y / gridSize;
+            return sample::mesh::SourceVertex{{u, v, 0.1f * std::sin(x * 0.1f)}, {u, v, 1}};
+        };
+
+        MeshFixture mesh;
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (uint32_t y = 0; y < gridSize; y++) {
+            for (uint32_t x = 0; x < gridSize; x++) {
+                const uint32_t first = (uint32_t)mesh.Vertices.size();
+                for (const auto& [vx, vy] : {std::pair{x, y}, {x + 1, y}, {x, y + 1}, {x + 1, y}, {x + 1, y + 1}, {x, y + 1}}) {
+                    mesh.Vertices.push_back(GridVertex(vx, vy));
+                }
+                triangles.push_back({first, first + 1, first + 2});
+                triangles.push_back({first + 3, first + 4, first + 5});
+            }
+        }
+        std::shuffle(triangles.begin(), triangles.end(), random);
+        for (const std::array<uint32_t, 3>& triangle : triangles) {
+            mesh.Indices.insert(mesh.Indices.end(), triangle.begin(), triangle.end());
+        }
+        return mesh;
+    }
+
+    // Each pass on its own input as produced by the passes before it, and the whole stage. Passes work in place,
+    // so every call first copies its input, which is a small part of the time.
+    void BenchmarkMeshOptimization(Suite& suite) {
+        const char* const names[] = {"mesh_optimize/deduplicate", "mesh_optimize/vertex_cache", "mesh_optimize/overdraw", "mesh_optimize/full"};
+        if (std::none_of(std::begin(names), std::end(names), [&](const char* name) { return suite.Enabled(name); })) {
+            return;
+        }
+
+        std::mt19937 random(FixtureSeed);
+        const MeshFixture source = MakeUnindexedGrid(random, 200); // 80000 triangles
+        const uint32_t triangleCount = (uint32_t)(source.Indices.size() / 3);
+
+        MeshFixture shared = source;
+        sample::mesh::DeduplicateVertices(shared.Vertices, shared.Indices);
+        MeshFixture cacheOptimized = shared;
+        sample::mesh::OptimizeVertexCache(cacheOptimized.Indices, (uint32_t)cacheOptimized.Vertices.size());
+        const sample::mesh::OptimizeOptions options;
+
+        suite.Run(names[0], triangleCount, [&] {
+            MeshFixture mesh = source;
+            Consume((float)sample::mesh::DeduplicateVertices(mesh.Vertices, mesh.Indices));
+        });
+        suite.Run(names[1], triangleCount, [&] {
+            std::vector<uint32_t> indices = shared.Indices;
+            sample::mesh::OptimizeVertexCache(indices, (uint32_t)shared.Vertices.size());
+            Consume((float)indices[0]);
+        });
+        suite.Run(names[2], triangleCount, [&] {
+            std::vector<uint32_t> indices = cacheOptimized.Indices;
+            sample::mesh::OptimizeOverdraw(indices, cacheOptimized.Vertices, options.CacheSize, options.OverdrawThreshold);
+            Consume((float)indices[0]);
+        });
+
+        sample::mesh::OptimizationReport report;
+        suite.Run(names[3], triangleCount, [&] {
+            report = sample::mesh::OptimizeMesh(source.Vertices, source.Indices, options).Report;
+        });
+        if (suite.Enabled(names[3])) {
+            DEBUG_PRINT("Grid mesh: %u -> %u vertices, %llu -> %llu vertex bytes, %llu -> %llu index bytes, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+                        report.SourceVertexCount,
+                        report.VertexCount,
+                        (unsigned long long)report.SourceVertexBytes,
+                        (unsigned long long)report.VertexBytes,
+                        (unsigned long long)report.SourceIndexBytes,
+                        (unsigned long long)report.IndexBytes,
+                        report.SourceCache.Acmr,
+                        report.Cache.Acmr,
+                        report.SourceCache.Atvr,
+                        report.Cache.Atvr);
+        }
+    }
+
+    // Selecting levels of a four level chain for holograms spread up to 20 meters around the viewer, as in a large scene.
+    void BenchmarkLodSelection(Suite& suite) {
+        const std::string name = "lod/select_10000";
+        if (!suite.Enabled(name)) {
+            return;
+        }
+
+        sample::lod::LodSelector selector({});
+        const sample::lod::LodChainId chain = selector.AddChain(std::vector<sample::mesh::MeshHandle>{{1}, {2}, {3}, {4}});
+        selector.ResolveMeshes([](sample::mesh::MeshHandle mesh) {
+            return std::optional<sample::mesh::MeshInfo>({100000u >> (2 * (mesh.Id - 1)), {-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}});
+        });
+
+        std::mt19937 random(FixtureSeed);
+        const std::vector<XrView> views = MakeStereoViews(random);
+        std::vector<XrPosef> poses(10000);
+        std::vector<uint8_t> levels(poses.size(), 0);
+        for (XrPosef& pose : poses) {
+            pose = RandomPose(random);
+            pose.position = RandomVector(random, 20);
+        }
+
+        sample::lod::FrameStats stats;
+        suite.Run(name, poses.size(), [&] {
+            selector.BeginFrame(views.data(), (uint32_t)views.size());
+            for (size_t i = 0; i < poses.size(); i++) {
+                Consume((float)selector.Select(chain, poses[i], {0.25f, 0.25f, 0.25f}, &levels[i]).Id);
+            }
+            stats = selector.Stats();
+        });
+        DEBUG_PRINT("LOD: %llu of %llu triangles selected", (unsigned long long)stats.SelectedTriangles, (unsigned long long)stats.FullDetailTriangles);
+    }
+
+    // A room of 32 cube occluders in front of 10000 holograms up to 10 meters away, rasterized and tested per frame.
+    void BenchmarkOcclusionCulling(Suite& suite) {
+        const std::string rasterizeName = "occlusion/rasterize_32";
+        const std::string testName = "occlusion/test_10000";
+        if (!suite.Enabled(rasterizeName) && !suite.Enabled(testName)) {
+            return;
+        }
+
+        std::mt19937 random(FixtureSeed);
+        std::uniform_real_distribution<float> unit(0, 1);
+        const std::vector<XrView> views = MakeForwardViews();
+        std::vector<XrPosef> occluders(32);
+        for (XrPosef& pose : occluders) {
+            const float angle = 6.2831853f * unit(random);
+            pose = {{0, std::sin(angle / 2), 0, std::cos(angle / 2)}, {4 * unit(random) - 2, 2 * unit(random) - 1, -1.5f - 2 * unit(random)}};
+        }
+        std::vector<XrVector3f> holograms(10000);
+        for (XrVector3f& position : holograms) {
+            position = {10 * unit(random) - 5, 4 * unit(random) - 2, -1 - 9 * unit(random)};
+        }
+
+        sample::occlusion::OcclusionCuller culler({});
+        auto Rasterize = [&] {
+            culler.BeginFrame(views.data(), (uint32_t)views.size(), {20.f, 0.1f});
+            for (const XrPosef& pose : occluders) {
+                culler.AddOccluder(pose, {0.4f, 0.4f, 0.4f});
+            }
+            culler.Rasterize();
+        };
+        if (suite.Enabled(rasterizeName)) {
+            suite.Run(rasterizeName, occluders.size(), Rasterize);
+        }
+
+        Rasterize();
+        if (suite.Enabled(testName)) {
+            suite.Run(testName, holograms.size(), [&] {
+                for (const XrVector3f& position : holograms) {
+                    Consume(culler.IsVisible(position, 0.1f) ? 1.0f : 0.0f);
+                }
+            });
+        }
+        const auto culled = std::count_if(holograms.begin(), holograms.end(), [&](const XrVector3f& position) {
+            return !culler.IsVisible(position, 0.1f);
+        });
+        culler.CountTested((uint32_t)holograms.size(), (uint32_t)culled);
+        const sample::occlusion::FrameStats& stats = culler.Stats();
+        DEBUG_PRINT("Occlusion: %u of %u holograms culled, %u occluders", stats.Culled, stats.Tested, stats.Occluders);
+    }
+
+    // Saving a 10000 hologram scene, and what restoring it costs before the first frame: opening the file and reading
+    // the first batch of records.
+    void BenchmarkHologramPersistence(Suite& suite) {
+        const std::string saveName = "persistence/save_10000";
+        const std::string openName = "persistence/open_first_256_of_10000";
+        if (!suite.Enabled(saveName) && !suite.Enabled(openName)) {
+            return;
+        }
+
+        std::mt19937 random(FixtureSeed);
+        std::vector<sample::persistence::HologramRecord> records(10000);
+        for (uint32_t i = 0; i < records.size(); i++) {
+            records[i] = {i + 1, RandomPose(random), {0.1f, 0.1f, 0.1f}, xr::math::Pose::Identity()};
+        }
+        const std::wstring scenePath = (std::filesystem::temp_directory_path() / L"BasicXrApp_benchmark.holograms").wstring();
+
+        if (suite.Enabled(saveName)) {
+            suite.Run(saveName, records.size(), [&] { sample::persistence::HologramFile::Write(scenePath, records); });
+        }
+        if (suite.Enabled(openName)) {
+            sample::persistence::HologramFile::Write(scenePath, records);
+            suite.Run(openName, 1, [&] {
+                const std::unique_ptr<sample::persistence::HologramFile> file = sample::persistence::HologramFile::Open(scenePath);
+                for (uint32_t i = 0; i < 256; i++) {
+                    Consume(file->Record(i).PoseInScene.position.x);
+                }
+            });
+        }
+
+        std::error_code error;
+        std::filesystem::remove(scenePath, error);
+    }
+
+    // Clustering 10000 holograms placed around a room, and locating each relative to its cluster per frame. Clusters stay
+    // at fixed poses, so the runtime's anchor calls are left out and only the manager's CPU work is measured.
+    void BenchmarkAnchorClustering(Suite& suite) {
+        const std::string placeName = "anchors/place_10000";
+        const std::string locateName = "anchors/locate_10000";
+        if (!suite.Enabled(placeName) && !suite.Enabled(locateName)) {
+            return;
+        }
+
+        std::mt19937 random(FixtureSeed);
+        std::uniform_real_distribution<float> unit(0, 1);
+        std::vector<XrPosef> poses(10000);
+        for (XrPosef& pose : poses) {
+            pose = RandomPose(random);
+            pose.position = {10 * unit(random) - 5, 2 * unit(random) - 1, 10 * unit(random) - 5};
+        }
+
+        using sample::anchors::AnchorManager;
+        const sample::dispatch::DispatchTable dispatch; // Never called, anchors are unsupported
+        auto PlaceAll = [&](AnchorManager& manager) {
+            for (const XrPosef& pose : poses) {
+                Consume((float)manager.Place(pose, FixtureDisplayTime));
+            }
+        };
+        if (suite.Enabled(placeName)) {
+            suite.Run(placeName, poses.size(), [&] {
+                AnchorManager manager(dispatch, XR_NULL_HANDLE, XR_NULL_HANDLE, false, nullptr, {});
+                PlaceAll(manager);
+            });
+        }
+
+        AnchorManager manager(dispatch, XR_NULL_HANDLE, XR_NULL_HANDLE, false, nullptr, {});
+        PlaceAll(manager);
+        manager.Update(FixtureDisplayTime, FixtureDisplayTime, {});
+        if (suite.Enabled(locateName)) {
+            suite.Run(locateName, poses.size(), [&] {
+                XrPosef pose;
+                for (sample::anchors::AttachmentId attachment = 0; attachment < poses.size(); attachment++) {
+                    manager.Locate(attachment, &pose);
+                    Consume(pose.position.x);
+                }
+            });
+        }
+        DEBUG_PRINT("Anchors: %zu holograms in %u clusters", poses.size(), manager.Stats().Clusters);
+    }
+
+    // Accounts resources of random sizes and releases them in random order, as mesh loads and session restarts do.
+    void BenchmarkResourceTracking(Suite& suite) {
+        const std::string name = "memory/track_10000";
+        if (!suite.Enabled(name)) {
+            return;
+        }
+
+        std::mt19937 random(FixtureSeed);
+        std::uniform_int_distribution<uint64_t> size(256, 16ull << 20);
+        std::vector<uint64_t> sizes(10000);
+        for (uint64_t& bytes : sizes) {
+            bytes = size(random);
+        }
+        std::vector<uint32_t> releaseOrder(sizes.size());
+        for (uint32_t i = 0; i < releaseOrder.size(); i++) {
+            releaseOrder[i] = i;
+        }
+        std::shuffle(releaseOrder.begin(), releaseOrder.end(), random);
+
+        constexpr sample::memory::ResourceCategory categories[] = {sample::memory::ResourceCategory::Textures,
+                                                                   sample::memory::ResourceCategory::Geometry,
+                                                                   sample::memory::ResourceCategory::ConstantBuffers};
+        std::vector<uint64_t> ids(sizes.size());
+        suite.Run(name, sizes.size(), [&] {
+            sample::memory::ResourceTracker tracker({UINT64_MAX}); // No budget warnings, they would time the log
+            for (size_t i = 0; i < sizes.size(); i++) {
+                ids[i] = tracker.Add(categories[i % std::size(categories)], sizes[i], "fixture");
+            }
+            for (uint32_t i : releaseOrder) {
+                tracker.Remove(ids[i]);
+            }
+            Consume((float)tracker.GetSnapshot().PeakBytes);
+        });
+    }
+} // namespace
+
+namespace sample::bench {
+
+    std::vector<Result> RunAll(const Options& options) {
+        Suite suite(options);
+        BenchmarkPoseMath(suite);
+        BenchmarkSceneUpdate(suite);
+        BenchmarkEventPump(suite);
+        BenchmarkFormatting(suite);
+        BenchmarkFrameLoop(suite);
+        BenchmarkMeshOpen(suite);
+        BenchmarkMeshOptimization(suite);
+        BenchmarkLodSelection(suite);
+        BenchmarkOcclusionCulling(suite);
+        BenchmarkHologramPersistence(suite);
+        BenchmarkAnchorClustering(suite);
+        BenchmarkResourceTracking(suite);
+        return suite.TakeResults();
+    }
+
+    void WriteJson(const std::vector<Result>& results, const std::wstring& path) {
+        std::ofstream file(std::filesystem::path(path), std::ios::trunc);
+        CHECK_MSG(file, "Failed to open benchmark output file");
+
+        // Names only contain [a-z0-9_/], so they need no escaping.
+        char line[512];
+        file << "{\n  \"schema\": " << JsonSchemaVersion << ",\n";
+        file << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+        file << "  \"benchmarks\": {";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            snprintf(line,
+                     sizeof(line),
+                     "%s\n    \"%s\": {\"iterations\": %llu, \"repetitions\": %u, \"median_ns\": %.3f, \"min_ns\": %.3f, \"max_ns\": %.3f}",
+                     i == 0 ? "" : ",",
+                     result.Name.c_str(),
+                     (unsigned long long)result.Iterations,
+                     result.Repetitions,
+                     result.MedianNanoseconds,
+                     result.MinNanoseconds,
+                     result.MaxNanoseconds);
+            file << line;
+        }
+        file << "\n  }\n}\n";
+        CHECK_MSG(file, "Failed to write benchmark output file");
+    }
+
+} // namespace sample::bench
@@ -0,0 +1,46 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+namespace sample::bench {
+
+    // Timing of one benchmark. Times are per operation, so results at different sizes compare directly.
+    struct Result {
+        std::string Name;
+        uint64_t Iterations{0}; // Operations per repetition
+        uint32_t Repetitions{0};
+        double MedianNanoseconds{0};
+        double MinNanoseconds{0};
+        double MaxNanoseconds{0};
+    };
+
+    struct Options {
+        std::chrono::milliseconds MinRepetitionTime{20}; // Iterations are doubled until one repetition takes this long
+        uint32_t Repetitions{9};
+        std::string Filter; // Only run benchmarks whose name contains this. Empty runs all.
+    };
+
+    // Runs the micro-benchmarks of the CPU paths of the frame loop, each through the app's own code: pose math, the scene
+    // update and its scaling across threads, the event pump, message formatting, a frame loop replayed through the replay
+    // runtime, opening a mesh, optimizing one, selecting levels of detail, occlusion culling, saving and opening a hologram
+    // scene, clustering holograms onto anchors and accounting graphics memory. Fixtures come from fixed seeds, so every
+    // run and every commit measures the same work. Call from a single thread, other work in the process skews the results.
+    std::vector<Result> RunAll(const Options& options);
+
+    // Writes results as JSON, one object per benchmark keyed by its stable name, to compare runs across commits.
+    void WriteJson(const std::vector<Result>& results, const std::wstring& path);
+
+} // namespace sample::bench
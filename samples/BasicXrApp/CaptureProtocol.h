@@ -0,0 +1,92 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <dxgiformat.h>
+#include <openxr/openxr.h>
+
+// What FrameCapture and a receiver on the same machine share: the message sent over the loopback socket for each frame
+// and the layout of the shared memory section holding the encoded pixels.
+namespace sample::capture {
+
+    constexpr uint16_t DefaultCapturePort = 48750;
+    constexpr uint32_t MaxCaptureViews = 2;
+    constexpr uint32_t MaxSharedSlots = 16;
+    constexpr uint32_t FrameMessageMagic = 0x43465258;  // "XRFC"
+    constexpr uint32_t SharedRingMagic = 0x52465258;    // "XRFR"
+
+    // Sent over the socket for each captured frame. The encoded array slices are stored back to back in Slot
+    // of the shared memory ring, and the receiver sets the slot state back to SlotFree once it has read them.
+    struct FrameMessage {
+        uint32_t Magic{FrameMessageMagic};
+        uint32_t Slot{0};
+        uint64_t FrameIndex{0};
+        XrTime DisplayTime{0};
+        uint32_t Width{0};
+        uint32_t Height{0};
+        uint32_t ArraySize{0};
+        uint32_t Format{0}; // DXGI_FORMAT, 4 bytes per pixel
+        std::array<uint32_t, MaxCaptureViews> EncodedSizes{};
+        std::array<XrPosef, MaxCaptureViews> Poses{};
+        std::array<XrFovf, MaxCaptureViews> Fovs{};
+    };
+
+    enum SlotState : uint32_t {
+        SlotFree = 0,
+        SlotWriting = 1,
+        SlotReady = 2,
+    };
+
+    // Start of the shared memory section. Slot i starts at DataOffset + i * SlotSize.
+    struct SharedRingHeader {
+        uint32_t Magic;
+        uint32_t SlotCount;
+        uint64_t SlotSize;
+        uint64_t DataOffset;
+        std::array<std::atomic<uint32_t>, MaxSharedSlots> SlotStates;
+    };
+
+    // Each port has its own section, so several sessions of one host can stream to their own receivers.
+    inline std::wstring SharedMemoryName(uint16_t port) {
+        return L"Local\\BasicXrAppCapture" + std::to_wstring(port);
+    }
+
+    // The codec works on the 4 bytes of each pixel, whatever their channels are.
+    inline bool IsCaptureFormat(uint32_t format) {
+        switch (format) {
+        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+        case DXGI_FORMAT_R10G10B10A2_UNORM:
+        case DXGI_FORMAT_R11G11B10_FLOAT:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+} // namespace sample::capture
@@ -17,6 +17,11 @@
 #include "pch.h"
 #include "App.h"
 #include "DxUtility.h"
+#include "MeshLibrary.h"
+#include "MeshOptimizer.h"
+#include "ResourceTracker.h"
+#include "ViewConfiguration.h"
+#include <dxgi1_3.h> // IDXGIDevice3::Trim
 
 namespace {
     namespace CubeShader {
@@ -63,16 +68,40 @@ namespace {
             30, 31, 32, 33, 34, 35, // +Z
         };
 
+        // The authored cube repeats each corner for every triangle. Sharing the 24 unique vertices, ordering them for the
+        // post-transform cache and quantizing to half positions and 8-bit colors is done once, when first needed.
+        const sample::mesh::OptimizedMesh& OptimizedCube() {
+            static const sample::mesh::OptimizedMesh cube = [] {
+                std::vector<sample::mesh::SourceVertex> vertices;
+                for (const Vertex& vertex : c_cubeVertices) {
+                    vertices.push_back({vertex.Position, vertex.Color});
+                }
+                sample::mesh::OptimizedMesh mesh = sample::mesh::OptimizeMesh(
+                    std::move(vertices), std::vector<uint32_t>(std::begin(c_cubeIndices), std::end(c_cubeIndices)), {});
+
+                const sample::mesh::OptimizationReport& report = mesh.Report;
+                DEBUG_PRINT("Cube mesh: %u -> %u vertices, %llu -> %llu bytes, ACMR %.2f -> %.2f",
+                            report.SourceVertexCount,
+                            report.VertexCount,
+                            (unsigned long long)(report.SourceVertexBytes + report.SourceIndexBytes),
+                            (unsigned long long)(report.VertexBytes + report.IndexBytes),
+                            report.SourceCache.Acmr,
+                            report.Cache.Acmr);
+                return mesh;
+            }();
+            return cube;
+        }
+
         struct ModelConstantBuffer {
             DirectX::XMFLOAT4X4 Model;
         };
 
+        constexpr uint32_t MaxViewInstance = sample::views::MaxViewCount;
+
         struct ViewProjectionConstantBuffer {
-            DirectX::XMFLOAT4X4 ViewProjection[2];
+            DirectX::XMFLOAT4X4 ViewProjection[MaxViewInstance];
         };
 
-        constexpr uint32_t MaxViewInstance = 2;
-
         // Separate entrypoints for the vertex and pixel shader functions.
         constexpr char ShaderHlsl[] = R"_(
             struct VSOutput {
@@ -89,7 +118,7 @@ namespace {
                 float4x4 Model;
             };
             cbuffer ViewProjectionConstantBuffer : register(b1) {
-                float4x4 ViewProjection[2];
+                float4x4 ViewProjection[4]; // MaxViewInstance
             };
 
             VSOutput MainVS(VSInput input) {
@@ -109,27 +138,83 @@ namespace {
 
     struct CubeGraphics : sample::IGraphicsPluginD3D11 {
         ID3D11Device* InitializeDevice(LUID adapterLuid, const std::vector<D3D_FEATURE_LEVEL>& featureLevels) override {
+            // A recreated session usually reports the same adapter, so keep the device and the compiled pipeline state warm.
+            if (m_device && memcmp(&m_adapterLuid, &adapterLuid, sizeof(adapterLuid)) == 0 &&
+                m_device->GetDeviceRemovedReason() == S_OK &&
+                std::find(featureLevels.begin(), featureLevels.end(), m_device->GetFeatureLevel()) != featureLevels.end()) {
+                DEBUG_PRINT("Reusing existing D3D11 device");
+                return m_device.get();
+            }
+
+            // Meshes are device objects. Reload the previous device's meshes on the new one, in order, so their handles stay valid.
+            const std::vector<std::wstring> meshPaths = m_meshes ? m_meshes->Paths() : std::vector<std::wstring>{};
+            m_meshes = nullptr;
+
+            ReleaseSwapchainViews();
+            m_deviceContext1 = nullptr;
+            m_deviceContext = nullptr;
+            m_device = nullptr;
+
             const winrt::com_ptr<IDXGIAdapter1> adapter = sample::dx::GetAdapter(adapterLuid);
 
             sample::dx::CreateD3D11DeviceAndContext(adapter.get(), featureLevels, m_device.put(), m_deviceContext.put());
+            m_deviceContext1 = m_deviceContext.as<ID3D11DeviceContext1>();
+            m_adapterLuid = adapterLuid;
 
             InitializeD3DResources();
 
+            m_meshes = std::make_unique<sample::mesh::MeshLibrary>(m_device, sample::mesh::MeshLibrary::Options{});
+            for (const std::wstring& path : meshPaths) {
+                m_meshes->Load(path);
+            }
+
             return m_device.get();
         }
 
+        void ReleaseSwapchainViews() override {
+            // The views hold references to the swapchain images, which would otherwise outlive xrDestroySwapchain.
+            if (m_deviceContext) {
+                m_deviceContext->OMSetRenderTargets(0, nullptr, nullptr);
+            }
+            m_renderTargetViews.clear();
+            m_depthStencilViews.clear();
+        }
+
+        void Trim() override {
+            if (!m_deviceContext) {
+                return;
+            }
+
+            // Unbind everything so the driver can release its internal allocations, but keep shaders and buffers.
+            m_deviceContext->ClearState();
+            m_deviceContext->Flush();
+            if (const auto dxgiDevice = m_device.try_as<IDXGIDevice3>()) {
+                dxgiDevice->Trim();
+            }
+        }
+
+        sample::mesh::MeshHandle LoadMesh(const std::wstring& path) override {
+            CHECK_MSG(m_meshes, "InitializeDevice must be called before LoadMesh");
+            return m_meshes->Load(path);
+        }
+
+        std::optional<sample::mesh::MeshInfo> FindMeshInfo(sample::mesh::MeshHandle mesh) const override {
+            return m_meshes ? m_meshes->FindInfo(mesh) : std::nullopt;
+        }
+
         void InitializeD3DResources() {
-            /*const winrt::com_ptr<ID3DBlob> vertexShaderBytes = sample::dx::CompileShader(CubeShader::ShaderHlsl, "MainVS", "vs_5_0");
+            const winrt::com_ptr<ID3DBlob> vertexShaderBytes = sample::dx::CompileShaderCached(CubeShader::ShaderHlsl, "MainVS", "vs_5_0");
             CHECK_HRCMD(m_device->CreateVertexShader(
                 vertexShaderBytes->GetBufferPointer(), vertexShaderBytes->GetBufferSize(), nullptr, m_vertexShader.put()));
 
-            const winrt::com_ptr<ID3DBlob> pixelShaderBytes = sample::dx::CompileShader(CubeShader::ShaderHlsl, "MainPS", "ps_5_0");
+            const winrt::com_ptr<ID3DBlob> pixelShaderBytes = sample::dx::CompileShaderCached(CubeShader::ShaderHlsl, "MainPS", "ps_5_0");
             CHECK_HRCMD(m_device->CreatePixelShader(
                 pixelShaderBytes->GetBufferPointer(), pixelShaderBytes->GetBufferSize(), nullptr, m_pixelShader.put()));
 
+            // Matches sample::mesh::QuantizedVertex with half positions. The shader reads both as floats unchanged.
             const D3D11_INPUT_ELEMENT_DESC vertexDesc[] = {
-                {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-                {"COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+                {"POSITION", 0, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+                {"COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
             };
 
             CHECK_HRCMD(m_device->CreateInputLayout(vertexDesc,
@@ -138,20 +223,53 @@ namespace {
                                                     vertexShaderBytes->GetBufferSize(),
                                                     m_inputLayout.put()));
 
+            // Meshes keep positions and normals in separate streams as stored in the file. Normals are shaded as colors.
+            const D3D11_INPUT_ELEMENT_DESC meshVertexDesc[] = {
+                {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+                {"COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+            };
+
+            CHECK_HRCMD(m_device->CreateInputLayout(meshVertexDesc,
+                                                    (UINT)std::size(meshVertexDesc),
+                                                    vertexShaderBytes->GetBufferPointer(),
+                                                    vertexShaderBytes->GetBufferSize(),
+                                                    m_meshInputLayout.put()));
+
             const CD3D11_BUFFER_DESC modelConstantBufferDesc(sizeof(CubeShader::ModelConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-            CHECK_HRCMD(m_device->CreateBuffer(&modelConstantBufferDesc, nullptr, m_modelCBuffer.put()));
+            CHECK_HRCMD(sample::memory::CreateBuffer(m_device.get(),
+                                                     modelConstantBufferDesc,
+                                                     nullptr,
+                                                     sample::memory::ResourceCategory::ConstantBuffers,
+                                                     "model constants",
+                                                     m_modelCBuffer.put()));
 
             const CD3D11_BUFFER_DESC viewProjectionConstantBufferDesc(sizeof(CubeShader::ViewProjectionConstantBuffer),
                                                                       D3D11_BIND_CONSTANT_BUFFER);
-            CHECK_HRCMD(m_device->CreateBuffer(&viewProjectionConstantBufferDesc, nullptr, m_viewProjectionCBuffer.put()));
-
-            const D3D11_SUBRESOURCE_DATA vertexBufferData{CubeShader::c_cubeVertices};
-            const CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(CubeShader::c_cubeVertices), D3D11_BIND_VERTEX_BUFFER);
-            CHECK_HRCMD(m_device->CreateBuffer(&vertexBufferDesc, &vertexBufferData, m_cubeVertexBuffer.put()));
-
-            const D3D11_SUBRESOURCE_DATA indexBufferData{CubeShader::c_cubeIndices};
-            const CD3D11_BUFFER_DESC indexBufferDesc(sizeof(CubeShader::c_cubeIndices), D3D11_BIND_INDEX_BUFFER);
-            CHECK_HRCMD(m_device->CreateBuffer(&indexBufferDesc, &indexBufferData, m_cubeIndexBuffer.put()));
+            CHECK_HRCMD(sample::memory::CreateBuffer(m_device.get(),
+                                                     viewProjectionConstantBufferDesc,
+                                                     nullptr,
+                                                     sample::memory::ResourceCategory::ConstantBuffers,
+                                                     "view projection constants",
+                                                     m_viewProjectionCBuffer.put()));
+
+            const sample::mesh::OptimizedMesh& cube = CubeShader::OptimizedCube();
+            const D3D11_SUBRESOURCE_DATA vertexBufferData{cube.Vertices.data()};
+            const CD3D11_BUFFER_DESC vertexBufferDesc((UINT)(cube.Vertices.size() * sizeof(sample::mesh::QuantizedVertex)), D3D11_BIND_VERTEX_BUFFER);
+            CHECK_HRCMD(sample::memory::CreateBuffer(m_device.get(),
+                                                     vertexBufferDesc,
+                                                     &vertexBufferData,
+                                                     sample::memory::ResourceCategory::Geometry,
+                                                     "cube vertices",
+                                                     m_cubeVertexBuffer.put()));
+
+            const D3D11_SUBRESOURCE_DATA indexBufferData{cube.Indices16.data()};
+            const CD3D11_BUFFER_DESC indexBufferDesc((UINT)(cube.Indices16.size() * sizeof(uint16_t)), D3D11_BIND_INDEX_BUFFER);
+            CHECK_HRCMD(sample::memory::CreateBuffer(m_device.get(),
+                                                     indexBufferDesc,
+                                                     &indexBufferData,
+                                                     sample::memory::ResourceCategory::Geometry,
+                                                     "cube indices",
+                                                     m_cubeIndexBuffer.put()));
 
             D3D11_FEATURE_DATA_D3D11_OPTIONS3 options;
             m_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS3, &options, sizeof(options));
@@ -162,7 +280,7 @@ namespace {
             depthStencilDesc.DepthEnable = true;
             depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
             depthStencilDesc.DepthFunc = D3D11_COMPARISON_GREATER;
-            CHECK_HRCMD(m_device->CreateDepthStencilState(&depthStencilDesc, m_reversedZDepthNoStencilTest.put()));*/
+            CHECK_HRCMD(m_device->CreateDepthStencilState(&depthStencilDesc, m_reversedZDepthNoStencilTest.put()));
         }
 
         const std::vector<DXGI_FORMAT>& SupportedColorFormats() const override {
@@ -187,74 +305,39 @@ namespace {
 
         void RenderView(const XrRect2Di& imageRect,
                         const float renderTargetClearColor[4],
-                        const std::vector<xr::math::ViewProjection>& viewProjections,
+                        const xr::math::ViewProjection* viewProjections,
+                        uint32_t viewCount,
                         DXGI_FORMAT colorSwapchainFormat,
                         ID3D11Texture2D* colorTexture,
                         DXGI_FORMAT depthSwapchainFormat,
                         ID3D11Texture2D* depthTexture,
-                        const std::vector<const sample::Cube*>& cubes) override {
-            /*std::vector<char> pixels;
-            int byteLen = imageRect.extent.width * imageRect.extent.height * 4;
-            pixels.resize(byteLen);
-            memset(pixels.data(), 0xFF, byteLen);
-            D3D11_SUBRESOURCE_DATA data;
-            data.pSysMem = pixels.data();
-            data.SysMemPitch = imageRect.extent.width * 4;
-            data.SysMemSlicePitch = byteLen;
-
-            D3D11_TEXTURE2D_DESC desc;
-            desc.Width = imageRect.extent.width;
-            desc.Height = imageRect.extent.height;
-            desc.Format = colorSwapchainFormat;
-            desc.MipLevels = 1;
-            desc.ArraySize = 1;
-            desc.SampleDesc = DXGI_SAMPLE_DESC {1, 0};
-            desc.Usage = D3D11_USAGE_DEFAULT;
-            desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-            desc.CPUAccessFlags = 0;
-            desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
-
-            winrt::com_ptr<ID3D11Texture2D> solidTexture;
-            CHECK_HRCMD(m_device->CreateTexture2D(&desc, &data, solidTexture.put()));
-
-            D3D11_BOX box;
-            box.left = 0;
-            box.right = imageRect.extent.width;
-            box.top = 0;
-            box.bottom = imageRect.extent.height;
-            box.back = 1;
-            box.front = 0;
-            m_deviceContext->CopySubresourceRegion(colorTexture, 0, 0, 0, 0, solidTexture.get(), 0, &box);
-            m_deviceContext->CopySubresourceRegion(colorTexture, 1, 0, 0, 0, solidTexture.get(), 0, &box);*/
-
-            /*const uint32_t viewInstanceCount = (uint32_t)viewProjections.size();
+                        const sample::scene::SceneSnapshot& scene) override {
+            const uint32_t viewInstanceCount = viewCount;
             CHECK_MSG(viewInstanceCount <= CubeShader::MaxViewInstance,
-                      "Sample shader supports 2 or fewer view instances. Adjust shader to accommodate more.")
+                      "Sample shader supports 4 or fewer view instances. Adjust shader to accommodate more.")
 
             CD3D11_VIEWPORT viewport(
                 (float)imageRect.offset.x, (float)imageRect.offset.y, (float)imageRect.extent.width, (float)imageRect.extent.height);
-            m_deviceContext->RSSetViewports(1, &viewport);*/
-
-            // Create RenderTargetView with the original swapchain format (swapchain image is typeless).
-            winrt::com_ptr<ID3D11RenderTargetView> renderTargetView;
-            const CD3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc(D3D11_RTV_DIMENSION_TEXTURE2DARRAY, colorSwapchainFormat);
-            CHECK_HRCMD(m_device->CreateRenderTargetView(colorTexture, &renderTargetViewDesc, renderTargetView.put()));
-
-            // Create a DepthStencilView with the original swapchain format (swapchain image is typeless)
-            /*winrt::com_ptr<ID3D11DepthStencilView> depthStencilView;
-            CD3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc(D3D11_DSV_DIMENSION_TEXTURE2DARRAY, depthSwapchainFormat);
-            CHECK_HRCMD(m_device->CreateDepthStencilView(depthTexture, &depthStencilViewDesc, depthStencilView.put()));*/
-
-            /*const bool reversedZ = viewProjections[0].NearFar.Near > viewProjections[0].NearFar.Far;
-            const float depthClearValue = reversedZ ? 0.f : 1.f;*/
-
-            // Clear swapchain and depth buffer. NOTE: This will clear the entire render target view, not just the specified view.
-            m_deviceContext->ClearRenderTargetView(renderTargetView.get(), renderTargetClearColor);
-            /*m_deviceContext->ClearDepthStencilView(depthStencilView.get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, depthClearValue, 0);
+            m_deviceContext->RSSetViewports(1, &viewport);
+
+            ID3D11RenderTargetView* renderTargetView = GetRenderTargetView(colorTexture, colorSwapchainFormat);
+            ID3D11DepthStencilView* depthStencilView = GetDepthStencilView(depthTexture, depthSwapchainFormat);
+
+            const bool reversedZ = viewProjections[0].NearFar.Near > viewProjections[0].NearFar.Far;
+            const float depthClearValue = reversedZ ? 0.f : 1.f;
+
+            // Clear only the image rect of every view, the rest of the swapchain is never shown at a lower resolution.
+            // D3D11 cannot clear part of a depth view, but GPUs usually fast clear depth without writing every pixel.
+            const D3D11_RECT clearRect{imageRect.offset.x,
+                                       imageRect.offset.y,
+                                       imageRect.offset.x + imageRect.extent.width,
+                                       imageRect.offset.y + imageRect.extent.height};
+            m_deviceContext1->ClearView(renderTargetView, renderTargetClearColor, &clearRect, 1);
+            m_deviceContext->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, depthClearValue, 0);
             m_deviceContext->OMSetDepthStencilState(reversedZ ? m_reversedZDepthNoStencilTest.get() : nullptr, 0);
 
-            ID3D11RenderTargetView* renderTargets[] = {renderTargetView.get()};
-            m_deviceContext->OMSetRenderTargets((UINT)std::size(renderTargets), renderTargets, depthStencilView.get());
+            ID3D11RenderTargetView* renderTargets[] = {renderTargetView};
+            m_deviceContext->OMSetRenderTargets((UINT)std::size(renderTargets), renderTargets, depthStencilView);
 
             ID3D11Buffer* const constantBuffers[] = {m_modelCBuffer.get(), m_viewProjectionCBuffer.get()};
             m_deviceContext->VSSetConstantBuffers(0, (UINT)std::size(constantBuffers), constantBuffers);
@@ -265,7 +348,7 @@ namespace {
 
             for (uint32_t k = 0; k < viewInstanceCount; k++) {
                 const DirectX::XMMATRIX spaceToView = xr::math::LoadInvertedXrPose(viewProjections[k].Pose);
-                const DirectX::XMMATRIX projectionMatrix = ComposeProjectionMatrix(viewProjections[k].Fov, viewProjections[k].NearFar);
+                const DirectX::XMMATRIX projectionMatrix = xr::math::ComposeProjectionMatrix(viewProjections[k].Fov, viewProjections[k].NearFar);
 
                 // Set view projection matrix for each view, transpose for shader usage.
                 DirectX::XMStoreFloat4x4(&viewProjectionCBufferData.ViewProjection[k],
@@ -274,38 +357,95 @@ namespace {
             m_deviceContext->UpdateSubresource(m_viewProjectionCBuffer.get(), 0, nullptr, &viewProjectionCBufferData, 0, 0);
 
             // Set cube primitive data.
-            const UINT strides[] = {sizeof(CubeShader::Vertex)};
-            const UINT offsets[] = {0};
-            ID3D11Buffer* vertexBuffers[] = {m_cubeVertexBuffer.get()};
-            m_deviceContext->IASetVertexBuffers(0, (UINT)std::size(vertexBuffers), vertexBuffers, strides, offsets);
-            m_deviceContext->IASetIndexBuffer(m_cubeIndexBuffer.get(), DXGI_FORMAT_R16_UINT, 0);
+            auto SetCubeGeometry = [&] {
+                const UINT strides[] = {sizeof(sample::mesh::QuantizedVertex)};
+                const UINT offsets[] = {0};
+                ID3D11Buffer* vertexBuffers[] = {m_cubeVertexBuffer.get()};
+                m_deviceContext->IASetVertexBuffers(0, (UINT)std::size(vertexBuffers), vertexBuffers, strides, offsets);
+                m_deviceContext->IASetIndexBuffer(m_cubeIndexBuffer.get(), DXGI_FORMAT_R16_UINT, 0);
+                m_deviceContext->IASetInputLayout(m_inputLayout.get());
+            };
+            SetCubeGeometry();
             m_deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-            m_deviceContext->IASetInputLayout(m_inputLayout.get());
 
-            // Render each cube
-            for (const sample::Cube* cube : cubes) {
+            // Render each cube, or its mesh once loaded.
+            for (const sample::scene::CubeInstance& cube : scene.Cubes) {
                 // Compute and update the model transform for each cube, transpose for shader usage.
                 CubeShader::ModelConstantBuffer model;
-                const DirectX::XMMATRIX scaleMatrix = DirectX::XMMatrixScaling(cube->Scale.x, cube->Scale.y, cube->Scale.z);
-                DirectX::XMStoreFloat4x4(&model.Model, DirectX::XMMatrixTranspose(scaleMatrix * xr::math::LoadXrPose(cube->PoseInScene)));
+                const DirectX::XMMATRIX scaleMatrix = DirectX::XMMatrixScaling(cube.Scale.x, cube.Scale.y, cube.Scale.z);
+                DirectX::XMStoreFloat4x4(&model.Model, DirectX::XMMatrixTranspose(scaleMatrix * xr::math::LoadXrPose(cube.Pose)));
                 m_deviceContext->UpdateSubresource(m_modelCBuffer.get(), 0, nullptr, &model, 0, 0);
 
-                // Draw the cube.
-                m_deviceContext->DrawIndexedInstanced((UINT)std::size(CubeShader::c_cubeIndices), viewInstanceCount, 0, 0, 0);
-            }*/
+                if (const sample::mesh::Mesh* mesh = m_meshes->Find(cube.Mesh)) {
+                    DrawMesh(*mesh, viewInstanceCount);
+                    SetCubeGeometry();
+                } else {
+                    // Draw the cube.
+                    m_deviceContext->DrawIndexedInstanced((UINT)CubeShader::OptimizedCube().Indices16.size(), viewInstanceCount, 0, 0, 0);
+                }
+            }
         }
 
     private:
+        // Binds the buffers of each primitive with the offsets and strides of its accessors, straight as they were loaded.
+        void DrawMesh(const sample::mesh::Mesh& mesh, uint32_t viewInstanceCount) {
+            m_deviceContext->IASetInputLayout(m_meshInputLayout.get());
+            for (const sample::mesh::Mesh::DrawPrimitive& primitive : mesh.Primitives) {
+                // Without normals the color stream stays unbound, which reads as black.
+                ID3D11Buffer* vertexBuffers[] = {
+                    mesh.Buffers[primitive.Position.Buffer].get(),
+                    primitive.Normal.Buffer != sample::mesh::Mesh::NoBuffer ? mesh.Buffers[primitive.Normal.Buffer].get() : nullptr};
+                const UINT strides[] = {primitive.Position.Stride, primitive.Normal.Stride};
+                const UINT offsets[] = {primitive.Position.Offset, primitive.Normal.Offset};
+                m_deviceContext->IASetVertexBuffers(0, (UINT)std::size(vertexBuffers), vertexBuffers, strides, offsets);
+
+                if (primitive.IndexBuffer != sample::mesh::Mesh::NoBuffer) {
+                    m_deviceContext->IASetIndexBuffer(mesh.Buffers[primitive.IndexBuffer].get(), primitive.IndexFormat, primitive.IndexOffset);
+                    m_deviceContext->DrawIndexedInstanced(primitive.ElementCount, viewInstanceCount, 0, 0, 0);
+                } else {
+                    m_deviceContext->DrawInstanced(primitive.ElementCount, viewInstanceCount, 0, 0);
+                }
+            }
+        }
+
+        // Swapchain images are created once per swapchain and reused every frame, so their views are created once too.
+        ID3D11RenderTargetView* GetRenderTargetView(ID3D11Texture2D* colorTexture, DXGI_FORMAT colorSwapchainFormat) {
+            winrt::com_ptr<ID3D11RenderTargetView>& renderTargetView = m_renderTargetViews[colorTexture];
+            if (!renderTargetView) {
+                // Create RenderTargetView with the original swapchain format (swapchain image is typeless).
+                const CD3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc(D3D11_RTV_DIMENSION_TEXTURE2DARRAY, colorSwapchainFormat);
+                CHECK_HRCMD(m_device->CreateRenderTargetView(colorTexture, &renderTargetViewDesc, renderTargetView.put()));
+            }
+            return renderTargetView.get();
+        }
+
+        ID3D11DepthStencilView* GetDepthStencilView(ID3D11Texture2D* depthTexture, DXGI_FORMAT depthSwapchainFormat) {
+            winrt::com_ptr<ID3D11DepthStencilView>& depthStencilView = m_depthStencilViews[depthTexture];
+            if (!depthStencilView) {
+                // Create a DepthStencilView with the original swapchain format (swapchain image is typeless)
+                const CD3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc(D3D11_DSV_DIMENSION_TEXTURE2DARRAY, depthSwapchainFormat);
+                CHECK_HRCMD(m_device->CreateDepthStencilView(depthTexture, &depthStencilViewDesc, depthStencilView.put()));
+            }
+            return depthStencilView.get();
+        }
+
+        LUID m_adapterLuid{};
         winrt::com_ptr<ID3D11Device> m_device;
         winrt::com_ptr<ID3D11DeviceContext> m_deviceContext;
+        winrt::com_ptr<ID3D11DeviceContext1> m_deviceContext1; // Windows 10 always has the D3D 11.1 runtime
         winrt::com_ptr<ID3D11VertexShader> m_vertexShader;
         winrt::com_ptr<ID3D11PixelShader> m_pixelShader;
         winrt::com_ptr<ID3D11InputLayout> m_inputLayout;
+        winrt::com_ptr<ID3D11InputLayout> m_meshInputLayout;
         winrt::com_ptr<ID3D11Buffer> m_modelCBuffer;
         winrt::com_ptr<ID3D11Buffer> m_viewProjectionCBuffer;
         winrt::com_ptr<ID3D11Buffer> m_cubeVertexBuffer;
         winrt::com_ptr<ID3D11Buffer> m_cubeIndexBuffer;
         winrt::com_ptr<ID3D11DepthStencilState> m_reversedZDepthNoStencilTest;
+        std::unique_ptr<sample::mesh::MeshLibrary> m_meshes;
+
+        std::unordered_map<ID3D11Texture2D*, winrt::com_ptr<ID3D11RenderTargetView>> m_renderTargetViews;
+        std::unordered_map<ID3D11Texture2D*, winrt::com_ptr<ID3D11DepthStencilView>> m_depthStencilViews;
     };
 } // namespace
 
@@ -16,6 +16,7 @@
 #include "pch.h"
 #include "DxUtility.h"
 #include <D3Dcompiler.h>
+#include <mutex>
 #pragma comment(lib, "D3DCompiler.lib")
 
 namespace sample::dx {
@@ -100,4 +101,17 @@ namespace sample::dx {
 
         return compiled;
     }
+
+    winrt::com_ptr<ID3DBlob> CompileShaderCached(const char* hlsl, const char* entrypoint, const char* shaderTarget) {
+        static std::mutex mutex;
+        static std::map<std::tuple<std::string, std::string, std::string>, winrt::com_ptr<ID3DBlob>> cache;
+
+        // Compiling under the lock is intended: sessions starting together wait for one compile instead of each doing it.
+        std::lock_guard lock(mutex);
+        winrt::com_ptr<ID3DBlob>& compiled = cache[{hlsl, entrypoint, shaderTarget}];
+        if (!compiled) {
+            compiled = CompileShader(hlsl, entrypoint, shaderTarget);
+        }
+        return compiled;
+    }
 } // namespace sample::dx
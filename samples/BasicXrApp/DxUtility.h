@@ -28,4 +28,8 @@ namespace sample::dx {
                                      ID3D11DeviceContext** deviceContext);
 
     winrt::com_ptr<ID3DBlob> CompileShader(const char* hlsl, const char* entrypoint, const char* shaderTarget);
+
+    // Same as CompileShader, but compiles each hlsl/entrypoint/target combination once per process.
+    // The blob is immutable and shared, so devices of concurrent sessions can create their shaders from it. Thread safe.
+    winrt::com_ptr<ID3DBlob> CompileShaderCached(const char* hlsl, const char* entrypoint, const char* shaderTarget);
 } // namespace sample::dx
@@ -0,0 +1,411 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "FrameCapture.h"
+#include "FrameCodec.h"
+#include "ResourceTracker.h"
+#include <winsock2.h>
+#pragma comment(lib, "Ws2_32.lib")
+
+namespace {
+    SOCKET ConnectLoopback(uint16_t port) {
+        SOCKET socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (socket == INVALID_SOCKET) {
+            return INVALID_SOCKET;
+        }
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR) {
+            closesocket(socket);
+            return INVALID_SOCKET;
+        }
+
+        // Messages are small and latency matters more than packet count.
+        const BOOL noDelay = TRUE;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        return socket;
+    }
+
+    bool SendAll(SOCKET socket, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            const int sent = send(socket, bytes, (int)size, 0);
+            if (sent == SOCKET_ERROR) {
+                return false;
+            }
+            bytes += sent;
+            size -= sent;
+        }
+        return true;
+    }
+} // namespace
+
+namespace sample::capture {
+    FrameCapture::FrameCapture(ID3D11Device* device, Options options)
+        : m_options(std::move(options)) {
+        CHECK(m_options.StagingCount > 0);
+        CHECK(m_options.SlotCount > 0 && m_options.SlotCount <= MaxSharedSlots);
+        CHECK(m_options.WorkerCount > 0);
+
+        m_device.copy_from(device);
+        m_device->GetImmediateContext(m_deviceContext.put());
+    }
+
+    FrameCapture::~FrameCapture() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopRequested = true;
+        }
+        m_workAvailable.notify_all();
+        for (std::thread& thread : m_encodeThreads) {
+            thread.join();
+        }
+        if (m_sendThread.joinable()) {
+            m_sendThread.join();
+        }
+
+        // Staging textures still queued for encoding are mapped as well.
+        for (const std::unique_ptr<Staging>& staging : m_stagings) {
+            if (staging->State == StagingState::Encoding || staging->State == StagingState::Encoded) {
+                Unmap(*staging);
+            }
+        }
+
+        if (m_sharedHeader) {
+            UnmapViewOfFile(m_sharedHeader);
+        }
+        if (m_sharedMemory) {
+            CloseHandle(m_sharedMemory);
+        }
+    }
+
+    void FrameCapture::Capture(
+        ID3D11Texture2D* colorTexture, const XrRect2Di& imageRect, XrTime displayTime, const XrView* views, uint32_t viewCount) {
+        if (m_stagings.empty()) {
+            D3D11_TEXTURE2D_DESC colorDesc;
+            colorTexture->GetDesc(&colorDesc);
+            CreateResources(colorDesc);
+        }
+
+        CHECK(imageRect.offset.x >= 0 && imageRect.offset.y >= 0 && imageRect.extent.width > 0 && imageRect.extent.height > 0);
+        CHECK((uint32_t)(imageRect.offset.x + imageRect.extent.width) <= m_stagingDesc.Width);
+        CHECK((uint32_t)(imageRect.offset.y + imageRect.extent.height) <= m_stagingDesc.Height);
+
+        ProcessReadbacks();
+
+        const auto free = std::find_if(m_stagings.begin(), m_stagings.end(), [](const std::unique_ptr<Staging>& staging) {
+            return staging->State == StagingState::Free;
+        });
+        if (free == m_stagings.end()) {
+            // All staging textures are still in flight, the GPU or the encoders are behind.
+            m_droppedFrames++;
+            return;
+        }
+
+        Staging& staging = **free;
+        const D3D11_BOX box{(UINT)imageRect.offset.x,
+                            (UINT)imageRect.offset.y,
+                            0,
+                            (UINT)(imageRect.offset.x + imageRect.extent.width),
+                            (UINT)(imageRect.offset.y + imageRect.extent.height),
+                            1};
+        for (uint32_t slice = 0; slice < m_stagingDesc.ArraySize; slice++) {
+            m_deviceContext->CopySubresourceRegion(staging.Texture.get(),
+                                                   D3D11CalcSubresource(0, slice, m_stagingDesc.MipLevels),
+                                                   0,
+                                                   0,
+                                                   0,
+                                                   colorTexture,
+                                                   D3D11CalcSubresource(0, slice, m_colorMipLevels),
+                                                   &box);
+        }
+        staging.CopyTime = std::chrono::steady_clock::now();
+
+        staging.Message = {};
+        staging.Message.FrameIndex = m_frameIndex++;
+        staging.Message.DisplayTime = displayTime;
+        staging.Message.Width = imageRect.extent.width;
+        staging.Message.Height = imageRect.extent.height;
+        staging.Message.ArraySize = m_stagingDesc.ArraySize;
+        staging.Message.Format = m_stagingDesc.Format;
+        for (uint32_t i = 0; i < viewCount && i < MaxCaptureViews; i++) {
+            staging.Message.Poses[i] = views[i].pose;
+            staging.Message.Fovs[i] = views[i].fov;
+        }
+
+        staging.State = StagingState::Copied;
+    }
+
+    void FrameCapture::CreateResources(const D3D11_TEXTURE2D_DESC& colorDesc) {
+        CHECK_MSG(colorDesc.SampleDesc.Count == 1, "Capture of multisampled swapchains is not supported");
+        CHECK(colorDesc.ArraySize <= MaxCaptureViews);
+        CHECK_MSG(IsCaptureFormat(colorDesc.Format), "Capture supports swapchain formats of 4 bytes per pixel only");
+
+        // Large enough for any image rect of the swapchain image, which is copied into the top left corner of mip 0.
+        m_colorMipLevels = colorDesc.MipLevels;
+        m_stagingDesc = colorDesc;
+        m_stagingDesc.MipLevels = 1;
+        m_stagingDesc.Usage = D3D11_USAGE_STAGING;
+        m_stagingDesc.BindFlags = 0;
+        m_stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        m_stagingDesc.MiscFlags = 0;
+
+        for (uint32_t i = 0; i < m_options.StagingCount; i++) {
+            auto staging = std::make_unique<Staging>();
+            CHECK_HRCMD(memory::CreateTexture2D(
+                m_device.get(), m_stagingDesc, nullptr, memory::ResourceCategory::Staging, "capture staging", staging->Texture.put()));
+            m_stagings.push_back(std::move(staging));
+        }
+
+        // Encoded output is written directly into a named section, so a receiver on the same machine maps it
+        // instead of reading the pixels through the socket.
+        const uint64_t slotSize = MaxEncodedSize(m_stagingDesc.Width, m_stagingDesc.Height) * m_stagingDesc.ArraySize;
+        const uint64_t dataOffset = (sizeof(SharedRingHeader) + 4095) & ~4095ull;
+        const uint64_t sectionSize = dataOffset + slotSize * m_options.SlotCount;
+
+        m_sharedMemory = CreateFileMappingW(INVALID_HANDLE_VALUE,
+                                            nullptr,
+                                            PAGE_READWRITE,
+                                            (DWORD)(sectionSize >> 32),
+                                            (DWORD)sectionSize,
+                                            SharedMemoryName(m_options.Port).c_str());
+        CHECK_MSG(m_sharedMemory != nullptr, "CreateFileMapping failed");
+        m_sharedHeader = static_cast<SharedRingHeader*>(MapViewOfFile(m_sharedMemory, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+        CHECK_MSG(m_sharedHeader != nullptr, "MapViewOfFile failed");
+
+        new (m_sharedHeader) SharedRingHeader{};
+        m_sharedHeader->SlotCount = m_options.SlotCount;
+        m_sharedHeader->SlotSize = slotSize;
+        m_sharedHeader->DataOffset = dataOffset;
+        for (std::atomic<uint32_t>& slotState : m_sharedHeader->SlotStates) {
+            slotState.store(SlotFree, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        m_sharedHeader->Magic = SharedRingMagic;
+
+        for (uint32_t i = 0; i < m_options.WorkerCount; i++) {
+            m_encodeThreads.emplace_back([this] { EncodeThreadProc(); });
+        }
+        m_sendThread = std::thread([this] { SendThreadProc(); });
+    }
+
+    void FrameCapture::ProcessReadbacks() {
+        for (const std::unique_ptr<Staging>& staging : m_stagings) {
+            if (staging->State == StagingState::Encoded) {
+                Unmap(*staging);
+                staging->State = StagingState::Free;
+            } else if (staging->State == StagingState::Copied) {
+                // Never wait for the GPU here. A copy that is not done yet is retried on the next frame.
+                bool mapped = true;
+                for (uint32_t slice = 0; slice < m_stagingDesc.ArraySize; slice++) {
+                    const HRESULT hr = m_deviceContext->Map(staging->Texture.get(),
+                                                            D3D11CalcSubresource(0, slice, m_stagingDesc.MipLevels),
+                                                            D3D11_MAP_READ,
+                                                            D3D11_MAP_FLAG_DO_NOT_WAIT,
+                                                            &staging->Mapped[slice]);
+                    if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+                        for (uint32_t mappedSlice = 0; mappedSlice < slice; mappedSlice++) {
+                            m_deviceContext->Unmap(staging->Texture.get(), D3D11CalcSubresource(0, mappedSlice, m_stagingDesc.MipLevels));
+                        }
+                        mapped = false;
+                        break;
+                    }
+                    CHECK_HRCMD(hr);
+                }
+
+                if (mapped) {
+                    m_readback.Add(staging->CopyTime, std::chrono::steady_clock::now());
+                    staging->State = StagingState::Encoding;
+                    {
+                        std::lock_guard lock(m_mutex);
+                        m_encodeQueue.push_back(staging.get());
+                    }
+                    m_workAvailable.notify_all();
+                }
+            }
+        }
+    }
+
+    void FrameCapture::Unmap(Staging& staging) {
+        for (uint32_t slice = 0; slice < m_stagingDesc.ArraySize; slice++) {
+            m_deviceContext->Unmap(staging.Texture.get(), D3D11CalcSubresource(0, slice, m_stagingDesc.MipLevels));
+        }
+    }
+
+    void FrameCapture::EncodeThreadProc() {
+        while (true) {
+            Staging* staging;
+            {
+                std::unique_lock lock(m_mutex);
+                m_workAvailable.wait(lock, [this] { return m_stopRequested || !m_encodeQueue.empty(); });
+                if (m_stopRequested) {
+                    return;
+                }
+                staging = m_encodeQueue.front();
+                m_encodeQueue.pop_front();
+            }
+
+            Encode(*staging);
+        }
+    }
+
+    void FrameCapture::Encode(Staging& staging) {
+        const auto start = std::chrono::steady_clock::now();
+
+        // The receiver hands slots back by resetting them to SlotFree.
+        std::optional<uint32_t> slot;
+        for (uint32_t i = 0; i < m_sharedHeader->SlotCount && !slot; i++) {
+            uint32_t expected = SlotFree;
+            if (m_sharedHeader->SlotStates[i].compare_exchange_strong(expected, SlotWriting, std::memory_order_acquire)) {
+                slot = i;
+            }
+        }
+        if (!slot) {
+            m_droppedFrames++;
+            staging.State = StagingState::Encoded;
+            return;
+        }
+
+        PendingSend pending{staging.Message, staging.CopyTime};
+        pending.Message.Slot = slot.value();
+
+        uint8_t* output = SlotData(slot.value());
+        size_t encodedSize = 0;
+        for (uint32_t slice = 0; slice < pending.Message.ArraySize; slice++) {
+            const D3D11_MAPPED_SUBRESOURCE& mapped = staging.Mapped[slice];
+            const size_t sliceSize = EncodeLossless(static_cast<const uint8_t*>(mapped.pData),
+                                                    pending.Message.Width,
+                                                    pending.Message.Height,
+                                                    mapped.RowPitch,
+                                                    output + encodedSize);
+            pending.Message.EncodedSizes[slice] = (uint32_t)sliceSize;
+            encodedSize += sliceSize;
+        }
+
+        // Done reading the mapped memory, the render thread can unmap and reuse the staging texture.
+        staging.State = StagingState::Encoded;
+
+        m_rawBytes += (uint64_t)pending.Message.Width * pending.Message.Height * 4 * pending.Message.ArraySize;
+        m_encodedBytes += encodedSize;
+        m_encode.Add(start, std::chrono::steady_clock::now());
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_sendQueue.push_back(pending);
+        }
+        m_workAvailable.notify_all();
+    }
+
+    void FrameCapture::SendThreadProc() {
+        WSADATA wsaData;
+        const bool winsockStarted = WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+
+        SOCKET socket = INVALID_SOCKET;
+        std::chrono::steady_clock::time_point nextConnect{};
+
+        while (true) {
+            PendingSend pending;
+            {
+                std::unique_lock lock(m_mutex);
+                m_workAvailable.wait(lock, [this] { return m_stopRequested || !m_sendQueue.empty(); });
+                if (m_stopRequested) {
+                    break;
+                }
+                pending = m_sendQueue.front();
+                m_sendQueue.pop_front();
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            if (winsockStarted && socket == INVALID_SOCKET && start >= nextConnect) {
+                socket = ConnectLoopback(m_options.Port);
+                if (socket == INVALID_SOCKET) {
+                    // No receiver listening. Try again later instead of paying for a failed connect every frame.
+                    nextConnect = start + std::chrono::seconds(1);
+                }
+            }
+
+            std::atomic<uint32_t>& slotState = m_sharedHeader->SlotStates[pending.Message.Slot];
+            slotState.store(SlotReady, std::memory_order_release);
+
+            if (socket != INVALID_SOCKET && SendAll(socket, &pending.Message, sizeof(pending.Message))) {
+                const auto end = std::chrono::steady_clock::now();
+                m_send.Add(start, end);
+                m_endToEnd.Add(pending.CopyTime, end);
+                continue;
+            }
+
+            m_droppedFrames++;
+            slotState.store(SlotFree, std::memory_order_release);
+            if (socket != INVALID_SOCKET) {
+                // The receiver went away, so nobody will hand back the slots it was still reading.
+                closesocket(socket);
+                socket = INVALID_SOCKET;
+                nextConnect = start + std::chrono::seconds(1);
+                for (uint32_t i = 0; i < m_sharedHeader->SlotCount; i++) {
+                    uint32_t expected = SlotReady;
+                    m_sharedHeader->SlotStates[i].compare_exchange_strong(expected, SlotFree);
+                }
+            }
+        }
+
+        if (socket != INVALID_SOCKET) {
+            closesocket(socket);
+        }
+        if (winsockStarted) {
+            WSACleanup();
+        }
+    }
+
+    uint8_t* FrameCapture::SlotData(uint32_t slot) const {
+        return reinterpret_cast<uint8_t*>(m_sharedHeader) + m_sharedHeader->DataOffset + slot * m_sharedHeader->SlotSize;
+    }
+
+    CaptureMetrics FrameCapture::Metrics() const {
+        CaptureMetrics metrics;
+        metrics.Readback = m_readback.Get();
+        metrics.Encode = m_encode.Get();
+        metrics.Send = m_send.Get();
+        metrics.EndToEnd = m_endToEnd.Get();
+        metrics.DroppedFrames = m_droppedFrames;
+        metrics.RawBytes = m_rawBytes;
+        metrics.EncodedBytes = m_encodedBytes;
+        return metrics;
+    }
+
+    void FrameCapture::StageCounter::Add(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+        const uint64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        Count.fetch_add(1, std::memory_order_relaxed);
+        TotalMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+
+        uint64_t max = MaxMicroseconds.load(std::memory_order_relaxed);
+        while (microseconds > max && !MaxMicroseconds.compare_exchange_weak(max, microseconds, std::memory_order_relaxed)) {
+        }
+    }
+
+    StageMetrics FrameCapture::StageCounter::Get() const {
+        StageMetrics metrics;
+        metrics.Count = Count.load(std::memory_order_relaxed);
+        if (metrics.Count > 0) {
+            metrics.AverageMilliseconds = TotalMicroseconds.load(std::memory_order_relaxed) / 1000.0 / metrics.Count;
+        }
+        metrics.MaxMilliseconds = MaxMicroseconds.load(std::memory_order_relaxed) / 1000.0;
+        return metrics;
+    }
+} // namespace sample::capture
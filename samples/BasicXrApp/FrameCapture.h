@@ -0,0 +1,132 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include "CaptureProtocol.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace sample::capture {
+
+    struct StageMetrics {
+        uint64_t Count{0};
+        double AverageMilliseconds{0};
+        double MaxMilliseconds{0};
+    };
+
+    struct CaptureMetrics {
+        StageMetrics Readback; // Copy until the staging texture could be mapped without stalling
+        StageMetrics Encode;
+        StageMetrics Send;
+        StageMetrics EndToEnd; // Copy until the frame message was sent
+        uint64_t DroppedFrames{0};
+        uint64_t RawBytes{0};
+        uint64_t EncodedBytes{0};
+    };
+
+    // Streams the rendered color swapchain image to a local receiver.
+    // The GPU copies each captured image into a ring of staging textures. They are mapped a few frames later
+    // without stalling, and worker threads encode straight from the mapped memory into a shared memory ring,
+    // so pixels are touched once by the CPU. Frame metadata and poses go over a loopback TCP connection.
+    // Frames are dropped, never queued without bound, when the receiver or the encoder falls behind.
+    // samples/CaptureReceiver is such a receiver.
+    class FrameCapture {
+    public:
+        struct Options {
+            uint32_t StagingCount{3};
+            uint32_t SlotCount{4};
+            uint32_t WorkerCount{2};
+            uint16_t Port{DefaultCapturePort}; // Also names the shared memory section, see SharedMemoryName
+        };
+
+        FrameCapture(ID3D11Device* device, Options options);
+        ~FrameCapture();
+
+        FrameCapture(const FrameCapture&) = delete;
+        FrameCapture& operator=(const FrameCapture&) = delete;
+
+        // Render thread: call after rendering into the color swapchain image and before releasing it.
+        // Only the image rect submitted with the frame is copied and encoded.
+        void Capture(ID3D11Texture2D* colorTexture, const XrRect2Di& imageRect, XrTime displayTime, const XrView* views, uint32_t viewCount);
+
+        CaptureMetrics Metrics() const;
+
+    private:
+        enum class StagingState { Free, Copied, Encoding, Encoded };
+
+        struct Staging {
+            winrt::com_ptr<ID3D11Texture2D> Texture;
+            std::atomic<StagingState> State{StagingState::Free};
+            FrameMessage Message;
+            std::chrono::steady_clock::time_point CopyTime;
+            std::array<D3D11_MAPPED_SUBRESOURCE, MaxCaptureViews> Mapped{};
+        };
+
+        struct PendingSend {
+            FrameMessage Message;
+            std::chrono::steady_clock::time_point CopyTime;
+        };
+
+        // Accumulates one StageMetrics from several threads.
+        struct StageCounter {
+            std::atomic<uint64_t> Count{0};
+            std::atomic<uint64_t> TotalMicroseconds{0};
+            std::atomic<uint64_t> MaxMicroseconds{0};
+
+            void Add(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+            StageMetrics Get() const;
+        };
+
+        void CreateResources(const D3D11_TEXTURE2D_DESC& colorDesc);
+        void ProcessReadbacks();
+        void Unmap(Staging& staging);
+        void EncodeThreadProc();
+        void Encode(Staging& staging);
+        void SendThreadProc();
+        uint8_t* SlotData(uint32_t slot) const;
+
+        const Options m_options;
+        winrt::com_ptr<ID3D11Device> m_device;
+        winrt::com_ptr<ID3D11DeviceContext> m_deviceContext;
+
+        D3D11_TEXTURE2D_DESC m_stagingDesc{};
+        uint32_t m_colorMipLevels{1};
+        std::vector<std::unique_ptr<Staging>> m_stagings;
+        uint64_t m_frameIndex{0};
+
+        HANDLE m_sharedMemory{nullptr};
+        SharedRingHeader* m_sharedHeader{nullptr};
+
+        std::mutex m_mutex;
+        std::condition_variable m_workAvailable;
+        std::deque<Staging*> m_encodeQueue;
+        std::deque<PendingSend> m_sendQueue;
+        bool m_stopRequested{false};
+        std::vector<std::thread> m_encodeThreads;
+        std::thread m_sendThread;
+
+        StageCounter m_readback;
+        StageCounter m_encode;
+        StageCounter m_send;
+        StageCounter m_endToEnd;
+        std::atomic<uint64_t> m_droppedFrames{0};
+        std::atomic<uint64_t> m_rawBytes{0};
+        std::atomic<uint64_t> m_encodedBytes{0};
+    };
+
+} // namespace sample::capture
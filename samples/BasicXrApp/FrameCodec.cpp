@@ -0,0 +1,180 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "FrameCodec.h"
+
+namespace {
+    constexpr uint8_t OpIndex = 0x00; // 00iiiiii: pixel from the table
+    constexpr uint8_t OpDiff = 0x40;  // 01rrggbb: each channel differs by -2..1 from the previous pixel
+    constexpr uint8_t OpLuma = 0x80;  // 10gggggg rrrrbbbb: green differs by -32..31, red and blue by -8..7 relative to it
+    constexpr uint8_t OpRun = 0xc0;   // 11llllll: previous pixel repeated 1..62 times
+    constexpr uint8_t OpRgb = 0xfe;   // Literal color, same alpha
+    constexpr uint8_t OpRgba = 0xff;  // Literal color and alpha
+    constexpr uint8_t OpMask = 0xc0;
+    constexpr uint32_t MaxRun = 62; // Run lengths 63 and 64 would collide with OpRgb and OpRgba
+
+    struct Pixel {
+        uint8_t C0, C1, C2, A;
+
+        bool operator==(const Pixel& other) const {
+            return C0 == other.C0 && C1 == other.C1 && C2 == other.C2 && A == other.A;
+        }
+    };
+
+    uint32_t Hash(const Pixel& p) {
+        return (p.C0 * 3 + p.C1 * 5 + p.C2 * 7 + p.A * 11) % 64;
+    }
+} // namespace
+
+namespace sample::capture {
+    size_t EncodeLossless(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint8_t* output) {
+        std::array<Pixel, 64> table{};
+        Pixel previous{0, 0, 0, 255};
+        uint32_t run = 0;
+        uint8_t* out = output;
+
+        for (uint32_t y = 0; y < height; y++) {
+            const uint8_t* row = pixels + (size_t)y * rowPitch;
+            for (uint32_t x = 0; x < width; x++) {
+                Pixel pixel;
+                std::memcpy(&pixel, row + (size_t)x * 4, sizeof(pixel));
+
+                if (pixel == previous) {
+                    if (++run == MaxRun) {
+                        *out++ = OpRun | (uint8_t)(run - 1);
+                        run = 0;
+                    }
+                    continue;
+                }
+
+                if (run > 0) {
+                    *out++ = OpRun | (uint8_t)(run - 1);
+                    run = 0;
+                }
+
+                const uint32_t hash = Hash(pixel);
+                if (table[hash] == pixel) {
+                    *out++ = OpIndex | (uint8_t)hash;
+                } else {
+                    table[hash] = pixel;
+
+                    if (pixel.A == previous.A) {
+                        // Differences wrap around, e.g. 255 -> 0 is +1.
+                        const int8_t d0 = (int8_t)(pixel.C0 - previous.C0);
+                        const int8_t d1 = (int8_t)(pixel.C1 - previous.C1);
+                        const int8_t d2 = (int8_t)(pixel.C2 - previous.C2);
+                        const int8_t d0d1 = (int8_t)(d0 - d1);
+                        const int8_t d2d1 = (int8_t)(d2 - d1);
+
+                        if (d0 >= -2 && d0 <= 1 && d1 >= -2 && d1 <= 1 && d2 >= -2 && d2 <= 1) {
+                            *out++ = OpDiff | (uint8_t)((d0 + 2) << 4 | (d1 + 2) << 2 | (d2 + 2));
+                        } else if (d1 >= -32 && d1 <= 31 && d0d1 >= -8 && d0d1 <= 7 && d2d1 >= -8 && d2d1 <= 7) {
+                            *out++ = OpLuma | (uint8_t)(d1 + 32);
+                            *out++ = (uint8_t)((d0d1 + 8) << 4 | (d2d1 + 8));
+                        } else {
+                            *out++ = OpRgb;
+                            *out++ = pixel.C0;
+                            *out++ = pixel.C1;
+                            *out++ = pixel.C2;
+                        }
+                    } else {
+                        *out++ = OpRgba;
+                        *out++ = pixel.C0;
+                        *out++ = pixel.C1;
+                        *out++ = pixel.C2;
+                        *out++ = pixel.A;
+                    }
+                }
+
+                previous = pixel;
+            }
+        }
+
+        if (run > 0) {
+            *out++ = OpRun | (uint8_t)(run - 1);
+        }
+
+        return out - output;
+    }
+
+    bool DecodeLossless(const uint8_t* data, size_t size, uint32_t width, uint32_t height, uint8_t* pixels) {
+        std::array<Pixel, 64> table{};
+        Pixel pixel{0, 0, 0, 255};
+        const uint8_t* const end = data + size;
+        const size_t pixelCount = (size_t)width * height;
+
+        for (size_t written = 0; written < pixelCount;) {
+            if (data == end) {
+                return false;
+            }
+
+            const uint8_t op = *data++;
+            size_t repeat = 1;
+            if (op == OpRgb) {
+                if (end - data < 3) {
+                    return false;
+                }
+                pixel.C0 = *data++;
+                pixel.C1 = *data++;
+                pixel.C2 = *data++;
+            } else if (op == OpRgba) {
+                if (end - data < 4) {
+                    return false;
+                }
+                pixel.C0 = *data++;
+                pixel.C1 = *data++;
+                pixel.C2 = *data++;
+                pixel.A = *data++;
+            } else {
+                switch (op & OpMask) {
+                case OpIndex:
+                    pixel = table[op & 0x3f];
+                    break;
+                case OpDiff:
+                    pixel.C0 += ((op >> 4) & 0x03) - 2;
+                    pixel.C1 += ((op >> 2) & 0x03) - 2;
+                    pixel.C2 += (op & 0x03) - 2;
+                    break;
+                case OpLuma: {
+                    if (data == end) {
+                        return false;
+                    }
+                    const uint8_t second = *data++;
+                    const int d1 = (op & 0x3f) - 32;
+                    pixel.C0 += d1 - 8 + ((second >> 4) & 0x0f);
+                    pixel.C1 += d1;
+                    pixel.C2 += d1 - 8 + (second & 0x0f);
+                    break;
+                }
+                case OpRun:
+                    repeat = (op & 0x3f) + 1;
+                    if (written + repeat > pixelCount) {
+                        return false;
+                    }
+                    break;
+                }
+            }
+
+            table[Hash(pixel)] = pixel;
+            for (size_t i = 0; i < repeat; i++, written++) {
+                std::memcpy(pixels + written * 4, &pixel, sizeof(pixel));
+            }
+        }
+
+        return data == end;
+    }
+} // namespace sample::capture
@@ -0,0 +1,37 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+namespace sample::capture {
+
+    // Fast lossless codec for 4 byte per pixel images, in the style of QOI: each pixel is encoded as a run of the
+    // previous pixel, a reference into a 64 entry table of recently seen pixels, a small difference to the previous
+    // pixel, or a literal. Single pass, no entropy coding, so encoding runs at memory speed on one core.
+    // Channel order does not matter, the codec works on the 4 bytes of each pixel as they are.
+
+    // Upper bound of the encoded size of one image, used to size output buffers.
+    constexpr size_t MaxEncodedSize(uint32_t width, uint32_t height) {
+        return (size_t)width * height * 5;
+    }
+
+    // Encodes width x height pixels, rows rowPitch bytes apart, into output, which must hold MaxEncodedSize bytes.
+    // Returns the number of bytes written.
+    size_t EncodeLossless(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint8_t* output);
+
+    // Decodes into width * height tightly packed pixels. Returns false if the data is truncated or malformed.
+    bool DecodeLossless(const uint8_t* data, size_t size, uint32_t width, uint32_t height, uint8_t* pixels);
+
+} // namespace sample::capture
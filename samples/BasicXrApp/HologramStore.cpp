@@ -0,0 +1,296 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "HologramStore.h"
+#include <cinttypes>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr uint32_t HologramFileMagic = 0x53485258; // "XRHS"
+    constexpr uint32_t HologramFileVersion = 2;
+
+    struct HologramFileHeader {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t RecordSize;
+        uint32_t RecordCount;
+    };
+
+    struct HologramRecordV1 {
+        uint64_t AnchorId;
+        XrPosef PoseInScene;
+        XrVector3f Scale;
+        uint32_t Reserved[2];
+    };
+    static_assert(sizeof(HologramRecordV1) == 56, "HologramRecordV1 layout is part of the file format");
+
+    uint32_t RecordSize(uint32_t version) {
+        return version == 1 ? sizeof(HologramRecordV1) : sizeof(sample::persistence::HologramRecord);
+    }
+
+    // Persisted anchor names are per app, the prefix keeps other names of this app apart from hologram anchors.
+    constexpr char AnchorNamePrefix[] = "Hologram.";
+
+    XrSpatialAnchorPersistenceNameMSFT AnchorName(uint64_t id) {
+        XrSpatialAnchorPersistenceNameMSFT name{};
+        snprintf(name.name, sizeof(name.name), "%s%016" PRIx64, AnchorNamePrefix, id);
+        return name;
+    }
+
+    // Returns zero for names not written by AnchorName.
+    uint64_t AnchorId(const XrSpatialAnchorPersistenceNameMSFT& name) {
+        constexpr size_t prefixLength = sizeof(AnchorNamePrefix) - 1;
+        if (strncmp(name.name, AnchorNamePrefix, prefixLength) != 0) {
+            return 0;
+        }
+        char* end = nullptr;
+        const uint64_t id = strtoull(name.name + prefixLength, &end, 16);
+        return *end == '\0' ? id : 0;
+    }
+} // namespace
+
+namespace sample::persistence {
+    std::unique_ptr<HologramFile> HologramFile::Open(const std::wstring& path) {
+#ifdef _WIN32
+        const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            const DWORD error = GetLastError();
+            CHECK_MSG(error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND, "Cannot open hologram file");
+            return nullptr;
+        }
+#else
+        const int file = open(std::filesystem::path(path).c_str(), O_RDONLY);
+        if (file < 0) {
+            CHECK_MSG(errno == ENOENT, "Cannot open hologram file");
+            return nullptr;
+        }
+#endif
+        return std::unique_ptr<HologramFile>(new HologramFile(file));
+    }
+
+#ifdef _WIN32
+    HologramFile::HologramFile(HANDLE file)
+        : m_file(file) {
+        LARGE_INTEGER size;
+        CHECK(GetFileSizeEx(m_file, &size));
+        const uint64_t fileSize = size.QuadPart;
+        CHECK_MSG(fileSize >= sizeof(HologramFileHeader), "Hologram file is too small");
+
+        m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CHECK_MSG(m_mapping != nullptr, "CreateFileMapping failed");
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        CHECK_MSG(m_data != nullptr, "MapViewOfFile failed");
+#else
+    HologramFile::HologramFile(int file)
+        : m_file(file) {
+        struct stat status;
+        CHECK(fstat(m_file, &status) == 0);
+        const uint64_t fileSize = status.st_size;
+        CHECK_MSG(fileSize >= sizeof(HologramFileHeader), "Hologram file is too small");
+
+        void* data = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, m_file, 0);
+        CHECK_MSG(data != MAP_FAILED, "mmap failed");
+        m_data = static_cast<const uint8_t*>(data);
+        m_mappedSize = fileSize;
+#endif
+
+        const HologramFileHeader* header = reinterpret_cast<const HologramFileHeader*>(m_data);
+        CHECK_MSG(header->Magic == HologramFileMagic && header->Version >= 1 && header->Version <= HologramFileVersion &&
+                      header->RecordSize == RecordSize(header->Version),
+                  "Not a hologram file");
+        CHECK_MSG(sizeof(HologramFileHeader) + (uint64_t)header->RecordCount * header->RecordSize <= fileSize,
+                  "Hologram file is truncated");
+        m_version = header->Version;
+        m_count = header->RecordCount;
+    }
+
+    HologramFile::~HologramFile() {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+#else
+        munmap(const_cast<uint8_t*>(m_data), m_mappedSize);
+        close(m_file);
+#endif
+    }
+
+    HologramRecord HologramFile::Record(uint32_t index) const {
+        CHECK(index < m_count);
+        const uint8_t* records = m_data + sizeof(HologramFileHeader);
+        if (m_version == 1) {
+            // Each hologram had its own anchor, created at the hologram's pose.
+            const HologramRecordV1& record = reinterpret_cast<const HologramRecordV1*>(records)[index];
+            return {record.AnchorId, record.PoseInScene, record.Scale, xr::math::Pose::Identity()};
+        }
+        return reinterpret_cast<const HologramRecord*>(records)[index];
+    }
+
+    void HologramFile::Write(const std::wstring& path, const std::vector<HologramRecord>& records) {
+        CHECK_MSG(records.size() <= UINT32_MAX / sizeof(HologramRecord), "Too many holograms to save");
+        const std::wstring temporaryPath = path + L".tmp";
+        const HologramFileHeader header{HologramFileMagic, HologramFileVersion, sizeof(HologramRecord), (uint32_t)records.size()};
+#ifdef _WIN32
+        const HANDLE file = CreateFileW(temporaryPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        CHECK_MSG(file != INVALID_HANDLE_VALUE, "Cannot create hologram file");
+
+        const DWORD recordBytes = (DWORD)(records.size() * sizeof(HologramRecord));
+        DWORD written = 0;
+        bool succeeded = WriteFile(file, &header, sizeof(header), &written, nullptr) && written == sizeof(header);
+        succeeded = succeeded && WriteFile(file, records.data(), recordBytes, &written, nullptr) && written == recordBytes;
+        succeeded = succeeded && FlushFileBuffers(file);
+        CloseHandle(file);
+        CHECK_MSG(succeeded, "Cannot write hologram file");
+        CHECK_MSG(MoveFileExW(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH),
+                  "Cannot replace hologram file");
+#else
+        const std::filesystem::path temporaryFile(temporaryPath);
+        const int file = open(temporaryFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        CHECK_MSG(file >= 0, "Cannot create hologram file");
+
+        const size_t recordBytes = records.size() * sizeof(HologramRecord);
+        bool succeeded = write(file, &header, sizeof(header)) == (ssize_t)sizeof(header);
+        succeeded = succeeded && write(file, records.data(), recordBytes) == (ssize_t)recordBytes;
+        succeeded = succeeded && fsync(file) == 0;
+        close(file);
+        CHECK_MSG(succeeded, "Cannot write hologram file");
+        CHECK_MSG(rename(temporaryFile.c_str(), std::filesystem::path(path).c_str()) == 0, "Cannot replace hologram file");
+#endif
+    }
+
+    AnchorStore::AnchorStore(const dispatch::DispatchTable& dispatch, XrSession session)
+        : m_dispatch(dispatch)
+        , m_session(session) {
+        CHECK_MSG(m_dispatch.xrCreateSpatialAnchorStoreConnectionMSFT != nullptr, "XR_MSFT_spatial_anchor_persistence is not enabled");
+        CHECK_XRCMD(m_dispatch.xrCreateSpatialAnchorStoreConnectionMSFT(m_session, &m_connection));
+        m_resolver = std::thread(&AnchorStore::ResolverProc, this);
+    }
+
+    AnchorStore::~AnchorStore() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopRequested = true;
+        }
+        m_requestQueued.notify_one();
+        m_resolver.join();
+
+        for (const ResolvedAnchor& resolved : m_resolved) {
+            if (resolved.Anchor != XR_NULL_HANDLE) {
+                m_dispatch.xrDestroySpatialAnchorMSFT(resolved.Anchor);
+            }
+        }
+        m_dispatch.xrDestroySpatialAnchorStoreConnectionMSFT(m_connection);
+    }
+
+    void AnchorStore::Persist(uint64_t id, XrSpatialAnchorMSFT anchor) {
+        XrSpatialAnchorPersistenceInfoMSFT persistenceInfo{XR_TYPE_SPATIAL_ANCHOR_PERSISTENCE_INFO_MSFT};
+        persistenceInfo.spatialAnchorPersistenceName = AnchorName(id);
+        persistenceInfo.spatialAnchor = anchor;
+        CHECK_XRCMD(m_dispatch.xrPersistSpatialAnchorMSFT(m_connection, &persistenceInfo));
+
+        std::lock_guard lock(m_mutex);
+        m_stats.Persisted++;
+    }
+
+    void AnchorStore::RequestAnchor(uint64_t id) {
+        {
+            std::lock_guard lock(m_mutex);
+            m_requests.push_back(id);
+        }
+        m_requestQueued.notify_one();
+    }
+
+    void AnchorStore::TakeResolved(std::vector<ResolvedAnchor>* resolved) {
+        std::lock_guard lock(m_mutex);
+        resolved->insert(resolved->end(), m_resolved.begin(), m_resolved.end());
+        m_resolved.clear();
+    }
+
+    void AnchorStore::RemoveUnreferenced(const std::unordered_set<uint64_t>& keep) {
+        uint32_t count = 0;
+        CHECK_XRCMD(m_dispatch.xrEnumeratePersistedSpatialAnchorNamesMSFT(m_connection, 0, &count, nullptr));
+        std::vector<XrSpatialAnchorPersistenceNameMSFT> names(count);
+        CHECK_XRCMD(m_dispatch.xrEnumeratePersistedSpatialAnchorNamesMSFT(m_connection, count, &count, names.data()));
+        names.resize(count);
+
+        uint32_t removed = 0;
+        for (const XrSpatialAnchorPersistenceNameMSFT& name : names) {
+            const uint64_t id = AnchorId(name);
+            if (id != 0 && keep.count(id) == 0) {
+                CHECK_XRCMD(m_dispatch.xrUnpersistSpatialAnchorMSFT(m_connection, &name));
+                removed++;
+            }
+        }
+
+        std::lock_guard lock(m_mutex);
+        m_stats.Removed += removed;
+    }
+
+    AnchorStore::Stats AnchorStore::GetStats() const {
+        std::lock_guard lock(m_mutex);
+        return m_stats;
+    }
+
+    void AnchorStore::ResolverProc() {
+        for (;;) {
+            uint64_t id;
+            {
+                std::unique_lock lock(m_mutex);
+                m_requestQueued.wait(lock, [this] { return m_stopRequested || !m_requests.empty(); });
+                if (m_stopRequested) {
+                    return;
+                }
+                id = m_requests.front();
+                m_requests.pop_front();
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            XrSpatialAnchorFromPersistedAnchorCreateInfoMSFT createInfo{XR_TYPE_SPATIAL_ANCHOR_FROM_PERSISTED_ANCHOR_CREATE_INFO_MSFT};
+            createInfo.spatialAnchorStore = m_connection;
+            createInfo.spatialAnchorPersistenceName = AnchorName(id);
+            XrSpatialAnchorMSFT anchor{XR_NULL_HANDLE};
+            try {
+                const XrResult result = m_dispatch.xrCreateSpatialAnchorFromPersistedNameMSFT(m_session, &createInfo, &anchor);
+                if (result == XR_ERROR_SPATIAL_ANCHOR_NAME_NOT_FOUND_MSFT) {
+                    anchor = XR_NULL_HANDLE; // Unpersisted, or the store was cleared since the scene was saved
+                } else {
+                    CHECK_XRRESULT(result, "xrCreateSpatialAnchorFromPersistedNameMSFT");
+                }
+            } catch (const std::exception& ex) {
+                DEBUG_PRINT("Failed to resolve anchor %s: %s", createInfo.spatialAnchorPersistenceName.name, ex.what());
+                anchor = XR_NULL_HANDLE;
+            }
+            const auto resolveTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+            std::lock_guard lock(m_mutex);
+            m_resolved.push_back({id, anchor});
+            if (anchor != XR_NULL_HANDLE) {
+                m_stats.Resolved++;
+            } else {
+                m_stats.Missing++;
+            }
+            m_stats.MaxResolveTime = std::max(m_stats.MaxResolveTime, resolveTime);
+        }
+    }
+} // namespace sample::persistence
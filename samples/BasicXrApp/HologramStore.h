@@ -0,0 +1,132 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+
+#include "XrDispatch.h"
+
+namespace sample::persistence {
+
+    // One placed hologram as saved. Part of the file format, so fields are only ever added with a new file version.
+    struct HologramRecord {
+        uint64_t AnchorId{0}; // Names the anchor persisted in the runtime's anchor store, zero without one
+        XrPosef PoseInScene;
+        XrVector3f Scale;
+        XrPosef PoseInAnchor; // Relative to the anchor, which several holograms may share. Added in version 2.
+        uint32_t Reserved{0};
+    };
+    static_assert(sizeof(HologramRecord) == 80, "HologramRecord layout is part of the file format");
+
+    // A saved scene: a small header followed by fixed size records. The file is mapped read-only, with Win32 or POSIX
+    // mmap, and records are read in place, so opening costs the same for any number of holograms and only the records read so far are paged in.
+    // Version 1 files, with an anchor per hologram, are read with the anchor at the hologram's pose.
+    class HologramFile {
+    public:
+        // Returns null when there is no file at path. Throws when the file is not a hologram file of a known version.
+        static std::unique_ptr<HologramFile> Open(const std::wstring& path);
+
+        // Writes a temporary file next to path and then replaces path, so a crash while saving keeps the previous scene.
+        // Replacing fails while path is open, so close it first.
+        static void Write(const std::wstring& path, const std::vector<HologramRecord>& records);
+
+        ~HologramFile();
+
+        HologramFile(const HologramFile&) = delete;
+        HologramFile& operator=(const HologramFile&) = delete;
+
+        uint32_t Count() const {
+            return m_count;
+        }
+
+        HologramRecord Record(uint32_t index) const;
+
+    private:
+#ifdef _WIN32
+        explicit HologramFile(HANDLE file);
+
+        HANDLE m_file{INVALID_HANDLE_VALUE};
+        HANDLE m_mapping{nullptr};
+#else
+        explicit HologramFile(int file);
+
+        int m_file{-1};
+        uint64_t m_mappedSize{0};
+#endif
+        const uint8_t* m_data{nullptr};
+        uint32_t m_version{0};
+        uint32_t m_count{0};
+    };
+
+    // Anchors persisted by name in the runtime's anchor store with XR_MSFT_spatial_anchor_persistence. Finding a
+    // persisted anchor in the environment can take the runtime a while, so anchors are created from their names on a
+    // background thread and handed to the frame loop as they resolve.
+    class AnchorStore {
+    public:
+        struct ResolvedAnchor {
+            uint64_t Id;
+            XrSpatialAnchorMSFT Anchor; // Owned by the caller, or XR_NULL_HANDLE when the store has no anchor of that name
+        };
+
+        struct Stats {
+            uint32_t Persisted{0};
+            uint32_t Resolved{0};
+            uint32_t Missing{0};
+            uint32_t Removed{0};
+            std::chrono::microseconds MaxResolveTime{0};
+        };
+
+        // The table must come from an instance with XR_MSFT_spatial_anchor_persistence enabled, and outlive the store.
+        AnchorStore(const dispatch::DispatchTable& dispatch, XrSession session);
+        ~AnchorStore();
+
+        AnchorStore(const AnchorStore&) = delete;
+        AnchorStore& operator=(const AnchorStore&) = delete;
+
+        // Persists the anchor under the name of id, replacing any anchor of that name.
+        void Persist(uint64_t id, XrSpatialAnchorMSFT anchor);
+
+        // Queues creating the anchor persisted under id.
+        void RequestAnchor(uint64_t id);
+
+        // Appends the anchors resolved since the last call, in no particular order.
+        void TakeResolved(std::vector<ResolvedAnchor>* resolved);
+
+        // Unpersists anchors of this app whose ids are not in keep, e.g. of holograms placed in a session that never saved.
+        void RemoveUnreferenced(const std::unordered_set<uint64_t>& keep);
+
+        Stats GetStats() const;
+
+    private:
+        void ResolverProc();
+
+        const dispatch::DispatchTable& m_dispatch;
+        const XrSession m_session;
+        XrSpatialAnchorStoreConnectionMSFT m_connection{XR_NULL_HANDLE};
+
+        std::thread m_resolver;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_requestQueued;
+        std::deque<uint64_t> m_requests;
+        std::vector<ResolvedAnchor> m_resolved;
+        bool m_stopRequested{false};
+        Stats m_stats;
+    };
+
+} // namespace sample::persistence
@@ -0,0 +1,119 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "InputSampler.h"
+
+namespace sample::input {
+    InputSampler::InputSampler(const dispatch::DispatchTable& dispatch,
+                               ActionCache& actionCache,
+                               XrSession session,
+                               XrSpace baseSpace,
+                               std::array<XrSpace, 2> handSpaces,
+                               Clock clock,
+                               Options options)
+        : m_dispatch(dispatch)
+        , m_actionCache(actionCache)
+        , m_session(session)
+        , m_baseSpace(baseSpace)
+        , m_handSpaces(handSpaces)
+        , m_clock(std::move(clock))
+        , m_options(options) {
+        m_thread = std::thread([this] { ThreadProc(); });
+    }
+
+    InputSampler::~InputSampler() {
+        m_stopRequested = true;
+        m_thread.join();
+    }
+
+    void InputSampler::ThreadProc() {
+        try {
+            auto nextSample = std::chrono::steady_clock::now();
+            while (!m_stopRequested) {
+                Sample();
+
+                nextSample += m_options.Period;
+                const auto now = std::chrono::steady_clock::now();
+                if (nextSample < now) {
+                    // Fell behind, e.g. the runtime blocked in xrSyncActions. Skip the missed ticks instead of bursting.
+                    nextSample = now;
+                }
+                std::this_thread::sleep_until(nextSample);
+            }
+        } catch (...) {
+            m_failure = std::current_exception();
+            m_failed = true;
+        }
+    }
+
+    void InputSampler::Sample() {
+        m_actionCache.SyncAndRefresh(m_dispatch, m_session);
+
+        // Forward changes to the render thread. Dropping one would lose a press or release,
+        // so wait for the consumer instead when the queue is full.
+        m_actionCache.ForEachChange([this](const ActionChange& change) {
+            while (!m_changes.TryPush(change)) {
+                if (m_stopRequested) {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        });
+
+        InputSnapshot snapshot;
+        snapshot.Time = m_clock();
+        for (size_t side = 0; side < m_handSpaces.size(); side++) {
+            XrSpaceLocation location{XR_TYPE_SPACE_LOCATION};
+            CHECK_XRCMD(m_dispatch.xrLocateSpace(m_handSpaces[side], m_baseSpace, snapshot.Time, &location));
+            snapshot.Hands[side] = {location.locationFlags, location.pose};
+        }
+        m_snapshots.Publish(snapshot);
+    }
+
+    void InputSampler::DispatchChanges() {
+        if (m_failed) {
+            std::rethrow_exception(m_failure);
+        }
+
+        ActionChange change;
+        while (m_changes.TryPop(&change)) {
+            m_actionCache.Dispatch(change);
+        }
+    }
+
+    std::optional<InputSnapshot> InputSampler::FindClosest(XrTime time) const {
+        std::optional<InputSnapshot> closest;
+        XrDuration closestDistance = std::numeric_limits<XrDuration>::max();
+
+        // Snapshot times only increase, so walk back from the newest until the distance starts growing again.
+        InputSnapshot snapshot;
+        for (uint64_t index = m_snapshots.PublishedCount(); index-- > 0;) {
+            if (!m_snapshots.TryRead(index, &snapshot)) {
+                break;
+            }
+
+            const XrDuration distance = std::abs(snapshot.Time - time);
+            if (distance > closestDistance) {
+                break;
+            }
+            closestDistance = distance;
+            closest = snapshot;
+        }
+
+        return closest;
+    }
+} // namespace sample::input
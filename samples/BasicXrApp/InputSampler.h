@@ -0,0 +1,86 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include "ActionCache.h"
+#include "LockFreeChannel.h"
+
+namespace sample::input {
+
+    struct HandSample {
+        XrSpaceLocationFlags LocationFlags{0};
+        XrPosef Pose{};
+    };
+
+    // Hand locations sampled together at a single XrTime by the input thread.
+    struct InputSnapshot {
+        XrTime Time{0};
+        std::array<HandSample, 2> Hands{};
+    };
+
+    // Syncs actions and locates hand spaces on a dedicated thread at a fixed rate, independent of the frame rate.
+    // Snapshots are published through a seqlock ring and action changes through an SPSC queue,
+    // so the render thread never waits on the input thread.
+    class InputSampler {
+    public:
+        struct Options {
+            std::chrono::microseconds Period{2000}; // 500Hz
+        };
+
+        // Returns the current XrTime, e.g. converted from QueryPerformanceCounter.
+        using Clock = std::function<XrTime()>;
+
+        InputSampler(const dispatch::DispatchTable& dispatch,
+                     ActionCache& actionCache,
+                     XrSession session,
+                     XrSpace baseSpace,
+                     std::array<XrSpace, 2> handSpaces,
+                     Clock clock,
+                     Options options);
+        ~InputSampler();
+
+        InputSampler(const InputSampler&) = delete;
+        InputSampler& operator=(const InputSampler&) = delete;
+
+        // Render thread: run the callbacks for action changes sampled since the previous call.
+        // Also rethrows any error raised on the input thread.
+        void DispatchChanges();
+
+        // Snapshot sampled closest to the given time, if one is still held in the ring.
+        std::optional<InputSnapshot> FindClosest(XrTime time) const;
+
+    private:
+        void ThreadProc();
+        void Sample();
+
+        const dispatch::DispatchTable& m_dispatch;
+        ActionCache& m_actionCache;
+        const XrSession m_session;
+        const XrSpace m_baseSpace;
+        const std::array<XrSpace, 2> m_handSpaces;
+        const Clock m_clock;
+        const Options m_options;
+
+        concurrency::SeqLockRing<InputSnapshot, 256> m_snapshots;
+        concurrency::SpscQueue<ActionChange, 256> m_changes;
+
+        std::atomic<bool> m_stopRequested{false};
+        std::atomic<bool> m_failed{false};
+        std::exception_ptr m_failure;
+        std::thread m_thread;
+    };
+
+} // namespace sample::input
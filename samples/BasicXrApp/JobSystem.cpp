@@ -0,0 +1,214 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "JobSystem.h"
+
+namespace {
+    // Workers remember which job system they belong to, since benchmarks create their own besides the process one.
+    thread_local const sample::jobs::JobSystem* t_jobSystem = nullptr;
+    thread_local uint32_t t_queueIndex = 0;
+
+    sample::jobs::JobSystem::Options g_processOptions{};
+    std::atomic<bool> g_processCreated{false};
+} // namespace
+
+namespace sample::jobs {
+
+    JobSystem::JobSystem(Options options) {
+        uint32_t threadCount = options.ThreadCount;
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (uint32_t i = 0; i < threadCount; i++) {
+            m_queues.push_back(std::make_unique<Queue>());
+        }
+        for (uint32_t i = 0; i + 1 < threadCount; i++) {
+            m_workers.emplace_back(&JobSystem::WorkerProc, this, i);
+        }
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard lock(m_sleepMutex);
+            m_stopRequested = true;
+        }
+        m_jobQueued.notify_all();
+        for (std::thread& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    JobSystem& JobSystem::Process() {
+        static JobSystem jobSystem([] {
+            g_processCreated = true;
+            return g_processOptions;
+        }());
+        return jobSystem;
+    }
+
+    void JobSystem::ConfigureProcess(Options options) {
+        CHECK_MSG(!g_processCreated, "The process job system is already running");
+        g_processOptions = options;
+    }
+
+    uint32_t JobSystem::CurrentQueue() const {
+        return t_jobSystem == this ? t_queueIndex : (uint32_t)m_queues.size() - 1;
+    }
+
+    void JobSystem::Push(Job job) {
+        // Counted before it is visible, so the count never drops below the number of queued jobs.
+        m_queuedJobs.fetch_add(1, std::memory_order_relaxed);
+        Queue& queue = *m_queues[CurrentQueue()];
+        {
+            std::lock_guard lock(queue.Mutex);
+            queue.Jobs.push_back(std::move(job));
+        }
+
+        if (!m_workers.empty()) {
+            // Pairs with the predicate check in WorkerProc, so a worker about to sleep cannot miss this job.
+            { std::lock_guard lock(m_sleepMutex); }
+            m_jobQueued.notify_one();
+        }
+    }
+
+    bool JobSystem::TryRunOne() {
+        if (m_queuedJobs.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+
+        const uint32_t self = CurrentQueue();
+        const uint32_t queueCount = (uint32_t)m_queues.size();
+        Job job;
+        for (uint32_t i = 0; i < queueCount && !job; i++) {
+            Queue& queue = *m_queues[(self + i) % queueCount];
+            std::lock_guard lock(queue.Mutex);
+            if (queue.Jobs.empty()) {
+                continue;
+            }
+            // The own queue is used as a stack for locality, others are stolen from in FIFO order,
+            // which takes the largest remaining parts of a recursively split range.
+            if (i == 0) {
+                job = std::move(queue.Jobs.back());
+                queue.Jobs.pop_back();
+            } else {
+                job = std::move(queue.Jobs.front());
+                queue.Jobs.pop_front();
+            }
+        }
+
+        if (!job) {
+            return false;
+        }
+        m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        job();
+        return true;
+    }
+
+    void JobSystem::WorkerProc(uint32_t index) {
+        t_jobSystem = this;
+        t_queueIndex = index;
+
+        for (;;) {
+            if (TryRunOne()) {
+                continue;
+            }
+
+            std::unique_lock lock(m_sleepMutex);
+            m_jobQueued.wait(lock, [&] { return m_stopRequested || m_queuedJobs.load(std::memory_order_relaxed) > 0; });
+            if (m_stopRequested) {
+                return;
+            }
+        }
+    }
+
+    void JobSystem::ParallelFor(size_t begin, size_t end, size_t grainSize, const RangeFunction& body) {
+        grainSize = std::max<size_t>(grainSize, 1);
+        if (end <= begin) {
+            return;
+        }
+        if (end - begin <= grainSize || m_workers.empty()) {
+            for (size_t rangeBegin = begin; rangeBegin < end; rangeBegin += grainSize) {
+                body(rangeBegin, std::min(end, rangeBegin + grainSize));
+            }
+            return;
+        }
+
+        TaskGroup group(*this);
+        std::function<void(size_t, size_t)> split = [&](size_t rangeBegin, size_t rangeEnd) {
+            while (rangeEnd - rangeBegin > grainSize) {
+                const size_t middle = rangeBegin + (rangeEnd - rangeBegin) / 2;
+                group.Run([&split, middle, rangeEnd] { split(middle, rangeEnd); });
+                rangeEnd = middle;
+            }
+            body(rangeBegin, rangeEnd);
+        };
+
+        try {
+            split(begin, end);
+        } catch (...) {
+            group.Wait(); // Jobs still reference split and body
+            throw;
+        }
+        group.Wait();
+    }
+
+    TaskGroup::TaskGroup(JobSystem& jobSystem)
+        : m_jobSystem(jobSystem) {
+    }
+
+    TaskGroup::~TaskGroup() {
+        try {
+            Wait();
+        } catch (...) {
+            // Failures are only reported by an explicit Wait.
+        }
+    }
+
+    void TaskGroup::Run(std::function<void()> job) {
+        m_pendingJobs.fetch_add(1, std::memory_order_relaxed);
+        m_jobSystem.Push([this, job = std::move(job)] {
+            try {
+                job();
+            } catch (...) {
+                std::lock_guard lock(m_failureMutex);
+                if (!m_failure) {
+                    m_failure = std::current_exception();
+                }
+            }
+            m_pendingJobs.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    void TaskGroup::Wait() {
+        while (m_pendingJobs.load(std::memory_order_acquire) != 0) {
+            if (!m_jobSystem.TryRunOne()) {
+                std::this_thread::yield();
+            }
+        }
+
+        std::exception_ptr failure;
+        {
+            std::lock_guard lock(m_failureMutex);
+            failure = m_failure;
+            m_failure = nullptr;
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+} // namespace sample::jobs
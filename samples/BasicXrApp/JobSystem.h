@@ -0,0 +1,99 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace sample::jobs {
+
+    // Work-stealing scheduler. Each worker pushes and pops jobs at the back of its own deque, and idle workers steal
+    // from the front of the others', so jobs forked by one job mostly stay on the thread that has them in cache.
+    // Threads waiting for their jobs execute other jobs meanwhile, including threads that are not workers.
+    class JobSystem {
+    public:
+        struct Options {
+            uint32_t ThreadCount{0}; // Including the thread calling ParallelFor or TaskGroup::Wait. Zero uses every hardware thread.
+        };
+
+        explicit JobSystem(Options options);
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        uint32_t ThreadCount() const {
+            return (uint32_t)m_workers.size() + 1;
+        }
+
+        // Shared by every session of the process, so hosting more sessions does not add more workers.
+        // Created on first use, with the options of the last ConfigureProcess call made before it.
+        static JobSystem& Process();
+        static void ConfigureProcess(Options options);
+
+        // Calls body(rangeBegin, rangeEnd) for consecutive ranges of at most grainSize elements covering [begin, end).
+        // Ranges are split in halves recursively, so idle threads steal large ranges first. Returns when all are done,
+        // rethrowing the first exception thrown by body.
+        using RangeFunction = std::function<void(size_t rangeBegin, size_t rangeEnd)>;
+        void ParallelFor(size_t begin, size_t end, size_t grainSize, const RangeFunction& body);
+
+    private:
+        friend class TaskGroup;
+        using Job = std::function<void()>;
+
+        struct Queue {
+            std::mutex Mutex;
+            std::deque<Job> Jobs;
+        };
+
+        void Push(Job job);
+        bool TryRunOne();
+        void WorkerProc(uint32_t index);
+        uint32_t CurrentQueue() const;
+
+        // One queue per worker, plus one shared by all other threads, which is the last.
+        std::vector<std::unique_ptr<Queue>> m_queues;
+        std::vector<std::thread> m_workers;
+
+        std::atomic<uint32_t> m_queuedJobs{0};
+        std::mutex m_sleepMutex;
+        std::condition_variable m_jobQueued;
+        bool m_stopRequested{false};
+    };
+
+    // Fork-join scope: Run queues jobs, Wait executes queued jobs until all jobs run by this group have finished.
+    class TaskGroup {
+    public:
+        explicit TaskGroup(JobSystem& jobSystem);
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        void Run(std::function<void()> job);
+
+        // Rethrows the first exception thrown by a job of this group.
+        void Wait();
+
+    private:
+        JobSystem& m_jobSystem;
+        std::atomic<uint32_t> m_pendingJobs{0};
+        std::mutex m_failureMutex;
+        std::exception_ptr m_failure;
+    };
+
+} // namespace sample::jobs
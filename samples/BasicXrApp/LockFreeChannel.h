@@ -0,0 +1,112 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <type_traits>
+
+namespace sample::concurrency {
+
+    // Bounded single-producer single-consumer FIFO. Push fails instead of blocking when full.
+    template <typename T, uint32_t Capacity>
+    class SpscQueue {
+        static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        bool TryPush(const T& value) {
+            const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_head.load(std::memory_order_acquire) == Capacity) {
+                return false;
+            }
+            m_items[tail & (Capacity - 1)] = value;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool TryPop(T* value) {
+            const uint32_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            *value = m_items[head & (Capacity - 1)];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        std::array<T, Capacity> m_items{};
+        alignas(64) std::atomic<uint32_t> m_head{0};
+        alignas(64) std::atomic<uint32_t> m_tail{0};
+    };
+
+    // Ring of the most recent Capacity values published by a single writer. Each slot is guarded by its own
+    // sequence lock, so readers never block the writer and simply retry or skip a slot that is being rewritten.
+    template <typename T, uint32_t Capacity>
+    class SeqLockRing {
+        static_assert(std::is_trivially_copyable_v<T>, "Seqlock payloads are copied while they may be written");
+        static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        void Publish(const T& value) {
+            const uint64_t index = m_published.load(std::memory_order_relaxed);
+            Slot& slot = m_slots[index & (Capacity - 1)];
+
+            const uint32_t sequence = slot.Sequence.load(std::memory_order_relaxed);
+            slot.Sequence.store(sequence + 1, std::memory_order_relaxed); // Odd while writing
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.Index.store(index, std::memory_order_relaxed);
+            std::memcpy(&slot.Value, &value, sizeof(T));
+            slot.Sequence.store(sequence + 2, std::memory_order_release);
+
+            m_published.store(index + 1, std::memory_order_release);
+        }
+
+        // Number of values published so far. The newest value has index PublishedCount() - 1.
+        uint64_t PublishedCount() const {
+            return m_published.load(std::memory_order_acquire);
+        }
+
+        // Returns false if the value was already overwritten, or is being overwritten right now.
+        bool TryRead(uint64_t index, T* value) const {
+            if (index >= PublishedCount() || PublishedCount() - index > Capacity) {
+                return false;
+            }
+
+            const Slot& slot = m_slots[index & (Capacity - 1)];
+            const uint32_t before = slot.Sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                return false;
+            }
+            const uint64_t slotIndex = slot.Index.load(std::memory_order_relaxed);
+            std::memcpy(value, &slot.Value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint32_t after = slot.Sequence.load(std::memory_order_relaxed);
+
+            // The slot must not have been rewritten, or already hold a newer index, by the time of the copy.
+            return before == after && slotIndex == index;
+        }
+
+    private:
+        struct alignas(64) Slot {
+            std::atomic<uint32_t> Sequence{0};
+            std::atomic<uint64_t> Index{0};
+            T Value{};
+        };
+
+        std::array<Slot, Capacity> m_slots{};
+        alignas(64) std::atomic<uint64_t> m_published{0};
+    };
+
+} // namespace sample::concurrency
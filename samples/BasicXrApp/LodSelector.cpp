@@ -0,0 +1,146 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "LodSelector.h"
+#include <cfloat>
+#include <cmath>
+
+namespace {
+    float SquaredDistance(const XrVector3f& a, const XrVector3f& b) {
+        const float x = a.x - b.x;
+        const float y = a.y - b.y;
+        const float z = a.z - b.z;
+        return x * x + y * y + z * z;
+    }
+} // namespace
+
+namespace sample::lod {
+    LodSelector::LodSelector(Options options)
+        : m_options(options) {
+    }
+
+    LodChainId LodSelector::AddChain(const std::vector<sample::mesh::MeshHandle>& meshesFinestFirst) {
+        std::vector<LodLevel> levels;
+        float screenSize = m_options.FinestScreenSize;
+        for (const sample::mesh::MeshHandle& mesh : meshesFinestFirst) {
+            levels.push_back({mesh, screenSize});
+            screenSize /= 2;
+        }
+        return AddChain(std::move(levels));
+    }
+
+    LodChainId LodSelector::AddChain(std::vector<LodLevel> levels) {
+        CHECK_MSG(!levels.empty() && levels.size() <= UINT8_MAX, "A LOD chain needs between 1 and 255 levels");
+        levels.back().MinScreenSize = 0; // The coarsest level is used however small the hologram gets
+
+        Chain& chain = m_chains.emplace_back();
+        chain.Levels = std::move(levels);
+        return (LodChainId)m_chains.size() - 1;
+    }
+
+    void LodSelector::ResolveMeshes(const MeshInfoFunction& findMeshInfo) {
+        for (Chain& chain : m_chains) {
+            if (chain.Resolved) {
+                continue;
+            }
+
+            chain.Resolved = true;
+            for (LodLevel& level : chain.Levels) {
+                if (level.TriangleCount != 0) {
+                    continue;
+                }
+                if (const std::optional<sample::mesh::MeshInfo> info = findMeshInfo(level.Mesh)) {
+                    const XrVector3f& min = info->BoundsMin;
+                    const XrVector3f& max = info->BoundsMax;
+                    const XrVector3f extent{std::max(std::abs(min.x), std::abs(max.x)),
+                                            std::max(std::abs(min.y), std::abs(max.y)),
+                                            std::max(std::abs(min.z), std::abs(max.z))};
+                    level.TriangleCount = info->TriangleCount;
+                    level.Radius = std::sqrt(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+                    chain.Radius = std::max(chain.Radius, level.Radius);
+                } else {
+                    chain.Resolved = false; // Still loading, or failed and drawn as a cube
+                }
+            }
+        }
+    }
+
+    void LodSelector::BeginFrame(const XrView* views, uint32_t viewCount) {
+        m_views.resize(viewCount);
+        for (uint32_t i = 0; i < viewCount; i++) {
+            const XrFovf& fov = views[i].fov;
+            m_views[i].Position = views[i].pose.position;
+            m_views[i].InverseHeight = 1.0f / (std::tan(fov.angleUp) - std::tan(fov.angleDown));
+        }
+        m_stats = {};
+    }
+
+    float LodSelector::ScreenSize(const XrVector3f& center, float radius) const {
+        // The size in a view is 2 * radius / distance * InverseHeight. Its square is compared across views, so the square
+        // root is only taken once per hologram.
+        float largestSquaredSize = 0;
+        for (const ViewFrustum& view : m_views) {
+            const float squaredDistance = SquaredDistance(view.Position, center);
+            if (squaredDistance <= radius * radius) {
+                return FLT_MAX; // The viewer is inside the bounding sphere
+            }
+            largestSquaredSize = std::max(largestSquaredSize, view.InverseHeight * view.InverseHeight / squaredDistance);
+        }
+        return 2 * radius * std::sqrt(largestSquaredSize);
+    }
+
+    sample::mesh::MeshHandle LodSelector::Select(LodChainId chainId, const XrPosef& pose, const XrVector3f& scale, uint8_t* level) {
+        CHECK(chainId < m_chains.size());
+        const Chain& chain = m_chains[chainId];
+        const std::vector<LodLevel>& levels = chain.Levels;
+
+        const float radius = (chain.Radius > 0 ? chain.Radius : CubeRadius) * std::max({scale.x, scale.y, scale.z});
+        const float size = ScreenSize(pose.position, radius);
+
+        // Coarser once the hologram is clearly smaller than its level allows, finer once it is clearly bigger than the
+        // finer level needs. Between the two it keeps its level.
+        uint32_t selected = std::min<uint32_t>(*level, (uint32_t)levels.size() - 1);
+        while (selected + 1 < levels.size() && size < levels[selected].MinScreenSize * (1 - m_options.Hysteresis)) {
+            selected++;
+        }
+        while (selected > 0 && size >= levels[selected - 1].MinScreenSize * (1 + m_options.Hysteresis)) {
+            selected--;
+        }
+
+        auto TriangleCount = [](const LodLevel& level) { return level.TriangleCount != 0 ? level.TriangleCount : CubeTriangleCount; };
+        m_stats.Holograms++;
+        m_stats.FullDetailTriangles += TriangleCount(levels.front());
+        m_stats.SelectedTriangles += TriangleCount(levels[selected]);
+        if (selected != *level) {
+            m_stats.LevelChanges++;
+            *level = (uint8_t)selected;
+        }
+        return levels[selected].TriangleCount != 0 ? levels[selected].Mesh : sample::mesh::MeshHandle{};
+    }
+
+    void LodSelector::CountCube() {
+        m_stats.Holograms++;
+        m_stats.FullDetailTriangles += CubeTriangleCount;
+        m_stats.SelectedTriangles += CubeTriangleCount;
+    }
+
+    float LodSelector::LevelRadius(LodChainId chainId, uint8_t level) const {
+        CHECK(chainId < m_chains.size());
+        const std::vector<LodLevel>& levels = m_chains[chainId].Levels;
+        const LodLevel& drawn = levels[std::min<size_t>(level, levels.size() - 1)];
+        return drawn.TriangleCount != 0 ? drawn.Radius : CubeRadius;
+    }
+} // namespace sample::lod
@@ -0,0 +1,103 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include "MeshLibrary.h"
+
+namespace sample::lod {
+
+    // Index of a chain added to a LodSelector.
+    using LodChainId = uint32_t;
+    constexpr LodChainId NoLodChain = ~0u;
+
+    // One level of a chain, finest first.
+    struct LodLevel {
+        sample::mesh::MeshHandle Mesh;
+        float MinScreenSize{0};    // Fraction of the view height the hologram must cover to use this level. Zero for the coarsest.
+        uint32_t TriangleCount{0}; // Zero until the mesh is loaded
+        float Radius{0};           // Bounding sphere radius around the mesh origin, zero until the mesh is loaded
+    };
+
+    struct FrameStats {
+        uint32_t Holograms{0};
+        uint64_t FullDetailTriangles{0}; // If every hologram used its finest level
+        uint64_t SelectedTriangles{0};
+        uint32_t LevelChanges{0};
+    };
+
+    // Picks a level of detail per hologram from its projected size in whichever view sees it largest. A hologram only
+    // moves to another level once its size is past the threshold by the hysteresis fraction, so it does not pop back and
+    // forth at a threshold. Not thread safe, call from the thread gathering the scene.
+    class LodSelector {
+    public:
+        struct Options {
+            float FinestScreenSize{0.25f}; // Default thresholds: level i is used down to FinestScreenSize / 2^i of the view height
+            float Hysteresis{0.15f};
+        };
+
+        // Unloaded meshes render as the built-in cube, so they are counted as one.
+        constexpr static uint32_t CubeTriangleCount = 12;
+        constexpr static float CubeRadius = 0.8660254f; // Bounding sphere of the unit cube centered on its origin
+
+        explicit LodSelector(Options options);
+
+        // Adds a chain with the default thresholds.
+        LodChainId AddChain(const std::vector<sample::mesh::MeshHandle>& meshesFinestFirst);
+        LodChainId AddChain(std::vector<LodLevel> levels);
+
+        // Fills in triangle counts and radii of meshes loaded since the last call.
+        using MeshInfoFunction = std::function<std::optional<sample::mesh::MeshInfo>(sample::mesh::MeshHandle)>;
+        void ResolveMeshes(const MeshInfoFunction& findMeshInfo);
+
+        // Views are in the space of the hologram poses passed to Select. Resets the frame stats.
+        void BeginFrame(const XrView* views, uint32_t viewCount);
+
+        // Returns the mesh to draw, invalid while the level is not loaded, and updates level, the hologram's level from
+        // the previous frame.
+        sample::mesh::MeshHandle Select(LodChainId chain, const XrPosef& pose, const XrVector3f& scale, uint8_t* level);
+
+        // Counts a hologram drawn as the built-in cube.
+        void CountCube();
+
+        // Bounding sphere radius around the origin of a level as drawn, the cube's until it is loaded. Unscaled.
+        float LevelRadius(LodChainId chain, uint8_t level) const;
+
+        const FrameStats& Stats() const {
+            return m_stats;
+        }
+
+        // Largest fraction of the view height a sphere covers in any view of the frame.
+        float ScreenSize(const XrVector3f& center, float radius) const;
+
+    private:
+        struct Chain {
+            std::vector<LodLevel> Levels;
+            float Radius{0}; // Largest radius of its loaded levels
+            bool Resolved{false};
+        };
+
+        struct ViewFrustum {
+            XrVector3f Position;
+            float InverseHeight; // 1 / (tan(up) - tan(down)), the view height at distance 1
+        };
+
+        const Options m_options;
+        std::vector<Chain> m_chains;
+        std::vector<ViewFrustum> m_views;
+        FrameStats m_stats;
+    };
+
+} // namespace sample::lod
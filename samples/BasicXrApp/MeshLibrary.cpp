@@ -0,0 +1,633 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "MeshLibrary.h"
+#include "ResourceTracker.h"
+#include <charconv>
+#include <string_view>
+
+#ifndef _WIN32
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr uint32_t GlbMagic = 0x46546C67; // "glTF"
+    constexpr uint32_t GlbVersion = 2;
+    constexpr uint32_t JsonChunkType = 0x4E4F534A; // "JSON"
+    constexpr uint32_t BinaryChunkType = 0x004E4942; // "BIN\0"
+
+    constexpr uint32_t UnsignedByte = 5121;
+    constexpr uint32_t UnsignedShort = 5123;
+    constexpr uint32_t UnsignedInt = 5125;
+    constexpr uint32_t Float = 5126;
+    constexpr uint32_t Triangles = 4;
+
+    struct GlbHeader {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t Length;
+    };
+
+    struct GlbChunkHeader {
+        uint32_t Length;
+        uint32_t Type;
+    };
+
+    // Just enough JSON for glTF. Strings are views into the mapped chunk and are not unescaped, which is fine for the
+    // keys and enumeration strings glTF uses, and keeps parsing free of allocations except for the containers.
+    struct JsonValue {
+        enum class Type : uint8_t { Null, Bool, Number, String, Array, Object };
+
+        Type Kind{Type::Null};
+        bool Bool{false};
+        double Number{0};
+        std::string_view String;
+        std::vector<JsonValue> Elements; // Array elements, or object members in the order of Keys
+        std::vector<std::string_view> Keys;
+
+        const JsonValue* Find(std::string_view key) const {
+            for (size_t i = 0; i < Keys.size(); i++) {
+                if (Keys[i] == key) {
+                    return &Elements[i];
+                }
+            }
+            return nullptr;
+        }
+    };
+
+    class JsonParser {
+    public:
+        explicit JsonParser(std::string_view text)
+            : m_text(text) {
+        }
+
+        JsonValue ParseDocument() {
+            JsonValue document = ParseValue(0);
+            SkipWhitespace();
+            CHECK_MSG(m_offset == m_text.size(), "Unexpected characters after glTF JSON");
+            return document;
+        }
+
+    private:
+        constexpr static uint32_t MaxDepth = 64;
+
+        JsonValue ParseValue(uint32_t depth) {
+            CHECK_MSG(depth < MaxDepth, "glTF JSON is nested too deeply");
+            SkipWhitespace();
+            CHECK_MSG(m_offset < m_text.size(), "Truncated glTF JSON");
+
+            JsonValue value;
+            const char c = m_text[m_offset];
+            if (c == '{') {
+                value.Kind = JsonValue::Type::Object;
+                m_offset++;
+                if (!Consume('}')) {
+                    do {
+                        SkipWhitespace();
+                        value.Keys.push_back(ParseString());
+                        SkipWhitespace();
+                        CHECK_MSG(Consume(':'), "Expected ':' in glTF JSON");
+                        value.Elements.push_back(ParseValue(depth + 1));
+                    } while (Consume(','));
+                    CHECK_MSG(Consume('}'), "Expected '}' in glTF JSON");
+                }
+            } else if (c == '[') {
+                value.Kind = JsonValue::Type::Array;
+                m_offset++;
+                if (!Consume(']')) {
+                    do {
+                        value.Elements.push_back(ParseValue(depth + 1));
+                    } while (Consume(','));
+                    CHECK_MSG(Consume(']'), "Expected ']' in glTF JSON");
+                }
+            } else if (c == '"') {
+                value.Kind = JsonValue::Type::String;
+                value.String = ParseString();
+            } else if (ConsumeLiteral("true")) {
+                value.Kind = JsonValue::Type::Bool;
+                value.Bool = true;
+            } else if (ConsumeLiteral("false")) {
+                value.Kind = JsonValue::Type::Bool;
+            } else if (ConsumeLiteral("null")) {
+                value.Kind = JsonValue::Type::Null;
+            } else {
+                value.Kind = JsonValue::Type::Number;
+                const char* begin = m_text.data() + m_offset;
+                const auto [end, error] = std::from_chars(begin, m_text.data() + m_text.size(), value.Number);
+                CHECK_MSG(error == std::errc(), "Invalid number in glTF JSON");
+                m_offset += end - begin;
+            }
+            return value;
+        }
+
+        std::string_view ParseString() {
+            CHECK_MSG(Consume('"'), "Expected string in glTF JSON");
+            const size_t begin = m_offset;
+            while (m_offset < m_text.size() && m_text[m_offset] != '"') {
+                m_offset += m_text[m_offset] == '\\' ? 2 : 1;
+            }
+            CHECK_MSG(m_offset < m_text.size(), "Unterminated string in glTF JSON");
+            return m_text.substr(begin, m_offset++ - begin);
+        }
+
+        void SkipWhitespace() {
+            while (m_offset < m_text.size() &&
+                   (m_text[m_offset] == ' ' || m_text[m_offset] == '\t' || m_text[m_offset] == '\n' || m_text[m_offset] == '\r')) {
+                m_offset++;
+            }
+        }
+
+        bool Consume(char c) {
+            SkipWhitespace();
+            if (m_offset < m_text.size() && m_text[m_offset] == c) {
+                m_offset++;
+                return true;
+            }
+            return false;
+        }
+
+        bool ConsumeLiteral(std::string_view literal) {
+            if (m_text.substr(m_offset, literal.size()) == literal) {
+                m_offset += literal.size();
+                return true;
+            }
+            return false;
+        }
+
+        const std::string_view m_text;
+        size_t m_offset{0};
+    };
+
+    const JsonValue& Member(const JsonValue& object, std::string_view key) {
+        const JsonValue* member = object.Find(key);
+        CHECK_MSG(member != nullptr, "Missing required glTF property");
+        return *member;
+    }
+
+    const JsonValue& Element(const JsonValue* array, uint32_t index) {
+        CHECK_MSG(array != nullptr && array->Kind == JsonValue::Type::Array && index < array->Elements.size(),
+                  "glTF index out of range");
+        return array->Elements[index];
+    }
+
+    uint32_t ToUint(const JsonValue& value) {
+        CHECK_MSG(value.Kind == JsonValue::Type::Number && value.Number >= 0 && value.Number <= UINT32_MAX &&
+                      value.Number == (double)(uint32_t)value.Number,
+                  "Expected an unsigned integer in glTF JSON");
+        return (uint32_t)value.Number;
+    }
+
+    uint32_t UintMember(const JsonValue& object, std::string_view key, std::optional<uint32_t> defaultValue = {}) {
+        const JsonValue* member = object.Find(key);
+        if (member == nullptr) {
+            CHECK_MSG(defaultValue.has_value(), "Missing required glTF property");
+            return defaultValue.value();
+        }
+        return ToUint(*member);
+    }
+
+    uint32_t ComponentSize(uint32_t componentType) {
+        switch (componentType) {
+        case 5120: // BYTE
+        case UnsignedByte:
+            return 1;
+        case 5122: // SHORT
+        case UnsignedShort:
+            return 2;
+        case UnsignedInt:
+        case Float:
+            return 4;
+        default:
+            CHECK_MSG(false, "Unknown glTF component type");
+            return 0;
+        }
+    }
+
+    uint32_t ComponentCount(std::string_view type) {
+        if (type == "SCALAR") {
+            return 1;
+        } else if (type == "VEC2") {
+            return 2;
+        } else if (type == "VEC3") {
+            return 3;
+        } else if (type == "VEC4" || type == "MAT2") {
+            return 4;
+        } else if (type == "MAT3") {
+            return 9;
+        } else if (type == "MAT4") {
+            return 16;
+        }
+        CHECK_MSG(false, "Unknown glTF accessor type");
+        return 0;
+    }
+
+    XrVector3f Vector3Member(const JsonValue& object, std::string_view key) {
+        const JsonValue& array = Member(object, key);
+        CHECK_MSG(array.Kind == JsonValue::Type::Array && array.Elements.size() == 3, "Expected a 3 component glTF vector");
+        for (const JsonValue& element : array.Elements) {
+            CHECK_MSG(element.Kind == JsonValue::Type::Number, "Expected a number in glTF vector");
+        }
+        return {(float)array.Elements[0].Number, (float)array.Elements[1].Number, (float)array.Elements[2].Number};
+    }
+} // namespace
+
+namespace sample::mesh {
+    GlbFile::GlbFile(const std::wstring& path) {
+#ifdef _WIN32
+        m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        CHECK_MSG(m_file != INVALID_HANDLE_VALUE, "Cannot open mesh file");
+
+        LARGE_INTEGER fileSize;
+        CHECK(GetFileSizeEx(m_file, &fileSize));
+        m_size = fileSize.QuadPart;
+        CHECK_MSG(m_size >= sizeof(GlbHeader) + sizeof(GlbChunkHeader), "Mesh file is too small");
+
+        m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CHECK_MSG(m_mapping != nullptr, "CreateFileMapping failed");
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        CHECK_MSG(m_data != nullptr, "MapViewOfFile failed");
+#else
+        m_file = open(std::filesystem::path(path).c_str(), O_RDONLY);
+        CHECK_MSG(m_file >= 0, "Cannot open mesh file");
+
+        struct stat status;
+        CHECK(fstat(m_file, &status) == 0);
+        m_size = status.st_size;
+        CHECK_MSG(m_size >= sizeof(GlbHeader) + sizeof(GlbChunkHeader), "Mesh file is too small");
+
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_file, 0);
+        CHECK_MSG(data != MAP_FAILED, "mmap failed");
+        m_data = static_cast<const uint8_t*>(data);
+#endif
+
+        Parse();
+    }
+
+    GlbFile::~GlbFile() {
+#ifdef _WIN32
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping) {
+            CloseHandle(m_mapping);
+        }
+        CloseHandle(m_file);
+#else
+        if (m_data) {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+        }
+        close(m_file);
+#endif
+    }
+
+    void GlbFile::Parse() {
+        GlbHeader header;
+        std::memcpy(&header, m_data, sizeof(header));
+        CHECK_MSG(header.Magic == GlbMagic && header.Version == GlbVersion, "Not a glTF 2.0 binary file");
+        CHECK_MSG(header.Length <= m_size, "Truncated glTF binary file");
+
+        // Chunks follow the header back to back, the JSON chunk first and the optional binary chunk second.
+        std::string_view json;
+        uint64_t offset = sizeof(GlbHeader);
+        while (offset + sizeof(GlbChunkHeader) <= header.Length) {
+            GlbChunkHeader chunk;
+            std::memcpy(&chunk, m_data + offset, sizeof(chunk));
+            offset += sizeof(chunk);
+            CHECK_MSG(offset + chunk.Length <= header.Length, "Truncated glTF chunk");
+
+            if (chunk.Type == JsonChunkType && json.empty()) {
+                json = std::string_view(reinterpret_cast<const char*>(m_data + offset), chunk.Length);
+            } else if (chunk.Type == BinaryChunkType && m_binaryChunk == nullptr) {
+                m_binaryChunk = m_data + offset;
+                m_binaryChunkSize = chunk.Length;
+            }
+            offset += (chunk.Length + 3) & ~3ull; // Chunks are 4-byte aligned
+        }
+        CHECK_MSG(!json.empty(), "glTF binary file has no JSON chunk");
+
+        const JsonValue document = JsonParser(json).ParseDocument();
+        CHECK_MSG(document.Kind == JsonValue::Type::Object, "glTF JSON is not an object");
+
+        // Only the GLB-stored buffer is supported, external buffers would need a second mapping each.
+        if (const JsonValue* buffers = document.Find("buffers")) {
+            CHECK_MSG(buffers->Kind == JsonValue::Type::Array && buffers->Elements.size() <= 1, "External glTF buffers are not supported");
+            if (!buffers->Elements.empty()) {
+                const JsonValue& buffer = buffers->Elements[0];
+                CHECK_MSG(buffer.Find("uri") == nullptr, "External glTF buffers are not supported");
+                CHECK_MSG(UintMember(buffer, "byteLength") <= m_binaryChunkSize, "glTF buffer exceeds the binary chunk");
+            }
+        }
+
+        const JsonValue* bufferViews = document.Find("bufferViews");
+        if (bufferViews != nullptr) {
+            CHECK_MSG(bufferViews->Kind == JsonValue::Type::Array, "glTF bufferViews is not an array");
+            for (const JsonValue& view : bufferViews->Elements) {
+                CHECK_MSG(UintMember(view, "buffer") == 0, "External glTF buffers are not supported");
+                BufferView& bufferView = m_bufferViews.emplace_back();
+                bufferView.ByteOffset = UintMember(view, "byteOffset", 0);
+                bufferView.ByteLength = UintMember(view, "byteLength");
+                CHECK_MSG(bufferView.ByteLength > 0 && (uint64_t)bufferView.ByteOffset + bufferView.ByteLength <= m_binaryChunkSize,
+                          "glTF buffer view exceeds the binary chunk");
+            }
+        }
+
+        const JsonValue* accessors = document.Find("accessors");
+        auto ReadAccessor = [&](uint32_t index) {
+            const JsonValue& accessorJson = Element(accessors, index);
+            CHECK_MSG(accessorJson.Find("sparse") == nullptr, "Sparse glTF accessors are not supported");
+
+            Accessor accessor;
+            accessor.BufferView = UintMember(accessorJson, "bufferView");
+            CHECK_MSG(accessor.BufferView < m_bufferViews.size(), "glTF buffer view index out of range");
+            accessor.ByteOffset = UintMember(accessorJson, "byteOffset", 0);
+            accessor.Count = UintMember(accessorJson, "count");
+            accessor.ComponentType = UintMember(accessorJson, "componentType");
+            const JsonValue& type = Member(accessorJson, "type");
+            CHECK_MSG(type.Kind == JsonValue::Type::String, "glTF accessor type is not a string");
+            accessor.ComponentCount = ComponentCount(type.String);
+
+            const uint32_t componentSize = ComponentSize(accessor.ComponentType);
+            const uint32_t elementSize = componentSize * accessor.ComponentCount;
+            const JsonValue& view = bufferViews->Elements[accessor.BufferView];
+            accessor.ByteStride = UintMember(view, "byteStride", elementSize);
+            CHECK_MSG(accessor.Count > 0 && accessor.ByteStride >= elementSize && accessor.ByteOffset % componentSize == 0,
+                      "Invalid glTF accessor layout");
+
+            // The last element must end within the buffer view, the stride only separates the elements before it.
+            const uint64_t end = accessor.ByteOffset + (uint64_t)accessor.ByteStride * (accessor.Count - 1) + elementSize;
+            CHECK_MSG(end <= m_bufferViews[accessor.BufferView].ByteLength, "glTF accessor exceeds its buffer view");
+            return accessor;
+        };
+
+        const JsonValue* meshes = document.Find("meshes");
+        if (meshes == nullptr) {
+            return;
+        }
+        CHECK_MSG(meshes->Kind == JsonValue::Type::Array, "glTF meshes is not an array");
+        for (const JsonValue& mesh : meshes->Elements) {
+            for (const JsonValue& primitiveJson : Member(mesh, "primitives").Elements) {
+                if (UintMember(primitiveJson, "mode", Triangles) != Triangles) {
+                    continue; // Points and lines are not rendered
+                }
+
+                Primitive primitive;
+                const JsonValue& attributes = Member(primitiveJson, "attributes");
+                const uint32_t positionIndex = UintMember(attributes, "POSITION");
+                primitive.Position = ReadAccessor(positionIndex);
+                CHECK_MSG(primitive.Position.ComponentType == Float && primitive.Position.ComponentCount == 3,
+                          "glTF positions must be float VEC3");
+
+                // glTF requires bounds on positions, which spares reading the vertices to compute them.
+                const JsonValue& positionJson = Element(accessors, positionIndex);
+                primitive.BoundsMin = Vector3Member(positionJson, "min");
+                primitive.BoundsMax = Vector3Member(positionJson, "max");
+
+                if (attributes.Find("NORMAL") != nullptr) {
+                    primitive.Normal = ReadAccessor(UintMember(attributes, "NORMAL"));
+                    CHECK_MSG(primitive.Normal->ComponentType == Float && primitive.Normal->ComponentCount == 3 &&
+                                  primitive.Normal->Count == primitive.Position.Count,
+                              "glTF normals must be float VEC3, one per position");
+                }
+
+                if (primitiveJson.Find("indices") != nullptr) {
+                    primitive.Indices = ReadAccessor(UintMember(primitiveJson, "indices"));
+                    const uint32_t componentType = primitive.Indices->ComponentType;
+                    CHECK_MSG(primitive.Indices->ComponentCount == 1 &&
+                                  (componentType == UnsignedByte || componentType == UnsignedShort || componentType == UnsignedInt) &&
+                                  primitive.Indices->ByteStride == ComponentSize(componentType),
+                              "glTF indices must be tightly packed unsigned integers");
+                }
+
+                m_primitives.push_back(primitive);
+            }
+        }
+    }
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+    MeshLibrary::MeshLibrary(winrt::com_ptr<ID3D11Device> device, Options options)
+        : m_device(std::move(device)) {
+        for (uint32_t i = 0; i < std::max(1u, options.LoaderThreadCount); i++) {
+            m_loaders.emplace_back(&MeshLibrary::LoaderProc, this);
+        }
+    }
+
+    MeshLibrary::~MeshLibrary() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopRequested = true;
+        }
+        m_loadQueued.notify_all();
+        for (std::thread& loader : m_loaders) {
+            loader.join();
+        }
+    }
+
+    MeshHandle MeshLibrary::Load(const std::wstring& path) {
+        std::lock_guard lock(m_mutex);
+        const auto [it, inserted] = m_handles.try_emplace(path);
+        if (inserted) {
+            m_entries.push_back({path, nullptr});
+            it->second.Id = (uint32_t)m_entries.size();
+            m_pendingLoads.push_back(it->second.Id - 1);
+            m_loadQueued.notify_one();
+        }
+        return it->second;
+    }
+
+    const Mesh* MeshLibrary::Find(MeshHandle handle) const {
+        if (!handle.IsValid()) {
+            return nullptr;
+        }
+        std::lock_guard lock(m_mutex);
+        CHECK_MSG(handle.Id <= m_entries.size(), "Mesh handle of another library");
+        return m_entries[handle.Id - 1].Loaded.get();
+    }
+
+    std::optional<MeshInfo> MeshLibrary::FindInfo(MeshHandle handle) const {
+        const Mesh* mesh = Find(handle);
+        if (mesh == nullptr) {
+            return std::nullopt;
+        }
+
+        MeshInfo info;
+        for (const Mesh::DrawPrimitive& primitive : mesh->Primitives) {
+            info.TriangleCount += primitive.ElementCount / 3;
+        }
+        info.BoundsMin = mesh->BoundsMin;
+        info.BoundsMax = mesh->BoundsMax;
+        return info;
+    }
+
+    std::vector<std::wstring> MeshLibrary::Paths() const {
+        std::lock_guard lock(m_mutex);
+        std::vector<std::wstring> paths;
+        for (const Entry& entry : m_entries) {
+            paths.push_back(entry.Path);
+        }
+        return paths;
+    }
+
+    MeshLibrary::Stats MeshLibrary::GetStats() const {
+        std::lock_guard lock(m_mutex);
+        return m_stats;
+    }
+
+    void MeshLibrary::AddMappedBytes(int64_t bytes) {
+        std::lock_guard lock(m_mutex);
+        m_mappedBytes += bytes;
+        m_stats.PeakMappedBytes = std::max(m_stats.PeakMappedBytes, m_mappedBytes);
+    }
+
+    void MeshLibrary::LoaderProc() {
+        for (;;) {
+            uint32_t index;
+            std::wstring path;
+            {
+                std::unique_lock lock(m_mutex);
+                m_loadQueued.wait(lock, [&] { return m_stopRequested || !m_pendingLoads.empty(); });
+                if (m_stopRequested) {
+                    return;
+                }
+                index = m_pendingLoads.front();
+                m_pendingLoads.pop_front();
+                path = m_entries[index].Path;
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            std::unique_ptr<Mesh> mesh;
+            uint64_t uploadedBytes = 0;
+            uint64_t copiedBytes = 0;
+            try {
+                const GlbFile file(path);
+                AddMappedBytes(file.FileSize());
+                try {
+                    mesh = Upload(file, &uploadedBytes, &copiedBytes);
+                } catch (...) {
+                    AddMappedBytes(-(int64_t)file.FileSize());
+                    throw;
+                }
+                AddMappedBytes(-(int64_t)file.FileSize());
+            } catch (const std::exception& ex) {
+                DEBUG_PRINT("Failed to load mesh %ws: %s", path.c_str(), ex.what());
+            }
+            const auto loadTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+            std::lock_guard lock(m_mutex);
+            if (mesh) {
+                DEBUG_PRINT("Loaded mesh %ws in %.2f ms: %zu primitives, %llu KB uploaded, %llu KB copied, %llu KB peak mapped",
+                            path.c_str(),
+                            loadTime.count() / 1000.0,
+                            mesh->Primitives.size(),
+                            (unsigned long long)uploadedBytes / 1024,
+                            (unsigned long long)copiedBytes / 1024,
+                            (unsigned long long)m_stats.PeakMappedBytes / 1024);
+                m_stats.MeshesLoaded++;
+                m_stats.TotalLoadTime += loadTime;
+                m_stats.MaxLoadTime = std::max(m_stats.MaxLoadTime, loadTime);
+                m_stats.UploadedBytes += uploadedBytes;
+                m_stats.CopiedBytes += copiedBytes;
+            } else {
+                m_stats.MeshesFailed++;
+            }
+            m_entries[index].Loaded = std::move(mesh);
+        }
+    }
+
+    std::unique_ptr<Mesh> MeshLibrary::Upload(const GlbFile& file, uint64_t* uploadedBytes, uint64_t* copiedBytes) {
+        auto mesh = std::make_unique<Mesh>();
+        const std::vector<BufferView>& views = file.BufferViews();
+
+        // One buffer per buffer view, bound with the accessor offsets and strides, so interleaved vertex data is
+        // uploaded as stored. D3D11 has no 8-bit indices, those are the only data widened into a copy.
+        std::vector<UINT> bindFlags(views.size(), 0);
+        for (const Primitive& primitive : file.Primitives()) {
+            bindFlags[primitive.Position.BufferView] |= D3D11_BIND_VERTEX_BUFFER;
+            if (primitive.Normal) {
+                bindFlags[primitive.Normal->BufferView] |= D3D11_BIND_VERTEX_BUFFER;
+            }
+            if (primitive.Indices && primitive.Indices->ComponentType != UnsignedByte) {
+                bindFlags[primitive.Indices->BufferView] |= D3D11_BIND_INDEX_BUFFER;
+            }
+        }
+
+        std::vector<uint32_t> bufferOfView(views.size(), Mesh::NoBuffer);
+        for (size_t i = 0; i < views.size(); i++) {
+            if (bindFlags[i] == 0) {
+                continue; // Images, animations and other data this renderer does not use
+            }
+            const D3D11_SUBRESOURCE_DATA data{file.BinaryChunk() + views[i].ByteOffset};
+            const CD3D11_BUFFER_DESC desc(views[i].ByteLength, bindFlags[i], D3D11_USAGE_IMMUTABLE);
+            bufferOfView[i] = (uint32_t)mesh->Buffers.size();
+            CHECK_HRCMD(memory::CreateBuffer(
+                m_device.get(), desc, &data, memory::ResourceCategory::Geometry, "mesh buffer", mesh->Buffers.emplace_back().put()));
+            *uploadedBytes += views[i].ByteLength;
+        }
+
+        for (size_t i = 0; i < file.Primitives().size(); i++) {
+            const Primitive& primitive = file.Primitives()[i];
+            Mesh::DrawPrimitive& draw = mesh->Primitives.emplace_back();
+            draw.Position = {bufferOfView[primitive.Position.BufferView], primitive.Position.ByteOffset, primitive.Position.ByteStride};
+            if (primitive.Normal) {
+                draw.Normal = {bufferOfView[primitive.Normal->BufferView], primitive.Normal->ByteOffset, primitive.Normal->ByteStride};
+            }
+
+            if (!primitive.Indices) {
+                draw.ElementCount = primitive.Position.Count;
+            } else if (primitive.Indices->ComponentType != UnsignedByte) {
+                draw.IndexBuffer = bufferOfView[primitive.Indices->BufferView];
+                draw.IndexOffset = primitive.Indices->ByteOffset;
+                draw.IndexFormat = primitive.Indices->ComponentType == UnsignedShort ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+                draw.ElementCount = primitive.Indices->Count;
+            } else {
+                const uint8_t* source = file.BinaryChunk() + views[primitive.Indices->BufferView].ByteOffset + primitive.Indices->ByteOffset;
+                const std::vector<uint16_t> widened(source, source + primitive.Indices->Count);
+                const uint64_t widenedBytes = widened.size() * sizeof(uint16_t);
+                AddMappedBytes(widenedBytes);
+
+                const D3D11_SUBRESOURCE_DATA data{widened.data()};
+                const CD3D11_BUFFER_DESC desc((UINT)widenedBytes, D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+                draw.IndexBuffer = (uint32_t)mesh->Buffers.size();
+                const HRESULT hr = memory::CreateBuffer(
+                    m_device.get(), desc, &data, memory::ResourceCategory::Geometry, "mesh indices", mesh->Buffers.emplace_back().put());
+                AddMappedBytes(-(int64_t)widenedBytes);
+                CHECK_HRESULT(hr, "CreateBuffer");
+
+                draw.IndexFormat = DXGI_FORMAT_R16_UINT;
+                draw.ElementCount = primitive.Indices->Count;
+                *uploadedBytes += widenedBytes;
+                *copiedBytes += widenedBytes;
+            }
+
+            if (i == 0) {
+                mesh->BoundsMin = primitive.BoundsMin;
+                mesh->BoundsMax = primitive.BoundsMax;
+            } else {
+                mesh->BoundsMin = {std::min(mesh->BoundsMin.x, primitive.BoundsMin.x),
+                                   std::min(mesh->BoundsMin.y, primitive.BoundsMin.y),
+                                   std::min(mesh->BoundsMin.z, primitive.BoundsMin.z)};
+                mesh->BoundsMax = {std::max(mesh->BoundsMax.x, primitive.BoundsMax.x),
+                                   std::max(mesh->BoundsMax.y, primitive.BoundsMax.y),
+                                   std::max(mesh->BoundsMax.z, primitive.BoundsMax.z)};
+            }
+        }
+        return mesh;
+    }
+#endif
+} // namespace sample::mesh
@@ -0,0 +1,198 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace sample::mesh {
+
+    // Identifies a mesh of a MeshLibrary. The default handle is invalid and renders as the built-in cube.
+    struct MeshHandle {
+        uint32_t Id{0};
+
+        bool IsValid() const {
+            return Id != 0;
+        }
+    };
+
+    // A typed range of the binary chunk, validated to lie within its buffer view.
+    struct Accessor {
+        uint32_t BufferView{0};
+        uint32_t ByteOffset{0}; // Relative to the buffer view
+        uint32_t ByteStride{0}; // Never zero, tightly packed accessors report their element size
+        uint32_t Count{0};
+        uint32_t ComponentType{0}; // GL enum, e.g. 5126 for FLOAT
+        uint32_t ComponentCount{0};
+    };
+
+    struct BufferView {
+        uint32_t ByteOffset{0}; // Relative to the binary chunk
+        uint32_t ByteLength{0};
+    };
+
+    struct Primitive {
+        Accessor Position;
+        std::optional<Accessor> Normal;
+        std::optional<Accessor> Indices;
+        XrVector3f BoundsMin{};
+        XrVector3f BoundsMax{};
+    };
+
+    // Read-only mapping, with Win32 or POSIX mmap, of a glTF 2.0 binary (.glb) file. The JSON chunk is parsed and every accessor used by a
+    // triangle primitive is validated in place, so vertex and index data can be handed to the GPU straight from
+    // BinaryChunk() without being copied or re-read. Throws on malformed files.
+    class GlbFile {
+    public:
+        explicit GlbFile(const std::wstring& path);
+        ~GlbFile();
+
+        GlbFile(const GlbFile&) = delete;
+        GlbFile& operator=(const GlbFile&) = delete;
+
+        // Primitives of all meshes in the file, in order.
+        const std::vector<Primitive>& Primitives() const {
+            return m_primitives;
+        }
+
+        const std::vector<BufferView>& BufferViews() const {
+            return m_bufferViews;
+        }
+
+        const uint8_t* BinaryChunk() const {
+            return m_binaryChunk;
+        }
+
+        uint64_t FileSize() const {
+            return m_size;
+        }
+
+    private:
+        void Parse();
+
+#ifdef _WIN32
+        HANDLE m_file{INVALID_HANDLE_VALUE};
+        HANDLE m_mapping{nullptr};
+#else
+        int m_file{-1};
+#endif
+        const uint8_t* m_data{nullptr};
+        uint64_t m_size{0};
+
+        const uint8_t* m_binaryChunk{nullptr};
+        uint32_t m_binaryChunkSize{0};
+        std::vector<BufferView> m_bufferViews;
+        std::vector<Primitive> m_primitives;
+    };
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+    // A loaded mesh. Its GPU buffers are immutable and shared by every hologram using the mesh.
+    struct Mesh {
+        constexpr static uint32_t NoBuffer = ~0u;
+
+        struct VertexStream {
+            uint32_t Buffer{NoBuffer};
+            UINT Offset{0};
+            UINT Stride{0};
+        };
+
+        struct DrawPrimitive {
+            VertexStream Position;
+            VertexStream Normal;
+            uint32_t IndexBuffer{NoBuffer}; // Without indices, ElementCount vertices are drawn in order
+            UINT IndexOffset{0};
+            DXGI_FORMAT IndexFormat{DXGI_FORMAT_UNKNOWN};
+            UINT ElementCount{0};
+        };
+
+        std::vector<winrt::com_ptr<ID3D11Buffer>> Buffers; // One per buffer view, plus widened 8-bit index buffers
+        std::vector<DrawPrimitive> Primitives;
+        XrVector3f BoundsMin{};
+        XrVector3f BoundsMax{};
+    };
+#endif
+
+    // What the CPU side needs to know of a loaded mesh.
+    struct MeshInfo {
+        uint32_t TriangleCount{0};
+        XrVector3f BoundsMin{};
+        XrVector3f BoundsMax{};
+    };
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+    // Loads glTF binary meshes on background threads and shares them by handle. Loading the same path twice returns
+    // the same handle. Buffers are created on the loader threads, which relies on the D3D11 device being free threaded.
+    class MeshLibrary {
+    public:
+        struct Options {
+            uint32_t LoaderThreadCount{2};
+        };
+
+        struct Stats {
+            uint32_t MeshesLoaded{0};
+            uint32_t MeshesFailed{0};
+            std::chrono::microseconds TotalLoadTime{0};
+            std::chrono::microseconds MaxLoadTime{0};
+            uint64_t UploadedBytes{0};
+            uint64_t CopiedBytes{0};     // Bytes that could not be uploaded from the mapping, i.e. widened 8-bit indices
+            uint64_t PeakMappedBytes{0}; // Most bytes of files and copies held at once by all loader threads
+        };
+
+        MeshLibrary(winrt::com_ptr<ID3D11Device> device, Options options);
+        ~MeshLibrary();
+
+        MeshLibrary(const MeshLibrary&) = delete;
+        MeshLibrary& operator=(const MeshLibrary&) = delete;
+
+        // Queues the file for loading and returns immediately. Thread safe.
+        MeshHandle Load(const std::wstring& path);
+
+        // Returns nullptr until the mesh is loaded, and forever if loading failed. The mesh lives as long as the library.
+        const Mesh* Find(MeshHandle handle) const;
+        std::optional<MeshInfo> FindInfo(MeshHandle handle) const;
+
+        // Paths in handle order, so a library for a new device can reload them under the same handles.
+        std::vector<std::wstring> Paths() const;
+
+        Stats GetStats() const;
+
+    private:
+        struct Entry {
+            std::wstring Path;
+            std::unique_ptr<const Mesh> Loaded; // Null while pending or after a failure
+        };
+
+        void LoaderProc();
+        std::unique_ptr<Mesh> Upload(const GlbFile& file, uint64_t* uploadedBytes, uint64_t* copiedBytes);
+        void AddMappedBytes(int64_t bytes);
+
+        const winrt::com_ptr<ID3D11Device> m_device;
+        std::vector<std::thread> m_loaders;
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_loadQueued;
+        std::vector<Entry> m_entries; // Index is handle Id - 1
+        std::unordered_map<std::wstring, MeshHandle> m_handles;
+        std::deque<uint32_t> m_pendingLoads;
+        bool m_stopRequested{false};
+        uint64_t m_mappedBytes{0};
+        Stats m_stats;
+    };
+#endif
+
+} // namespace sample::mesh
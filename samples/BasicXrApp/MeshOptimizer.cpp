@@ -0,0 +1,439 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace {
+    using sample::mesh::SourceVertex;
+
+    // Simulates a FIFO cache: a vertex hits while fewer than cacheSize misses happened since it was inserted.
+    class FifoCache {
+    public:
+        FifoCache(uint32_t vertexCount, uint32_t cacheSize)
+            : m_insertedAt(vertexCount, 0)
+            , m_cacheSize(cacheSize)
+            , m_time(cacheSize + 1) {
+        }
+
+        bool Miss(uint32_t vertex) {
+            if (m_time - m_insertedAt[vertex] > m_cacheSize) {
+                m_insertedAt[vertex] = m_time++;
+                return true;
+            }
+            return false;
+        }
+
+        // Expires every entry, as if the cache was never used.
+        void Flush() {
+            m_time += m_cacheSize + 1;
+        }
+
+    private:
+        std::vector<uint32_t> m_insertedAt;
+        const uint32_t m_cacheSize;
+        uint32_t m_time;
+    };
+
+    // Forsyth's scoring. The cache size here only shapes the score, it need not match the hardware.
+    constexpr uint32_t ScoringCacheSize = 32;
+    constexpr float CacheDecayPower = 1.5f;
+    constexpr float LastTriangleScore = 0.75f;
+    constexpr float ValenceBoostScale = 2.0f;
+    constexpr float ValenceBoostPower = 0.5f;
+    constexpr uint32_t NoTriangle = ~0u;
+
+    float VertexScore(int cachePosition, uint32_t remainingTriangles) {
+        if (remainingTriangles == 0) {
+            return -1.0f; // Never needed again
+        }
+
+        float score = 0;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // Vertices of the last triangle get a fixed score, so the next one does not simply continue a strip.
+                score = LastTriangleScore;
+            } else {
+                const float scaler = 1.0f / (ScoringCacheSize - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+            }
+        }
+        // Boost vertices with few triangles left, so they are finished off instead of lingering.
+        return score + ValenceBoostScale * std::pow((float)remainingTriangles, -ValenceBoostPower);
+    }
+
+    XrVector3f Subtract(const XrVector3f& a, const XrVector3f& b) {
+        return {a.x - b.x, a.y - b.y, a.z - b.z};
+    }
+
+    XrVector3f Cross(const XrVector3f& a, const XrVector3f& b) {
+        return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+    }
+
+    float Dot(const XrVector3f& a, const XrVector3f& b) {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    uint8_t FloatToUnorm8(float value) {
+        return (uint8_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+    }
+
+    uint64_t SmallestIndexBytes(size_t indexCount, size_t vertexCount) {
+        return indexCount * (vertexCount <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t));
+    }
+} // namespace
+
+namespace sample::mesh {
+    uint32_t DeduplicateVertices(std::vector<SourceVertex>& vertices, std::vector<uint32_t>& indices) {
+        struct VertexBits {
+            uint32_t Bits[6];
+            bool operator==(const VertexBits& other) const {
+                return std::memcmp(Bits, other.Bits, sizeof(Bits)) == 0;
+            }
+        };
+        struct VertexBitsHash {
+            size_t operator()(const VertexBits& vertex) const {
+                uint64_t hash = 14695981039346656037ull; // FNV-1a over the six words
+                for (const uint32_t word : vertex.Bits) {
+                    hash = (hash ^ word) * 1099511628211ull;
+                }
+                return (size_t)hash;
+            }
+        };
+        static_assert(sizeof(VertexBits) == sizeof(SourceVertex), "Vertex is compared bitwise");
+
+        std::unordered_map<VertexBits, uint32_t, VertexBitsHash> uniqueIndices;
+        uniqueIndices.reserve(vertices.size());
+        std::vector<uint32_t> remap(vertices.size());
+        uint32_t uniqueCount = 0;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            VertexBits bits;
+            std::memcpy(&bits, &vertices[i], sizeof(bits));
+            const auto [it, inserted] = uniqueIndices.try_emplace(bits, uniqueCount);
+            if (inserted) {
+                vertices[uniqueCount++] = vertices[i];
+            }
+            remap[i] = it->second;
+        }
+
+        vertices.resize(uniqueCount);
+        for (uint32_t& index : indices) {
+            index = remap[index];
+        }
+        return uniqueCount;
+    }
+
+    void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+        const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+        if (triangleCount == 0) {
+            return;
+        }
+
+        // Triangles of each vertex, packed by vertex. The first remainingTriangles[v] of each range are not yet drawn.
+        std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+        for (const uint32_t index : indices) {
+            remainingTriangles[index]++;
+        }
+        std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+        std::partial_sum(remainingTriangles.begin(), remainingTriangles.end(), firstTriangle.begin() + 1);
+        std::vector<uint32_t> vertexTriangles(indices.size());
+        std::vector<uint32_t> filled(vertexCount, 0);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint32_t v = indices[t * 3 + k];
+                vertexTriangles[firstTriangle[v] + filled[v]++] = t;
+            }
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            vertexScore[v] = VertexScore(-1, remainingTriangles[v]);
+        }
+
+        std::vector<float> triangleScore(triangleCount);
+        std::vector<bool> triangleDrawn(triangleCount, false);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        }
+
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> nextCache;
+        cache.reserve(ScoringCacheSize + 3);
+        nextCache.reserve(ScoringCacheSize + 3);
+
+        uint32_t bestTriangle = (uint32_t)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+        uint32_t scanPosition = 0;
+        for (uint32_t drawn = 0; drawn < triangleCount; drawn++) {
+            if (bestTriangle == NoTriangle) {
+                // Nothing in the cache has triangles left, continue with the next undrawn triangle in input order.
+                while (triangleDrawn[scanPosition]) {
+                    scanPosition++;
+                }
+                bestTriangle = scanPosition;
+            }
+
+            const uint32_t* triangle = &indices[bestTriangle * 3];
+            triangleDrawn[bestTriangle] = true;
+            output.insert(output.end(), triangle, triangle + 3);
+
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint32_t v = triangle[k];
+                uint32_t* begin = &vertexTriangles[firstTriangle[v]];
+                uint32_t* end = begin + remainingTriangles[v];
+                std::iter_swap(std::find(begin, end, bestTriangle), end - 1);
+                remainingTriangles[v]--;
+            }
+
+            // The triangle's vertices move to the front, the rest shift back and those beyond the cache size fall out.
+            nextCache.assign(triangle, triangle + 3);
+            for (const uint32_t v : cache) {
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                    nextCache.push_back(v);
+                }
+            }
+            for (size_t i = ScoringCacheSize; i < nextCache.size(); i++) {
+                cachePosition[nextCache[i]] = -1;
+            }
+
+            for (size_t i = 0; i < nextCache.size(); i++) {
+                const uint32_t v = nextCache[i];
+                if (i < ScoringCacheSize) {
+                    cachePosition[v] = (int)i;
+                }
+                const float score = VertexScore(cachePosition[v], remainingTriangles[v]);
+                const float delta = score - vertexScore[v];
+                vertexScore[v] = score;
+                for (uint32_t j = 0; j < remainingTriangles[v]; j++) {
+                    triangleScore[vertexTriangles[firstTriangle[v] + j]] += delta;
+                }
+            }
+            nextCache.resize(std::min<size_t>(nextCache.size(), ScoringCacheSize));
+            std::swap(cache, nextCache);
+
+            // Only triangles of cached vertices changed score, so the best next triangle is among them.
+            bestTriangle = NoTriangle;
+            float bestScore = -1.0f;
+            for (const uint32_t v : cache) {
+                for (uint32_t j = 0; j < remainingTriangles[v]; j++) {
+                    const uint32_t t = vertexTriangles[firstTriangle[v] + j];
+                    if (triangleScore[t] > bestScore) {
+                        bestScore = triangleScore[t];
+                        bestTriangle = t;
+                    }
+                }
+            }
+        }
+
+        indices = std::move(output);
+    }
+
+    void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<SourceVertex>& vertices, uint32_t cacheSize, float threshold) {
+        const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+        if (triangleCount == 0) {
+            return;
+        }
+
+        FifoCache cache((uint32_t)vertices.size(), cacheSize);
+        std::vector<uint8_t> triangleMisses(triangleCount);
+        uint32_t totalMisses = 0;
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            triangleMisses[t] = (uint8_t)(cache.Miss(indices[t * 3]) + cache.Miss(indices[t * 3 + 1]) + cache.Miss(indices[t * 3 + 2]));
+            totalMisses += triangleMisses[t];
+        }
+        const float maxClusterAcmr = threshold * totalMisses / triangleCount;
+
+        // A triangle missing all three vertices starts over anyway, so moving it costs nothing. Elsewhere a cluster ends
+        // once its ACMR from a cold cache is within the threshold, which bounds what reordering the clusters costs.
+        std::vector<uint32_t> clusterStarts;
+        FifoCache clusterCache((uint32_t)vertices.size(), cacheSize);
+        uint32_t clusterMisses = 0;
+        uint32_t clusterStart = 0;
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            if (t == clusterStart || triangleMisses[t] == 3) {
+                clusterStarts.push_back(t);
+                clusterStart = t;
+                clusterMisses = 0;
+                clusterCache.Flush();
+            }
+            clusterMisses += clusterCache.Miss(indices[t * 3]) + clusterCache.Miss(indices[t * 3 + 1]) + clusterCache.Miss(indices[t * 3 + 2]);
+            if (clusterMisses <= maxClusterAcmr * (t - clusterStart + 1)) {
+                clusterStart = t + 1;
+            }
+        }
+
+        // Clusters facing away from the mesh center are more likely in front of the rest, so they are drawn first.
+        struct Cluster {
+            uint32_t Start;
+            uint32_t End;
+            XrVector3f Centroid; // Area weighted
+            XrVector3f Normal;   // Area weighted, not normalized
+            float SortKey;
+        };
+        std::vector<Cluster> clusters;
+        XrVector3f meshCentroid{0, 0, 0};
+        float meshArea = 0;
+        for (size_t c = 0; c < clusterStarts.size(); c++) {
+            Cluster& cluster = clusters.emplace_back();
+            cluster.Start = clusterStarts[c];
+            cluster.End = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+            cluster.Centroid = cluster.Normal = {0, 0, 0};
+
+            float clusterArea = 0;
+            for (uint32_t t = cluster.Start; t < cluster.End; t++) {
+                const XrVector3f& a = vertices[indices[t * 3]].Position;
+                const XrVector3f& b = vertices[indices[t * 3 + 1]].Position;
+                const XrVector3f& c = vertices[indices[t * 3 + 2]].Position;
+                const XrVector3f normal = Cross(Subtract(b, a), Subtract(c, a));
+                const float area = std::sqrt(Dot(normal, normal));
+                cluster.Normal = {cluster.Normal.x + normal.x, cluster.Normal.y + normal.y, cluster.Normal.z + normal.z};
+                cluster.Centroid.x += area * (a.x + b.x + c.x) / 3;
+                cluster.Centroid.y += area * (a.y + b.y + c.y) / 3;
+                cluster.Centroid.z += area * (a.z + b.z + c.z) / 3;
+                clusterArea += area;
+            }
+
+            meshCentroid = {meshCentroid.x + cluster.Centroid.x, meshCentroid.y + cluster.Centroid.y, meshCentroid.z + cluster.Centroid.z};
+            meshArea += clusterArea;
+            if (clusterArea > 0) {
+                cluster.Centroid = {cluster.Centroid.x / clusterArea, cluster.Centroid.y / clusterArea, cluster.Centroid.z / clusterArea};
+            }
+        }
+        if (meshArea > 0) {
+            meshCentroid = {meshCentroid.x / meshArea, meshCentroid.y / meshArea, meshCentroid.z / meshArea};
+        }
+
+        for (Cluster& cluster : clusters) {
+            const float normalLength = std::sqrt(Dot(cluster.Normal, cluster.Normal));
+            cluster.SortKey = normalLength > 0 ? Dot(Subtract(cluster.Centroid, meshCentroid), cluster.Normal) / normalLength : 0;
+        }
+        std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.SortKey > b.SortKey; });
+
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+        for (const Cluster& cluster : clusters) {
+            output.insert(output.end(), indices.begin() + cluster.Start * 3, indices.begin() + cluster.End * 3);
+        }
+        indices = std::move(output);
+    }
+
+    void OptimizeVertexFetch(std::vector<SourceVertex>& vertices, std::vector<uint32_t>& indices) {
+        constexpr uint32_t Unused = ~0u;
+        std::vector<uint32_t> remap(vertices.size(), Unused);
+        std::vector<SourceVertex> reordered;
+        reordered.reserve(vertices.size());
+        for (uint32_t& index : indices) {
+            if (remap[index] == Unused) {
+                remap[index] = (uint32_t)reordered.size();
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices = std::move(reordered);
+    }
+
+    CacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize) {
+        if (indices.empty() || vertexCount == 0) {
+            return {};
+        }
+
+        FifoCache cache(vertexCount, cacheSize);
+        uint32_t misses = 0;
+        for (const uint32_t index : indices) {
+            misses += cache.Miss(index);
+        }
+        return {(float)misses / (indices.size() / 3), (float)misses / vertexCount};
+    }
+
+    uint16_t FloatToHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        const uint32_t sign = (bits >> 16) & 0x8000;
+        const int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (((bits >> 23) & 0xFF) == 0xFF) {
+            return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0)); // Infinity or NaN
+        }
+        if (exponent >= 31) {
+            return (uint16_t)(sign | 0x7C00); // Overflows to infinity
+        }
+        if (exponent <= 0) {
+            if (exponent < -10) {
+                return (uint16_t)sign; // Underflows to zero
+            }
+            // Denormal: shift the mantissa with its implicit bit into place, rounding to nearest even.
+            mantissa |= 0x800000;
+            const uint32_t shift = (uint32_t)(14 - exponent);
+            const uint32_t half = mantissa >> shift;
+            const uint32_t remainder = mantissa & ((1u << shift) - 1);
+            const uint32_t halfway = 1u << (shift - 1);
+            return (uint16_t)(sign | (half + (remainder > halfway || (remainder == halfway && (half & 1)))));
+        }
+
+        // Rounding may carry into the exponent, which correctly rounds up to the next power of two or to infinity.
+        const uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+        const uint32_t remainder = mantissa & 0x1FFF;
+        return (uint16_t)(sign | (half + (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))));
+    }
+
+    OptimizedMesh OptimizeMesh(std::vector<SourceVertex> vertices, std::vector<uint32_t> indices, const OptimizeOptions& options) {
+        OptimizedMesh mesh;
+        OptimizationReport& report = mesh.Report;
+        report.SourceVertexCount = (uint32_t)vertices.size();
+        report.TriangleCount = (uint32_t)(indices.size() / 3);
+        report.SourceVertexBytes = vertices.size() * sizeof(SourceVertex);
+        report.SourceIndexBytes = SmallestIndexBytes(indices.size(), vertices.size());
+        report.SourceCache = AnalyzeVertexCache(indices, (uint32_t)vertices.size(), options.CacheSize);
+
+        DeduplicateVertices(vertices, indices);
+        OptimizeVertexCache(indices, (uint32_t)vertices.size());
+        if (options.OverdrawThreshold > 0) {
+            OptimizeOverdraw(indices, vertices, options.CacheSize, options.OverdrawThreshold);
+        }
+        OptimizeVertexFetch(vertices, indices);
+
+        mesh.Vertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const SourceVertex& source = vertices[i];
+            QuantizedVertex& vertex = mesh.Vertices[i];
+            vertex.Position[0] = FloatToHalf(source.Position.x);
+            vertex.Position[1] = FloatToHalf(source.Position.y);
+            vertex.Position[2] = FloatToHalf(source.Position.z);
+            vertex.Position[3] = FloatToHalf(1.0f);
+            vertex.Color[0] = FloatToUnorm8(source.Color.x);
+            vertex.Color[1] = FloatToUnorm8(source.Color.y);
+            vertex.Color[2] = FloatToUnorm8(source.Color.z);
+            vertex.Color[3] = 255;
+        }
+
+        report.VertexCount = (uint32_t)mesh.Vertices.size();
+        report.VertexBytes = mesh.Vertices.size() * sizeof(QuantizedVertex);
+        report.Cache = AnalyzeVertexCache(indices, report.VertexCount, options.CacheSize);
+        if (vertices.size() <= 0x10000) {
+            mesh.Indices16.assign(indices.begin(), indices.end());
+        } else {
+            mesh.Indices32 = std::move(indices);
+        }
+
+        report.IndexBytes = mesh.Indices16.size() * sizeof(uint16_t) + mesh.Indices32.size() * sizeof(uint32_t);
+        return mesh;
+    }
+} // namespace sample::mesh
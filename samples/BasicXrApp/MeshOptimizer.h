@@ -0,0 +1,85 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+namespace sample::mesh {
+
+    // Vertex as authored, full precision.
+    struct SourceVertex {
+        XrVector3f Position;
+        XrVector3f Color;
+    };
+
+    // 12 bytes instead of the 24 of SourceVertex.
+    struct QuantizedVertex {
+        uint16_t Position[4]; // R16G16B16A16_FLOAT, read by the shader as is. The fourth component is 1.
+        uint8_t Color[4];     // R8G8B8A8_UNORM, alpha is 255
+    };
+    static_assert(sizeof(QuantizedVertex) == 12, "QuantizedVertex must stay tightly packed");
+
+    // Average cache miss ratio (misses per triangle, 0.5 to 3) and transformed vertex ratio (misses per vertex, 1 is ideal)
+    // of a FIFO post-transform cache.
+    struct CacheStats {
+        float Acmr{0};
+        float Atvr{0};
+    };
+
+    struct OptimizationReport {
+        uint32_t SourceVertexCount{0};
+        uint32_t VertexCount{0};
+        uint32_t TriangleCount{0};
+        uint64_t SourceVertexBytes{0};
+        uint64_t VertexBytes{0};
+        uint64_t SourceIndexBytes{0}; // At the smallest index size the source vertex count allows
+        uint64_t IndexBytes{0};
+        CacheStats SourceCache;
+        CacheStats Cache;
+    };
+
+    struct OptimizedMesh {
+        std::vector<QuantizedVertex> Vertices;
+        std::vector<uint16_t> Indices16; // Used when all vertices fit, otherwise Indices32
+        std::vector<uint32_t> Indices32;
+        OptimizationReport Report;
+    };
+
+    struct OptimizeOptions {
+        uint32_t CacheSize{16};        // Post-transform cache entries assumed for analysis and overdraw clustering
+        float OverdrawThreshold{1.05f}; // ACMR the overdraw pass may give up for better triangle order. Zero skips it.
+    };
+
+    // Merges bitwise identical vertices and rewrites the indices to share them. Returns the unique vertex count.
+    uint32_t DeduplicateVertices(std::vector<SourceVertex>& vertices, std::vector<uint32_t>& indices);
+
+    // Reorders triangles so consecutive ones reuse recently transformed vertices, with Forsyth's linear-speed algorithm.
+    void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+    // Splits cache-optimized triangles into clusters where the cache restarts anyway, or where the threshold allows,
+    // and draws outward-facing clusters first, so front faces tend to be drawn before what they occlude.
+    void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<SourceVertex>& vertices, uint32_t cacheSize, float threshold);
+
+    // Reorders vertices by first use, so vertex fetch reads memory sequentially. Drops unreferenced vertices.
+    void OptimizeVertexFetch(std::vector<SourceVertex>& vertices, std::vector<uint32_t>& indices);
+
+    CacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize);
+
+    // IEEE half precision, rounding to nearest even. Overflows to infinity and keeps denormals.
+    uint16_t FloatToHalf(float value);
+
+    // Runs every pass above in order, then quantizes. CPU only, so it also runs offline and in benchmarks.
+    OptimizedMesh OptimizeMesh(std::vector<SourceVertex> vertices, std::vector<uint32_t> indices, const OptimizeOptions& options);
+
+} // namespace sample::mesh
@@ -0,0 +1,458 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "OcclusionCuller.h"
+#include <cfloat>
+#include <cmath>
+#if defined(_M_ARM) || defined(_M_ARM64)
+#include <arm_neon.h>
+#else
+#include <xmmintrin.h>
+#endif
+
+namespace {
+    // Four pixels of a row at a time.
+#if defined(_M_ARM) || defined(_M_ARM64)
+    using Float4 = float32x4_t;
+    using Mask4 = uint32x4_t;
+    Float4 Set(float a, float b, float c, float d) {
+        const float values[4] = {a, b, c, d};
+        return vld1q_f32(values);
+    }
+    Float4 Splat(float value) {
+        return vdupq_n_f32(value);
+    }
+    Float4 Load(const float* values) {
+        return vld1q_f32(values);
+    }
+    void Store(float* values, Float4 v) {
+        vst1q_f32(values, v);
+    }
+    Float4 Add(Float4 a, Float4 b) {
+        return vaddq_f32(a, b);
+    }
+    Float4 Min(Float4 a, Float4 b) {
+        return vminq_f32(a, b);
+    }
+    Float4 Max(Float4 a, Float4 b) {
+        return vmaxq_f32(a, b);
+    }
+    Mask4 InsideEdges(Float4 e0, Float4 e1, Float4 e2) {
+        const Float4 zero = vdupq_n_f32(0);
+        return vandq_u32(vandq_u32(vcgeq_f32(e0, zero), vcgeq_f32(e1, zero)), vcgeq_f32(e2, zero));
+    }
+    Float4 Select(Mask4 mask, Float4 ifSet, Float4 ifClear) {
+        return vbslq_f32(mask, ifSet, ifClear);
+    }
+#else
+    using Float4 = __m128;
+    using Mask4 = __m128;
+    Float4 Set(float a, float b, float c, float d) {
+        return _mm_setr_ps(a, b, c, d);
+    }
+    Float4 Splat(float value) {
+        return _mm_set1_ps(value);
+    }
+    Float4 Load(const float* values) {
+        return _mm_loadu_ps(values);
+    }
+    void Store(float* values, Float4 v) {
+        _mm_storeu_ps(values, v);
+    }
+    Float4 Add(Float4 a, Float4 b) {
+        return _mm_add_ps(a, b);
+    }
+    Float4 Min(Float4 a, Float4 b) {
+        return _mm_min_ps(a, b);
+    }
+    Float4 Max(Float4 a, Float4 b) {
+        return _mm_max_ps(a, b);
+    }
+    Mask4 InsideEdges(Float4 e0, Float4 e1, Float4 e2) {
+        const Float4 zero = _mm_setzero_ps();
+        return _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+    }
+    Float4 Select(Mask4 mask, Float4 ifSet, Float4 ifClear) {
+        return _mm_or_ps(_mm_and_ps(mask, ifSet), _mm_andnot_ps(mask, ifClear));
+    }
+#endif
+
+    XrVector3f Add(const XrVector3f& a, const XrVector3f& b) {
+        return {a.x + b.x, a.y + b.y, a.z + b.z};
+    }
+
+    XrVector3f Subtract(const XrVector3f& a, const XrVector3f& b) {
+        return {a.x - b.x, a.y - b.y, a.z - b.z};
+    }
+
+    XrVector3f Scale(const XrVector3f& v, float scale) {
+        return {v.x * scale, v.y * scale, v.z * scale};
+    }
+
+    float Dot(const XrVector3f& a, const XrVector3f& b) {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    float Dot(const XrQuaternionf& a, const XrQuaternionf& b) {
+        return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    }
+
+    float Length(const XrVector3f& v) {
+        return std::sqrt(Dot(v, v));
+    }
+
+    XrVector3f Rotate(const XrQuaternionf& q, const XrVector3f& v) {
+        // v + 2 * cross(q.xyz, cross(q.xyz, v) + q.w * v)
+        const XrVector3f t{q.y * v.z - q.z * v.y + q.w * v.x, q.z * v.x - q.x * v.z + q.w * v.y, q.x * v.y - q.y * v.x + q.w * v.z};
+        return {v.x + 2 * (q.y * t.z - q.z * t.y), v.y + 2 * (q.z * t.x - q.x * t.z), v.z + 2 * (q.x * t.y - q.y * t.x)};
+    }
+
+    XrQuaternionf Inverse(const XrQuaternionf& q) {
+        return {-q.x, -q.y, -q.z, q.w};
+    }
+} // namespace
+
+namespace sample::occlusion {
+    OcclusionCuller::OcclusionCuller(Options options)
+        : m_options(options) {
+        CHECK_MSG(options.Width > 0 && options.Width % 4 == 0 && options.Height > 0, "Occlusion buffer width must be a multiple of 4");
+        m_depth.resize((size_t)options.Width * options.Height);
+
+        uint32_t width = options.Width;
+        uint32_t height = options.Height;
+        m_levels.emplace_back(); // The depth buffer
+        while (width > 1 || height > 1) {
+            width = (width + 1) / 2;
+            height = (height + 1) / 2;
+            Level& level = m_levels.emplace_back();
+            level.Width = width;
+            level.Height = height;
+            level.Min.resize((size_t)width * height);
+            level.Max.resize((size_t)width * height);
+        }
+    }
+
+    void OcclusionCuller::BeginFrame(const XrView* views, uint32_t viewCount, const xr::math::NearFar& nearFar) {
+        CHECK_MSG(nearFar.Far < nearFar.Near, "Occlusion culling expects a reversed-Z depth range");
+        m_occluders.clear();
+        m_stats = {};
+        m_hasView = false;
+        std::fill(m_depth.begin(), m_depth.end(), 0.0f); // The far plane
+        if (viewCount == 0) {
+            return;
+        }
+
+        // Views of a headset face nearly the same way, so the normalized sum of their orientations is between them.
+        m_position = {0, 0, 0};
+        XrQuaternionf orientation{0, 0, 0, 0};
+        for (uint32_t i = 0; i < viewCount; i++) {
+            const XrQuaternionf& q = views[i].pose.orientation;
+            const float sign = Dot(q, views[0].pose.orientation) < 0 ? -1.0f : 1.0f; // q and -q are the same rotation
+            orientation = {orientation.x + sign * q.x, orientation.y + sign * q.y, orientation.z + sign * q.z, orientation.w + sign * q.w};
+            m_position = Add(m_position, views[i].pose.position);
+        }
+        m_position = Scale(m_position, 1.0f / viewCount);
+        const float orientationLength = std::sqrt(Dot(orientation, orientation));
+        m_inverseOrientation = Inverse({orientation.x / orientationLength,
+                                        orientation.y / orientationLength,
+                                        orientation.z / orientationLength,
+                                        orientation.w / orientationLength});
+
+        // The union of the views' fields of view, from the directions of their frustum corners in the combined view.
+        float tanLeft = FLT_MAX, tanRight = -FLT_MAX, tanDown = FLT_MAX, tanUp = -FLT_MAX;
+        m_eyeOffset = 0;
+        for (uint32_t i = 0; i < viewCount; i++) {
+            const XrFovf& fov = views[i].fov;
+            for (const float x : {std::tan(fov.angleLeft), std::tan(fov.angleRight)}) {
+                for (const float y : {std::tan(fov.angleDown), std::tan(fov.angleUp)}) {
+                    const XrVector3f corner = Rotate(m_inverseOrientation, Rotate(views[i].pose.orientation, {x, y, -1}));
+                    if (corner.z > -0.01f) {
+                        return; // Wider than a combined view can cover, nothing is culled
+                    }
+                    tanLeft = std::min(tanLeft, corner.x / -corner.z);
+                    tanRight = std::max(tanRight, corner.x / -corner.z);
+                    tanDown = std::min(tanDown, corner.y / -corner.z);
+                    tanUp = std::max(tanUp, corner.y / -corner.z);
+                }
+            }
+            m_eyeOffset = std::max(m_eyeOffset, Length(Subtract(views[i].pose.position, m_position)));
+        }
+
+        m_tanLeft = tanLeft;
+        m_tanUp = tanUp;
+        m_pixelsPerTanX = m_options.Width / (tanRight - tanLeft);
+        m_pixelsPerTanY = m_options.Height / (tanUp - tanDown);
+        m_pixelRadius = 0.5f * std::sqrt(1 / (m_pixelsPerTanX * m_pixelsPerTanX) + 1 / (m_pixelsPerTanY * m_pixelsPerTanY));
+
+        // Depth 0 at nearFar.Near, the far plane, and 1 at nearFar.Far.
+        m_nearDistance = nearFar.Far;
+        m_farDistance = nearFar.Near;
+        m_depthScale = 1 / (1 / nearFar.Far - 1 / nearFar.Near);
+        m_depthOffset = -m_depthScale / nearFar.Near;
+        m_hasView = true;
+    }
+
+    void OcclusionCuller::AddOccluder(const XrPosef& pose, const XrVector3f& halfExtents) {
+        m_occluders.push_back({pose, halfExtents, Length(Subtract(pose.position, m_position))});
+    }
+
+    void OcclusionCuller::Rasterize() {
+        if (!m_hasView) {
+            return;
+        }
+
+        const size_t count = std::min<size_t>(m_occluders.size(), m_options.MaxOccluders);
+        std::partial_sort(m_occluders.begin(), m_occluders.begin() + count, m_occluders.end(), [](const Occluder& a, const Occluder& b) {
+            return a.Distance < b.Distance;
+        });
+        for (size_t i = 0; i < count; i++) {
+            if (RasterizeBox(m_occluders[i])) {
+                m_stats.Occluders++;
+            }
+        }
+        BuildHierarchy();
+    }
+
+    XrVector3f OcclusionCuller::ToView(const XrVector3f& point) const {
+        return Rotate(m_inverseOrientation, Subtract(point, m_position));
+    }
+
+    bool OcclusionCuller::RasterizeBox(const Occluder& occluder) {
+        // A ray from an eye is a ray from the center moved by at most m_eyeOffset, and every ray through a pixel passes
+        // within m_pixelRadius * distance of its center. Shrinking the box by both keeps every covered pixel covered by
+        // the original box for every eye, at no farther than the stored depth.
+        const XrVector3f& half = occluder.HalfExtents;
+        const float farthest = occluder.Distance + Length(half);
+        const float shrink = m_eyeOffset + farthest * m_pixelRadius;
+        const XrVector3f shrunk{half.x - shrink, half.y - shrink, half.z - shrink};
+        if (shrunk.x <= 0 || shrunk.y <= 0 || shrunk.z <= 0) {
+            return false;
+        }
+
+        const XrQuaternionf& orientation = occluder.Pose.orientation;
+        const XrVector3f center = ToView(occluder.Pose.position);
+        const std::array<XrVector3f, 3> axes{Rotate(m_inverseOrientation, Rotate(orientation, {shrunk.x, 0, 0})),
+                                             Rotate(m_inverseOrientation, Rotate(orientation, {0, shrunk.y, 0})),
+                                             Rotate(m_inverseOrientation, Rotate(orientation, {0, 0, shrunk.z}))};
+
+        // Corner i is on the positive side of axis a when bit a of i is set.
+        std::array<ScreenVertex, 8> corners;
+        for (uint32_t i = 0; i < 8; i++) {
+            XrVector3f corner = center;
+            for (uint32_t a = 0; a < 3; a++) {
+                corner = (i & (1 << a)) ? Add(corner, axes[a]) : Subtract(corner, axes[a]);
+            }
+            const float distance = -corner.z;
+            if (distance < m_nearDistance) {
+                return false; // Crosses the near plane
+            }
+            corners[i] = {(corner.x / distance - m_tanLeft) * m_pixelsPerTanX,
+                          (m_tanUp - corner.y / distance) * m_pixelsPerTanY,
+                          m_depthOffset + m_depthScale / distance};
+        }
+
+        // Only faces toward the eyes' center, each as two triangles.
+        for (uint32_t a = 0; a < 3; a++) {
+            const uint32_t b = 1 << ((a + 1) % 3);
+            const uint32_t c = 1 << ((a + 2) % 3);
+            for (const uint32_t side : {0u, 1u << a}) {
+                const XrVector3f outward = side ? axes[a] : Scale(axes[a], -1);
+                if (Dot(Add(center, outward), outward) >= 0) {
+                    continue;
+                }
+                RasterizeTriangle(corners[side], corners[side | b], corners[side | b | c]);
+                RasterizeTriangle(corners[side], corners[side | b | c], corners[side | c]);
+            }
+        }
+        return true;
+    }
+
+    void OcclusionCuller::RasterizeTriangle(ScreenVertex v0, ScreenVertex v1, ScreenVertex v2) {
+        float area = (v1.X - v0.X) * (v2.Y - v0.Y) - (v1.Y - v0.Y) * (v2.X - v0.X);
+        if (std::abs(area) < 1e-6f) {
+            return;
+        }
+        if (area < 0) {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        // Pixels whose centers are inside, the first column rounded down to a multiple of 4.
+        const int32_t width = (int32_t)m_options.Width;
+        const int32_t height = (int32_t)m_options.Height;
+        const int32_t left = std::max(0, (int32_t)std::ceil(std::min({v0.X, v1.X, v2.X}) - 0.5f)) & ~3;
+        const int32_t right = std::min(width - 1, (int32_t)std::floor(std::max({v0.X, v1.X, v2.X}) - 0.5f));
+        const int32_t top = std::max(0, (int32_t)std::ceil(std::min({v0.Y, v1.Y, v2.Y}) - 0.5f));
+        const int32_t bottom = std::min(height - 1, (int32_t)std::floor(std::max({v0.Y, v1.Y, v2.Y}) - 0.5f));
+        if (left > right || top > bottom) {
+            return;
+        }
+
+        // Edge functions, non-negative inside, and the depth plane, all as a * x + b * y + c at pixel centers.
+        struct Plane {
+            float A, B, C;
+        };
+        auto Edge = [](const ScreenVertex& from, const ScreenVertex& to) {
+            const float a = from.Y - to.Y;
+            const float b = to.X - from.X;
+            return Plane{a, b, -a * from.X - b * from.Y};
+        };
+        const std::array<Plane, 3> edges{Edge(v0, v1), Edge(v1, v2), Edge(v2, v0)};
+        const float depthA = ((v1.Depth - v0.Depth) * (v2.Y - v0.Y) - (v2.Depth - v0.Depth) * (v1.Y - v0.Y)) / area;
+        const float depthB = ((v2.Depth - v0.Depth) * (v1.X - v0.X) - (v1.Depth - v0.Depth) * (v2.X - v0.X)) / area;
+        const Plane depth{depthA, depthB, v0.Depth - depthA * v0.X - depthB * v0.Y};
+
+        // Interpolation never stores a depth nearer than the triangle's nearest vertex.
+        const Float4 nearestDepth = Splat(std::max({v0.Depth, v1.Depth, v2.Depth}));
+        auto RowStart = [&](const Plane& plane, float y) {
+            return Add(Splat(plane.A * (left + 0.5f) + plane.B * y + plane.C), Set(0, plane.A, 2 * plane.A, 3 * plane.A));
+        };
+        for (int32_t y = top; y <= bottom; y++) {
+            const float centerY = y + 0.5f;
+            Float4 e0 = RowStart(edges[0], centerY);
+            Float4 e1 = RowStart(edges[1], centerY);
+            Float4 e2 = RowStart(edges[2], centerY);
+            Float4 z = RowStart(depth, centerY);
+            const Float4 e0Step = Splat(4 * edges[0].A);
+            const Float4 e1Step = Splat(4 * edges[1].A);
+            const Float4 e2Step = Splat(4 * edges[2].A);
+            const Float4 zStep = Splat(4 * depth.A);
+
+            float* row = m_depth.data() + (size_t)y * width;
+            for (int32_t x = left; x <= right; x += 4) {
+                const Float4 stored = Load(row + x);
+                Store(row + x, Select(InsideEdges(e0, e1, e2), Max(stored, Min(z, nearestDepth)), stored));
+                e0 = Add(e0, e0Step);
+                e1 = Add(e1, e1Step);
+                e2 = Add(e2, e2Step);
+                z = Add(z, zStep);
+            }
+        }
+    }
+
+    void OcclusionCuller::BuildHierarchy() {
+        for (uint32_t l = 1; l < m_levels.size(); l++) {
+            const bool fromPixels = l == 1;
+            const uint32_t childWidth = fromPixels ? m_options.Width : m_levels[l - 1].Width;
+            const uint32_t childHeight = fromPixels ? m_options.Height : m_levels[l - 1].Height;
+            const std::vector<float>& childMin = fromPixels ? m_depth : m_levels[l - 1].Min;
+            const std::vector<float>& childMax = fromPixels ? m_depth : m_levels[l - 1].Max;
+
+            Level& level = m_levels[l];
+            for (uint32_t y = 0; y < level.Height; y++) {
+                const uint32_t y0 = 2 * y;
+                const uint32_t y1 = std::min(y0 + 1, childHeight - 1);
+                for (uint32_t x = 0; x < level.Width; x++) {
+                    const uint32_t x0 = 2 * x;
+                    const uint32_t x1 = std::min(x0 + 1, childWidth - 1);
+                    level.Min[y * level.Width + x] = std::min({childMin[y0 * childWidth + x0],
+                                                               childMin[y0 * childWidth + x1],
+                                                               childMin[y1 * childWidth + x0],
+                                                               childMin[y1 * childWidth + x1]});
+                    level.Max[y * level.Width + x] = std::max({childMax[y0 * childWidth + x0],
+                                                               childMax[y0 * childWidth + x1],
+                                                               childMax[y1 * childWidth + x0],
+                                                               childMax[y1 * childWidth + x1]});
+                }
+            }
+        }
+    }
+
+    bool OcclusionCuller::IsVisible(const XrVector3f& center, float radius) const {
+        if (!m_hasView) {
+            return true;
+        }
+
+        // The sphere seen from the center of the eyes, grown so it covers what each eye sees of it.
+        const XrVector3f position = ToView(center);
+        const float sphereRadius = radius + m_eyeOffset;
+        const float nearest = -position.z - sphereRadius;
+        if (nearest < m_nearDistance) {
+            return true;
+        }
+        if (nearest > m_farDistance) {
+            return false; // Clipped by the far plane when rendered too
+        }
+
+        // Bounds of the sphere's box, projected with its nearest and farthest distance.
+        const float farthest = -position.z + sphereRadius;
+        const float tanLeft = std::min((position.x - sphereRadius) / nearest, (position.x - sphereRadius) / farthest);
+        const float tanRight = std::max((position.x + sphereRadius) / nearest, (position.x + sphereRadius) / farthest);
+        const float tanDown = std::min((position.y - sphereRadius) / nearest, (position.y - sphereRadius) / farthest);
+        const float tanUp = std::max((position.y + sphereRadius) / nearest, (position.y + sphereRadius) / farthest);
+        const int32_t width = (int32_t)m_options.Width;
+        const int32_t height = (int32_t)m_options.Height;
+        PixelRect rect{(int32_t)std::floor((tanLeft - m_tanLeft) * m_pixelsPerTanX),
+                       (int32_t)std::floor((m_tanUp - tanUp) * m_pixelsPerTanY),
+                       (int32_t)std::floor((tanRight - m_tanLeft) * m_pixelsPerTanX),
+                       (int32_t)std::floor((m_tanUp - tanDown) * m_pixelsPerTanY)};
+        if (rect.Right < 0 || rect.Left >= width || rect.Bottom < 0 || rect.Top >= height) {
+            return false; // The combined view covers every view
+        }
+        rect = {std::max(rect.Left, 0), std::max(rect.Top, 0), std::min(rect.Right, width - 1), std::min(rect.Bottom, height - 1)};
+
+        // Start from the finest level where the rectangle spans at most 2 by 2 cells.
+        uint32_t level = 0;
+        while (((rect.Right >> level) - (rect.Left >> level)) > 1 || ((rect.Bottom >> level) - (rect.Top >> level)) > 1) {
+            level++;
+        }
+        const float depth = m_depthOffset + m_depthScale / nearest;
+        for (int32_t y = rect.Top >> level; y <= rect.Bottom >> level; y++) {
+            for (int32_t x = rect.Left >> level; x <= rect.Right >> level; x++) {
+                if (IsCellVisible(level, x, y, rect, depth)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void OcclusionCuller::CountTested(uint32_t tested, uint32_t culled) {
+        m_stats.Tested += tested;
+        m_stats.Culled += culled;
+    }
+
+    bool OcclusionCuller::IsCellVisible(uint32_t level, uint32_t x, uint32_t y, const PixelRect& rect, float depth) const {
+        if (level == 0) {
+            return m_depth[(size_t)y * m_options.Width + x] <= depth;
+        }
+
+        // Hidden when the farthest occluder in the cell is nearer, visible when the nearest is not and the cell is inside
+        // the rectangle. Otherwise it depends on the finer cells.
+        const Level& cells = m_levels[level];
+        const size_t index = (size_t)y * cells.Width + x;
+        if (cells.Min[index] > depth) {
+            return false;
+        }
+        const int32_t left = x << level;
+        const int32_t top = y << level;
+        const int32_t right = std::min(((int32_t)x + 1) << level, (int32_t)m_options.Width) - 1;
+        const int32_t bottom = std::min(((int32_t)y + 1) << level, (int32_t)m_options.Height) - 1;
+        if (cells.Max[index] <= depth && left >= rect.Left && top >= rect.Top && right <= rect.Right && bottom <= rect.Bottom) {
+            return true;
+        }
+
+        const int32_t child = level - 1;
+        for (int32_t cy = std::max<int32_t>(2 * y, rect.Top >> child); cy <= std::min<int32_t>(2 * y + 1, rect.Bottom >> child); cy++) {
+            for (int32_t cx = std::max<int32_t>(2 * x, rect.Left >> child); cx <= std::min<int32_t>(2 * x + 1, rect.Right >> child); cx++) {
+                if (IsCellVisible(child, cx, cy, rect, depth)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+} // namespace sample::occlusion
@@ -0,0 +1,109 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+namespace sample::occlusion {
+
+    struct FrameStats {
+        uint32_t Occluders{0}; // Rasterized this frame
+        uint32_t Tested{0};
+        uint32_t Culled{0}; // Hidden behind occluders, outside the views or beyond the far plane
+    };
+
+    // Hides holograms behind solid boxes, which is what holograms render as until their meshes load. The nearest boxes
+    // are rasterized into a small reversed-Z depth buffer seen from between the eyes, covering every view, and hologram
+    // bounds are tested against a min/max hierarchy of it. Occluders are shrunk by the distance to the eyes and half a
+    // pixel, and tested spheres grown by the distance to the eyes, so nothing seen from either eye is ever culled.
+    // Not thread safe, except IsVisible between Rasterize and the next BeginFrame.
+    class OcclusionCuller {
+    public:
+        struct Options {
+            uint32_t Width{192}; // Depth buffer size, the width a multiple of 4
+            uint32_t Height{128};
+            uint32_t MaxOccluders{32}; // Only the nearest are rasterized
+        };
+
+        explicit OcclusionCuller(Options options);
+
+        // Views are in the space of the occluders and spheres below. nearFar must be reversed-Z, with Near the farther
+        // plane, as the views are rendered with. Clears the occluders and the frame stats.
+        void BeginFrame(const XrView* views, uint32_t viewCount, const xr::math::NearFar& nearFar);
+
+        // A solid box to rasterize, e.g. a cube with half its scale.
+        void AddOccluder(const XrPosef& pose, const XrVector3f& halfExtents);
+
+        // Rasterizes the nearest occluders added since BeginFrame and builds the depth hierarchy.
+        void Rasterize();
+
+        // Whether any part of the sphere may be seen in any view. Only reads what Rasterize built, so many spheres may be
+        // tested in parallel. Not counted in the stats, the caller adds its totals with CountTested.
+        bool IsVisible(const XrVector3f& center, float radius) const;
+
+        void CountTested(uint32_t tested, uint32_t culled);
+
+        const FrameStats& Stats() const {
+            return m_stats;
+        }
+
+    private:
+        struct Occluder {
+            XrPosef Pose;
+            XrVector3f HalfExtents;
+            float Distance; // From the eyes' center to the box center
+        };
+
+        struct ScreenVertex {
+            float X, Y; // In pixels
+            float Depth;
+        };
+
+        // Cells of one hierarchy level cover 2^level pixels squared. Level 0 is the depth buffer itself.
+        struct Level {
+            uint32_t Width{0};
+            uint32_t Height{0};
+            std::vector<float> Min;
+            std::vector<float> Max;
+        };
+
+        struct PixelRect {
+            int32_t Left, Top, Right, Bottom; // Inclusive
+        };
+
+        XrVector3f ToView(const XrVector3f& point) const;
+        bool RasterizeBox(const Occluder& occluder);
+        void RasterizeTriangle(ScreenVertex v0, ScreenVertex v1, ScreenVertex v2);
+        void BuildHierarchy();
+        bool IsCellVisible(uint32_t level, uint32_t x, uint32_t y, const PixelRect& rect, float depth) const;
+
+        const Options m_options;
+        std::vector<Occluder> m_occluders;
+        std::vector<float> m_depth;
+        std::vector<Level> m_levels;
+        FrameStats m_stats;
+
+        // The combined view, located at the center of the eyes and spanning the fields of view of all of them.
+        bool m_hasView{false};
+        XrVector3f m_position{};
+        XrQuaternionf m_inverseOrientation{0, 0, 0, 1};
+        float m_tanLeft{0}, m_tanUp{0};
+        float m_pixelsPerTanX{0}, m_pixelsPerTanY{0};
+        float m_eyeOffset{0};   // Largest distance from the center to an eye
+        float m_pixelRadius{0}; // Half the pixel diagonal at distance 1
+        float m_nearDistance{0}, m_farDistance{0};
+        float m_depthOffset{0}, m_depthScale{0}; // Reversed-Z depth at distance z is m_depthOffset + m_depthScale / z
+    };
+
+} // namespace sample::occlusion
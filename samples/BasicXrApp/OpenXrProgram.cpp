@@ -17,6 +17,22 @@
 #include "pch.h"
 #include "App.h"
 #include "DxUtility.h"
+#include "PosePrediction.h"
+#include "ActionCache.h"
+#include "InputSampler.h"
+#include "SessionEvents.h"
+#include "FrameCapture.h"
+#include "SessionTrace.h"
+#include "ReplayRuntime.h"
+#include "JobSystem.h"
+#include "SceneUpdate.h"
+#include "HologramStore.h"
+#include "AnchorManager.h"
+#include "ResourceTracker.h"
+#include "ViewConfiguration.h"
+#include "XrDispatch.h"
+#include "SwapchainWait.h"
+#include "ResolutionController.h"
 
 namespace {
     struct ImplementOpenXrProgram : sample::IOpenXrProgram {
@@ -29,25 +45,40 @@ namespace {
             CreateInstance();
             CreateActions();
 
+            {
+                std::lock_guard lock(m_eventPumpMutex);
+                m_eventPump = std::make_unique<sample::session::EventPump>(m_dispatch, m_instance.Get(), m_eventPumpOptions);
+            }
+
             bool requestRestart = false;
             do {
                 InitializeSystem();
                 InitializeSession();
 
                 while (true) {
+                    if (m_exitRequested.exchange(false)) {
+                        if (m_sessionStateMachine.IsRunning()) {
+                            // Leave through STOPPING and EXITING like a user initiated exit.
+                            CHECK_XRCMD(m_dispatch.xrRequestExitSession(m_session.Get()));
+                            m_eventPump->Wake();
+                        } else {
+                            requestRestart = false;
+                            break;
+                        }
+                    }
+
                     bool exitRenderLoop = false;
                     ProcessEvents(&exitRenderLoop, &requestRestart);
                     if (exitRenderLoop) {
                         break;
                     }
 
-                    if (m_sessionRunning) {
+                    if (m_sessionStateMachine.IsRunning()) {
                         PollActions();
                         RenderFrame();
                     } else {
-                        // Throttle loop since xrWaitFrame won't be called.
-                        using namespace std::chrono_literals;
-                        std::this_thread::sleep_for(250ms);
+                        // xrWaitFrame won't be called, so block until the runtime reports the next state change.
+                        m_eventPump->WaitForEvent();
                     }
                 }
 
@@ -55,6 +86,52 @@ namespace {
                     PrepareSessionRestart();
                 }
             } while (requestRestart);
+
+            SaveHolograms();
+        }
+
+        void RequestExit() override {
+            m_exitRequested = true;
+
+            std::lock_guard lock(m_eventPumpMutex);
+            if (m_eventPump) {
+                m_eventPump->Interrupt();
+            }
+        }
+
+        void SetFrameObserver(FrameObserver observer) override {
+            m_frameObserver = std::move(observer);
+        }
+
+        void EnableTraceRecording(const std::wstring& path) override {
+            m_traceWriter = std::make_unique<sample::trace::TraceWriter>(path);
+            m_actionCache.SetDispatchObserver(
+                [this](const sample::input::ActionChange& change) { m_traceWriter->RecordActionChange(change); });
+        }
+
+        void EnableReplay(const std::wstring& path, bool asFastAsPossible) override {
+            sample::replay::ReplayRuntime::Options options;
+            options.Pace = asFastAsPossible ? sample::trace::TraceReplayer::Pace::AsFastAsPossible
+                                            : sample::trace::TraceReplayer::Pace::Original;
+            m_replayRuntime = std::make_unique<sample::replay::ReplayRuntime>(path, options);
+        }
+
+        void EnableFrameCapture(uint16_t port) override {
+            sample::capture::FrameCapture::Options options;
+            options.Port = port;
+            m_frameCaptureOptions = options;
+        }
+
+        void SetHologramMeshLods(const std::vector<std::wstring>& paths) override {
+            m_hologramMeshPaths = paths;
+        }
+
+        void EnableHologramPersistence(const std::wstring& path) override {
+            m_hologramsPath = path;
+        }
+
+        void SetPipelineDepth(uint32_t frames) override {
+            m_predictionOptions.PipelineDepth = frames;
         }
 
     private:
@@ -71,15 +148,28 @@ namespace {
 
             createInfo.applicationInfo = {"", 1, "OpenXR Sample", 1, XR_CURRENT_API_VERSION};
             strcpy_s(createInfo.applicationInfo.applicationName, m_applicationName.c_str());
-            CHECK_XRCMD(xrCreateInstance(&createInfo, m_instance.Put()));
+            if (m_replayRuntime) {
+                // The replay stands in for the loader and the runtime behind it.
+                CHECK_XRCMD(m_replayRuntime->CreateInstance(&createInfo, m_instance.Put(sample::replay::ReplayRuntime::DestroyInstance)));
+                sample::replay::ReplayRuntime::Load(&m_dispatch);
+                return;
+            }
+            CHECK_XRCMD(xrCreateInstance(&createInfo, m_instance.Put(xrDestroyInstance)));
+
+            // Everything after goes through the table of the instance rather than the loader's exports.
+            m_dispatch.Load(m_instance.Get());
         }
 
         std::vector<const char*> SelectExtensions() {
             // Fetch the list of extensions supported by the runtime.
+            auto EnumerateExtensions = [this](uint32_t capacity, uint32_t* count, XrExtensionProperties* properties) {
+                return m_replayRuntime ? m_replayRuntime->EnumerateInstanceExtensionProperties(capacity, count, properties)
+                                       : xrEnumerateInstanceExtensionProperties(nullptr, capacity, count, properties);
+            };
             uint32_t extensionCount;
-            CHECK_XRCMD(xrEnumerateInstanceExtensionProperties(nullptr, 0, &extensionCount, nullptr));
+            CHECK_XRCMD(EnumerateExtensions(0, &extensionCount, nullptr));
             std::vector<XrExtensionProperties> extensionProperties(extensionCount, {XR_TYPE_EXTENSION_PROPERTIES});
-            CHECK_XRCMD(xrEnumerateInstanceExtensionProperties(nullptr, extensionCount, &extensionCount, extensionProperties.data()));
+            CHECK_XRCMD(EnumerateExtensions(extensionCount, &extensionCount, extensionProperties.data()));
 
             std::vector<const char*> enabledExtensions;
 
@@ -101,6 +191,12 @@ namespace {
             //m_optionalExtensions.DepthExtensionSupported = EnableExtentionIfSupported(XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME);
             m_optionalExtensions.UnboundedRefSpaceSupported = EnableExtentionIfSupported(XR_MSFT_UNBOUNDED_REFERENCE_SPACE_EXTENSION_NAME);
             m_optionalExtensions.SpatialAnchorSupported = EnableExtentionIfSupported(XR_MSFT_SPATIAL_ANCHOR_EXTENSION_NAME);
+            m_optionalExtensions.SpatialAnchorPersistenceSupported =
+                m_optionalExtensions.SpatialAnchorSupported &&
+                EnableExtentionIfSupported(XR_MSFT_SPATIAL_ANCHOR_PERSISTENCE_EXTENSION_NAME);
+            m_optionalExtensions.PerformanceCounterTimeSupported =
+                EnableExtentionIfSupported(XR_KHR_WIN32_CONVERT_PERFORMANCE_COUNTER_TIME_EXTENSION_NAME);
+            m_optionalExtensions.QuadViewsSupported = EnableExtentionIfSupported(XR_VARJO_QUAD_VIEWS_EXTENSION_NAME);
 
             return enabledExtensions;
         }
@@ -113,7 +209,7 @@ namespace {
                 XrActionSetCreateInfo actionSetInfo{XR_TYPE_ACTION_SET_CREATE_INFO};
                 strcpy_s(actionSetInfo.actionSetName, "place_hologram_action_set");
                 strcpy_s(actionSetInfo.localizedActionSetName, "Placement");
-                CHECK_XRCMD(xrCreateActionSet(m_instance.Get(), &actionSetInfo, m_actionSet.Put()));
+                CHECK_XRCMD(m_dispatch.xrCreateActionSet(m_instance.Get(), &actionSetInfo, m_actionSet.Put(m_dispatch.xrDestroyActionSet)));
             }
 
             // Create actions.
@@ -130,7 +226,7 @@ namespace {
                     strcpy_s(actionInfo.localizedActionName, "Place Hologram");
                     actionInfo.countSubactionPaths = (uint32_t)m_subactionPaths.size();
                     actionInfo.subactionPaths = m_subactionPaths.data();
-                    CHECK_XRCMD(xrCreateAction(m_actionSet.Get(), &actionInfo, m_placeAction.Put()));
+                    CHECK_XRCMD(m_dispatch.xrCreateAction(m_actionSet.Get(), &actionInfo, m_placeAction.Put(m_dispatch.xrDestroyAction)));
                 }
 
                 // Create an input action getting the left and right hand poses.
@@ -141,7 +237,7 @@ namespace {
                     strcpy_s(actionInfo.localizedActionName, "Hand Pose");
                     actionInfo.countSubactionPaths = (uint32_t)m_subactionPaths.size();
                     actionInfo.subactionPaths = m_subactionPaths.data();
-                    CHECK_XRCMD(xrCreateAction(m_actionSet.Get(), &actionInfo, m_poseAction.Put()));
+                    CHECK_XRCMD(m_dispatch.xrCreateAction(m_actionSet.Get(), &actionInfo, m_poseAction.Put(m_dispatch.xrDestroyAction)));
                 }
 
                 // Create an output action for vibrating the left and right controller.
@@ -152,7 +248,7 @@ namespace {
                     strcpy_s(actionInfo.localizedActionName, "Vibrate");
                     actionInfo.countSubactionPaths = (uint32_t)m_subactionPaths.size();
                     actionInfo.subactionPaths = m_subactionPaths.data();
-                    CHECK_XRCMD(xrCreateAction(m_actionSet.Get(), &actionInfo, m_vibrateAction.Put()));
+                    CHECK_XRCMD(m_dispatch.xrCreateAction(m_actionSet.Get(), &actionInfo, m_vibrateAction.Put(m_dispatch.xrDestroyAction)));
                 }
 
                 // Create an input action to exit session
@@ -163,7 +259,7 @@ namespace {
                     strcpy_s(actionInfo.localizedActionName, "Exit session");
                     actionInfo.countSubactionPaths = (uint32_t)m_subactionPaths.size();
                     actionInfo.subactionPaths = m_subactionPaths.data();
-                    CHECK_XRCMD(xrCreateAction(m_actionSet.Get(), &actionInfo, m_exitAction.Put()));
+                    CHECK_XRCMD(m_dispatch.xrCreateAction(m_actionSet.Get(), &actionInfo, m_exitAction.Put(m_dispatch.xrDestroyAction)));
                 }
             }
 
@@ -183,7 +279,20 @@ namespace {
                 suggestedBindings.interactionProfile = GetXrPath("/interaction_profiles/khr/simple_controller");
                 suggestedBindings.suggestedBindings = bindings.data();
                 suggestedBindings.countSuggestedBindings = (uint32_t)bindings.size();
-                CHECK_XRCMD(xrSuggestInteractionProfileBindings(m_instance.Get(), &suggestedBindings));
+                CHECK_XRCMD(m_dispatch.xrSuggestInteractionProfileBindings(m_instance.Get(), &suggestedBindings));
+            }
+
+            // Register the action states read every frame, with callbacks that only run when a state changes.
+            {
+                m_actionCache.AddActiveActionSet(m_actionSet.Get());
+                for (uint32_t side : {LeftSide, RightSide}) {
+                    m_actionCache.RegisterBoolean(m_placeAction.Get(), m_subactionPaths[side], [this, side](const XrActionStateBoolean& state) {
+                        OnPlaceAction(side, state);
+                    });
+                    m_actionCache.RegisterBoolean(m_exitAction.Get(), m_subactionPaths[side], [this, side](const XrActionStateBoolean& state) {
+                        OnExitAction(side, state);
+                    });
+                }
             }
         }
 
@@ -193,28 +302,55 @@ namespace {
 
             XrSystemGetInfo systemInfo{XR_TYPE_SYSTEM_GET_INFO};
             systemInfo.formFactor = m_formFactor;
+
+            // After a session loss the headset is usually back within a few frames, so retry quickly at first.
+            using namespace std::chrono_literals;
+            std::chrono::milliseconds retryDelay = 50ms;
             while (true) {
-                XrResult result = xrGetSystem(m_instance.Get(), &systemInfo, &m_systemId);
+                XrResult result = m_dispatch.xrGetSystem(m_instance.Get(), &systemInfo, &m_systemId);
                 if (SUCCEEDED(result)) {
                     break;
                 } else if (result == XR_ERROR_FORM_FACTOR_UNAVAILABLE) {
-                    DEBUG_PRINT("No headset detected.  Trying again in one second...");
-                    using namespace std::chrono_literals;
-                    std::this_thread::sleep_for(1s);
+                    DEBUG_PRINT("No headset detected.  Trying again in %lld ms...", (long long)retryDelay.count());
+                    std::this_thread::sleep_for(retryDelay);
+                    retryDelay = std::min<std::chrono::milliseconds>(retryDelay * 2, 1s);
                 } else {
                     CHECK_XRRESULT(result, "xrGetSystem");
                 }
             };
 
+            // Choose the most detailed view configuration the render path is compiled for.
+            {
+                uint32_t count;
+                CHECK_XRCMD(m_dispatch.xrEnumerateViewConfigurations(m_instance.Get(), m_systemId, 0, &count, nullptr));
+                std::vector<XrViewConfigurationType> viewConfigurations(count);
+                CHECK_XRCMD(m_dispatch.xrEnumerateViewConfigurations(
+                    m_instance.Get(), m_systemId, count, &count, viewConfigurations.data()));
+
+                auto IsSelectable = [&](XrViewConfigurationType viewConfiguration) {
+                    if (viewConfiguration == XR_VIEW_CONFIGURATION_TYPE_PRIMARY_QUAD_VARJO && !m_optionalExtensions.QuadViewsSupported) {
+                        return false;
+                    }
+                    return std::find(viewConfigurations.begin(), viewConfigurations.end(), viewConfiguration) != viewConfigurations.end();
+                };
+                const auto selected = std::find_if(std::begin(sample::views::SupportedViewConfigurations),
+                                                   std::end(sample::views::SupportedViewConfigurations),
+                                                   IsSelectable);
+                CHECK_MSG(selected != std::end(sample::views::SupportedViewConfigurations), "No supported view configuration");
+                m_primaryViewConfigType = *selected;
+                DEBUG_PRINT("Rendering %u views", sample::views::ViewCountOf(m_primaryViewConfigType));
+            }
+
             // Choose an environment blend mode.
             {
                 // Query the list of supported environment blend modes for the current system
                 uint32_t count;
-                CHECK_XRCMD(xrEnumerateEnvironmentBlendModes(m_instance.Get(), m_systemId, m_primaryViewConfigType, 0, &count, nullptr));
+                CHECK_XRCMD(m_dispatch.xrEnumerateEnvironmentBlendModes(
+                    m_instance.Get(), m_systemId, m_primaryViewConfigType, 0, &count, nullptr));
                 CHECK(count > 0); // A system must support at least one environment blend mode.
 
                 std::vector<XrEnvironmentBlendMode> environmentBlendModes(count);
-                CHECK_XRCMD(xrEnumerateEnvironmentBlendModes(
+                CHECK_XRCMD(m_dispatch.xrEnumerateEnvironmentBlendModes(
                     m_instance.Get(), m_systemId, m_primaryViewConfigType, count, &count, environmentBlendModes.data()));
 
                 // This sample supports all modes, pick the system's preferred one.
@@ -233,7 +369,7 @@ namespace {
 
             // Create the D3D11 device for the adapter associated with the system.
             XrGraphicsRequirementsD3D11KHR graphicsRequirements{XR_TYPE_GRAPHICS_REQUIREMENTS_D3D11_KHR};
-            CHECK_XRCMD(xrGetD3D11GraphicsRequirementsKHR(m_instance.Get(), m_systemId, &graphicsRequirements));
+            CHECK_XRCMD(m_dispatch.xrGetD3D11GraphicsRequirementsKHR(m_instance.Get(), m_systemId, &graphicsRequirements));
 
             // Create a list of feature levels which are both supported by the OpenXR runtime and this application.
             std::vector<D3D_FEATURE_LEVEL> featureLevels = {D3D_FEATURE_LEVEL_12_1,
@@ -248,7 +384,25 @@ namespace {
                                 featureLevels.end());
             CHECK_MSG(featureLevels.size() != 0, "Unsupported minimum feature level!");
 
+            // On a session restart this returns the device, shaders and buffers created for the previous session.
             ID3D11Device* device = m_graphicsPlugin->InitializeDevice(graphicsRequirements.adapterLuid, featureLevels);
+            if (!m_hologramMeshPaths.empty() && m_hologramLodChain == sample::lod::NoLodChain) {
+                // Meshes load in the background while the session starts. Their handles survive device changes,
+                // so the chain is only added once.
+                std::vector<sample::mesh::MeshHandle> meshes;
+                for (const std::wstring& path : m_hologramMeshPaths) {
+                    meshes.push_back(m_graphicsPlugin->LoadMesh(path));
+                }
+                m_hologramLodChain = m_lodSelector.AddChain(meshes);
+            }
+
+            // The capture message carries the poses of at most a stereo pair, which receivers rely on.
+            if (m_frameCaptureOptions && sample::views::ViewCountOf(m_primaryViewConfigType) > sample::capture::MaxCaptureViews) {
+                DEBUG_PRINT("Frame capture is disabled, it supports at most %u views", sample::capture::MaxCaptureViews);
+            } else if (m_frameCaptureOptions) {
+                m_frameCapture = std::make_unique<sample::capture::FrameCapture>(device, m_frameCaptureOptions.value());
+            }
+            m_gpuTimer = std::make_unique<sample::resolution::GpuTimer>(device);
 
             XrGraphicsBindingD3D11KHR graphicsBinding{XR_TYPE_GRAPHICS_BINDING_D3D11_KHR};
             graphicsBinding.device = device;
@@ -256,16 +410,31 @@ namespace {
             XrSessionCreateInfo createInfo{XR_TYPE_SESSION_CREATE_INFO};
             createInfo.next = &graphicsBinding;
             createInfo.systemId = m_systemId;
-            CHECK_XRCMD(xrCreateSession(m_instance.Get(), &createInfo, m_session.Put()));
+            CHECK_XRCMD(m_dispatch.xrCreateSession(m_instance.Get(), &createInfo, m_session.Put(m_dispatch.xrDestroySession)));
 
             XrSessionActionSetsAttachInfo attachInfo{XR_TYPE_SESSION_ACTION_SETS_ATTACH_INFO};
             std::vector<XrActionSet> actionSets = {m_actionSet.Get()};
             attachInfo.countActionSets = (uint32_t)actionSets.size();
             attachInfo.actionSets = actionSets.data();
-            CHECK_XRCMD(xrAttachSessionActionSets(m_session.Get(), &attachInfo));
+            CHECK_XRCMD(m_dispatch.xrAttachSessionActionSets(m_session.Get(), &attachInfo));
 
             CreateSpaces();
             CreateSwapchains();
+
+            if (!m_hologramsPath.empty()) {
+                // Only the header is read here, the saved holograms are restored over the first frames.
+                if (m_optionalExtensions.SpatialAnchorPersistenceSupported) {
+                    m_anchorStore = std::make_unique<sample::persistence::AnchorStore>(m_dispatch, m_session.Get());
+                }
+                m_savedHolograms = sample::persistence::HologramFile::Open(m_hologramsPath);
+                m_restoredCount = 0;
+            }
+            m_anchorManager = std::make_unique<sample::anchors::AnchorManager>(m_dispatch,
+                                                                               m_session.Get(),
+                                                                               m_sceneSpace.Get(),
+                                                                               m_optionalExtensions.SpatialAnchorSupported,
+                                                                               m_anchorStore.get(),
+                                                                               m_anchorManagerOptions);
         }
 
         void CreateSpaces() {
@@ -284,7 +453,8 @@ namespace {
                 XrReferenceSpaceCreateInfo spaceCreateInfo{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
                 spaceCreateInfo.referenceSpaceType = m_sceneSpaceType;
                 spaceCreateInfo.poseInReferenceSpace = xr::math::Pose::Identity();
-                CHECK_XRCMD(xrCreateReferenceSpace(m_session.Get(), &spaceCreateInfo, m_sceneSpace.Put()));
+                CHECK_XRCMD(m_dispatch.xrCreateReferenceSpace(
+                    m_session.Get(), &spaceCreateInfo, m_sceneSpace.Put(m_dispatch.xrDestroySpace)));
             }
 
             // Create a space for each hand pointer pose.
@@ -293,7 +463,13 @@ namespace {
                 createInfo.action = m_poseAction.Get();
                 createInfo.poseInActionSpace = xr::math::Pose::Identity();
                 createInfo.subactionPath = m_subactionPaths[side];
-                CHECK_XRCMD(xrCreateActionSpace(m_session.Get(), &createInfo, m_cubesInHand[side].Space.Put()));
+                CHECK_XRCMD(m_dispatch.xrCreateActionSpace(
+                    m_session.Get(), &createInfo, m_cubesInHand[side].Space.Put(m_dispatch.xrDestroySpace)));
+
+                // The hands keep their ids across sessions, which a replay matches by the order it creates action spaces.
+                if (m_traceWriter) {
+                    m_traceWriter->DeclareSpace(m_cubesInHand[side].Space.Get(), side);
+                }
             }
         }
 
@@ -302,10 +478,10 @@ namespace {
 
             // Query runtime preferred swapchain formats.
             uint32_t swapchainFormatCount;
-            CHECK_XRCMD(xrEnumerateSwapchainFormats(m_session.Get(), 0, &swapchainFormatCount, nullptr));
+            CHECK_XRCMD(m_dispatch.xrEnumerateSwapchainFormats(m_session.Get(), 0, &swapchainFormatCount, nullptr));
 
             std::vector<int64_t> swapchainFormats(swapchainFormatCount);
-            CHECK_XRCMD(xrEnumerateSwapchainFormats(
+            CHECK_XRCMD(m_dispatch.xrEnumerateSwapchainFormats(
                 m_session.Get(), (uint32_t)swapchainFormats.size(), &swapchainFormatCount, swapchainFormats.data()));
 
             // Choose the first runtime preferred format that this app supports.
@@ -331,41 +507,42 @@ namespace {
             CHECK(m_session.Get() != XR_NULL_HANDLE);
             CHECK(m_renderResources == nullptr);
 
-            m_renderResources = std::make_unique<RenderResources>();
-
             // Read graphics properties for preferred swapchain length and logging.
             XrSystemProperties systemProperties{XR_TYPE_SYSTEM_PROPERTIES};
-            CHECK_XRCMD(xrGetSystemProperties(m_instance.Get(), m_systemId, &systemProperties));
+            CHECK_XRCMD(m_dispatch.xrGetSystemProperties(m_instance.Get(), m_systemId, &systemProperties));
 
             // Select color and depth swapchain pixel formats
             const auto [colorSwapchainFormat, depthSwapchainFormat] = SelectSwapchainPixelFormats();
 
-            // Query and cache view configuration views.
-            uint32_t viewCount;
-            CHECK_XRCMD(xrEnumerateViewConfigurationViews(m_instance.Get(), m_systemId, m_primaryViewConfigType, 0, &viewCount, nullptr));
-            CHECK(viewCount == m_stereoViewCount);
-
-            m_renderResources->ConfigViews.resize(viewCount, {XR_TYPE_VIEW_CONFIGURATION_VIEW});
-            CHECK_XRCMD(xrEnumerateViewConfigurationViews(
-                m_instance.Get(), m_systemId, m_primaryViewConfigType, viewCount, &viewCount, m_renderResources->ConfigViews.data()));
-
-            // Using texture array for better performance, but requiring left/right views have identical sizes.
-            const XrViewConfigurationView& view = m_renderResources->ConfigViews[0];
-            CHECK(m_renderResources->ConfigViews[0].recommendedImageRectWidth ==
-                  m_renderResources->ConfigViews[1].recommendedImageRectWidth);
-            CHECK(m_renderResources->ConfigViews[0].recommendedImageRectHeight ==
-                  m_renderResources->ConfigViews[1].recommendedImageRectHeight);
-            CHECK(m_renderResources->ConfigViews[0].recommendedSwapchainSampleCount ==
-                  m_renderResources->ConfigViews[1].recommendedSwapchainSampleCount);
-
-            // Use recommended rendering parameters for a balance between quality and performance
-            const uint32_t imageRectWidth = view.recommendedImageRectWidth;
-            const uint32_t imageRectHeight = view.recommendedImageRectHeight;
+            // The frame loop is compiled for each view count, the one of the selected configuration is picked here once.
+            switch (sample::views::ViewCountOf(m_primaryViewConfigType)) {
+            case 1:
+                CreateRenderResources<1>();
+                break;
+            case 2:
+                CreateRenderResources<2>();
+                break;
+            case 4:
+                CreateRenderResources<4>();
+                break;
+            default:
+                THROW("Unsupported view configuration");
+            }
+
+            // Swapchains are allocated at the maximum size, each frame renders the part of it the resolution controller picks.
+            // It starts at the recommended size, for a balance between quality and performance.
+            const XrViewConfigurationView& view = m_renderResources->RecommendedView;
+            const uint32_t imageRectWidth = view.maxImageRectWidth;
+            const uint32_t imageRectHeight = view.maxImageRectHeight;
             const uint32_t swapchainSampleCount = view.recommendedSwapchainSampleCount;
+            m_resolutionController = std::make_unique<sample::resolution::ResolutionController>(
+                XrExtent2Di{(int32_t)view.recommendedImageRectWidth, (int32_t)view.recommendedImageRectHeight},
+                XrExtent2Di{(int32_t)imageRectWidth, (int32_t)imageRectHeight},
+                m_resolutionOptions);
 
             // Create swapchains with texture array for color and depth images.
-            // The texture array has the size of viewCount, and they are rendered in a single pass using VPRT.
-            const uint32_t textureArraySize = viewCount;
+            // The texture array has a slice per view, and they are rendered in a single pass using VPRT.
+            const uint32_t textureArraySize = m_renderResources->ViewCount;
             m_renderResources->ColorSwapchain =
                 CreateSwapchainD3D11(m_session.Get(),
                                      colorSwapchainFormat,
@@ -385,9 +562,39 @@ namespace {
                                      swapchainSampleCount,
                                      0 /*createFlags*/,
                                      XR_SWAPCHAIN_USAGE_SAMPLED_BIT | XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        }
+
+        // Query and cache view configuration views, with storage for every per-view structure of the frame loop.
+        template <uint32_t ViewCount>
+        void CreateRenderResources() {
+            auto resources = std::make_unique<ViewResources<ViewCount>>();
+            sample::views::FrameViews<ViewCount>& frame = resources->Frame;
+
+            uint32_t viewCount;
+            CHECK_XRCMD(m_dispatch.xrEnumerateViewConfigurationViews(
+                m_instance.Get(), m_systemId, m_primaryViewConfigType, 0, &viewCount, nullptr));
+            CHECK(viewCount == ViewCount);
+            CHECK_XRCMD(m_dispatch.xrEnumerateViewConfigurationViews(
+                m_instance.Get(), m_systemId, m_primaryViewConfigType, viewCount, &viewCount, frame.ConfigViews.data()));
+
+            // Using texture array for better performance, so every view renders at the largest recommended size.
+            // Stereo views have identical sizes, the focus views of quad views are denser than the context views.
+            resources->ViewCount = ViewCount;
+            resources->RecommendedView = frame.ConfigViews[0];
+            for (const XrViewConfigurationView& configView : frame.ConfigViews) {
+                CHECK(configView.recommendedSwapchainSampleCount == resources->RecommendedView.recommendedSwapchainSampleCount);
+                resources->RecommendedView.recommendedImageRectWidth =
+                    std::max(resources->RecommendedView.recommendedImageRectWidth, configView.recommendedImageRectWidth);
+                resources->RecommendedView.recommendedImageRectHeight =
+                    std::max(resources->RecommendedView.recommendedImageRectHeight, configView.recommendedImageRectHeight);
+                resources->RecommendedView.maxImageRectWidth =
+                    std::max(resources->RecommendedView.maxImageRectWidth, configView.maxImageRectWidth);
+                resources->RecommendedView.maxImageRectHeight =
+                    std::max(resources->RecommendedView.maxImageRectHeight, configView.maxImageRectHeight);
+            }
 
-            // Preallocate view buffers for xrLocateViews later inside frame loop.
-            m_renderResources->Views.resize(viewCount, {XR_TYPE_VIEW});
+            m_renderResources = std::move(resources);
+            m_renderLayer = &ImplementOpenXrProgram::RenderLayer<ViewCount>;
         }
 
         struct SwapchainD3D11;
@@ -416,32 +623,26 @@ namespace {
             swapchainCreateInfo.createFlags = createFlags;
             swapchainCreateInfo.usageFlags = usageFlags;
 
-            CHECK_XRCMD(xrCreateSwapchain(session, &swapchainCreateInfo, swapchain.Handle.Put()));
+            CHECK_XRCMD(m_dispatch.xrCreateSwapchain(session, &swapchainCreateInfo, swapchain.Handle.Put(m_dispatch.xrDestroySwapchain)));
 
             uint32_t chainLength;
-            CHECK_XRCMD(xrEnumerateSwapchainImages(swapchain.Handle.Get(), 0, &chainLength, nullptr));
+            CHECK_XRCMD(m_dispatch.xrEnumerateSwapchainImages(swapchain.Handle.Get(), 0, &chainLength, nullptr));
 
             swapchain.Images.resize(chainLength, {XR_TYPE_SWAPCHAIN_IMAGE_D3D11_KHR});
-            CHECK_XRCMD(xrEnumerateSwapchainImages(swapchain.Handle.Get(),
-                                                   (uint32_t)swapchain.Images.size(),
-                                                   &chainLength,
-                                                   reinterpret_cast<XrSwapchainImageBaseHeader*>(swapchain.Images.data())));
+            CHECK_XRCMD(m_dispatch.xrEnumerateSwapchainImages(swapchain.Handle.Get(),
+                                                              (uint32_t)swapchain.Images.size(),
+                                                              &chainLength,
+                                                              reinterpret_cast<XrSwapchainImageBaseHeader*>(swapchain.Images.data())));
+
+            // The runtime owns the images, they are accounted until it destroys them with the swapchain.
+            const char* name = (usageFlags & XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) ? "depth swapchain" : "color swapchain";
+            for (const XrSwapchainImageD3D11KHR& image : swapchain.Images) {
+                sample::memory::ResourceTracker::Process().Track(image.texture, sample::memory::ResourceCategory::SwapchainImages, name);
+            }
 
             return swapchain;
         }
 
-        // Return true if an event is available, otherwise return false.
-        bool TryReadNextEvent(XrEventDataBuffer* buffer) const {
-            // Reset buffer header for every xrPollEvent function call.
-            *buffer = {XR_TYPE_EVENT_DATA_BUFFER};
-            const XrResult xr = CHECK_XRCMD(xrPollEvent(m_instance.Get(), buffer));
-            if (xr == XR_EVENT_UNAVAILABLE) {
-                return false;
-            } else {
-                return true;
-            }
-        }
-
         void ProcessEvents(bool* exitRenderLoop, bool* requestRestart) {
             *exitRenderLoop = *requestRestart = false;
 
@@ -449,7 +650,11 @@ namespace {
             XrEventDataBaseHeader* header = reinterpret_cast<XrEventDataBaseHeader*>(&buffer);
 
             // Process all pending messages.
-            while (TryReadNextEvent(&buffer)) {
+            while (m_eventPump->TryReadNextEvent(&buffer)) {
+                if (m_traceWriter) {
+                    m_traceWriter->RecordEvent(buffer);
+                }
+
                 switch (header->type) {
                 case XR_TYPE_EVENT_DATA_INSTANCE_LOSS_PENDING: {
                     *exitRenderLoop = true;
@@ -459,33 +664,37 @@ namespace {
                 case XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED: {
                     const auto stateEvent = *reinterpret_cast<const XrEventDataSessionStateChanged*>(header);
                     CHECK(m_session.Get() != XR_NULL_HANDLE && m_session.Get() == stateEvent.session);
-                    m_sessionState = stateEvent.state;
-                    switch (m_sessionState) {
-                    case XR_SESSION_STATE_READY: {
+                    switch (m_sessionStateMachine.OnStateChanged(stateEvent.state)) {
+                    case sample::session::SessionTransition::BeginSession: {
                         CHECK(m_session.Get() != XR_NULL_HANDLE);
                         XrSessionBeginInfo sessionBeginInfo{XR_TYPE_SESSION_BEGIN_INFO};
                         sessionBeginInfo.primaryViewConfigurationType = m_primaryViewConfigType;
-                        CHECK_XRCMD(xrBeginSession(m_session.Get(), &sessionBeginInfo));
-                        m_sessionRunning = true;
+                        CHECK_XRCMD(m_dispatch.xrBeginSession(m_session.Get(), &sessionBeginInfo));
+                        StartInputSampler();
                         break;
                     }
-                    case XR_SESSION_STATE_STOPPING: {
-                        m_sessionRunning = false;
-                        CHECK_XRCMD(xrEndSession(m_session.Get()))
+                    case sample::session::SessionTransition::EndSession: {
+                        m_inputSampler.reset();
+                        CHECK_XRCMD(m_dispatch.xrEndSession(m_session.Get()))
+                        LogCaptureMetrics();
+                        sample::memory::ResourceTracker::Process().LogSnapshot();
+
+                        // Nothing is rendered until the next READY, so let the driver release what it can meanwhile.
+                        m_graphicsPlugin->Trim();
                         break;
                     }
-                    case XR_SESSION_STATE_EXITING: {
-                        // Do not attempt to restart because user closed this session.
+                    case sample::session::SessionTransition::ExitRenderLoop: {
                         *exitRenderLoop = true;
                         *requestRestart = false;
                         break;
                     }
-                    case XR_SESSION_STATE_LOSS_PENDING: {
-                        // Poll for a new systemId
+                    case sample::session::SessionTransition::RestartSession: {
                         *exitRenderLoop = true;
                         *requestRestart = true;
                         break;
                     }
+                    case sample::session::SessionTransition::None:
+                        break;
                     }
                     break;
                 }
@@ -500,104 +709,126 @@ namespace {
         }
 
         struct Hologram;
-        Hologram CreateHologram(const XrPosef& poseInScene, XrTime placementTime) const {
+        Hologram CreateHologram(const XrPosef& poseInScene, XrTime placementTime) {
+            // Anchors provide the best stability when moving beyond 5 meters, so if the extension is enabled, the hologram
+            // is placed relative to an anchor shared with the holograms near it. Otherwise it stays in the scene space,
+            // which works fine as long as user doesn't move far away from scene space origin.
             Hologram hologram{};
-            if (m_optionalExtensions.SpatialAnchorSupported) {
-                // Anchors provide the best stability when moving beyond 5 meters, so if the extension is enabled,
-                // create an anchor at given location and place the hologram at the resulting anchor space.
-                XrSpatialAnchorCreateInfoMSFT createInfo{XR_TYPE_SPATIAL_ANCHOR_CREATE_INFO_MSFT};
-                createInfo.space = m_sceneSpace.Get();
-                createInfo.pose = poseInScene;
-                createInfo.time = placementTime;
-
-                XrResult r = xrCreateSpatialAnchorMSFT(m_session.Get(), &createInfo, hologram.Anchor.Put());
-                if (r == XR_ERROR_CREATE_SPATIAL_ANCHOR_FAILED_MSFT) {
-                    DEBUG_PRINT("Anchor cannot be created, likely due to lost positional tracking.");
-                } else if (XR_SUCCEEDED(r)) {
-                    XrSpatialAnchorSpaceCreateInfoMSFT createSpaceInfo{XR_TYPE_SPATIAL_ANCHOR_SPACE_CREATE_INFO_MSFT};
-                    createSpaceInfo.anchor = hologram.Anchor.Get();
-                    createSpaceInfo.poseInAnchorSpace = xr::math::Pose::Identity();
-                    CHECK_XRCMD(xrCreateSpatialAnchorSpaceMSFT(m_session.Get(), &createSpaceInfo, hologram.Cube.Space.Put()));
-                } else {
-                    CHECK_XRRESULT(r, "xrCreateSpatialAnchorMSFT");
-                }
-            } else {
-                // If the anchor extension is not available, place it in the scene space.
-                // This works fine as long as user doesn't move far away from scene space origin.
-                XrReferenceSpaceCreateInfo createInfo{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
-                createInfo.referenceSpaceType = m_sceneSpaceType;
-                createInfo.poseInReferenceSpace = poseInScene;
-                CHECK_XRCMD(xrCreateReferenceSpace(m_session.Get(), &createInfo, hologram.Cube.Space.Put()));
-            }
+            hologram.Attachment = m_anchorManager->Place(poseInScene, placementTime);
+            hologram.Cube.PoseInScene = poseInScene;
             return hologram;
         }
 
-        void PollActions() {
-            // Get updated action states.
-            std::vector<XrActiveActionSet> activeActionSets = {{m_actionSet.Get(), XR_NULL_PATH}};
-            XrActionsSyncInfo syncInfo{XR_TYPE_ACTIONS_SYNC_INFO};
-            syncInfo.countActiveActionSets = (uint32_t)activeActionSets.size();
-            syncInfo.activeActionSets = activeActionSets.data();
-            CHECK_XRCMD(xrSyncActions(m_session.Get(), &syncInfo));
-
-            // Check the state of the actions for left and right hands separately.
-            for (uint32_t side : {LeftSide, RightSide}) {
-                const XrPath subactionPath = m_subactionPaths[side];
-
-                // Apply a tiny vibration to the corresponding hand to indicate that action is detected.
-                auto ApplyVibration = [this, subactionPath] {
-                    XrHapticActionInfo actionInfo{XR_TYPE_HAPTIC_ACTION_INFO};
-                    actionInfo.action = m_vibrateAction.Get();
-                    actionInfo.subactionPath = subactionPath;
-
-                    XrHapticVibration vibration{XR_TYPE_HAPTIC_VIBRATION};
-                    vibration.amplitude = 0.5f;
-                    vibration.duration = XR_MIN_HAPTIC_DURATION;
-                    vibration.frequency = XR_FREQUENCY_UNSPECIFIED;
-                    CHECK_XRCMD(xrApplyHapticFeedback(m_session.Get(), &actionInfo, (XrHapticBaseHeader*)&vibration));
-                };
+        void StartInputSampler() {
+            // The input thread needs the current XrTime to locate hands between frames.
+            if (m_dispatch.xrConvertWin32PerformanceCounterToTimeKHR == nullptr) {
+                return;
+            }
 
-                XrActionStateBoolean placeActionValue{XR_TYPE_ACTION_STATE_BOOLEAN};
-                {
-                    XrActionStateGetInfo getInfo{XR_TYPE_ACTION_STATE_GET_INFO};
-                    getInfo.action = m_placeAction.Get();
-                    getInfo.subactionPath = subactionPath;
-                    CHECK_XRCMD(xrGetActionStateBoolean(m_session.Get(), &getInfo, &placeActionValue));
-                }
+            m_inputSampler = std::make_unique<sample::input::InputSampler>(
+                m_dispatch,
+                m_actionCache,
+                m_session.Get(),
+                m_sceneSpace.Get(),
+                std::array<XrSpace, 2>{m_cubesInHand[LeftSide].Space.Get(), m_cubesInHand[RightSide].Space.Get()},
+                [this] { return Now(); },
+                m_inputSamplerOptions);
+        }
+
+        // Only where the runtime converts performance counter time, see m_dispatch.xrConvertWin32PerformanceCounterToTimeKHR.
+        XrTime Now() const {
+            LARGE_INTEGER performanceCounter;
+            QueryPerformanceCounter(&performanceCounter);
+            XrTime time;
+            CHECK_XRCMD(m_dispatch.xrConvertWin32PerformanceCounterToTimeKHR(m_instance.Get(), &performanceCounter, &time));
+            return time;
+        }
 
-                // When select button is pressed, place the cube at the location of corresponding hand.
-                if (placeActionValue.isActive && placeActionValue.changedSinceLastSync && placeActionValue.currentState) {
-                    // Use the poses at the time when action happened to do the placement
-                    const XrTime placementTime = placeActionValue.lastChangeTime;
+        // A frame submitted after its predicted display time is shown at least a display period later for each period it
+        // is late. The GPU finishes later still, so this measures the lag the CPU side causes, a lower bound. The lag
+        // rises to the lateness at once, and drops a period at a time once LagDecayFrames frames in a row were less late.
+        void MeasureDisplayLag(const XrFrameState& frameState) {
+            if (m_dispatch.xrConvertWin32PerformanceCounterToTimeKHR == nullptr || frameState.predictedDisplayPeriod <= 0) {
+                return; // E.g. in a replay, whose display times were recorded
+            }
 
-                    // Locate the hand in the scene.
-                    XrSpaceLocation handLocation{XR_TYPE_SPACE_LOCATION};
-                    CHECK_XRCMD(xrLocateSpace(m_cubesInHand[side].Space.Get(), m_sceneSpace.Get(), placementTime, &handLocation));
+            const XrDuration late = Now() - frameState.predictedDisplayTime;
+            const XrDuration period = frameState.predictedDisplayPeriod;
+            const uint32_t periodsLate = late > 0 ? (uint32_t)std::min<XrDuration>((late + period - 1) / period, MaxDisplayLag) : 0;
+            if (periodsLate >= m_displayLag) {
+                m_displayLag = periodsLate;
+                m_framesSinceLag = 0;
+            } else if (++m_framesSinceLag >= LagDecayFrames) {
+                m_displayLag--;
+                m_framesSinceLag = 0;
+            }
+        }
 
-                    // Ensure we have tracking before placing a cube in the scene, so that it stays reliably at a physical location.
-                    if (!xr::math::Pose::IsPoseValid(handLocation)) {
-                        DEBUG_PRINT("Cube cannot be placed when positional tracking is lost.");
-                    } else {
-                        // Place a new cube at the given location and time, and remember output placement space and anchor.
-                        m_holograms.push_back(CreateHologram(handLocation.pose, placementTime));
-                    }
+        void PollActions() {
+            // Get updated action states. The cache calls OnPlaceAction and OnExitAction for states that changed.
+            if (m_inputSampler) {
+                // Actions are synced on the input thread, only dispatch what it sampled since last frame.
+                m_inputSampler->DispatchChanges();
+            } else {
+                m_actionCache.Sync(m_dispatch, m_session.Get());
+            }
+        }
+
+        // Apply a tiny vibration to the corresponding hand to indicate that action is detected.
+        void ApplyVibration(uint32_t side) {
+            XrHapticActionInfo actionInfo{XR_TYPE_HAPTIC_ACTION_INFO};
+            actionInfo.action = m_vibrateAction.Get();
+            actionInfo.subactionPath = m_subactionPaths[side];
+
+            XrHapticVibration vibration{XR_TYPE_HAPTIC_VIBRATION};
+            vibration.amplitude = 0.5f;
+            vibration.duration = XR_MIN_HAPTIC_DURATION;
+            vibration.frequency = XR_FREQUENCY_UNSPECIFIED;
+            CHECK_XRCMD(m_dispatch.xrApplyHapticFeedback(m_session.Get(), &actionInfo, (XrHapticBaseHeader*)&vibration));
+        }
 
-                    ApplyVibration();
+        void OnPlaceAction(uint32_t side, const XrActionStateBoolean& placeActionValue) {
+            // When select button is pressed, place the cube at the location of corresponding hand.
+            if (placeActionValue.isActive && placeActionValue.currentState) {
+                // Use the poses at the time when action happened to do the placement
+                const XrTime placementTime = placeActionValue.lastChangeTime;
+
+                // Locate the hand in the scene, preferring the input thread's snapshot taken closest to the action.
+                XrSpaceLocation handLocation{XR_TYPE_SPACE_LOCATION};
+                const std::optional<sample::input::InputSnapshot> snapshot =
+                    m_inputSampler ? m_inputSampler->FindClosest(placementTime) : std::nullopt;
+                const XrDuration snapshotTolerance = std::chrono::nanoseconds(m_inputSamplerOptions.Period).count();
+                if (snapshot && std::abs(snapshot->Time - placementTime) <= snapshotTolerance) {
+                    handLocation.locationFlags = snapshot->Hands[side].LocationFlags;
+                    handLocation.pose = snapshot->Hands[side].Pose;
+                } else {
+                    CHECK_XRCMD(m_dispatch.xrLocateSpace(
+                        m_cubesInHand[side].Space.Get(), m_sceneSpace.Get(), placementTime, &handLocation));
+                }
+                if (m_traceWriter) {
+                    m_traceWriter->RecordSpaceLocation(placementTime, m_cubesInHand[side].Space.Get(), handLocation);
                 }
 
-                // This sample, when menu button is released, requests to quit the session, and therefore quit the application.
-                {
-                    XrActionStateBoolean exitActionValue{XR_TYPE_ACTION_STATE_BOOLEAN};
-                    XrActionStateGetInfo getInfo{XR_TYPE_ACTION_STATE_GET_INFO};
-                    getInfo.action = m_exitAction.Get();
-                    getInfo.subactionPath = subactionPath;
-                    CHECK_XRCMD(xrGetActionStateBoolean(m_session.Get(), &getInfo, &exitActionValue));
-
-                    if (exitActionValue.isActive && exitActionValue.changedSinceLastSync && !exitActionValue.currentState) {
-                        CHECK_XRCMD(xrRequestExitSession(m_session.Get()));
-                        ApplyVibration();
-                    }
+                // Ensure we have tracking before placing a cube in the scene, so that it stays reliably at a physical location.
+                if (!xr::math::Pose::IsPoseValid(handLocation)) {
+                    DEBUG_PRINT("Cube cannot be placed when positional tracking is lost.");
+                } else {
+                    // Place a new cube at the given location and time, and remember output placement space and anchor.
+                    Hologram& hologram = m_holograms.emplace_back(CreateHologram(handLocation.pose, placementTime));
+                    hologram.Cube.LodChain = m_hologramLodChain;
+                    hologram.Persistent = true;
                 }
+
+                ApplyVibration(side);
+            }
+        }
+
+        void OnExitAction(uint32_t side, const XrActionStateBoolean& exitActionValue) {
+            // This sample, when menu button is released, requests to quit the session, and therefore quit the application.
+            if (exitActionValue.isActive && !exitActionValue.currentState) {
+                CHECK_XRCMD(m_dispatch.xrRequestExitSession(m_session.Get()));
+                m_eventPump->Wake(); // STOPPING follows shortly
+                ApplyVibration(side);
             }
         }
 
@@ -606,10 +837,20 @@ namespace {
 
             XrFrameWaitInfo frameWaitInfo{XR_TYPE_FRAME_WAIT_INFO};
             XrFrameState frameState{XR_TYPE_FRAME_STATE};
-            CHECK_XRCMD(xrWaitFrame(m_session.Get(), &frameWaitInfo, &frameState));
+            CHECK_XRCMD(m_dispatch.xrWaitFrame(m_session.Get(), &frameWaitInfo, &frameState));
+
+            // Extrapolate poses to when this frame is shown, a display period later for each frame rendering runs behind
+            // or recent frames were submitted late.
+            const uint32_t pipelineDepth = std::max(m_predictionOptions.PipelineDepth, m_displayLag);
+            m_predictionOptions.ExtraLatency = (XrDuration)pipelineDepth * frameState.predictedDisplayPeriod;
+
+            const auto frameStart = std::chrono::steady_clock::now();
+            if (m_traceWriter) {
+                m_traceWriter->RecordFrameState(frameState);
+            }
 
             XrFrameBeginInfo frameBeginInfo{XR_TYPE_FRAME_BEGIN_INFO};
-            CHECK_XRCMD(xrBeginFrame(m_session.Get(), &frameBeginInfo));
+            CHECK_XRCMD(m_dispatch.xrBeginFrame(m_session.Get(), &frameBeginInfo));
 
             // EndFrame can submit mutiple layers
             std::vector<XrCompositionLayerBaseHeader*> layers;
@@ -624,32 +865,8 @@ namespace {
 
             // Only render when session is visible. otherwise submit zero layers
             if (frameState.shouldRender) {
-                // First update the viewState and views using latest predicted display time.
-                {
-                    XrViewLocateInfo viewLocateInfo{XR_TYPE_VIEW_LOCATE_INFO};
-                    viewLocateInfo.viewConfigurationType = m_primaryViewConfigType;
-                    viewLocateInfo.displayTime = frameState.predictedDisplayTime;
-                    viewLocateInfo.space = m_sceneSpace.Get();
-
-                    // The output view count of xrLocateViews is always same as xrEnumerateViewConfigurationViews
-                    // Therefore Views can be preallocated and avoid two call idiom here.
-                    uint32_t viewCapacityInput = (uint32_t)m_renderResources->Views.size();
-                    uint32_t viewCountOutput;
-                    CHECK_XRCMD(xrLocateViews(m_session.Get(),
-                                              &viewLocateInfo,
-                                              &m_renderResources->ViewState,
-                                              viewCapacityInput,
-                                              &viewCountOutput,
-                                              m_renderResources->Views.data()));
-
-                    CHECK(viewCountOutput == viewCapacityInput);
-                    CHECK(viewCountOutput == m_renderResources->ConfigViews.size());
-                    CHECK(viewCountOutput == m_renderResources->ColorSwapchain.ArraySize);
-                    CHECK(viewCountOutput == m_renderResources->DepthSwapchain.ArraySize);
-                }
-
-                // Then render projection layer into each view.
-                if (RenderLayer(frameState.predictedDisplayTime, layer)) {
+                // Locate the views and render projection layer into each view, compiled for the session's view count.
+                if ((this->*m_renderLayer)(frameState.predictedDisplayTime, layer)) {
                     layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&layer));
                 }
             }
@@ -660,19 +877,18 @@ namespace {
             frameEndInfo.environmentBlendMode = m_environmentBlendMode;
             frameEndInfo.layerCount = (uint32_t)layers.size();
             frameEndInfo.layers = layers.data();
-            CHECK_XRCMD(xrEndFrame(m_session.Get(), &frameEndInfo));
-        }
-
-        uint32_t AquireAndWaitForSwapchainImage(XrSwapchain handle) {
-            uint32_t swapchainImageIndex;
-            XrSwapchainImageAcquireInfo acquireInfo{XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO};
-            CHECK_XRCMD(xrAcquireSwapchainImage(handle, &acquireInfo, &swapchainImageIndex));
-
-            XrSwapchainImageWaitInfo waitInfo{XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO};
-            waitInfo.timeout = XR_INFINITE_DURATION;
-            CHECK_XRCMD(xrWaitSwapchainImage(handle, &waitInfo));
-
-            return swapchainImageIndex;
+            CHECK_XRCMD(m_dispatch.xrEndFrame(m_session.Get(), &frameEndInfo));
+            MeasureDisplayLag(frameState);
+            m_eventPump->OnFrameEnded();
+
+            m_sessionStateMachine.OnFrameEnded();
+            const auto frameTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - frameStart);
+            while (const std::optional<sample::resolution::GpuTimer::Result> gpuFrame = m_gpuTimer->TryGetResult()) {
+                m_resolutionController->OnFrame(gpuFrame->Time, frameState.predictedDisplayPeriod, gpuFrame->Tag);
+            }
+            if (m_frameObserver) {
+                m_frameObserver(frameTime);
+            }
         }
 
         void UpdateSpinningCube(XrTime predictedDisplayTime) {
@@ -714,85 +930,76 @@ namespace {
             }
         }
 
+        template <uint32_t ViewCount>
         bool RenderLayer(XrTime predictedDisplayTime, XrCompositionLayerProjection& layer) {
-            const uint32_t viewCount = (uint32_t)m_renderResources->ConfigViews.size();
+            ViewResources<ViewCount>& resources = static_cast<ViewResources<ViewCount>&>(*m_renderResources);
+            sample::views::FrameViews<ViewCount>& frame = resources.Frame;
 
-            if (!xr::math::Pose::IsPoseValid(m_renderResources->ViewState)) {
-                DEBUG_PRINT("xrLocateViews returned an invalid pose.");
-                return false; // Skip rendering layers if view location is invalid
-            }
-
-            std::vector<const sample::Cube*> visibleCubes;
-
-            auto UpdateVisibleCube = [&](sample::Cube& cube) {
-                if (cube.Space.Get() != XR_NULL_HANDLE) {
-                    XrSpaceLocation cubeSpaceInScene{XR_TYPE_SPACE_LOCATION};
-                    CHECK_XRCMD(xrLocateSpace(cube.Space.Get(), m_sceneSpace.Get(), predictedDisplayTime, &cubeSpaceInScene));
-
-                    // Update cubes location with latest space relation
-                    if (xr::math::Pose::IsPoseValid(cubeSpaceInScene)) {
-                        if (cube.PoseInSpace.has_value()) {
-                            cube.PoseInScene = xr::math::Pose::Multiply(cube.PoseInSpace.value(), cubeSpaceInScene.pose);
-                        } else {
-                            cube.PoseInScene = cubeSpaceInScene.pose;
-                        }
-                        visibleCubes.push_back(&cube);
-                    }
+            // First update the viewState and views using latest predicted display time.
+            {
+                XrViewLocateInfo viewLocateInfo{XR_TYPE_VIEW_LOCATE_INFO};
+                viewLocateInfo.viewConfigurationType = m_primaryViewConfigType;
+                viewLocateInfo.displayTime = predictedDisplayTime;
+                viewLocateInfo.space = m_sceneSpace.Get();
+
+                // The output view count of xrLocateViews is always same as xrEnumerateViewConfigurationViews,
+                // which the views were sized for at compile time. Therefore no two call idiom here.
+                uint32_t viewCountOutput;
+                CHECK_XRCMD(m_dispatch.xrLocateViews(
+                    m_session.Get(), &viewLocateInfo, &resources.ViewState, ViewCount, &viewCountOutput, frame.Views.data()));
+                if (m_traceWriter) {
+                    m_traceWriter->RecordViews(predictedDisplayTime, resources.ViewState, frame.Views.data(), ViewCount);
                 }
-            };
-
-            UpdateSpinningCube(predictedDisplayTime);
-
-            UpdateVisibleCube(m_cubesInHand[LeftSide]);
-            UpdateVisibleCube(m_cubesInHand[RightSide]);
-
-            for (auto& hologram : m_holograms) {
-                UpdateVisibleCube(hologram.Cube);
             }
 
-            m_renderResources->ProjectionLayerViews.resize(viewCount);
-            if (m_optionalExtensions.DepthExtensionSupported) {
-                m_renderResources->DepthInfoViews.resize(viewCount);
+            if (!xr::math::Pose::IsPoseValid(resources.ViewState)) {
+                DEBUG_PRINT("xrLocateViews returned an invalid pose.");
+                return false; // Skip rendering layers if view location is invalid
             }
 
             // Swapchain is acquired, rendered to, and released together for all views as texture array
-            const SwapchainD3D11& colorSwapchain = m_renderResources->ColorSwapchain;
-            const SwapchainD3D11& depthSwapchain = m_renderResources->DepthSwapchain;
+            const SwapchainD3D11& colorSwapchain = resources.ColorSwapchain;
+            const SwapchainD3D11& depthSwapchain = resources.DepthSwapchain;
 
-            // Use the full range of recommended image size to achieve optimum resolution
-            const XrRect2Di imageRect = {{0, 0}, {(int32_t)colorSwapchain.Width, (int32_t)colorSwapchain.Height}};
+            // Render the top left part of the images, scaled to hold the frame budget
+            const XrRect2Di imageRect = {{0, 0}, m_resolutionController->Extent()};
             CHECK(colorSwapchain.Width == depthSwapchain.Width);
             CHECK(colorSwapchain.Height == depthSwapchain.Height);
 
-            const uint32_t colorSwapchainImageIndex = AquireAndWaitForSwapchainImage(colorSwapchain.Handle.Get());
-            const uint32_t depthSwapchainImageIndex = AquireAndWaitForSwapchainImage(depthSwapchain.Handle.Get());
+            // Both images are acquired before the scene update, whose CPU work overlaps the compositor still reading them.
+            const uint32_t colorSwapchainImageIndex = m_imageWaiter.Acquire(colorSwapchain.Handle.Get());
+            const uint32_t depthSwapchainImageIndex = m_imageWaiter.Acquire(depthSwapchain.Handle.Get());
+
+            UpdateScene(predictedDisplayTime, frame.Views.data(), ViewCount);
 
             // Prepare rendering parameters of each view for swapchain texture arrays
-            std::vector<xr::math::ViewProjection> viewProjections(viewCount);
-            for (uint32_t i = 0; i < viewCount; i++) {
-                viewProjections[i] = {m_renderResources->Views[i].pose, m_renderResources->Views[i].fov, m_nearFar};
+            sample::views::ForEachView<ViewCount>([&](uint32_t i) {
+                frame.ViewProjections[i] = {frame.Views[i].pose, frame.Views[i].fov, m_nearFar};
 
-                m_renderResources->ProjectionLayerViews[i] = {XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW};
-                m_renderResources->ProjectionLayerViews[i].pose = m_renderResources->Views[i].pose;
-                m_renderResources->ProjectionLayerViews[i].fov = m_renderResources->Views[i].fov;
-                m_renderResources->ProjectionLayerViews[i].subImage.swapchain = colorSwapchain.Handle.Get();
-                m_renderResources->ProjectionLayerViews[i].subImage.imageRect = imageRect;
-                m_renderResources->ProjectionLayerViews[i].subImage.imageArrayIndex = i;
+                frame.ProjectionLayerViews[i] = {XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW};
+                frame.ProjectionLayerViews[i].pose = frame.Views[i].pose;
+                frame.ProjectionLayerViews[i].fov = frame.Views[i].fov;
+                frame.ProjectionLayerViews[i].subImage.swapchain = colorSwapchain.Handle.Get();
+                frame.ProjectionLayerViews[i].subImage.imageRect = imageRect;
+                frame.ProjectionLayerViews[i].subImage.imageArrayIndex = i;
 
                 if (m_optionalExtensions.DepthExtensionSupported) {
-                    m_renderResources->DepthInfoViews[i] = {XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR};
-                    m_renderResources->DepthInfoViews[i].minDepth = 0;
-                    m_renderResources->DepthInfoViews[i].maxDepth = 1;
-                    m_renderResources->DepthInfoViews[i].nearZ = m_nearFar.Near;
-                    m_renderResources->DepthInfoViews[i].farZ = m_nearFar.Far;
-                    m_renderResources->DepthInfoViews[i].subImage.swapchain = depthSwapchain.Handle.Get();
-                    m_renderResources->DepthInfoViews[i].subImage.imageRect = imageRect;
-                    m_renderResources->DepthInfoViews[i].subImage.imageArrayIndex = i;
+                    frame.DepthInfoViews[i] = {XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR};
+                    frame.DepthInfoViews[i].minDepth = 0;
+                    frame.DepthInfoViews[i].maxDepth = 1;
+                    frame.DepthInfoViews[i].nearZ = m_nearFar.Near;
+                    frame.DepthInfoViews[i].farZ = m_nearFar.Far;
+                    frame.DepthInfoViews[i].subImage.swapchain = depthSwapchain.Handle.Get();
+                    frame.DepthInfoViews[i].subImage.imageRect = imageRect;
+                    frame.DepthInfoViews[i].subImage.imageArrayIndex = i;
 
                     // Chain depth info struct to the corresponding projection layer views's next
-                    m_renderResources->ProjectionLayerViews[i].next = &m_renderResources->DepthInfoViews[i];
+                    frame.ProjectionLayerViews[i].next = &frame.DepthInfoViews[i];
                 }
-            }
+            });
+
+            // Only the GPU work needs the images, so this is the last moment to wait for them.
+            m_imageWaiter.Wait();
 
             // For Hololens additive display, best to clear render target with transparent black color (0,0,0,0)
             //constexpr DirectX::XMVECTORF32 opaqueColor = {0.184313729f, 0.309803933f, 0.309803933f, 1.000000000f};
@@ -801,68 +1008,315 @@ namespace {
             const DirectX::XMVECTORF32 renderTargetClearColor = opaqueColor;
                 //(m_environmentBlendMode == XR_ENVIRONMENT_BLEND_MODE_OPAQUE) ? opaqueColor : transparent;
 
+            // Simulation and rendering share this thread for now, so this always picks up the snapshot published above.
+            m_sceneSnapshots.TryAcquireLatest();
+            m_gpuTimer->Begin(m_resolutionController->SizeChanges());
             m_graphicsPlugin->RenderView(imageRect,
                                          renderTargetClearColor,
-                                         viewProjections,
+                                         frame.ViewProjections.data(),
+                                         ViewCount,
                                          colorSwapchain.Format,
                                          colorSwapchain.Images[colorSwapchainImageIndex].texture,
                                          depthSwapchain.Format,
                                          depthSwapchain.Images[depthSwapchainImageIndex].texture,
-                                         visibleCubes);
+                                         m_sceneSnapshots.ReadBuffer());
+            m_gpuTimer->End();
+
+            if (m_frameCapture) {
+                m_frameCapture->Capture(colorSwapchain.Images[colorSwapchainImageIndex].texture,
+                                        imageRect,
+                                        predictedDisplayTime,
+                                        frame.Views.data(),
+                                        ViewCount);
+            }
 
             XrSwapchainImageReleaseInfo releaseInfo{XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO};
-            CHECK_XRCMD(xrReleaseSwapchainImage(colorSwapchain.Handle.Get(), &releaseInfo));
-            CHECK_XRCMD(xrReleaseSwapchainImage(depthSwapchain.Handle.Get(), &releaseInfo));
+            CHECK_XRCMD(m_dispatch.xrReleaseSwapchainImage(colorSwapchain.Handle.Get(), &releaseInfo));
+            CHECK_XRCMD(m_dispatch.xrReleaseSwapchainImage(depthSwapchain.Handle.Get(), &releaseInfo));
 
             layer.space = m_sceneSpace.Get();
-            layer.viewCount = (uint32_t)m_renderResources->ProjectionLayerViews.size();
-            layer.views = m_renderResources->ProjectionLayerViews.data();
+            layer.viewCount = ViewCount;
+            layer.views = frame.ProjectionLayerViews.data();
             return true;
         }
 
+        // Locates the cubes and holograms, and publishes the snapshot of those that may be seen from the views.
+        void UpdateScene(XrTime predictedDisplayTime, const XrView* views, uint32_t viewCount) {
+            // Restoring and animation may add holograms, so they run before anchors and holograms are located.
+            RestoreHolograms(predictedDisplayTime);
+            UpdateSpinningCube(predictedDisplayTime);
+
+            m_sceneUpdater.Add(&m_cubesInHand[LeftSide], &m_handVelocityFilters[LeftSide]);
+            m_sceneUpdater.Add(&m_cubesInHand[RightSide], &m_handVelocityFilters[RightSide]);
+            for (auto& hologram : m_holograms) {
+                m_sceneUpdater.Add(&hologram.Cube, nullptr, hologram.Attachment);
+            }
+
+            sample::scene::SceneSnapshot& snapshot = m_sceneSnapshots.WriteBuffer();
+            snapshot.FrameIndex = ++m_snapshotCount;
+            m_sceneUpdater.Update({m_sceneSpace.Get(), predictedDisplayTime, views, viewCount, m_nearFar, m_traceWriter.get()},
+                                  m_predictionOptions,
+                                  *m_anchorManager,
+                                  &snapshot);
+
+            const sample::lod::FrameStats& lodStats = m_lodSelector.Stats();
+            const sample::occlusion::FrameStats& occlusionStats = m_sceneUpdater.OcclusionStats();
+            const sample::anchors::FrameStats& anchorStats = m_anchorManager->Stats();
+            if (snapshot.FrameIndex % SceneReportFrames == 0) {
+                DEBUG_PRINT("LOD: %u holograms, %llu of %llu triangles, %u level changes",
+                            lodStats.Holograms,
+                            (unsigned long long)lodStats.SelectedTriangles,
+                            (unsigned long long)lodStats.FullDetailTriangles,
+                            lodStats.LevelChanges);
+                DEBUG_PRINT("Occlusion: %u of %u holograms culled, %u occluders",
+                            occlusionStats.Culled,
+                            occlusionStats.Tested,
+                            occlusionStats.Occluders);
+                DEBUG_PRINT("Prediction: %.1f ms past the predicted display time, measured lag %u periods, pipeline depth %u",
+                            m_predictionOptions.ExtraLatency / 1e6,
+                            m_displayLag,
+                            m_predictionOptions.PipelineDepth);
+                DEBUG_PRINT("Anchors: %u located instead of %u, %u clusters, %u pending, %u splits, %u merges",
+                            anchorStats.LocateCalls,
+                            anchorStats.UnclusteredLocateCalls,
+                            anchorStats.Clusters,
+                            anchorStats.PendingAnchors,
+                            anchorStats.Splits,
+                            anchorStats.Merges);
+                const sample::memory::Snapshot memory = sample::memory::ResourceTracker::Process().GetSnapshot();
+                DEBUG_PRINT("Graphics memory: %.1f MB live, %.1f MB peak of %.1f MB budget",
+                            memory.LiveBytes / 1048576.0,
+                            memory.PeakBytes / 1048576.0,
+                            memory.BudgetBytes / 1048576.0);
+                const sample::resolution::Stats& resolution = m_resolutionController->GetStats();
+                const XrExtent2Di extent = m_resolutionController->Extent();
+                DEBUG_PRINT("Resolution: %dx%d, %.0f%% of recommended, %llu of %llu frames over GPU budget, %u decreases, %u increases",
+                            extent.width,
+                            extent.height,
+                            m_resolutionController->Scale() * 100,
+                            (unsigned long long)resolution.FramesOverBudget,
+                            (unsigned long long)resolution.Frames,
+                            resolution.Decreases,
+                            resolution.Increases);
+                const sample::swapchain::WaitStats waits = m_imageWaiter.TakeStats();
+                DEBUG_PRINT("Swapchain wait: %llu of %llu images ready early, blocked %.2f ms per frame, %.2f ms max, polls %.2f ms",
+                            (unsigned long long)waits.ImagesReadyEarly,
+                            (unsigned long long)(waits.ImagesReadyEarly + waits.ImagesWaited),
+                            waits.Frames > 0 ? waits.BlockedTime.count() / 1000.0 / waits.Frames : 0.0,
+                            waits.MaxBlockedTime.count() / 1000.0,
+                            waits.PollTime.count() / 1000.0);
+            }
+            m_sceneSnapshots.Publish();
+        }
+
+        // Restores a batch of saved holograms per frame, so a large scene is interactive from the first frame. Each shows
+        // at its saved pose in the scene space until its anchor resolves.
+        void RestoreHolograms(XrTime predictedDisplayTime) {
+            if (m_anchorStore) {
+                m_resolvedAnchors.clear();
+                m_anchorStore->TakeResolved(&m_resolvedAnchors);
+                for (const sample::persistence::AnchorStore::ResolvedAnchor& resolved : m_resolvedAnchors) {
+                    m_anchorManager->ResolvePersisted(resolved.Id, resolved.Anchor);
+                }
+            }
+
+            if (!m_savedHolograms) {
+                return;
+            }
+
+            const uint32_t count = m_savedHolograms->Count();
+            const uint32_t batchEnd = std::min(count, m_restoredCount + RestoreBatchSize);
+            for (; m_restoredCount < batchEnd; m_restoredCount++) {
+                const sample::persistence::HologramRecord record = m_savedHolograms->Record(m_restoredCount);
+                Hologram& hologram = m_holograms.emplace_back();
+                bool requestAnchor = false;
+                hologram.Attachment = m_anchorManager->Restore(
+                    record.AnchorId, record.PoseInAnchor, record.PoseInScene, predictedDisplayTime, &requestAnchor);
+                if (requestAnchor) {
+                    m_anchorStore->RequestAnchor(record.AnchorId);
+                }
+                hologram.Cube.Scale = record.Scale;
+                hologram.Cube.PoseInScene = record.PoseInScene;
+                hologram.Cube.LodChain = m_hologramLodChain;
+                hologram.Persistent = true;
+            }
+
+            if (m_restoredCount == count) {
+                DEBUG_PRINT("Restored %u holograms", count);
+                m_savedHolograms.reset();
+            }
+        }
+
+        // Saves the placed holograms, including those not restored yet, and forgets anchors no saved hologram uses.
+        void SaveHolograms() {
+            if (m_hologramsPath.empty() || m_session.Get() == XR_NULL_HANDLE) {
+                return;
+            }
+
+            std::vector<sample::persistence::HologramRecord> records;
+            for (const Hologram& hologram : m_holograms) {
+                if (hologram.Persistent) {
+                    records.push_back({m_anchorManager->PersistedAnchorId(hologram.Attachment),
+                                       hologram.Cube.PoseInScene,
+                                       hologram.Cube.Scale,
+                                       m_anchorManager->PoseInAnchor(hologram.Attachment)});
+                }
+            }
+            if (m_savedHolograms) {
+                for (uint32_t i = m_restoredCount; i < m_savedHolograms->Count(); i++) {
+                    records.push_back(m_savedHolograms->Record(i));
+                }
+                m_savedHolograms.reset(); // The file cannot be replaced while it is mapped
+            }
+            sample::persistence::HologramFile::Write(m_hologramsPath, records);
+
+            if (m_anchorStore) {
+                std::unordered_set<uint64_t> anchorIds;
+                for (const sample::persistence::HologramRecord& record : records) {
+                    anchorIds.insert(record.AnchorId);
+                }
+                m_anchorStore->RemoveUnreferenced(anchorIds);
+
+                const sample::persistence::AnchorStore::Stats stats = m_anchorStore->GetStats();
+                DEBUG_PRINT("Saved %zu holograms. Anchors: %u persisted, %u resolved in at most %.2f ms, %u missing, %u removed",
+                            records.size(),
+                            stats.Persisted,
+                            stats.Resolved,
+                            stats.MaxResolveTime.count() / 1000.0,
+                            stats.Missing,
+                            stats.Removed);
+            } else {
+                DEBUG_PRINT("Saved %zu holograms", records.size());
+            }
+        }
+
         void PrepareSessionRestart() {
+            SaveHolograms();
+            m_inputSampler.reset();
+            m_sessionStateMachine = {};
             m_mainCubeIndex = m_spinningCubeIndex = {};
             m_holograms.clear();
+            m_anchorManager.reset();
+            m_anchorStore.reset();
+            m_handVelocityFilters = {};
+            m_actionCache.ResetStates();
+            m_frameCapture.reset();
+            m_gpuTimer.reset();
+
+            // Swapchains belong to the session and must be recreated with it. The device, shaders and buffers
+            // are owned by the graphics plugin and stay alive, so InitializeSession only redoes the session objects.
+            m_graphicsPlugin->ReleaseSwapchainViews();
             m_renderResources.reset();
+            m_resolutionController.reset();
             m_session.Reset();
             m_systemId = XR_NULL_SYSTEM_ID;
         }
 
-        constexpr bool IsSessionFocused() const {
-            return m_sessionState == XR_SESSION_STATE_FOCUSED;
+        void LogCaptureMetrics() const {
+            if (!m_frameCapture) {
+                return;
+            }
+
+            const sample::capture::CaptureMetrics metrics = m_frameCapture->Metrics();
+            auto LogStage = [](const char* name, const sample::capture::StageMetrics& stage) {
+                DEBUG_PRINT("Capture %s: %llu frames, %.2f ms average, %.2f ms max",
+                            name,
+                            (unsigned long long)stage.Count,
+                            stage.AverageMilliseconds,
+                            stage.MaxMilliseconds);
+            };
+            LogStage("readback", metrics.Readback);
+            LogStage("encode", metrics.Encode);
+            LogStage("send", metrics.Send);
+            LogStage("end to end", metrics.EndToEnd);
+            DEBUG_PRINT("Capture dropped %llu frames, compression ratio %.2f",
+                        (unsigned long long)metrics.DroppedFrames,
+                        metrics.EncodedBytes > 0 ? (double)metrics.RawBytes / metrics.EncodedBytes : 0.0);
+        }
+
+        bool IsSessionFocused() const {
+            return m_sessionStateMachine.IsFocused();
         }
 
         XrPath GetXrPath(const char* string) const {
-            return xr::StringToPath(m_instance.Get(), string);
+            XrPath path;
+            CHECK_XRCMD(m_dispatch.xrStringToPath(m_instance.Get(), string, &path));
+            return path;
         }
 
     private:
         constexpr static XrFormFactor m_formFactor{XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY};
-        constexpr static XrViewConfigurationType m_primaryViewConfigType{XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO};
-        constexpr static uint32_t m_stereoViewCount = 2; // PRIMARY_STEREO view configuration always has 2 views
+        XrViewConfigurationType m_primaryViewConfigType{XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO}; // Selected with the system
 
         const std::string m_applicationName;
         const std::unique_ptr<sample::IGraphicsPluginD3D11> m_graphicsPlugin;
 
+        std::unique_ptr<sample::replay::ReplayRuntime> m_replayRuntime; // Declared first, so it outlives all its handles
         xr::InstanceHandle m_instance;
+        sample::dispatch::DispatchTable m_dispatch; // Loaded with the instance, outlives every module holding it
+        sample::swapchain::ImageWaiter m_imageWaiter{m_dispatch, {}};
         xr::SessionHandle m_session;
         uint64_t m_systemId{XR_NULL_SYSTEM_ID};
 
+        // Declared after the session, so they are destroyed first. The manager persists its anchors in the store.
+        std::unique_ptr<sample::persistence::AnchorStore> m_anchorStore;
+        std::vector<sample::persistence::AnchorStore::ResolvedAnchor> m_resolvedAnchors;
+        sample::anchors::AnchorManager::Options m_anchorManagerOptions{};
+        std::unique_ptr<sample::anchors::AnchorManager> m_anchorManager;
+
+        sample::session::EventPump::Options m_eventPumpOptions{};
+        std::mutex m_eventPumpMutex; // Guards creation of m_eventPump against RequestExit on another thread
+        std::unique_ptr<sample::session::EventPump> m_eventPump;
+        std::atomic<bool> m_exitRequested{false};
+        FrameObserver m_frameObserver;
+
+        std::optional<sample::capture::FrameCapture::Options> m_frameCaptureOptions;
+        std::unique_ptr<sample::capture::FrameCapture> m_frameCapture;
+        std::unique_ptr<sample::trace::TraceWriter> m_traceWriter;
+
+        std::vector<std::wstring> m_hologramMeshPaths;
+        sample::lod::LodChainId m_hologramLodChain{sample::lod::NoLodChain};
+        sample::lod::LodSelector m_lodSelector{{}};
+        constexpr static uint64_t SceneReportFrames = 450; // Every 5 seconds at 90Hz
+
         struct {
             bool DepthExtensionSupported{false};
             bool UnboundedRefSpaceSupported{false};
             bool SpatialAnchorSupported{false};
+            bool SpatialAnchorPersistenceSupported{false};
+            bool PerformanceCounterTimeSupported{false};
+            bool QuadViewsSupported{false};
         } m_optionalExtensions;
 
         xr::SpaceHandle m_sceneSpace;
         XrReferenceSpaceType m_sceneSpaceType{};
 
         struct Hologram {
-            sample::Cube Cube;
-            xr::SpatialAnchorHandle Anchor;
+            sample::Cube Cube; // Its PoseInSpace is relative to the attachment's pose
+            sample::anchors::AttachmentId Attachment{sample::anchors::NoAttachment};
+            bool Persistent{false}; // Placed by the user, or restored, rather than created by the sample itself
         };
         std::vector<Hologram> m_holograms;
 
+        std::wstring m_hologramsPath;
+        std::unique_ptr<sample::persistence::HologramFile> m_savedHolograms; // Until all its holograms are restored
+        uint32_t m_restoredCount{0};
+        constexpr static uint32_t RestoreBatchSize = 256;
+
+        sample::scene::TripleBuffer<sample::scene::SceneSnapshot> m_sceneSnapshots;
+        uint64_t m_snapshotCount{0};
+
+        uint32_t m_displayLag{0}; // Display periods recent frames were submitted after their predicted display time
+        uint32_t m_framesSinceLag{0};
+        constexpr static uint32_t LagDecayFrames = 90;
+        constexpr static XrDuration MaxDisplayLag = 4; // Beyond this, prediction would do more harm than good
+
+        sample::scene::SceneUpdater m_sceneUpdater{
+            m_dispatch,
+            sample::jobs::JobSystem::Process(),
+            m_lodSelector,
+            {64, 256, [this](sample::mesh::MeshHandle mesh) { return m_graphicsPlugin->FindMeshInfo(mesh); }, [this] { m_imageWaiter.Poll(); }}};
+
         std::optional<uint32_t> m_mainCubeIndex;
         std::optional<uint32_t> m_spinningCubeIndex;
         XrTime m_spinningCubeStartTime;
@@ -871,12 +1325,17 @@ namespace {
         constexpr static uint32_t RightSide = 1;
         std::array<XrPath, 2> m_subactionPaths{};
         std::array<sample::Cube, 2> m_cubesInHand{};
+        std::array<sample::prediction::VelocityFilter, 2> m_handVelocityFilters{};
+        sample::prediction::PredictionOptions m_predictionOptions{};
 
         xr::ActionSetHandle m_actionSet;
         xr::ActionHandle m_placeAction;
         xr::ActionHandle m_exitAction;
         xr::ActionHandle m_poseAction;
         xr::ActionHandle m_vibrateAction;
+        sample::input::ActionCache m_actionCache;
+        sample::input::InputSampler::Options m_inputSamplerOptions{};
+        std::unique_ptr<sample::input::InputSampler> m_inputSampler;
 
         XrEnvironmentBlendMode m_environmentBlendMode{};
         xr::math::NearFar m_nearFar{};
@@ -891,19 +1350,27 @@ namespace {
         };
 
         struct RenderResources {
+            virtual ~RenderResources() = default;
+
+            uint32_t ViewCount{0};
+            XrViewConfigurationView RecommendedView{XR_TYPE_VIEW_CONFIGURATION_VIEW}; // Largest recommended and maximum sizes of any view
             XrViewState ViewState{XR_TYPE_VIEW_STATE};
-            std::vector<XrView> Views;
-            std::vector<XrViewConfigurationView> ConfigViews;
             SwapchainD3D11 ColorSwapchain;
             SwapchainD3D11 DepthSwapchain;
-            std::vector<XrCompositionLayerProjectionView> ProjectionLayerViews;
-            std::vector<XrCompositionLayerDepthInfoKHR> DepthInfoViews;
+        };
+
+        template <uint32_t Count>
+        struct ViewResources : RenderResources {
+            sample::views::FrameViews<Count> Frame;
         };
 
         std::unique_ptr<RenderResources> m_renderResources{};
+        sample::resolution::ResolutionController::Options m_resolutionOptions{};
+        std::unique_ptr<sample::resolution::ResolutionController> m_resolutionController; // Created with the swapchains
+        std::unique_ptr<sample::resolution::GpuTimer> m_gpuTimer; // Times RenderView for the resolution controller
+        bool (ImplementOpenXrProgram::*m_renderLayer)(XrTime, XrCompositionLayerProjection&){nullptr}; // RenderLayer<ViewCount>
 
-        bool m_sessionRunning{false};
-        XrSessionState m_sessionState{XR_SESSION_STATE_UNKNOWN};
+        sample::session::SessionStateMachine m_sessionStateMachine;
     };
 } // namespace
 
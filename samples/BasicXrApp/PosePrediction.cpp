@@ -0,0 +1,125 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "PosePrediction.h"
+
+namespace {
+    XrVector3f Lerp(const XrVector3f& a, const XrVector3f& b, float t) {
+        return {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t};
+    }
+
+    // Hamilton product, the result applies b first and then a.
+    XrQuaternionf Multiply(const XrQuaternionf& a, const XrQuaternionf& b) {
+        return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+                a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+    }
+
+    XrQuaternionf Normalize(const XrQuaternionf& q) {
+        const float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        if (length <= 0.f) {
+            return {0, 0, 0, 1};
+        }
+        return {q.x / length, q.y / length, q.z / length, q.w / length};
+    }
+
+    float ToSeconds(XrDuration nanoSeconds) {
+        using namespace std::chrono;
+        return duration_cast<duration<float>>(duration<XrDuration, std::nano>(nanoSeconds)).count();
+    }
+} // namespace
+
+namespace sample::prediction {
+    void VelocityFilter::Update(const XrSpaceVelocity& velocity, float smoothing) {
+        if (velocity.velocityFlags & XR_SPACE_VELOCITY_LINEAR_VALID_BIT) {
+            LinearVelocity = LinearValid ? Lerp(LinearVelocity, velocity.linearVelocity, smoothing) : velocity.linearVelocity;
+            LinearValid = true;
+        } else {
+            LinearValid = false;
+        }
+
+        if (velocity.velocityFlags & XR_SPACE_VELOCITY_ANGULAR_VALID_BIT) {
+            AngularVelocity = AngularValid ? Lerp(AngularVelocity, velocity.angularVelocity, smoothing) : velocity.angularVelocity;
+            AngularValid = true;
+        } else {
+            AngularValid = false;
+        }
+    }
+
+    void VelocityFilter::Reset() {
+        *this = {};
+    }
+
+    XrPosef Extrapolate(const XrPosef& pose, const VelocityFilter& velocity, XrDuration duration) {
+        const float seconds = ToSeconds(duration);
+        XrPosef result = pose;
+
+        if (velocity.LinearValid) {
+            result.position.x += velocity.LinearVelocity.x * seconds;
+            result.position.y += velocity.LinearVelocity.y * seconds;
+            result.position.z += velocity.LinearVelocity.z * seconds;
+        }
+
+        if (velocity.AngularValid) {
+            const XrVector3f& w = velocity.AngularVelocity;
+            const float speed = std::sqrt(w.x * w.x + w.y * w.y + w.z * w.z);
+            if (speed > 1e-6f) {
+                // Angular velocity is an axis scaled by radians per second in the base space,
+                // so the incremental rotation is applied on the left of the current orientation.
+                const float halfAngle = 0.5f * speed * seconds;
+                const float s = std::sin(halfAngle) / speed;
+                const XrQuaternionf delta{w.x * s, w.y * s, w.z * s, std::cos(halfAngle)};
+                result.orientation = Normalize(Multiply(delta, pose.orientation));
+            }
+        }
+
+        return result;
+    }
+
+    XrSpaceLocationFlags LocateAndPredict(const dispatch::DispatchTable& dispatch,
+                                          XrSpace space,
+                                          XrSpace baseSpace,
+                                          XrTime locateTime,
+                                          XrTime displayTime,
+                                          const PredictionOptions& options,
+                                          VelocityFilter& filter,
+                                          XrSpaceLocation* location,
+                                          XrSpaceVelocity* velocity,
+                                          XrPosef* predictedPose) {
+        *velocity = {XR_TYPE_SPACE_VELOCITY};
+        *location = {XR_TYPE_SPACE_LOCATION};
+        location->next = velocity;
+        const XrResult result = dispatch.xrLocateSpace(space, baseSpace, locateTime, location);
+        location->next = nullptr;
+        CHECK_XRRESULT(result, "xrLocateSpace");
+
+        const XrSpaceLocationFlags poseValid = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT;
+        if ((location->locationFlags & poseValid) != poseValid) {
+            // Stale velocities must not leak into the first frame after tracking is regained.
+            filter.Reset();
+            *predictedPose = location->pose;
+            return location->locationFlags;
+        }
+
+        filter.Update(*velocity, options.VelocitySmoothing);
+
+        const XrDuration extrapolation = std::clamp<XrDuration>(displayTime - locateTime, 0, options.MaxExtrapolation);
+        *predictedPose = extrapolation > 0 ? Extrapolate(location->pose, filter, extrapolation) : location->pose;
+        return location->locationFlags;
+    }
+} // namespace sample::prediction
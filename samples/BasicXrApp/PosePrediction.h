@@ -0,0 +1,69 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include "XrDispatch.h"
+
+namespace sample::prediction {
+
+    struct PredictionOptions {
+        // Frames rendering runs behind simulation, e.g. with the scene updated on another thread. Each one shows the
+        // frame a display period later than the runtime predicted. The frame loop raises it to the lag it measures.
+        uint32_t PipelineDepth{0};
+
+        // Time between the runtime's predictedDisplayTime and when the frame is actually shown.
+        // Derived by the frame loop every frame from the pipeline depth, the measured lag and the display period.
+        XrDuration ExtraLatency{0};
+
+        // Never extrapolate further than this, a wrong velocity quickly becomes worse than no prediction.
+        XrDuration MaxExtrapolation{50'000'000}; // 50ms
+
+        // Exponential smoothing weight given to the newest velocity sample. 1 disables filtering.
+        float VelocitySmoothing{0.5f};
+
+        // Holograms placed within this window are still predicted, since their anchor may still be settling.
+        XrDuration RecentPlacementWindow{500'000'000}; // 500ms
+    };
+
+    // Filtered linear and angular velocity of one space, kept across frames.
+    struct VelocityFilter {
+        XrVector3f LinearVelocity{0, 0, 0};
+        XrVector3f AngularVelocity{0, 0, 0};
+        bool LinearValid{false};
+        bool AngularValid{false};
+
+        void Update(const XrSpaceVelocity& velocity, float smoothing);
+        void Reset();
+    };
+
+    // Extrapolate the pose by the given duration. Velocities are expressed in the same base space as the pose.
+    XrPosef Extrapolate(const XrPosef& pose, const VelocityFilter& velocity, XrDuration duration);
+
+    // Locate space in baseSpace at locateTime together with its velocity, then extrapolate the result to displayTime.
+    // location and velocity receive what the runtime reported, e.g. to record in a trace, without a next chain.
+    // Returns the raw location flags so callers can apply the usual validity checks.
+    XrSpaceLocationFlags LocateAndPredict(const dispatch::DispatchTable& dispatch,
+                                          XrSpace space,
+                                          XrSpace baseSpace,
+                                          XrTime locateTime,
+                                          XrTime displayTime,
+                                          const PredictionOptions& options,
+                                          VelocityFilter& filter,
+                                          XrSpaceLocation* location,
+                                          XrSpaceVelocity* velocity,
+                                          XrPosef* predictedPose);
+
+} // namespace sample::prediction
@@ -0,0 +1,796 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "ReplayRuntime.h"
+
+namespace {
+    using sample::input::ActionChange;
+
+    constexpr XrSystemId ReplaySystemId = 1;
+    constexpr XrSpaceLocationFlags TrackedLocationFlags =
+        XR_SPACE_LOCATION_ORIENTATION_VALID_BIT | XR_SPACE_LOCATION_POSITION_VALID_BIT |
+        XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT | XR_SPACE_LOCATION_POSITION_TRACKED_BIT;
+
+    template <typename Handle, typename Object>
+    Handle ToHandle(Object* object) {
+        return (Handle)(uintptr_t)object;
+    }
+
+    template <typename Object, typename Handle>
+    Object* FromHandle(Handle handle) {
+        return (Object*)(uintptr_t)handle;
+    }
+
+    template <typename Object>
+    void Erase(std::list<Object>& objects, const Object* object) {
+        objects.remove_if([object](const Object& candidate) { return &candidate == object; });
+    }
+
+    // The two call idiom of the xrEnumerate functions.
+    template <typename T>
+    XrResult Enumerate(const std::vector<T>& values, uint32_t capacity, uint32_t* count, T* output) {
+        *count = (uint32_t)values.size();
+        if (capacity == 0) {
+            return XR_SUCCESS;
+        }
+        if (capacity < values.size()) {
+            return XR_ERROR_SIZE_INSUFFICIENT;
+        }
+        std::copy(values.begin(), values.end(), output);
+        return XR_SUCCESS;
+    }
+
+    // State of a slot before the trace changed it.
+    ActionChange InactiveState(ActionChange::ActionKind kind, uint32_t index) {
+        ActionChange state{};
+        state.Kind = kind;
+        state.Index = index;
+        switch (kind) {
+        case ActionChange::ActionKind::Boolean:
+            state.Boolean = {XR_TYPE_ACTION_STATE_BOOLEAN};
+            break;
+        case ActionChange::ActionKind::Float:
+            state.Float = {XR_TYPE_ACTION_STATE_FLOAT};
+            break;
+        case ActionChange::ActionKind::Vector2f:
+            state.Vector2f = {XR_TYPE_ACTION_STATE_VECTOR2F};
+            break;
+        case ActionChange::ActionKind::Pose:
+            state.Pose = {XR_TYPE_ACTION_STATE_POSE};
+            break;
+        }
+        return state;
+    }
+} // namespace
+
+namespace sample::replay {
+    ReplayRuntime::ReplayRuntime(const std::wstring& path, Options options)
+        : m_options(options)
+        , m_reader(path) {
+        // The view configuration is reported before the first frame, so it is taken from the first recorded views.
+        trace::TraceReader scan(path);
+        trace::Record record;
+        while (scan.Next(&record)) {
+            if (record.Kind == trace::RecordKind::Views) {
+                m_viewCount = (uint32_t)record.Views.size();
+                break;
+            }
+        }
+        switch (m_viewCount) {
+        case 1:
+            m_viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_MONO;
+            break;
+        case 2:
+            m_viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+            break;
+        case 4:
+            m_viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_QUAD_VARJO;
+            break;
+        default:
+            THROW("The trace has views of an unknown view configuration");
+        }
+        m_views.resize(m_viewCount, {XR_TYPE_VIEW});
+
+        // Events recorded before the first frame, e.g. READY, are queued for the session.
+        ReadUntilNextFrame();
+    }
+
+    XrResult ReplayRuntime::EnumerateInstanceExtensionProperties(uint32_t capacity,
+                                                                 uint32_t* count,
+                                                                 XrExtensionProperties* properties) const {
+        std::vector<XrExtensionProperties> extensions;
+        auto AddExtension = [&](const char* name, uint32_t version) {
+            XrExtensionProperties& extension = extensions.emplace_back(XrExtensionProperties{XR_TYPE_EXTENSION_PROPERTIES});
+            std::snprintf(extension.extensionName, sizeof(extension.extensionName), "%s", name);
+            extension.extensionVersion = version;
+        };
+#ifdef XR_USE_GRAPHICS_API_D3D11
+        AddExtension(XR_KHR_D3D11_ENABLE_EXTENSION_NAME, XR_KHR_D3D11_enable_SPEC_VERSION);
+#endif
+        if (m_viewConfigurationType == XR_VIEW_CONFIGURATION_TYPE_PRIMARY_QUAD_VARJO) {
+            AddExtension(XR_VARJO_QUAD_VIEWS_EXTENSION_NAME, XR_VARJO_quad_views_SPEC_VERSION);
+        }
+        return Enumerate(extensions, capacity, count, properties);
+    }
+
+    XrResult ReplayRuntime::CreateInstance(const XrInstanceCreateInfo* createInfo, XrInstance* instance) {
+        std::lock_guard lock(m_mutex);
+        if (m_instanceCreated) {
+            return XR_ERROR_LIMIT_REACHED;
+        }
+        (void)createInfo;
+        m_instanceCreated = true;
+        *instance = ToHandle<XrInstance>(this);
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::DestroyInstance(XrInstance instance) {
+        ReplayRuntime& runtime = *FromHandle<ReplayRuntime>(instance);
+        std::lock_guard lock(runtime.m_mutex);
+        runtime.m_instanceCreated = false;
+        return XR_SUCCESS;
+    }
+
+    void ReplayRuntime::Load(dispatch::DispatchTable* dispatch) {
+        *dispatch = {};
+#define SAMPLE_REPLAY_LOAD_FUNCTION(name) dispatch->name = &ReplayRuntime::name;
+        SAMPLE_XR_CORE_FUNCTIONS(SAMPLE_REPLAY_LOAD_FUNCTION)
+        SAMPLE_XR_D3D11_FUNCTIONS(SAMPLE_REPLAY_LOAD_FUNCTION)
+#undef SAMPLE_REPLAY_LOAD_FUNCTION
+    }
+
+    uint64_t ReplayRuntime::Frames() const {
+        std::lock_guard lock(m_mutex);
+        return m_frames;
+    }
+
+    void ReplayRuntime::ReadUntilNextFrame() {
+        m_nextFrame.reset();
+
+        trace::Record record;
+        while (m_reader.Next(&record)) {
+            switch (record.Kind) {
+            case trace::RecordKind::FrameState:
+                m_nextFrame = std::move(record);
+                return;
+            case trace::RecordKind::Views:
+                m_viewState = record.ViewState;
+                m_views = record.Views;
+                break;
+            case trace::RecordKind::SpaceLocation: {
+                if (record.SpaceId >= m_spaceLocations.size()) {
+                    m_spaceLocations.resize(record.SpaceId + 1);
+                }
+                std::deque<SpaceLocation>& locations = m_spaceLocations[record.SpaceId];
+                locations.push_back({record.Time, record.SpaceLocation, record.SpaceVelocity});
+                if (locations.size() > SpaceLocationHistory) {
+                    locations.pop_front();
+                }
+                break;
+            }
+            case trace::RecordKind::ActionChange:
+                m_pendingChanges.push_back(record.ActionChange);
+                break;
+            case trace::RecordKind::Event: {
+                if (record.Event.type == XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED) {
+                    if (m_stopped) {
+                        break;
+                    }
+                    const auto& stateChanged = reinterpret_cast<const XrEventDataSessionStateChanged&>(record.Event);
+                    m_exitingRecorded |= stateChanged.state == XR_SESSION_STATE_EXITING;
+                }
+                m_events.push_back(record.Event);
+                break;
+            }
+            }
+        }
+    }
+
+    void ReplayRuntime::QueueSessionState(XrSessionState state) {
+        XrEventDataBuffer buffer{XR_TYPE_EVENT_DATA_BUFFER};
+        auto& stateChanged = reinterpret_cast<XrEventDataSessionStateChanged&>(buffer);
+        stateChanged = {XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED};
+        stateChanged.state = state;
+        stateChanged.time = m_frameState.predictedDisplayTime;
+        m_events.push_back(buffer);
+    }
+
+    void ReplayRuntime::StopSession() {
+        if (m_stopped) {
+            return;
+        }
+        m_stopped = true;
+
+        // Recorded state changes still queued would contradict the synthesized ones.
+        m_events.erase(std::remove_if(m_events.begin(),
+                                      m_events.end(),
+                                      [](const XrEventDataBuffer& event) { return event.type == XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED; }),
+                       m_events.end());
+        QueueSessionState(XR_SESSION_STATE_STOPPING);
+    }
+
+    ActionChange& ReplayRuntime::Slot(ActionChange::ActionKind kind, const XrActionStateGetInfo& getInfo) {
+        // The app reads its slots in registration order, which numbered them in the trace too.
+        auto& indices = m_slotIndices[(size_t)kind];
+        const auto [it, added] = indices.emplace(std::make_pair(getInfo.action, getInfo.subactionPath), (uint32_t)indices.size());
+        return SlotAt(kind, it->second);
+    }
+
+    ActionChange& ReplayRuntime::SlotAt(ActionChange::ActionKind kind, uint32_t index) {
+        std::vector<ActionChange>& slots = m_slots[(size_t)kind];
+        while (slots.size() <= index) {
+            slots.push_back(InactiveState(kind, (uint32_t)slots.size()));
+        }
+        return slots[index];
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrPollEvent(XrInstance instance, XrEventDataBuffer* eventData) {
+        ReplayRuntime& runtime = *FromHandle<ReplayRuntime>(instance);
+        std::lock_guard lock(runtime.m_mutex);
+
+        // Recorded events refer to a session, so they wait for one to exist.
+        if (runtime.m_session == nullptr || runtime.m_events.empty()) {
+            return XR_EVENT_UNAVAILABLE;
+        }
+        *eventData = runtime.m_events.front();
+        runtime.m_events.pop_front();
+
+        const XrSession session = ToHandle<XrSession>(runtime.m_session);
+        switch (eventData->type) {
+        case XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED:
+            reinterpret_cast<XrEventDataSessionStateChanged*>(eventData)->session = session;
+            break;
+        case XR_TYPE_EVENT_DATA_REFERENCE_SPACE_CHANGE_PENDING:
+            reinterpret_cast<XrEventDataReferenceSpaceChangePending*>(eventData)->session = session;
+            break;
+        case XR_TYPE_EVENT_DATA_INTERACTION_PROFILE_CHANGED:
+            reinterpret_cast<XrEventDataInteractionProfileChanged*>(eventData)->session = session;
+            break;
+        default:
+            break;
+        }
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrStringToPath(XrInstance instance, const char* pathString, XrPath* path) {
+        ReplayRuntime& runtime = *FromHandle<ReplayRuntime>(instance);
+        std::lock_guard lock(runtime.m_mutex);
+        auto it = std::find(runtime.m_paths.begin(), runtime.m_paths.end(), pathString);
+        if (it == runtime.m_paths.end()) {
+            it = runtime.m_paths.insert(it, pathString);
+        }
+        *path = (XrPath)(it - runtime.m_paths.begin()) + 1;
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrGetSystem(XrInstance, const XrSystemGetInfo* getInfo, XrSystemId* systemId) {
+        if (getInfo->formFactor != XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY) {
+            return XR_ERROR_FORM_FACTOR_UNSUPPORTED;
+        }
+        *systemId = ReplaySystemId;
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrGetSystemProperties(XrInstance instance, XrSystemId systemId, XrSystemProperties* properties) {
+        const ReplayRuntime& runtime = *FromHandle<ReplayRuntime>(instance);
+        if (systemId != ReplaySystemId) {
+            return XR_ERROR_SYSTEM_INVALID;
+        }
+        properties->systemId = systemId;
+        properties->vendorId = 0;
+        std::snprintf(properties->systemName, sizeof(properties->systemName), "Trace replay");
+        properties->graphicsProperties.maxSwapchainImageWidth = runtime.m_options.MaxImageRect.width;
+        properties->graphicsProperties.maxSwapchainImageHeight = runtime.m_options.MaxImageRect.height;
+        properties->graphicsProperties.maxLayerCount = XR_MIN_COMPOSITION_LAYERS_SUPPORTED;
+        properties->trackingProperties.orientationTracking = XR_TRUE;
+        properties->trackingProperties.positionTracking = XR_TRUE;
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrEnumerateEnvironmentBlendModes(XrInstance,
+                                                                       XrSystemId,
+                                                                       XrViewConfigurationType,
+                                                                       uint32_t capacity,
+                                                                       uint32_t* count,
+                                                                       XrEnvironmentBlendMode* modes) {
+        return Enumerate<XrEnvironmentBlendMode>({XR_ENVIRONMENT_BLEND_MODE_OPAQUE}, capacity, count, modes);
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrEnumerateViewConfigurations(
+        XrInstance instance, XrSystemId, uint32_t capacity, uint32_t* count, XrViewConfigurationType* types) {
+        const ReplayRuntime& runtime = *FromHandle<ReplayRuntime>(instance);
+        return Enumerate<XrViewConfigurationType>({runtime.m_viewConfigurationType}, capacity, count, types);
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrEnumerateViewConfigurationViews(XrInstance instance,
+                                                                        XrSystemId,
+                                                                        XrViewConfigurationType type,
+                                                                        uint32_t capacity,
+                                                                        uint32_t* count,
+                                                                        XrViewConfigurationView* views) {
+        const ReplayRuntime& runtime = *FromHandle<ReplayRuntime>(instance);
+        if (type != runtime.m_viewConfigurationType) {
+            return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED;
+        }
+        *count = runtime.m_viewCount;
+        if (capacity == 0) {
+            return XR_SUCCESS;
+        }
+        if (capacity < runtime.m_viewCount) {
+            return XR_ERROR_SIZE_INSUFFICIENT;
+        }
+        for (uint32_t i = 0; i < runtime.m_viewCount; i++) {
+            views[i].recommendedImageRectWidth = runtime.m_options.RecommendedImageRect.width;
+            views[i].recommendedImageRectHeight = runtime.m_options.RecommendedImageRect.height;
+            views[i].maxImageRectWidth = runtime.m_options.MaxImageRect.width;
+            views[i].maxImageRectHeight = runtime.m_options.MaxImageRect.height;
+            views[i].recommendedSwapchainSampleCount = 1;
+            views[i].maxSwapchainSampleCount = 1;
+        }
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrCreateSession(XrInstance instance, const XrSessionCreateInfo* createInfo, XrSession* session) {
+        ReplayRuntime& runtime = *FromHandle<ReplayRuntime>(instance);
+        std::lock_guard lock(runtime.m_mutex);
+        if (createInfo->systemId != ReplaySystemId) {
+            return XR_ERROR_SYSTEM_INVALID;
+        }
+        if (runtime.m_session != nullptr) {
+            return XR_ERROR_LIMIT_REACHED;
+        }
+
+        Session created{&runtime};
+#ifdef XR_USE_GRAPHICS_API_D3D11
+        for (auto next = reinterpret_cast<const XrBaseInStructure*>(createInfo->next); next != nullptr; next = next->next) {
+            if (next->type == XR_TYPE_GRAPHICS_BINDING_D3D11_KHR) {
+                created.Device.copy_from(reinterpret_cast<const XrGraphicsBindingD3D11KHR*>(next)->device);
+            }
+        }
+        if (created.Device == nullptr) {
+            return XR_ERROR_GRAPHICS_DEVICE_INVALID;
+        }
+#endif
+
+        // A restarted session replays the rest of the trace.
+        runtime.m_session = &runtime.m_sessions.emplace_back(std::move(created));
+        runtime.m_stopped = false;
+        runtime.m_exitingRecorded = false;
+        *session = ToHandle<XrSession>(runtime.m_session);
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrDestroySession(XrSession session) {
+        Session* destroyed = FromHandle<Session>(session);
+        ReplayRuntime& runtime = *destroyed->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        if (runtime.m_session == destroyed) {
+            runtime.m_session = nullptr;
+        }
+        Erase(runtime.m_sessions, destroyed);
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrBeginSession(XrSession session, const XrSessionBeginInfo*) {
+        Session& begun = *FromHandle<Session>(session);
+        std::lock_guard lock(begun.Runtime->m_mutex);
+        begun.Running = true;
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrEndSession(XrSession session) {
+        Session& ended = *FromHandle<Session>(session);
+        ReplayRuntime& runtime = *ended.Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        ended.Running = false;
+
+        // Once the replay stopped the session it also ends it, as it does when the trace ends before its EXITING.
+        if (runtime.m_stopped || (!runtime.m_nextFrame && !runtime.m_exitingRecorded)) {
+            runtime.m_stopped = true;
+            runtime.QueueSessionState(XR_SESSION_STATE_IDLE);
+            runtime.QueueSessionState(XR_SESSION_STATE_EXITING);
+        }
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrRequestExitSession(XrSession session) {
+        Session& exiting = *FromHandle<Session>(session);
+        std::lock_guard lock(exiting.Runtime->m_mutex);
+        if (!exiting.Running) {
+            return XR_ERROR_SESSION_NOT_RUNNING;
+        }
+        exiting.Runtime->StopSession();
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrCreateReferenceSpace(XrSession session, const XrReferenceSpaceCreateInfo*, XrSpace* space) {
+        ReplayRuntime& runtime = *FromHandle<Session>(session)->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        *space = ToHandle<XrSpace>(&runtime.m_spaces.emplace_back(Space{&runtime}));
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrCreateActionSpace(XrSession session, const XrActionSpaceCreateInfo*, XrSpace* space) {
+        Session& owner = *FromHandle<Session>(session);
+        ReplayRuntime& runtime = *owner.Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        *space = ToHandle<XrSpace>(&runtime.m_spaces.emplace_back(Space{&runtime, owner.ActionSpaceCount++}));
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrLocateSpace(XrSpace space, XrSpace baseSpace, XrTime time, XrSpaceLocation* location) {
+        const Space& located = *FromHandle<Space>(space);
+        const Space& base = *FromHandle<Space>(baseSpace);
+        ReplayRuntime& runtime = *located.Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+
+        location->locationFlags = 0;
+        location->pose = xr::math::Pose::Identity();
+        XrSpaceVelocity* velocity = nullptr;
+        for (auto next = reinterpret_cast<XrBaseOutStructure*>(location->next); next != nullptr; next = next->next) {
+            if (next->type == XR_TYPE_SPACE_VELOCITY) {
+                velocity = reinterpret_cast<XrSpaceVelocity*>(next);
+                velocity->velocityFlags = 0;
+            }
+        }
+
+        // Locations are recorded relative to the scene space, the only one the app locates spaces in.
+        if (!located.TraceId && !base.TraceId) {
+            location->locationFlags = TrackedLocationFlags;
+            return XR_SUCCESS;
+        }
+        if (!located.TraceId || base.TraceId || *located.TraceId >= runtime.m_spaceLocations.size() ||
+            runtime.m_spaceLocations[*located.TraceId].empty()) {
+            return XR_SUCCESS;
+        }
+
+        // The record closest to the time asked for, e.g. of a placement a few frames back.
+        const std::deque<SpaceLocation>& locations = runtime.m_spaceLocations[*located.TraceId];
+        const auto closest = std::min_element(locations.begin(), locations.end(), [time](const SpaceLocation& a, const SpaceLocation& b) {
+            return std::abs(a.Time - time) < std::abs(b.Time - time);
+        });
+        location->locationFlags = closest->Location.locationFlags;
+        location->pose = closest->Location.pose;
+        if (velocity != nullptr) {
+            // Only spaces the app predicts were located with a velocity, the others have no valid bit.
+            velocity->velocityFlags = closest->Velocity.velocityFlags;
+            velocity->linearVelocity = closest->Velocity.linearVelocity;
+            velocity->angularVelocity = closest->Velocity.angularVelocity;
+        }
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrDestroySpace(XrSpace space) {
+        Space* destroyed = FromHandle<Space>(space);
+        ReplayRuntime& runtime = *destroyed->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        Erase(runtime.m_spaces, destroyed);
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrEnumerateSwapchainFormats(XrSession, uint32_t capacity, uint32_t* count, int64_t* formats) {
+#ifdef XR_USE_GRAPHICS_API_D3D11
+        return Enumerate<int64_t>({DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
+                                   DXGI_FORMAT_B8G8R8A8_UNORM_SRGB,
+                                   DXGI_FORMAT_R8G8B8A8_UNORM,
+                                   DXGI_FORMAT_B8G8R8A8_UNORM,
+                                   DXGI_FORMAT_D32_FLOAT,
+                                   DXGI_FORMAT_D24_UNORM_S8_UINT,
+                                   DXGI_FORMAT_D16_UNORM},
+                                  capacity,
+                                  count,
+                                  formats);
+#else
+        return Enumerate<int64_t>({}, capacity, count, formats);
+#endif
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrCreateSwapchain(XrSession session, const XrSwapchainCreateInfo* createInfo, XrSwapchain* swapchain) {
+        Session& owner = *FromHandle<Session>(session);
+        ReplayRuntime& runtime = *owner.Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+
+        Swapchain created{&runtime};
+#ifdef XR_USE_GRAPHICS_API_D3D11
+        D3D11_TEXTURE2D_DESC desc{};
+        desc.Width = createInfo->width;
+        desc.Height = createInfo->height;
+        desc.MipLevels = createInfo->mipCount;
+        desc.ArraySize = createInfo->arraySize;
+        desc.Format = (DXGI_FORMAT)createInfo->format;
+        desc.SampleDesc.Count = createInfo->sampleCount;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        if (createInfo->usageFlags & XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT) {
+            desc.BindFlags |= D3D11_BIND_RENDER_TARGET;
+        }
+        if (createInfo->usageFlags & XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            desc.BindFlags |= D3D11_BIND_DEPTH_STENCIL; // A typed depth format cannot be sampled as well
+        } else if (createInfo->usageFlags & XR_SWAPCHAIN_USAGE_SAMPLED_BIT) {
+            desc.BindFlags |= D3D11_BIND_SHADER_RESOURCE;
+        }
+        for (uint32_t i = 0; i < runtime.m_options.SwapchainLength; i++) {
+            winrt::com_ptr<ID3D11Texture2D> texture;
+            if (FAILED(owner.Device->CreateTexture2D(&desc, nullptr, texture.put()))) {
+                return XR_ERROR_RUNTIME_FAILURE;
+            }
+            created.Textures.push_back(std::move(texture));
+        }
+#else
+        (void)createInfo;
+#endif
+        *swapchain = ToHandle<XrSwapchain>(&runtime.m_swapchains.emplace_back(std::move(created)));
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrDestroySwapchain(XrSwapchain swapchain) {
+        Swapchain* destroyed = FromHandle<Swapchain>(swapchain);
+        ReplayRuntime& runtime = *destroyed->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        Erase(runtime.m_swapchains, destroyed);
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrEnumerateSwapchainImages(XrSwapchain swapchain,
+                                                                 uint32_t capacity,
+                                                                 uint32_t* count,
+                                                                 XrSwapchainImageBaseHeader* images) {
+#ifdef XR_USE_GRAPHICS_API_D3D11
+        const Swapchain& enumerated = *FromHandle<Swapchain>(swapchain);
+        *count = (uint32_t)enumerated.Textures.size();
+        if (capacity == 0) {
+            return XR_SUCCESS;
+        }
+        if (capacity < enumerated.Textures.size()) {
+            return XR_ERROR_SIZE_INSUFFICIENT;
+        }
+        auto d3d11Images = reinterpret_cast<XrSwapchainImageD3D11KHR*>(images);
+        for (uint32_t i = 0; i < *count; i++) {
+            d3d11Images[i].texture = enumerated.Textures[i].get();
+        }
+#else
+        (void)swapchain;
+        (void)capacity;
+        (void)images;
+        *count = 0;
+#endif
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrAcquireSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageAcquireInfo*, uint32_t* index) {
+        Swapchain& acquired = *FromHandle<Swapchain>(swapchain);
+        std::lock_guard lock(acquired.Runtime->m_mutex);
+        *index = acquired.NextImage;
+        acquired.NextImage = (acquired.NextImage + 1) % std::max(acquired.Runtime->m_options.SwapchainLength, 1u);
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrWaitSwapchainImage(XrSwapchain, const XrSwapchainImageWaitInfo*) {
+        return XR_SUCCESS; // No compositor reads the images
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrReleaseSwapchainImage(XrSwapchain, const XrSwapchainImageReleaseInfo*) {
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrWaitFrame(XrSession session, const XrFrameWaitInfo*, XrFrameState* frameState) {
+        ReplayRuntime& runtime = *FromHandle<Session>(session)->Runtime;
+        std::chrono::steady_clock::time_point wakeTime;
+        {
+            std::lock_guard lock(runtime.m_mutex);
+            const auto now = std::chrono::steady_clock::now();
+            if (runtime.m_nextFrame) {
+                runtime.m_frameState = runtime.m_nextFrame->FrameState;
+                runtime.m_frames++;
+                runtime.ReadUntilNextFrame();
+
+                // Recorded display times are in nanoseconds, frames are returned at the same distance from the first.
+                if (!runtime.m_firstFrameTime) {
+                    runtime.m_firstFrameTime = runtime.m_frameState.predictedDisplayTime;
+                    runtime.m_start = now;
+                }
+                wakeTime = runtime.m_start + std::chrono::nanoseconds(runtime.m_frameState.predictedDisplayTime - *runtime.m_firstFrameTime);
+            } else {
+                // Past the end of the trace, empty frames keep coming at the recorded rate until the session ends.
+                runtime.StopSession();
+                runtime.m_frameState.predictedDisplayTime += runtime.m_frameState.predictedDisplayPeriod;
+                runtime.m_frameState.shouldRender = XR_FALSE;
+                wakeTime = now + std::chrono::nanoseconds(runtime.m_frameState.predictedDisplayPeriod);
+            }
+
+            frameState->predictedDisplayTime = runtime.m_frameState.predictedDisplayTime;
+            frameState->predictedDisplayPeriod = runtime.m_frameState.predictedDisplayPeriod;
+            frameState->shouldRender = runtime.m_frameState.shouldRender;
+        }
+
+        if (runtime.m_options.Pace == trace::TraceReplayer::Pace::Original) {
+            std::this_thread::sleep_until(wakeTime);
+        }
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrBeginFrame(XrSession, const XrFrameBeginInfo*) {
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrEndFrame(XrSession, const XrFrameEndInfo*) {
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrLocateViews(XrSession session,
+                                                    const XrViewLocateInfo*,
+                                                    XrViewState* viewState,
+                                                    uint32_t capacity,
+                                                    uint32_t* count,
+                                                    XrView* views) {
+        ReplayRuntime& runtime = *FromHandle<Session>(session)->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        *count = (uint32_t)runtime.m_views.size();
+        if (capacity == 0) {
+            return XR_SUCCESS;
+        }
+        if (capacity < runtime.m_views.size()) {
+            return XR_ERROR_SIZE_INSUFFICIENT;
+        }
+        viewState->viewStateFlags = runtime.m_viewState.viewStateFlags;
+        for (uint32_t i = 0; i < *count; i++) {
+            views[i].pose = runtime.m_views[i].pose;
+            views[i].fov = runtime.m_views[i].fov;
+        }
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrCreateActionSet(XrInstance instance, const XrActionSetCreateInfo*, XrActionSet* actionSet) {
+        ReplayRuntime& runtime = *FromHandle<ReplayRuntime>(instance);
+        std::lock_guard lock(runtime.m_mutex);
+        *actionSet = ToHandle<XrActionSet>(&runtime.m_actionSets.emplace_back(ActionSet{&runtime}));
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrDestroyActionSet(XrActionSet actionSet) {
+        ActionSet* destroyed = FromHandle<ActionSet>(actionSet);
+        ReplayRuntime& runtime = *destroyed->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        Erase(runtime.m_actionSets, destroyed);
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrCreateAction(XrActionSet actionSet, const XrActionCreateInfo* createInfo, XrAction* action) {
+        ReplayRuntime& runtime = *FromHandle<ActionSet>(actionSet)->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        *action = ToHandle<XrAction>(&runtime.m_actions.emplace_back(Action{&runtime, createInfo->actionType}));
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrDestroyAction(XrAction action) {
+        Action* destroyed = FromHandle<Action>(action);
+        ReplayRuntime& runtime = *destroyed->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        Erase(runtime.m_actions, destroyed);
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrSuggestInteractionProfileBindings(XrInstance, const XrInteractionProfileSuggestedBinding*) {
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrAttachSessionActionSets(XrSession, const XrSessionActionSetsAttachInfo*) {
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrSyncActions(XrSession session, const XrActionsSyncInfo*) {
+        ReplayRuntime& runtime = *FromHandle<Session>(session)->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+
+        // A recorded change is only reported as changed by the sync that applies it.
+        for (std::vector<ActionChange>& slots : runtime.m_slots) {
+            for (ActionChange& slot : slots) {
+                switch (slot.Kind) {
+                case ActionChange::ActionKind::Boolean:
+                    slot.Boolean.changedSinceLastSync = XR_FALSE;
+                    break;
+                case ActionChange::ActionKind::Float:
+                    slot.Float.changedSinceLastSync = XR_FALSE;
+                    break;
+                case ActionChange::ActionKind::Vector2f:
+                    slot.Vector2f.changedSinceLastSync = XR_FALSE;
+                    break;
+                case ActionChange::ActionKind::Pose:
+                    break;
+                }
+            }
+        }
+        for (const ActionChange& change : runtime.m_pendingChanges) {
+            runtime.SlotAt(change.Kind, change.Index) = change;
+        }
+        runtime.m_pendingChanges.clear();
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrGetActionStateBoolean(XrSession session,
+                                                              const XrActionStateGetInfo* getInfo,
+                                                              XrActionStateBoolean* state) {
+        ReplayRuntime& runtime = *FromHandle<Session>(session)->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        const XrActionStateBoolean& recorded = runtime.Slot(ActionChange::ActionKind::Boolean, *getInfo).Boolean;
+        state->currentState = recorded.currentState;
+        state->changedSinceLastSync = recorded.changedSinceLastSync;
+        state->lastChangeTime = recorded.lastChangeTime;
+        state->isActive = recorded.isActive;
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrGetActionStateFloat(XrSession session,
+                                                            const XrActionStateGetInfo* getInfo,
+                                                            XrActionStateFloat* state) {
+        ReplayRuntime& runtime = *FromHandle<Session>(session)->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        const XrActionStateFloat& recorded = runtime.Slot(ActionChange::ActionKind::Float, *getInfo).Float;
+        state->currentState = recorded.currentState;
+        state->changedSinceLastSync = recorded.changedSinceLastSync;
+        state->lastChangeTime = recorded.lastChangeTime;
+        state->isActive = recorded.isActive;
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrGetActionStateVector2f(XrSession session,
+                                                               const XrActionStateGetInfo* getInfo,
+                                                               XrActionStateVector2f* state) {
+        ReplayRuntime& runtime = *FromHandle<Session>(session)->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        const XrActionStateVector2f& recorded = runtime.Slot(ActionChange::ActionKind::Vector2f, *getInfo).Vector2f;
+        state->currentState = recorded.currentState;
+        state->changedSinceLastSync = recorded.changedSinceLastSync;
+        state->lastChangeTime = recorded.lastChangeTime;
+        state->isActive = recorded.isActive;
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrGetActionStatePose(XrSession session,
+                                                           const XrActionStateGetInfo* getInfo,
+                                                           XrActionStatePose* state) {
+        ReplayRuntime& runtime = *FromHandle<Session>(session)->Runtime;
+        std::lock_guard lock(runtime.m_mutex);
+        state->isActive = runtime.Slot(ActionChange::ActionKind::Pose, *getInfo).Pose.isActive;
+        return XR_SUCCESS;
+    }
+
+    XrResult XRAPI_CALL ReplayRuntime::xrApplyHapticFeedback(XrSession, const XrHapticActionInfo*, const XrHapticBaseHeader*) {
+        return XR_SUCCESS;
+    }
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+    XrResult XRAPI_CALL ReplayRuntime::xrGetD3D11GraphicsRequirementsKHR(XrInstance,
+                                                                        XrSystemId systemId,
+                                                                        XrGraphicsRequirementsD3D11KHR* requirements) {
+        if (systemId != ReplaySystemId) {
+            return XR_ERROR_SYSTEM_INVALID;
+        }
+
+        // Render on the default adapter.
+        winrt::com_ptr<IDXGIFactory1> dxgiFactory;
+        winrt::com_ptr<IDXGIAdapter1> dxgiAdapter;
+        DXGI_ADAPTER_DESC1 adapterDesc;
+        if (FAILED(CreateDXGIFactory1(winrt::guid_of<IDXGIFactory1>(), dxgiFactory.put_void())) ||
+            FAILED(dxgiFactory->EnumAdapters1(0, dxgiAdapter.put())) || FAILED(dxgiAdapter->GetDesc1(&adapterDesc))) {
+            return XR_ERROR_RUNTIME_FAILURE;
+        }
+        requirements->adapterLuid = adapterDesc.AdapterLuid;
+        requirements->minFeatureLevel = D3D_FEATURE_LEVEL_11_0;
+        return XR_SUCCESS;
+    }
+#endif
+} // namespace sample::replay
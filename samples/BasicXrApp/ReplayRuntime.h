@@ -0,0 +1,149 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <deque>
+#include <list>
+#include <type_traits>
+#include "SessionTrace.h"
+#include "XrDispatch.h"
+
+namespace sample::replay {
+
+    // Stands in for the OpenXR runtime, answering the app's calls from a trace written by trace::TraceWriter, so the
+    // program runs without a runtime or a headset, e.g. to reproduce or profile a recorded session.
+    // Each xrWaitFrame returns the next recorded frame, and hands the views, space locations, action changes and events
+    // recorded until the frame after it to the calls that follow. Action states match the recorded slots in the order the
+    // app first reads them, and action spaces the recorded spaces in the order they are created, which is how the app
+    // declares them to the trace. The session stops when the trace ends or the app requests an exit.
+    // No optional extension is offered. With D3D11, swapchain images are textures of the device the session is bound to.
+    class ReplayRuntime {
+    public:
+        struct Options {
+            trace::TraceReplayer::Pace Pace{trace::TraceReplayer::Pace::Original};
+            XrExtent2Di RecommendedImageRect{1440, 1440};
+            XrExtent2Di MaxImageRect{2048, 2048};
+            uint32_t SwapchainLength{3};
+        };
+
+        ReplayRuntime(const std::wstring& path, Options options);
+
+        ReplayRuntime(const ReplayRuntime&) = delete;
+        ReplayRuntime& operator=(const ReplayRuntime&) = delete;
+
+        // In place of the loader's exports. The instance is the runtime itself, so there is at most one at a time.
+        XrResult EnumerateInstanceExtensionProperties(uint32_t capacity, uint32_t* count, XrExtensionProperties* properties) const;
+        XrResult CreateInstance(const XrInstanceCreateInfo* createInfo, XrInstance* instance);
+        static XrResult XRAPI_CALL DestroyInstance(XrInstance instance);
+
+        // In place of DispatchTable::Load. Points every function the replay implements at it, extensions stay null.
+        static void Load(dispatch::DispatchTable* dispatch);
+
+        // Recorded frames returned by xrWaitFrame so far.
+        uint64_t Frames() const;
+
+    private:
+        // One static member per function of the dispatch table. Handles are pointers to the objects below, or to the
+        // runtime for the instance.
+#define SAMPLE_REPLAY_DECLARE_FUNCTION(name) static std::remove_pointer_t<PFN_##name> name;
+        SAMPLE_XR_CORE_FUNCTIONS(SAMPLE_REPLAY_DECLARE_FUNCTION)
+        SAMPLE_XR_D3D11_FUNCTIONS(SAMPLE_REPLAY_DECLARE_FUNCTION)
+#undef SAMPLE_REPLAY_DECLARE_FUNCTION
+
+        struct Session {
+            ReplayRuntime* Runtime;
+#ifdef XR_USE_GRAPHICS_API_D3D11
+            winrt::com_ptr<ID3D11Device> Device;
+#endif
+            uint32_t ActionSpaceCount{0}; // Trace id of the next action space
+            bool Running{false};
+        };
+
+        struct Space {
+            ReplayRuntime* Runtime;
+            std::optional<uint32_t> TraceId; // Reference spaces are not recorded, they are all at the origin
+        };
+
+        struct ActionSet {
+            ReplayRuntime* Runtime;
+        };
+
+        struct Action {
+            ReplayRuntime* Runtime;
+            XrActionType Type;
+        };
+
+        struct Swapchain {
+            ReplayRuntime* Runtime;
+            uint32_t NextImage{0};
+#ifdef XR_USE_GRAPHICS_API_D3D11
+            std::vector<winrt::com_ptr<ID3D11Texture2D>> Textures;
+#endif
+        };
+
+        struct SpaceLocation {
+            XrTime Time;
+            XrSpaceLocation Location;
+            XrSpaceVelocity Velocity;
+        };
+
+        // Reads the records following the returned frame, up to and including the next FrameState.
+        void ReadUntilNextFrame();
+        void QueueSessionState(XrSessionState state);
+
+        // Queues STOPPING. From then on the replay drives the session state instead of the trace.
+        void StopSession();
+
+        input::ActionChange& Slot(input::ActionChange::ActionKind kind, const XrActionStateGetInfo& getInfo);
+        input::ActionChange& SlotAt(input::ActionChange::ActionKind kind, uint32_t index);
+
+        const Options m_options;
+        XrViewConfigurationType m_viewConfigurationType{XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO};
+        uint32_t m_viewCount{2};
+
+        // The app calls in from the frame loop, the event pump and the input thread.
+        mutable std::mutex m_mutex;
+        trace::TraceReader m_reader;
+        std::optional<trace::Record> m_nextFrame; // Empty once the trace ended
+        XrFrameState m_frameState{XR_TYPE_FRAME_STATE};
+        uint64_t m_frames{0};
+        std::optional<XrTime> m_firstFrameTime;
+        std::chrono::steady_clock::time_point m_start;
+
+        XrViewState m_viewState{XR_TYPE_VIEW_STATE};
+        std::vector<XrView> m_views;
+        std::vector<std::deque<SpaceLocation>> m_spaceLocations; // The latest few of each recorded space
+        constexpr static size_t SpaceLocationHistory = 8;
+
+        std::deque<XrEventDataBuffer> m_events;
+        bool m_stopped{false};
+        bool m_exitingRecorded{false};
+
+        std::vector<input::ActionChange> m_pendingChanges; // Applied by the next xrSyncActions
+        std::array<std::map<std::pair<XrAction, XrPath>, uint32_t>, 4> m_slotIndices;
+        std::array<std::vector<input::ActionChange>, 4> m_slots;
+
+        std::vector<std::string> m_paths; // XrPath n is m_paths[n - 1]
+        bool m_instanceCreated{false};
+        Session* m_session{nullptr};
+        std::list<Session> m_sessions;
+        std::list<Space> m_spaces;
+        std::list<ActionSet> m_actionSets;
+        std::list<Action> m_actions;
+        std::list<Swapchain> m_swapchains;
+    };
+
+} // namespace sample::replay
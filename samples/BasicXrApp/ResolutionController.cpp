@@ -0,0 +1,151 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "ResolutionController.h"
+
+#include <cmath>
+
+namespace sample::resolution {
+    ResolutionController::ResolutionController(XrExtent2Di recommendedExtent, XrExtent2Di maximumExtent, Options options)
+        : m_recommendedExtent(recommendedExtent)
+        , m_maximumExtent(maximumExtent)
+        , m_options(options)
+        , m_maxScale(std::min({options.MaxScale,
+                               (float)maximumExtent.width / recommendedExtent.width,
+                               (float)maximumExtent.height / recommendedExtent.height})) {
+        CHECK(recommendedExtent.width > 0 && recommendedExtent.height > 0);
+        CHECK(maximumExtent.width >= recommendedExtent.width && maximumExtent.height >= recommendedExtent.height);
+        CHECK(options.MinScale > 0 && options.MinScale <= 1);
+        SetScale(1);
+    }
+
+    void ResolutionController::OnFrame(std::chrono::microseconds gpuTime, XrDuration displayPeriod, uint32_t sizeChanges) {
+        if (displayPeriod <= 0) {
+            return; // The runtime has no estimate yet
+        }
+        if (sizeChanges != SizeChanges()) {
+            return; // Rendered at an earlier size, GPU times arrive a few frames late
+        }
+
+        m_stats.Frames++;
+        const float periodMicroseconds = displayPeriod / 1000.0f;
+        const float budget = m_options.TargetBudget * periodMicroseconds;
+        const float time = (float)gpuTime.count();
+        if (time > budget) {
+            m_stats.FramesOverBudget++;
+            m_framesOver++;
+            m_framesUnder = 0;
+        } else if (time < budget * (1 - m_options.Hysteresis)) {
+            m_framesUnder++;
+            m_framesOver = 0;
+        } else {
+            m_framesOver = 0;
+            m_framesUnder = 0;
+        }
+
+        if (m_framesOver >= m_options.FramesToDecrease && m_scale > m_options.MinScale) {
+            // The rendering cost follows the pixel count, which is the square of the scale.
+            const float factor = std::max(std::sqrt(budget / time), 1 - m_options.MaxStepDown);
+            SetScale(std::max(m_scale * factor, m_options.MinScale));
+            m_stats.Decreases++;
+        } else if (m_framesUnder >= m_options.FramesToIncrease && m_scale < m_maxScale) {
+            SetScale(std::min(m_scale + m_options.StepUp, m_maxScale));
+            m_stats.Increases++;
+        } else {
+            return;
+        }
+
+        // Only frames rendered at the new size count towards the next change.
+        m_framesOver = 0;
+        m_framesUnder = 0;
+    }
+
+    void ResolutionController::SetScale(float scale) {
+        m_scale = scale;
+        m_extent.width = std::clamp((int32_t)std::lround(m_recommendedExtent.width * scale), 1, m_maximumExtent.width);
+        m_extent.height = std::clamp((int32_t)std::lround(m_recommendedExtent.height * scale), 1, m_maximumExtent.height);
+    }
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+    GpuTimer::GpuTimer(ID3D11Device* device, uint32_t latency) {
+        CHECK(latency > 0);
+        device->GetImmediateContext(m_deviceContext.put());
+
+        m_querySets.resize(latency);
+        for (QuerySet& querySet : m_querySets) {
+            D3D11_QUERY_DESC desc{D3D11_QUERY_TIMESTAMP_DISJOINT, 0};
+            CHECK_HRCMD(device->CreateQuery(&desc, querySet.Disjoint.put()));
+            desc.Query = D3D11_QUERY_TIMESTAMP;
+            CHECK_HRCMD(device->CreateQuery(&desc, querySet.Begin.put()));
+            CHECK_HRCMD(device->CreateQuery(&desc, querySet.End.put()));
+        }
+    }
+
+    void GpuTimer::Begin(uint32_t tag) {
+        QuerySet& querySet = m_querySets[m_next];
+        m_timing = !querySet.InFlight;
+        if (!m_timing) {
+            return; // The GPU is more than the latency behind
+        }
+
+        querySet.Tag = tag;
+        m_deviceContext->Begin(querySet.Disjoint.get());
+        m_deviceContext->End(querySet.Begin.get());
+    }
+
+    void GpuTimer::End() {
+        if (!m_timing) {
+            return;
+        }
+
+        QuerySet& querySet = m_querySets[m_next];
+        m_deviceContext->End(querySet.End.get());
+        m_deviceContext->End(querySet.Disjoint.get());
+        querySet.InFlight = true;
+        m_next = (m_next + 1) % m_querySets.size();
+        m_timing = false;
+    }
+
+    std::optional<GpuTimer::Result> GpuTimer::TryGetResult() {
+        // Never flush here, the frame's own submission does. S_FALSE means the GPU has not reached the query yet.
+        auto GetData = [this](ID3D11Query* query, void* data, UINT size) {
+            const HRESULT hr = m_deviceContext->GetData(query, data, size, D3D11_ASYNC_GETDATA_DONOTFLUSH);
+            if (hr == S_FALSE) {
+                return false;
+            }
+            CHECK_HRCMD(hr);
+            return true;
+        };
+
+        while (m_querySets[m_oldest].InFlight) {
+            QuerySet& querySet = m_querySets[m_oldest];
+            D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+            UINT64 begin, end;
+            if (!GetData(querySet.Disjoint.get(), &disjoint, sizeof(disjoint)) || !GetData(querySet.Begin.get(), &begin, sizeof(begin)) ||
+                !GetData(querySet.End.get(), &end, sizeof(end))) {
+                return {};
+            }
+
+            querySet.InFlight = false;
+            m_oldest = (m_oldest + 1) % m_querySets.size();
+            if (!disjoint.Disjoint && disjoint.Frequency > 0 && end >= begin) {
+                return Result{std::chrono::microseconds((end - begin) * 1'000'000 / disjoint.Frequency), querySet.Tag};
+            }
+        }
+        return {};
+    }
+#endif
+} // namespace sample::resolution
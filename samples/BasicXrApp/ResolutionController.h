@@ -0,0 +1,121 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+namespace sample::resolution {
+
+    struct Stats {
+        uint64_t Frames{0};
+        uint64_t FramesOverBudget{0};
+        uint32_t Decreases{0};
+        uint32_t Increases{0};
+    };
+
+    // Scales the image rect rendered into swapchains allocated at the maximum size, so a heavy scene renders at a lower
+    // resolution instead of missing frames. The scale is relative to the recommended size. Frames are judged by their GPU time,
+    // which the scale changes, rather than the CPU time of the frame loop, which it does not. The scale drops as soon as a few
+    // frames in a row are over budget, by how much they were over, and only climbs back in small steps once frames have stayed
+    // under the budget by the hysteresis fraction for a while, so it does not flip between two sizes. Not thread safe.
+    class ResolutionController {
+    public:
+        struct Options {
+            float TargetBudget{0.9f}; // Fraction of the display period a frame may take
+            float Hysteresis{0.2f};   // Frames must be this fraction under budget before the scale increases
+            float MinScale{0.5f};
+            float MaxScale{1.25f}; // Also limited by the maximum size
+            float StepUp{0.05f};
+            float MaxStepDown{0.25f}; // Largest fraction the scale drops by at once
+            uint32_t FramesToDecrease{3};
+            uint32_t FramesToIncrease{90};
+        };
+
+        ResolutionController(XrExtent2Di recommendedExtent, XrExtent2Di maximumExtent, Options options);
+
+        // Once per frame the GPU finished, with how long the GPU took, the display period of the latest frame state and the
+        // SizeChanges() the frame was rendered at. Frames rendered before the last change are ignored.
+        void OnFrame(std::chrono::microseconds gpuTime, XrDuration displayPeriod, uint32_t sizeChanges);
+
+        // Counts the changes of the extent, to tag each frame with the size it was rendered at.
+        uint32_t SizeChanges() const {
+            return m_stats.Decreases + m_stats.Increases;
+        }
+
+        // Size of the image rect to render and submit this frame, at most the maximum size.
+        XrExtent2Di Extent() const {
+            return m_extent;
+        }
+
+        float Scale() const {
+            return m_scale;
+        }
+
+        const Stats& GetStats() const {
+            return m_stats;
+        }
+
+    private:
+        void SetScale(float scale);
+
+        const XrExtent2Di m_recommendedExtent;
+        const XrExtent2Di m_maximumExtent;
+        const Options m_options;
+        const float m_maxScale;
+        float m_scale{1};
+        XrExtent2Di m_extent{};
+        uint32_t m_framesOver{0};
+        uint32_t m_framesUnder{0};
+        Stats m_stats;
+    };
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+    // Times GPU work with timestamp queries on the immediate context. Results are read a few frames later, once the GPU is
+    // done with them, so the render thread never waits for the GPU. Work begun while every query set is still in flight
+    // is not timed. Not thread safe.
+    class GpuTimer {
+    public:
+        struct Result {
+            std::chrono::microseconds Time;
+            uint32_t Tag; // As given to Begin
+        };
+
+        GpuTimer(ID3D11Device* device, uint32_t latency = 4);
+
+        // Bracket the commands to time.
+        void Begin(uint32_t tag);
+        void End();
+
+        // The oldest finished result, or nothing once none is ready. Work the GPU could not time, e.g. because its clock
+        // changed, is skipped.
+        std::optional<Result> TryGetResult();
+
+    private:
+        struct QuerySet {
+            winrt::com_ptr<ID3D11Query> Disjoint;
+            winrt::com_ptr<ID3D11Query> Begin;
+            winrt::com_ptr<ID3D11Query> End;
+            uint32_t Tag{0};
+            bool InFlight{false};
+        };
+
+        winrt::com_ptr<ID3D11DeviceContext> m_deviceContext;
+        std::vector<QuerySet> m_querySets;
+        uint32_t m_next{0};   // Used by the next Begin
+        uint32_t m_oldest{0}; // Read by the next TryGetResult
+        bool m_timing{false}; // Between a Begin that got a query set and its End
+    };
+#endif
+
+} // namespace sample::resolution
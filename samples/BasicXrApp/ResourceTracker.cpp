@@ -0,0 +1,291 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "ResourceTracker.h"
+
+namespace {
+    using sample::memory::ResourceCategory;
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+    uint32_t BitsPerPixel(DXGI_FORMAT format) {
+        switch (format) {
+        case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            return 128;
+        case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_R32G8X24_TYPELESS:
+        case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+            return 64;
+        case DXGI_FORMAT_R16_TYPELESS:
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_D16_UNORM:
+            return 16;
+        case DXGI_FORMAT_R8_UNORM:
+            return 8;
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            return 4;
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return 8;
+        default:
+            return 32; // 8-bit RGBA, 32-bit depth and D24S8, the formats swapchains use
+        }
+    }
+
+    bool IsBlockCompressed(DXGI_FORMAT format) {
+        return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+               (format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+    }
+
+    // Releases tracked by the destruction callback, which only passes a pointer.
+    struct Registration {
+        sample::memory::ResourceTracker* Tracker;
+        uint64_t Id;
+    };
+#endif
+
+    constexpr double Megabytes(uint64_t bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+} // namespace
+
+namespace sample::memory {
+    const char* CategoryName(ResourceCategory category) {
+        switch (category) {
+        case ResourceCategory::SwapchainImages:
+            return "swapchain images";
+        case ResourceCategory::Textures:
+            return "textures";
+        case ResourceCategory::ConstantBuffers:
+            return "constant buffers";
+        case ResourceCategory::Geometry:
+            return "geometry";
+        case ResourceCategory::Staging:
+            return "staging";
+        }
+        return "unknown";
+    }
+
+    ResourceTracker::ResourceTracker(Options options)
+        : m_options(options)
+        , m_budgetBytes(options.BudgetBytes) {
+    }
+
+    ResourceTracker& ResourceTracker::Process() {
+        static ResourceTracker tracker({});
+        return tracker;
+    }
+
+    void ResourceTracker::SetBudget(uint64_t bytes) {
+        std::lock_guard lock(m_mutex);
+        m_budgetBytes = bytes;
+        m_overBudget = m_liveBytes > m_budgetBytes;
+    }
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+    void ResourceTracker::Track(ID3D11Resource* resource, ResourceCategory category, const char* name) {
+        D3D11_RESOURCE_DIMENSION dimension;
+        resource->GetType(&dimension);
+        uint64_t bytes = 0;
+        if (dimension == D3D11_RESOURCE_DIMENSION_BUFFER) {
+            D3D11_BUFFER_DESC desc;
+            static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc);
+            bytes = desc.ByteWidth;
+        } else if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE2D) {
+            D3D11_TEXTURE2D_DESC desc;
+            static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+            bytes = TextureBytes(desc);
+        } else {
+            THROW("Only buffers and 2D textures are tracked");
+        }
+
+        // The runtime calls back when the resource is destroyed, on whichever thread released its last reference.
+        winrt::com_ptr<ID3DDestructionNotifier> notifier;
+        CHECK_HRCMD(resource->QueryInterface(__uuidof(ID3DDestructionNotifier), notifier.put_void()));
+        auto registration = std::make_unique<Registration>(Registration{this, Add(category, bytes, name)});
+        UINT callbackId;
+        const HRESULT hr = notifier->RegisterDestroyCallback(&ResourceTracker::OnResourceDestroyed, registration.get(), &callbackId);
+        if (FAILED(hr)) {
+            Remove(registration->Id);
+            CHECK_HRESULT(hr, "RegisterDestroyCallback");
+        }
+        registration.release(); // Deleted by the callback
+    }
+
+    void CALLBACK ResourceTracker::OnResourceDestroyed(void* context) {
+        const std::unique_ptr<Registration> registration(static_cast<Registration*>(context));
+        registration->Tracker->Remove(registration->Id);
+    }
+#endif
+
+    uint64_t ResourceTracker::Add(ResourceCategory category, uint64_t bytes, const char* name) {
+        CHECK((uint32_t)category < CategoryCount);
+        bool crossedBudget = false;
+        uint64_t id;
+        {
+            std::lock_guard lock(m_mutex);
+            id = m_nextId++;
+            m_entries.emplace(id, Entry{category, name, bytes, std::chrono::steady_clock::now()});
+
+            CategoryStats& stats = m_categories[(uint32_t)category];
+            stats.LiveBytes += bytes;
+            stats.PeakBytes = std::max(stats.PeakBytes, stats.LiveBytes);
+            stats.LiveCount++;
+            stats.Created++;
+            m_liveBytes += bytes;
+            m_peakBytes = std::max(m_peakBytes, m_liveBytes);
+
+            if (!m_overBudget && m_liveBytes > m_budgetBytes) {
+                m_overBudget = crossedBudget = true;
+                m_budgetWarnings++;
+            }
+        }
+
+        if (crossedBudget) {
+            DEBUG_PRINT("WARNING: Graphics memory over budget after creating %.2f MB of %s (%s)",
+                        Megabytes(bytes),
+                        CategoryName(category),
+                        name);
+            LogSnapshot();
+        }
+        return id;
+    }
+
+    void ResourceTracker::Remove(uint64_t id) {
+        std::lock_guard lock(m_mutex);
+        const auto it = m_entries.find(id);
+        CHECK(it != m_entries.end());
+        const Entry& entry = it->second;
+        const auto lifetime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - entry.Created);
+
+        CategoryStats& stats = m_categories[(uint32_t)entry.Category];
+        stats.LiveBytes -= entry.Bytes;
+        stats.LiveCount--;
+        stats.Released++;
+        stats.TotalLifetime += lifetime;
+        stats.MaxLifetime = std::max(stats.MaxLifetime, lifetime);
+        m_liveBytes -= entry.Bytes;
+        if (m_liveBytes <= m_budgetBytes) {
+            m_overBudget = false; // Warn again the next time the budget is exceeded
+        }
+        m_entries.erase(it);
+    }
+
+    Snapshot ResourceTracker::GetSnapshot() const {
+        Snapshot snapshot;
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard lock(m_mutex);
+        snapshot.Categories = m_categories;
+        snapshot.LiveBytes = m_liveBytes;
+        snapshot.PeakBytes = m_peakBytes;
+        snapshot.BudgetBytes = m_budgetBytes;
+        snapshot.BudgetWarnings = m_budgetWarnings;
+
+        snapshot.Largest.reserve(m_entries.size());
+        for (const auto& [id, entry] : m_entries) {
+            const auto age = std::chrono::duration_cast<std::chrono::microseconds>(now - entry.Created);
+            snapshot.Largest.push_back({entry.Category, entry.Name, entry.Bytes, age});
+        }
+        const size_t largestCount = std::min<size_t>(snapshot.Largest.size(), m_options.LargestCount);
+        std::partial_sort(snapshot.Largest.begin(),
+                          snapshot.Largest.begin() + largestCount,
+                          snapshot.Largest.end(),
+                          [](const LiveResource& a, const LiveResource& b) { return a.Bytes > b.Bytes; });
+        snapshot.Largest.resize(largestCount);
+        return snapshot;
+    }
+
+    void ResourceTracker::LogSnapshot() const {
+        const Snapshot snapshot = GetSnapshot();
+        DEBUG_PRINT("Graphics memory: %.2f MB live, %.2f MB peak, %.2f MB budget, exceeded %u times",
+                    Megabytes(snapshot.LiveBytes),
+                    Megabytes(snapshot.PeakBytes),
+                    Megabytes(snapshot.BudgetBytes),
+                    snapshot.BudgetWarnings);
+        for (uint32_t i = 0; i < CategoryCount; i++) {
+            const CategoryStats& stats = snapshot.Categories[i];
+            if (stats.Created == 0) {
+                continue;
+            }
+            DEBUG_PRINT("  %s: %.2f MB in %u live, %.2f MB peak, %llu created, %llu released, %.2f s average and %.2f s max lifetime",
+                        CategoryName((ResourceCategory)i),
+                        Megabytes(stats.LiveBytes),
+                        stats.LiveCount,
+                        Megabytes(stats.PeakBytes),
+                        (unsigned long long)stats.Created,
+                        (unsigned long long)stats.Released,
+                        stats.Released > 0 ? stats.TotalLifetime.count() / 1e6 / stats.Released : 0.0,
+                        stats.MaxLifetime.count() / 1e6);
+        }
+        for (const LiveResource& resource : snapshot.Largest) {
+            DEBUG_PRINT("  %.2f MB %s (%s), %.1f s old",
+                        Megabytes(resource.Bytes),
+                        resource.Name,
+                        CategoryName(resource.Category),
+                        resource.Age.count() / 1e6);
+        }
+    }
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+    uint64_t TextureBytes(const D3D11_TEXTURE2D_DESC& desc) {
+        const uint32_t bitsPerPixel = BitsPerPixel(desc.Format);
+        const uint32_t mipLevels = desc.MipLevels > 0 ? desc.MipLevels : 1;
+        uint64_t bytes = 0;
+        for (uint32_t mip = 0; mip < mipLevels; mip++) {
+            uint64_t width = std::max(1u, desc.Width >> mip);
+            uint64_t height = std::max(1u, desc.Height >> mip);
+            if (IsBlockCompressed(desc.Format)) {
+                width = (width + 3) & ~3ull; // Whole 4x4 blocks
+                height = (height + 3) & ~3ull;
+            }
+            bytes += width * height * bitsPerPixel / 8;
+        }
+        return bytes * desc.ArraySize * std::max(1u, desc.SampleDesc.Count);
+    }
+
+    HRESULT CreateBuffer(ID3D11Device* device,
+                         const D3D11_BUFFER_DESC& desc,
+                         const D3D11_SUBRESOURCE_DATA* data,
+                         ResourceCategory category,
+                         const char* name,
+                         ID3D11Buffer** buffer) {
+        const HRESULT hr = device->CreateBuffer(&desc, data, buffer);
+        if (SUCCEEDED(hr)) {
+            ResourceTracker::Process().Track(*buffer, category, name);
+        }
+        return hr;
+    }
+
+    HRESULT CreateTexture2D(ID3D11Device* device,
+                            const D3D11_TEXTURE2D_DESC& desc,
+                            const D3D11_SUBRESOURCE_DATA* data,
+                            ResourceCategory category,
+                            const char* name,
+                            ID3D11Texture2D** texture) {
+        const HRESULT hr = device->CreateTexture2D(&desc, data, texture);
+        if (SUCCEEDED(hr)) {
+            ResourceTracker::Process().Track(*texture, category, name);
+        }
+        return hr;
+    }
+#endif
+} // namespace sample::memory
@@ -0,0 +1,134 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <mutex>
+
+namespace sample::memory {
+
+    enum class ResourceCategory : uint32_t {
+        SwapchainImages, // Owned by the runtime, rendered to every frame
+        Textures,
+        ConstantBuffers,
+        Geometry, // Vertex and index buffers of the cube and of loaded meshes
+        Staging,  // CPU readback, e.g. of captured frames
+    };
+    constexpr uint32_t CategoryCount = 5;
+
+    const char* CategoryName(ResourceCategory category);
+
+    struct CategoryStats {
+        uint64_t LiveBytes{0};
+        uint64_t PeakBytes{0}; // High-water mark of LiveBytes
+        uint32_t LiveCount{0};
+        uint64_t Created{0};
+        uint64_t Released{0};
+        std::chrono::microseconds TotalLifetime{0}; // Of released resources
+        std::chrono::microseconds MaxLifetime{0};
+    };
+
+    struct LiveResource {
+        ResourceCategory Category;
+        const char* Name;
+        uint64_t Bytes;
+        std::chrono::microseconds Age;
+    };
+
+    struct Snapshot {
+        std::array<CategoryStats, CategoryCount> Categories{};
+        uint64_t LiveBytes{0};
+        uint64_t PeakBytes{0};
+        uint64_t BudgetBytes{0};
+        uint32_t BudgetWarnings{0};
+        std::vector<LiveResource> Largest; // Largest live resources, largest first
+    };
+
+    // Accounts the graphics memory of every resource the backend creates, by category, from creation until the resource is
+    // destroyed. Crossing the budget logs a warning with a snapshot, once until usage drops back under it. Thread safe,
+    // since meshes are uploaded on loader threads and the last reference to a resource may be released on any thread.
+    class ResourceTracker {
+    public:
+        struct Options {
+            uint64_t BudgetBytes{1ull << 30}; // 1 GB
+            uint32_t LargestCount{8};         // Live resources listed in a snapshot
+        };
+
+        explicit ResourceTracker(Options options);
+
+        // Shared by every device and session of the process, which all draw on the same memory.
+        static ResourceTracker& Process();
+
+        void SetBudget(uint64_t bytes);
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+        // Accounts the resource until the D3D runtime destroys it, however many references it had.
+        // The name must be a string literal, or otherwise outlive the resource.
+        void Track(ID3D11Resource* resource, ResourceCategory category, const char* name);
+#endif
+
+        // Accounts memory no D3D resource stands for. Returns the id to pass to Remove.
+        uint64_t Add(ResourceCategory category, uint64_t bytes, const char* name);
+        void Remove(uint64_t id);
+
+        Snapshot GetSnapshot() const;
+
+        // Logs the snapshot, e.g. when a session ends or on request.
+        void LogSnapshot() const;
+
+    private:
+        struct Entry {
+            ResourceCategory Category;
+            const char* Name;
+            uint64_t Bytes;
+            std::chrono::steady_clock::time_point Created;
+        };
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+        static void CALLBACK OnResourceDestroyed(void* context);
+#endif
+
+        const Options m_options;
+        mutable std::mutex m_mutex;
+        std::unordered_map<uint64_t, Entry> m_entries;
+        uint64_t m_nextId{1};
+        std::array<CategoryStats, CategoryCount> m_categories{};
+        uint64_t m_liveBytes{0};
+        uint64_t m_peakBytes{0};
+        uint64_t m_budgetBytes{0};
+        uint32_t m_budgetWarnings{0};
+        bool m_overBudget{false};
+    };
+
+#ifdef XR_USE_GRAPHICS_API_D3D11
+    // Bytes of a texture with all its mips, array slices and samples. Formats without a known size count 4 bytes a pixel.
+    uint64_t TextureBytes(const D3D11_TEXTURE2D_DESC& desc);
+
+    // Same as the ID3D11Device methods, and the created resource is tracked by the process tracker.
+    HRESULT CreateBuffer(ID3D11Device* device,
+                         const D3D11_BUFFER_DESC& desc,
+                         const D3D11_SUBRESOURCE_DATA* data,
+                         ResourceCategory category,
+                         const char* name,
+                         ID3D11Buffer** buffer);
+    HRESULT CreateTexture2D(ID3D11Device* device,
+                            const D3D11_TEXTURE2D_DESC& desc,
+                            const D3D11_SUBRESOURCE_DATA* data,
+                            ResourceCategory category,
+                            const char* name,
+                            ID3D11Texture2D** texture);
+#endif
+
+} // namespace sample::memory
@@ -0,0 +1,86 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include "MeshLibrary.h"
+
+namespace sample::scene {
+
+    // What the renderer needs of one visible cube, copied out of the simulation's state.
+    struct CubeInstance {
+        XrPosef Pose; // In scene space
+        XrVector3f Scale;
+        sample::mesh::MeshHandle Mesh; // Drawn instead of the cube once loaded
+    };
+
+    // Everything one frame renders. Immutable once published, so the renderer never sees simulation mid-update.
+    struct SceneSnapshot {
+        uint64_t FrameIndex{0};
+        XrTime DisplayTime{0};
+        std::vector<CubeInstance> Cubes;
+        uint64_t FullDetailTriangles{0}; // Triangles of all located cubes if drawn at their finest level of detail
+        uint64_t SelectedTriangles{0};   // Triangles of all located cubes at their selected level of detail
+        uint32_t CulledCubes{0};         // Located cubes left out of Cubes, hidden or out of view
+    };
+
+    // Lock-free handoff between one producer and one consumer thread. The producer fills the write buffer and
+    // publishes it; the consumer picks up the latest published buffer and reads it for as long as it likes.
+    // Neither side ever waits, and a buffer is never written while it is read. Buffers are reused, so after the
+    // first frames filling them does not allocate.
+    template <typename T>
+    class TripleBuffer {
+    public:
+        // Producer only. Holds whatever was published two buffers ago.
+        T& WriteBuffer() {
+            return m_buffers[m_write];
+        }
+
+        // Producer only. Make the write buffer the latest one, replacing a published buffer the consumer missed.
+        void Publish() {
+            const uint8_t previous = m_middle.exchange(m_write | FreshBit, std::memory_order_acq_rel);
+            m_write = previous & IndexMask;
+        }
+
+        // Consumer only. Switch to the latest published buffer. Returns false, keeping the current one, if nothing
+        // was published since the last switch.
+        bool TryAcquireLatest() {
+            if ((m_middle.load(std::memory_order_relaxed) & FreshBit) == 0) {
+                return false;
+            }
+            const uint8_t previous = m_middle.exchange(m_read, std::memory_order_acq_rel);
+            m_read = previous & IndexMask;
+            return true;
+        }
+
+        // Consumer only.
+        const T& ReadBuffer() const {
+            return m_buffers[m_read];
+        }
+
+    private:
+        constexpr static uint8_t IndexMask = 0x3;
+        constexpr static uint8_t FreshBit = 0x4; // The middle buffer was published and not acquired yet
+
+        std::array<T, 3> m_buffers{};
+        uint8_t m_write{0};
+        std::atomic<uint8_t> m_middle{1};
+        uint8_t m_read{2};
+    };
+
+} // namespace sample::scene
@@ -0,0 +1,170 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "SceneUpdate.h"
+
+namespace sample::scene {
+    SceneUpdater::SceneUpdater(const dispatch::DispatchTable& dispatch,
+                               jobs::JobSystem& jobSystem,
+                               lod::LodSelector& lodSelector,
+                               Options options)
+        : m_dispatch(dispatch)
+        , m_jobSystem(jobSystem)
+        , m_lodSelector(lodSelector)
+        , m_options(std::move(options)) {
+    }
+
+    void SceneUpdater::Add(Cube* cube, prediction::VelocityFilter* velocityFilter, anchors::AttachmentId attachment) {
+        m_cubeUpdates.push_back({cube, velocityFilter, attachment});
+    }
+
+    void SceneUpdater::Poll() const {
+        if (m_options.Poll) {
+            m_options.Poll();
+        }
+    }
+
+    void SceneUpdater::Update(const Frame& frame,
+                              const prediction::PredictionOptions& predictionOptions,
+                              anchors::AnchorManager& anchorManager,
+                              SceneSnapshot* snapshot) {
+        // The frame may be shown later than the runtime predicted when rendering is pipelined.
+        const XrTime predictedDisplayTime = frame.PredictedDisplayTime;
+        const XrTime displayTime = predictedDisplayTime + predictionOptions.ExtraLatency;
+
+        anchorManager.Update(predictedDisplayTime, displayTime, predictionOptions);
+        if (frame.TraceWriter) {
+            anchorManager.ForEachLocatedAnchor(
+                [&](XrSpace space, XrTime locateTime, const XrSpaceLocation& location, const XrSpaceVelocity& velocity) {
+                    frame.TraceWriter->RecordSpaceLocation(locateTime, space, location, &velocity);
+                });
+        }
+        Poll(); // Between stages, so the swapchain images are seen ready as early as possible
+
+        // Spaces with a velocity filter are located together with their velocity and extrapolated to displayTime.
+        // Holograms are relative to anchors the anchor manager already located. Each cube only writes its own update
+        // and pose, so cubes are located in parallel.
+        auto LocateCube = [&](CubeUpdate& update) {
+            sample::Cube& cube = *update.Cube;
+            update.Location = {XR_TYPE_SPACE_LOCATION};
+            update.Velocity = {XR_TYPE_SPACE_VELOCITY};
+            XrPosef pose;
+            if (update.Attachment != anchors::NoAttachment) {
+                update.Location.locationFlags = anchorManager.Locate(update.Attachment, &pose);
+            } else if (cube.Space.Get() == XR_NULL_HANDLE) {
+                return;
+            } else if (update.VelocityFilter != nullptr) {
+                prediction::LocateAndPredict(m_dispatch,
+                                             cube.Space.Get(),
+                                             frame.SceneSpace,
+                                             predictedDisplayTime,
+                                             displayTime,
+                                             predictionOptions,
+                                             *update.VelocityFilter,
+                                             &update.Location,
+                                             &update.Velocity,
+                                             &pose);
+            } else {
+                CHECK_XRCMD(m_dispatch.xrLocateSpace(cube.Space.Get(), frame.SceneSpace, predictedDisplayTime, &update.Location));
+                pose = update.Location.pose;
+            }
+
+            // Update cubes location with latest space relation
+            if (xr::math::Pose::IsPoseValid(update.Location)) {
+                if (cube.PoseInSpace.has_value()) {
+                    cube.PoseInScene = xr::math::Pose::Multiply(cube.PoseInSpace.value(), pose);
+                } else {
+                    cube.PoseInScene = pose;
+                }
+            }
+        };
+
+        m_jobSystem.ParallelFor(0, m_cubeUpdates.size(), m_options.LocateGrainSize, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                LocateCube(m_cubeUpdates[i]);
+            }
+        });
+        Poll();
+
+        // Gather in placement order on this thread, which also keeps the trace writer single threaded.
+        // Visible cubes are copied into the snapshot, the renderer never reads the live cubes.
+        snapshot->DisplayTime = predictedDisplayTime;
+        snapshot->Cubes.clear();
+        m_cubeRadii.clear();
+        if (m_options.FindMeshInfo) {
+            m_lodSelector.ResolveMeshes(m_options.FindMeshInfo);
+        }
+        m_lodSelector.BeginFrame(frame.Views, frame.ViewCount);
+        for (const CubeUpdate& update : m_cubeUpdates) {
+            const XrSpace space = update.Cube->Space.Get();
+            if (space == XR_NULL_HANDLE && update.Attachment == anchors::NoAttachment) {
+                continue;
+            }
+            if (frame.TraceWriter && space != XR_NULL_HANDLE) {
+                // As the runtime reported it, so a replay predicts again with the options it runs with.
+                frame.TraceWriter->RecordSpaceLocation(predictedDisplayTime, space, update.Location, &update.Velocity);
+            }
+            if (xr::math::Pose::IsPoseValid(update.Location)) {
+                sample::Cube& cube = *update.Cube;
+                mesh::MeshHandle mesh{};
+                float radius = lod::LodSelector::CubeRadius;
+                if (cube.LodChain != lod::NoLodChain) {
+                    mesh = m_lodSelector.Select(cube.LodChain, cube.PoseInScene, cube.Scale, &cube.LodLevel);
+                    radius = m_lodSelector.LevelRadius(cube.LodChain, cube.LodLevel);
+                } else {
+                    m_lodSelector.CountCube();
+                }
+                snapshot->Cubes.push_back({cube.PoseInScene, cube.Scale, mesh});
+                m_cubeRadii.push_back(radius * std::max({cube.Scale.x, cube.Scale.y, cube.Scale.z}));
+            }
+        }
+        m_cubeUpdates.clear();
+
+        // Holograms drawn as cubes hide the ones behind them, only what may be seen stays in the snapshot.
+        Poll();
+        m_occlusionCuller.BeginFrame(frame.Views, frame.ViewCount, frame.NearFar);
+        for (const CubeInstance& cube : snapshot->Cubes) {
+            if (!cube.Mesh.IsValid()) {
+                m_occlusionCuller.AddOccluder(cube.Pose, {cube.Scale.x / 2, cube.Scale.y / 2, cube.Scale.z / 2});
+            }
+        }
+        m_occlusionCuller.Rasterize();
+        Poll();
+
+        // The depth hierarchy is only read from here on, so cubes are tested in parallel and compacted in order after.
+        const size_t cubeCount = snapshot->Cubes.size();
+        m_cubeVisible.resize(cubeCount);
+        m_jobSystem.ParallelFor(0, cubeCount, m_options.CullGrainSize, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                m_cubeVisible[i] = m_occlusionCuller.IsVisible(snapshot->Cubes[i].Pose.position, m_cubeRadii[i]);
+            }
+        });
+        size_t visibleCount = 0;
+        for (size_t i = 0; i < cubeCount; i++) {
+            if (m_cubeVisible[i]) {
+                snapshot->Cubes[visibleCount++] = snapshot->Cubes[i];
+            }
+        }
+        snapshot->Cubes.resize(visibleCount);
+        m_occlusionCuller.CountTested((uint32_t)cubeCount, (uint32_t)(cubeCount - visibleCount));
+
+        const lod::FrameStats& lodStats = m_lodSelector.Stats();
+        snapshot->FullDetailTriangles = lodStats.FullDetailTriangles;
+        snapshot->SelectedTriangles = lodStats.SelectedTriangles;
+        snapshot->CulledCubes = m_occlusionCuller.Stats().Culled;
+    }
+} // namespace sample::scene
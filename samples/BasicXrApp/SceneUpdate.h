@@ -0,0 +1,109 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <functional>
+#include <optional>
+#include "AnchorManager.h"
+#include "JobSystem.h"
+#include "LodSelector.h"
+#include "OcclusionCuller.h"
+#include "PosePrediction.h"
+#include "SceneSnapshot.h"
+#include "SessionTrace.h"
+
+namespace sample {
+    struct Cube {
+        xr::SpaceHandle Space{};
+        std::optional<XrPosef> PoseInSpace{}; // Cube pose in above Space. Default to identity.
+        XrVector3f Scale{0.1f, 0.1f, 0.1f};
+        sample::lod::LodChainId LodChain{sample::lod::NoLodChain}; // Meshes rendered instead of the cube once loaded
+        uint8_t LodLevel{0};                                        // Level of LodChain selected in the previous frame
+
+        XrPosef PoseInScene = xr::math::Pose::Identity(); // Cube pose in the scene.  Got updated every frame
+    };
+} // namespace sample
+
+namespace sample::scene {
+
+    // The per frame simulation of the frame loop: locates the anchors and the cubes added for the frame, selects their
+    // level of detail, and fills the snapshot with those the occluders among them leave visible. It only needs a dispatch
+    // table to locate spaces with, not a session, so it runs the same against a runtime, a replay or a benchmark stub.
+    // Not thread safe. Call from the simulation thread only, the job system spreads the work.
+    class SceneUpdater {
+    public:
+        struct Options {
+            size_t LocateGrainSize{64}; // Below this many cubes per job, locating them costs less than handing them to another thread
+            size_t CullGrainSize{256};  // Testing a cube against the depth hierarchy is cheaper than locating it
+            lod::LodSelector::MeshInfoFunction FindMeshInfo; // Resolves the meshes of level of detail chains once loaded
+            std::function<void()> Poll;                      // Called between stages, e.g. to see swapchain images ready early
+        };
+
+        struct Frame {
+            XrSpace SceneSpace{XR_NULL_HANDLE};
+            XrTime PredictedDisplayTime{0};
+            const XrView* Views{nullptr}; // In scene space
+            uint32_t ViewCount{0};
+            xr::math::NearFar NearFar{};
+            trace::TraceWriter* TraceWriter{nullptr}; // Records the located anchors and cubes when set
+        };
+
+        SceneUpdater(const dispatch::DispatchTable& dispatch, jobs::JobSystem& jobSystem, lod::LodSelector& lodSelector, Options options);
+
+        SceneUpdater(const SceneUpdater&) = delete;
+        SceneUpdater& operator=(const SceneUpdater&) = delete;
+
+        // Adds a cube to the next Update, which gathers cubes in the order they were added. Cubes with a velocity filter
+        // are located with their velocity and extrapolated, cubes with an attachment are located through the anchor manager
+        // instead of their space.
+        void Add(Cube* cube,
+                 prediction::VelocityFilter* velocityFilter = nullptr,
+                 anchors::AttachmentId attachment = anchors::NoAttachment);
+
+        // Updates anchors and the cubes added since the last call, and fills everything but the snapshot's FrameIndex.
+        void Update(const Frame& frame,
+                    const prediction::PredictionOptions& predictionOptions,
+                    anchors::AnchorManager& anchorManager,
+                    SceneSnapshot* snapshot);
+
+        const occlusion::FrameStats& OcclusionStats() const {
+            return m_occlusionCuller.Stats();
+        }
+
+    private:
+        // Per frame location of one cube, reused across frames.
+        struct CubeUpdate {
+            sample::Cube* Cube;
+            prediction::VelocityFilter* VelocityFilter;
+            anchors::AttachmentId Attachment{anchors::NoAttachment}; // Located instead of the cube's space
+            XrSpaceLocation Location{XR_TYPE_SPACE_LOCATION}; // As the runtime reported it, before prediction
+            XrSpaceVelocity Velocity{XR_TYPE_SPACE_VELOCITY}; // Only valid with a velocity filter
+        };
+
+        void Poll() const;
+
+        const dispatch::DispatchTable& m_dispatch;
+        jobs::JobSystem& m_jobSystem;
+        lod::LodSelector& m_lodSelector;
+        const Options m_options;
+
+        std::vector<CubeUpdate> m_cubeUpdates;
+        std::vector<float> m_cubeRadii;     // Bounding sphere radius of each cube gathered into the snapshot
+        std::vector<uint8_t> m_cubeVisible; // Written by the culling jobs, one byte each so they never share a write
+        occlusion::OcclusionCuller m_occlusionCuller{{}};
+    };
+
+} // namespace sample::scene
@@ -0,0 +1,172 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "SessionEvents.h"
+
+namespace sample::session {
+    EventPump::EventPump(const dispatch::DispatchTable& dispatch, XrInstance instance, Options options)
+        : m_dispatch(dispatch)
+        , m_instance(instance)
+        , m_options(options) {
+        m_thread = std::thread([this] { ThreadProc(); });
+    }
+
+    EventPump::~EventPump() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopRequested = true;
+        }
+        m_wake.notify_all();
+        m_eventQueued.notify_all();
+        m_thread.join();
+    }
+
+    void EventPump::ThreadProc() {
+        std::chrono::milliseconds backoff = m_options.MinBackoff;
+        try {
+            while (true) {
+                XrEventDataBuffer buffer{XR_TYPE_EVENT_DATA_BUFFER};
+                const XrResult xr = CHECK_XRCMD(m_dispatch.xrPollEvent(m_instance, &buffer));
+
+                std::unique_lock lock(m_mutex);
+                if (m_stopRequested) {
+                    return;
+                }
+
+                if (xr != XR_EVENT_UNAVAILABLE) {
+                    // Events tend to come in bursts, e.g. READY followed by SYNCHRONIZED, so poll again right away.
+                    m_events.push_back(buffer);
+                    m_eventQueued.notify_all();
+                    backoff = m_options.MinBackoff;
+                    continue;
+                }
+
+                m_wake.wait_for(lock, backoff, [this] { return m_stopRequested || m_wakeRequested || m_pollRequested; });
+                if (m_wakeRequested) {
+                    m_wakeRequested = false;
+                    m_pollRequested = false;
+                    backoff = m_options.MinBackoff;
+                } else if (m_pollRequested) {
+                    m_pollRequested = false;
+                } else {
+                    backoff = std::min(backoff * 2, m_options.MaxBackoff);
+                }
+            }
+        } catch (...) {
+            std::lock_guard lock(m_mutex);
+            m_failure = std::current_exception();
+            m_eventQueued.notify_all();
+        }
+    }
+
+    bool EventPump::TryReadNextEvent(XrEventDataBuffer* buffer) {
+        std::lock_guard lock(m_mutex);
+        if (m_failure) {
+            std::rethrow_exception(m_failure);
+        }
+        if (m_events.empty()) {
+            return false;
+        }
+        *buffer = m_events.front();
+        m_events.pop_front();
+        return true;
+    }
+
+    void EventPump::WaitForEvent() {
+        std::unique_lock lock(m_mutex);
+        m_eventQueued.wait(lock, [this] { return !m_events.empty() || m_failure || m_stopRequested || m_interruptRequested; });
+        m_interruptRequested = false;
+    }
+
+    void EventPump::Interrupt() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_interruptRequested = true;
+        }
+        m_eventQueued.notify_all();
+    }
+
+    void EventPump::Wake() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_wakeRequested = true;
+        }
+        m_wake.notify_all();
+    }
+
+    void EventPump::OnFrameEnded() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_pollRequested = true;
+        }
+        m_wake.notify_all();
+    }
+
+    SessionTransition SessionStateMachine::OnStateChanged(XrSessionState newState) {
+        const XrSessionState oldState = m_state;
+        m_state = newState;
+
+        switch (newState) {
+        case XR_SESSION_STATE_IDLE:
+            // Initial state after xrCreateSession, and the state after xrEndSession. Nothing to render.
+            return SessionTransition::None;
+
+        case XR_SESSION_STATE_READY:
+            m_readyTime = std::chrono::steady_clock::now();
+            m_running = true;
+            return SessionTransition::BeginSession;
+
+        case XR_SESSION_STATE_SYNCHRONIZED:
+        case XR_SESSION_STATE_VISIBLE:
+        case XR_SESSION_STATE_FOCUSED:
+            // The frame loop keeps running, only shouldRender and input focus change.
+            if (!m_running) {
+                DEBUG_PRINT("Unexpected session state %d while the session is not running (previous %d)", newState, oldState);
+            }
+            return SessionTransition::None;
+
+        case XR_SESSION_STATE_STOPPING:
+            m_running = false;
+            m_readyTime.reset();
+            return SessionTransition::EndSession;
+
+        case XR_SESSION_STATE_LOSS_PENDING:
+            // Poll for a new systemId
+            m_running = false;
+            return SessionTransition::RestartSession;
+
+        case XR_SESSION_STATE_EXITING:
+            // Do not attempt to restart because user closed this session.
+            m_running = false;
+            return SessionTransition::ExitRenderLoop;
+
+        case XR_SESSION_STATE_UNKNOWN:
+        default:
+            DEBUG_PRINT("Ignoring unknown session state %d", newState);
+            return SessionTransition::None;
+        }
+    }
+
+    void SessionStateMachine::OnFrameEnded() {
+        if (m_readyTime) {
+            m_lastTimeToFirstFrame =
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_readyTime.value());
+            m_readyTime.reset();
+            DEBUG_PRINT("Time to first frame after READY: %.2f ms", m_lastTimeToFirstFrame->count() / 1000.0);
+        }
+    }
+} // namespace sample::session
@@ -0,0 +1,121 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+#include "XrDispatch.h"
+
+namespace sample::session {
+
+    // Polls xrPollEvent on a lightweight background thread and queues events for the frame loop.
+    // While nothing arrives the thread backs off exponentially, so an idle app wakes rarely,
+    // and a frame loop with nothing to render can block in WaitForEvent instead of sleeping.
+    // While frames are rendered the frame loop calls OnFrameEnded, so an event waits at most a frame however far the
+    // backoff has grown.
+    class EventPump {
+    public:
+        struct Options {
+            std::chrono::milliseconds MinBackoff{1};
+            std::chrono::milliseconds MaxBackoff{100};
+        };
+
+        EventPump(const dispatch::DispatchTable& dispatch, XrInstance instance, Options options);
+        ~EventPump();
+
+        EventPump(const EventPump&) = delete;
+        EventPump& operator=(const EventPump&) = delete;
+
+        // Return true if an event is available, otherwise return false.
+        bool TryReadNextEvent(XrEventDataBuffer* buffer);
+
+        // Block until at least one event is queued, or Interrupt() is called.
+        void WaitForEvent();
+
+        // Return from the current or next WaitForEvent even though no event is queued. Callable from any thread.
+        void Interrupt();
+
+        // Restart polling at the minimum backoff, e.g. after requesting a state change from the runtime.
+        void Wake();
+
+        // Poll once right away without resetting the backoff. Call after xrEndFrame, so events raised during a frame
+        // are queued for the next one.
+        void OnFrameEnded();
+
+    private:
+        void ThreadProc();
+
+        const dispatch::DispatchTable& m_dispatch;
+        const XrInstance m_instance;
+        const Options m_options;
+
+        std::mutex m_mutex;
+        std::condition_variable m_eventQueued;
+        std::condition_variable m_wake;
+        std::deque<XrEventDataBuffer> m_events;
+        bool m_stopRequested{false};
+        bool m_wakeRequested{false};
+        bool m_pollRequested{false};
+        bool m_interruptRequested{false};
+        std::exception_ptr m_failure;
+        std::thread m_thread;
+    };
+
+    // What the frame loop has to do in response to a session state change.
+    enum class SessionTransition {
+        None,
+        BeginSession,
+        EndSession,
+        ExitRenderLoop,
+        RestartSession,
+    };
+
+    // Explicit handling of every XrSessionState, plus time-to-first-frame measurement after READY.
+    class SessionStateMachine {
+    public:
+        SessionTransition OnStateChanged(XrSessionState newState);
+
+        // Call after each xrEndFrame. The first call after READY reports the time to first frame.
+        void OnFrameEnded();
+
+        XrSessionState State() const {
+            return m_state;
+        }
+
+        // True between xrBeginSession and xrEndSession, when the frame loop must call xrWaitFrame.
+        bool IsRunning() const {
+            return m_running;
+        }
+
+        bool IsFocused() const {
+            return m_state == XR_SESSION_STATE_FOCUSED;
+        }
+
+        std::optional<std::chrono::microseconds> LastTimeToFirstFrame() const {
+            return m_lastTimeToFirstFrame;
+        }
+
+    private:
+        XrSessionState m_state{XR_SESSION_STATE_UNKNOWN};
+        bool m_running{false};
+        std::optional<std::chrono::steady_clock::time_point> m_readyTime;
+        std::optional<std::chrono::microseconds> m_lastTimeToFirstFrame;
+    };
+
+} // namespace sample::session
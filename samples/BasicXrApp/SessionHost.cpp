@@ -0,0 +1,192 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "SessionHost.h"
+
+namespace {
+    uint32_t PhysicalCoreCount() {
+        DWORD size = 0;
+        ::GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &size);
+        std::vector<uint8_t> buffer(size);
+        auto* const first = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+        if (size == 0 || !::GetLogicalProcessorInformationEx(RelationProcessorCore, first, &size)) {
+            return std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // One variable sized record per core, whatever the number of hardware threads it runs.
+        uint32_t cores = 0;
+        for (DWORD offset = 0; offset < size; cores++) {
+            offset += reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset)->Size;
+        }
+        return std::max(1u, cores);
+    }
+} // namespace
+
+namespace sample::host {
+    SessionHost::SessionHost(ProgramFactory factory, Options options)
+        : m_factory(std::move(factory))
+        , m_options(options) {
+    }
+
+    SessionHost::~SessionHost() {
+        RequestExit();
+        JoinSessions();
+    }
+
+    SessionHost::Report SessionHost::Run() {
+        CHECK(m_sessions.empty());
+
+        for (uint32_t index = 0; index < m_options.SessionCount; index++) {
+            auto session = std::make_unique<Session>();
+            session->Program = m_factory(index);
+
+            Session* const sessionPtr = session.get();
+            const uint64_t budget = m_options.FrameBudget.count();
+            session->Program->SetFrameObserver([sessionPtr, budget](std::chrono::microseconds frameTime) {
+                sessionPtr->Frames.fetch_add(1, std::memory_order_relaxed);
+                sessionPtr->FrameMicroseconds.fetch_add(frameTime.count(), std::memory_order_relaxed);
+                if ((uint64_t)frameTime.count() > budget) {
+                    sessionPtr->FramesOverBudget.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+
+            m_sessions.push_back(std::move(session));
+        }
+
+        // Programs are all created before any thread starts, so RequestExit never races with m_sessions growing.
+        for (const std::unique_ptr<Session>& session : m_sessions) {
+            session->Thread = std::thread([this, session = session.get()] {
+                try {
+                    session->Program->Run();
+                } catch (...) {
+                    session->Failure = std::current_exception();
+                }
+
+                {
+                    std::lock_guard lock(m_mutex);
+                    m_finishedCount++;
+                }
+                m_sessionFinished.notify_all();
+            });
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        bool exitRequested = false;
+        {
+            std::unique_lock lock(m_mutex);
+            while (m_finishedCount < m_sessions.size()) {
+                auto wakeTime = std::chrono::steady_clock::now() + m_options.ReportInterval;
+                if (m_options.Duration.count() > 0 && !exitRequested) {
+                    wakeTime = std::min(wakeTime, start + m_options.Duration);
+                }
+
+                if (m_sessionFinished.wait_until(lock, wakeTime, [this] { return m_finishedCount == m_sessions.size(); })) {
+                    break;
+                }
+
+                if (m_options.Duration.count() > 0 && !exitRequested && std::chrono::steady_clock::now() >= start + m_options.Duration) {
+                    exitRequested = true;
+                    lock.unlock();
+                    RequestExit();
+                    lock.lock();
+                    continue;
+                }
+
+                const Report report = MakeReport();
+                DEBUG_PRINT("%u sessions, %u within budget, %.2f ms average frame",
+                            report.SessionCount,
+                            report.SessionsWithinBudget,
+                            report.AverageFrameMilliseconds);
+            }
+        }
+
+        JoinSessions();
+
+        for (const std::unique_ptr<Session>& session : m_sessions) {
+            if (session->Failure) {
+                std::rethrow_exception(session->Failure);
+            }
+        }
+
+        return MakeReport();
+    }
+
+    SessionHost::SweepReport SessionHost::Sweep(const ProgramFactory& factory, Options options, uint32_t maxSessionCount) {
+        CHECK_MSG(options.Duration.count() > 0, "A sweep needs a duration for each session count");
+
+        SweepReport sweep;
+        sweep.PhysicalCores = PhysicalCoreCount();
+        for (uint32_t sessionCount = 1; sessionCount <= maxSessionCount; sessionCount++) {
+            options.SessionCount = sessionCount;
+            const Report report = SessionHost(factory, options).Run();
+            sweep.Steps.push_back(report);
+            DEBUG_PRINT("Sweep: %u sessions, %u within budget, %.2f ms average frame",
+                        report.SessionCount,
+                        report.SessionsWithinBudget,
+                        report.AverageFrameMilliseconds);
+
+            if (report.SessionsWithinBudget < report.SessionCount) {
+                break;
+            }
+            sweep.MaxSessionsWithinBudget = sessionCount;
+        }
+
+        // Every session of the largest passing count kept the fixed budget, so this is capacity rather than throughput.
+        sweep.SessionsPerCore = (double)sweep.MaxSessionsWithinBudget / sweep.PhysicalCores;
+        DEBUG_PRINT("Sweep: %u sessions within budget on %u cores, %.2f sessions per core",
+                    sweep.MaxSessionsWithinBudget,
+                    sweep.PhysicalCores,
+                    sweep.SessionsPerCore);
+        return sweep;
+    }
+
+    void SessionHost::RequestExit() {
+        for (const std::unique_ptr<Session>& session : m_sessions) {
+            session->Program->RequestExit();
+        }
+    }
+
+    void SessionHost::JoinSessions() {
+        for (const std::unique_ptr<Session>& session : m_sessions) {
+            if (session->Thread.joinable()) {
+                session->Thread.join();
+            }
+        }
+    }
+
+    SessionHost::Report SessionHost::MakeReport() const {
+        Report report;
+        report.SessionCount = (uint32_t)m_sessions.size();
+
+        uint64_t totalMicroseconds = 0;
+        for (const std::unique_ptr<Session>& session : m_sessions) {
+            const uint64_t frames = session->Frames.load(std::memory_order_relaxed);
+            const uint64_t overBudget = session->FramesOverBudget.load(std::memory_order_relaxed);
+            report.Frames += frames;
+            totalMicroseconds += session->FrameMicroseconds.load(std::memory_order_relaxed);
+
+            if (frames > 0 && overBudget <= frames * m_options.MaxOverBudgetRatio) {
+                report.SessionsWithinBudget++;
+            }
+        }
+
+        if (report.Frames > 0) {
+            report.AverageFrameMilliseconds = totalMicroseconds / 1000.0 / report.Frames;
+        }
+        return report;
+    }
+} // namespace sample::host
@@ -0,0 +1,95 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include "App.h"
+#include <condition_variable>
+#include <mutex>
+
+namespace sample::host {
+
+    // Drives several independent OpenXR programs in one process. Each has its own instance, session and frame loop
+    // thread, because xrWaitFrame blocks per session. Sessions share the process job system, and immutable resources such
+    // as compiled shaders through sample::dx::CompileShaderCached, so each additional session only pays for its device
+    // objects and swapchains.
+    class SessionHost {
+    public:
+        struct Options {
+            uint32_t SessionCount{1};
+            std::chrono::microseconds FrameBudget{11111}; // 90Hz
+            double MaxOverBudgetRatio{0.01};              // A session may miss the budget in 1% of its frames
+            std::chrono::seconds ReportInterval{5};
+            std::chrono::seconds Duration{0}; // Request all sessions to exit after this long. Zero runs until they exit.
+        };
+
+        // Creates the program for the given session index.
+        using ProgramFactory = std::function<std::unique_ptr<sample::IOpenXrProgram>(uint32_t sessionIndex)>;
+
+        struct Report {
+            uint32_t SessionCount{0};
+            uint32_t SessionsWithinBudget{0};
+            uint64_t Frames{0};
+            double AverageFrameMilliseconds{0};
+        };
+
+        struct SweepReport {
+            std::vector<Report> Steps;           // One per session count, ending with the first count over budget
+            uint32_t MaxSessionsWithinBudget{0}; // Largest count at which every session kept the budget
+            uint32_t PhysicalCores{0};
+            double SessionsPerCore{0}; // MaxSessionsWithinBudget divided by PhysicalCores
+        };
+
+        SessionHost(ProgramFactory factory, Options options);
+        ~SessionHost();
+
+        SessionHost(const SessionHost&) = delete;
+        SessionHost& operator=(const SessionHost&) = delete;
+
+        // Run all sessions until they exit or Options::Duration elapsed, logging a report every ReportInterval.
+        // Rethrows the first failure of any session after all of them have stopped.
+        Report Run();
+
+        // Ask all sessions to exit. Callable from any thread.
+        void RequestExit();
+
+        // Runs 1, 2, ... up to maxSessionCount sessions, each count for Options::Duration, and stops at the first count
+        // at which a session misses the budget. Options::SessionCount is ignored.
+        static SweepReport Sweep(const ProgramFactory& factory, Options options, uint32_t maxSessionCount);
+
+    private:
+        struct Session {
+            std::unique_ptr<sample::IOpenXrProgram> Program;
+            std::thread Thread;
+            std::atomic<uint64_t> Frames{0};
+            std::atomic<uint64_t> FramesOverBudget{0};
+            std::atomic<uint64_t> FrameMicroseconds{0};
+            std::exception_ptr Failure;
+        };
+
+        Report MakeReport() const;
+        void JoinSessions();
+
+        const ProgramFactory m_factory;
+        const Options m_options;
+
+        std::vector<std::unique_ptr<Session>> m_sessions;
+
+        std::mutex m_mutex;
+        std::condition_variable m_sessionFinished;
+        uint32_t m_finishedCount{0};
+    };
+
+} // namespace sample::host
@@ -0,0 +1,529 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "SessionTrace.h"
+
+#ifndef _WIN32
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr uint32_t TraceMagic = 0x52545258; // "XRTR"
+    constexpr uint32_t TraceVersion = 2; // 2 added space velocities
+    constexpr uint64_t InitialCapacity = 16 * 1024 * 1024;
+    constexpr uint32_t MaxVarintBytes = 10;
+
+    // Size is updated after every record, so a trace of a crashed session stays readable up to its last record.
+    struct TraceHeader {
+        uint32_t Magic;
+        uint32_t Version;
+        uint64_t Size;
+    };
+
+    uint64_t ZigZag(int64_t value) {
+        return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    }
+
+    int64_t UnZigZag(uint64_t value) {
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    uint32_t FloatBits(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float BitsFloat(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Only the typed part of an event is stored, not the whole XrEventDataBuffer.
+    size_t EventSize(XrStructureType type) {
+        switch (type) {
+        case XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED:
+            return sizeof(XrEventDataSessionStateChanged);
+        case XR_TYPE_EVENT_DATA_INSTANCE_LOSS_PENDING:
+            return sizeof(XrEventDataInstanceLossPending);
+        case XR_TYPE_EVENT_DATA_INTERACTION_PROFILE_CHANGED:
+            return sizeof(XrEventDataInteractionProfileChanged);
+        case XR_TYPE_EVENT_DATA_REFERENCE_SPACE_CHANGE_PENDING:
+            return sizeof(XrEventDataReferenceSpaceChangePending);
+        default:
+            return sizeof(XrEventDataBaseHeader);
+        }
+    }
+} // namespace
+
+namespace sample::trace {
+    TraceWriter::TraceWriter(const std::wstring& path) {
+#ifdef _WIN32
+        m_file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        CHECK_MSG(m_file != INVALID_HANDLE_VALUE, "Cannot create trace file");
+#else
+        m_file = open(std::filesystem::path(path).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        CHECK_MSG(m_file >= 0, "Cannot create trace file");
+#endif
+
+        Map(InitialCapacity);
+        const TraceHeader header{TraceMagic, TraceVersion, sizeof(TraceHeader)};
+        std::memcpy(m_data, &header, sizeof(header));
+        m_size = sizeof(header);
+    }
+
+    TraceWriter::~TraceWriter() {
+        Unmap();
+
+        // The mapping grew the file to its capacity, cut it back to what was written.
+#ifdef _WIN32
+        LARGE_INTEGER size;
+        size.QuadPart = m_size;
+        SetFilePointerEx(m_file, size, nullptr, FILE_BEGIN);
+        SetEndOfFile(m_file);
+        CloseHandle(m_file);
+#else
+        (void)ftruncate(m_file, (off_t)m_size);
+        close(m_file);
+#endif
+    }
+
+    void TraceWriter::RecordFrameState(const XrFrameState& frameState) {
+        BeginRecord(RecordKind::FrameState, frameState.predictedDisplayTime);
+        WriteVarint(ZigZag(frameState.predictedDisplayPeriod - m_lastPeriod));
+        WriteVarint(frameState.shouldRender);
+        m_lastPeriod = frameState.predictedDisplayPeriod;
+        EndRecord();
+    }
+
+    void TraceWriter::RecordViews(XrTime displayTime, const XrViewState& viewState, const XrView* views, uint32_t viewCount) {
+        BeginRecord(RecordKind::Views, displayTime, viewCount * 11 * MaxVarintBytes);
+        WriteVarint(viewState.viewStateFlags);
+        WriteVarint(viewCount);
+
+        m_lastViews.resize(viewCount, {XR_TYPE_VIEW});
+        for (uint32_t i = 0; i < viewCount; i++) {
+            WritePose(views[i].pose, &m_lastViews[i].pose);
+            WriteFloat(views[i].fov.angleLeft, &m_lastViews[i].fov.angleLeft);
+            WriteFloat(views[i].fov.angleRight, &m_lastViews[i].fov.angleRight);
+            WriteFloat(views[i].fov.angleUp, &m_lastViews[i].fov.angleUp);
+            WriteFloat(views[i].fov.angleDown, &m_lastViews[i].fov.angleDown);
+        }
+        EndRecord();
+    }
+
+    void TraceWriter::RecordSpaceLocation(XrTime time, XrSpace space, const XrSpaceLocation& location, const XrSpaceVelocity* velocity) {
+        const auto [it, added] = m_spaceIds.emplace(space, (uint32_t)m_lastSpacePoses.size());
+        if (added) {
+            m_lastSpacePoses.push_back({});
+            m_lastSpaceVelocities.push_back({XR_TYPE_SPACE_VELOCITY});
+        }
+        const uint32_t spaceId = it->second;
+
+        BeginRecord(RecordKind::SpaceLocation, time, 6 * MaxVarintBytes);
+        WriteVarint(spaceId);
+        WriteVarint(location.locationFlags);
+        WritePose(location.pose, &m_lastSpacePoses[spaceId]);
+
+        // Only the valid velocities are stored, after their flags.
+        const XrSpaceVelocityFlags velocityFlags = velocity != nullptr ? velocity->velocityFlags : 0;
+        XrSpaceVelocity& lastVelocity = m_lastSpaceVelocities[spaceId];
+        WriteVarint(velocityFlags);
+        if (velocityFlags & XR_SPACE_VELOCITY_LINEAR_VALID_BIT) {
+            WriteVector(velocity->linearVelocity, &lastVelocity.linearVelocity);
+        }
+        if (velocityFlags & XR_SPACE_VELOCITY_ANGULAR_VALID_BIT) {
+            WriteVector(velocity->angularVelocity, &lastVelocity.angularVelocity);
+        }
+        EndRecord();
+    }
+
+    void TraceWriter::DeclareSpace(XrSpace space, uint32_t spaceId) {
+        CHECK(spaceId <= m_lastSpacePoses.size());
+        if (spaceId == m_lastSpacePoses.size()) {
+            m_lastSpacePoses.push_back({});
+            m_lastSpaceVelocities.push_back({XR_TYPE_SPACE_VELOCITY});
+        }
+        m_spaceIds[space] = spaceId;
+    }
+
+    void TraceWriter::RecordActionChange(const input::ActionChange& change) {
+        BeginRecord(RecordKind::ActionChange, m_lastTime);
+        WriteVarint((uint8_t)change.Kind);
+        WriteVarint(change.Index);
+
+        float zero = 0;
+        switch (change.Kind) {
+        case input::ActionChange::ActionKind::Boolean:
+            WriteVarint(change.Boolean.currentState);
+            WriteVarint(change.Boolean.changedSinceLastSync);
+            WriteVarint(ZigZag(change.Boolean.lastChangeTime - m_lastTime));
+            WriteVarint(change.Boolean.isActive);
+            break;
+        case input::ActionChange::ActionKind::Float:
+            WriteFloat(change.Float.currentState, &zero);
+            WriteVarint(change.Float.changedSinceLastSync);
+            WriteVarint(ZigZag(change.Float.lastChangeTime - m_lastTime));
+            WriteVarint(change.Float.isActive);
+            break;
+        case input::ActionChange::ActionKind::Vector2f:
+            WriteFloat(change.Vector2f.currentState.x, &zero);
+            zero = 0;
+            WriteFloat(change.Vector2f.currentState.y, &zero);
+            WriteVarint(change.Vector2f.changedSinceLastSync);
+            WriteVarint(ZigZag(change.Vector2f.lastChangeTime - m_lastTime));
+            WriteVarint(change.Vector2f.isActive);
+            break;
+        case input::ActionChange::ActionKind::Pose:
+            WriteVarint(change.Pose.isActive);
+            break;
+        }
+        EndRecord();
+    }
+
+    void TraceWriter::RecordEvent(const XrEventDataBuffer& event) {
+        const size_t size = EventSize(event.type);
+        BeginRecord(RecordKind::Event, m_lastTime, size);
+        WriteVarint(event.type);
+        WriteVarint(size);
+        std::memcpy(m_data + m_size, &event, size);
+        m_size += size;
+        EndRecord();
+    }
+
+    void TraceWriter::BeginRecord(RecordKind kind, XrTime time, size_t maxPayloadSize) {
+        // Every record fits into a few varints plus its variable payload, so grow once up front instead of per byte.
+        Reserve(1 + 16 * MaxVarintBytes + maxPayloadSize);
+        m_data[m_size++] = (uint8_t)kind;
+        WriteVarint(ZigZag(time - m_lastTime));
+        m_lastTime = time;
+    }
+
+    void TraceWriter::EndRecord() {
+        reinterpret_cast<TraceHeader*>(m_data)->Size = m_size;
+    }
+
+    void TraceWriter::WriteVarint(uint64_t value) {
+        while (value >= 0x80) {
+            m_data[m_size++] = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        m_data[m_size++] = (uint8_t)value;
+    }
+
+    void TraceWriter::WriteFloat(float value, float* previous) {
+        // Nearby floats share sign, exponent and high mantissa bits, so their XOR is a small integer.
+        WriteVarint(FloatBits(value) ^ FloatBits(*previous));
+        *previous = value;
+    }
+
+    void TraceWriter::WritePose(const XrPosef& pose, XrPosef* previous) {
+        WriteFloat(pose.orientation.x, &previous->orientation.x);
+        WriteFloat(pose.orientation.y, &previous->orientation.y);
+        WriteFloat(pose.orientation.z, &previous->orientation.z);
+        WriteFloat(pose.orientation.w, &previous->orientation.w);
+        WriteFloat(pose.position.x, &previous->position.x);
+        WriteFloat(pose.position.y, &previous->position.y);
+        WriteFloat(pose.position.z, &previous->position.z);
+    }
+
+    void TraceWriter::WriteVector(const XrVector3f& vector, XrVector3f* previous) {
+        WriteFloat(vector.x, &previous->x);
+        WriteFloat(vector.y, &previous->y);
+        WriteFloat(vector.z, &previous->z);
+    }
+
+    void TraceWriter::Reserve(size_t bytes) {
+        if (m_size + bytes > m_capacity) {
+            Unmap();
+            Map(std::max(m_capacity * 2, m_size + bytes));
+        }
+    }
+
+    void TraceWriter::Map(uint64_t capacity) {
+#ifdef _WIN32
+        m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE, (DWORD)(capacity >> 32), (DWORD)capacity, nullptr);
+        CHECK_MSG(m_mapping != nullptr, "CreateFileMapping failed");
+        m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, 0));
+        CHECK_MSG(m_data != nullptr, "MapViewOfFile failed");
+#else
+        // Unlike a Win32 mapping, mmap does not grow the file, so extend it first.
+        CHECK_MSG(ftruncate(m_file, (off_t)capacity) == 0, "ftruncate failed");
+        void* data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+        CHECK_MSG(data != MAP_FAILED, "mmap failed");
+        m_data = static_cast<uint8_t*>(data);
+#endif
+        m_capacity = capacity;
+    }
+
+    void TraceWriter::Unmap() {
+#ifdef _WIN32
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+            m_data = nullptr;
+        }
+        if (m_mapping) {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+#else
+        if (m_data) {
+            munmap(m_data, m_capacity);
+            m_data = nullptr;
+        }
+#endif
+    }
+
+    TraceReader::TraceReader(const std::wstring& path) {
+#ifdef _WIN32
+        m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        CHECK_MSG(m_file != INVALID_HANDLE_VALUE, "Cannot open trace file");
+
+        LARGE_INTEGER size;
+        CHECK(GetFileSizeEx(m_file, &size));
+        const uint64_t fileSize = size.QuadPart;
+        CHECK_MSG(fileSize >= sizeof(TraceHeader), "Trace file is too small");
+
+        m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CHECK_MSG(m_mapping != nullptr, "CreateFileMapping failed");
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        CHECK_MSG(m_data != nullptr, "MapViewOfFile failed");
+#else
+        m_file = open(std::filesystem::path(path).c_str(), O_RDONLY);
+        CHECK_MSG(m_file >= 0, "Cannot open trace file");
+
+        struct stat status;
+        CHECK(fstat(m_file, &status) == 0);
+        const uint64_t fileSize = status.st_size;
+        CHECK_MSG(fileSize >= sizeof(TraceHeader), "Trace file is too small");
+
+        void* data = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, m_file, 0);
+        CHECK_MSG(data != MAP_FAILED, "mmap failed");
+        m_data = static_cast<const uint8_t*>(data);
+        m_mappedSize = fileSize;
+#endif
+
+        const TraceHeader* header = reinterpret_cast<const TraceHeader*>(m_data);
+        CHECK_MSG(header->Magic == TraceMagic && header->Version >= 1 && header->Version <= TraceVersion, "Not a trace file");
+        m_version = header->Version;
+        m_size = std::min<uint64_t>(header->Size, fileSize);
+        m_offset = sizeof(TraceHeader);
+    }
+
+    TraceReader::~TraceReader() {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+#else
+        munmap(const_cast<uint8_t*>(m_data), m_mappedSize);
+        close(m_file);
+#endif
+    }
+
+    bool TraceReader::Next(Record* record) {
+        if (m_offset >= m_size) {
+            return false;
+        }
+
+        record->Kind = (RecordKind)m_data[m_offset++];
+        record->Time = m_lastTime + UnZigZag(ReadVarint());
+        m_lastTime = record->Time;
+
+        switch (record->Kind) {
+        case RecordKind::FrameState: {
+            m_lastPeriod += UnZigZag(ReadVarint());
+            record->FrameState = {XR_TYPE_FRAME_STATE};
+            record->FrameState.predictedDisplayTime = record->Time;
+            record->FrameState.predictedDisplayPeriod = m_lastPeriod;
+            record->FrameState.shouldRender = (XrBool32)ReadVarint();
+            break;
+        }
+        case RecordKind::Views: {
+            record->ViewState = {XR_TYPE_VIEW_STATE};
+            record->ViewState.viewStateFlags = ReadVarint();
+            const uint32_t viewCount = (uint32_t)ReadVarint();
+            CHECK_MSG(viewCount <= 16, "Corrupt trace");
+
+            m_lastViews.resize(viewCount, {XR_TYPE_VIEW});
+            record->Views.resize(viewCount, {XR_TYPE_VIEW});
+            for (uint32_t i = 0; i < viewCount; i++) {
+                XrView& view = record->Views[i];
+                ReadPose(&view.pose, &m_lastViews[i].pose);
+                view.fov.angleLeft = ReadFloat(&m_lastViews[i].fov.angleLeft);
+                view.fov.angleRight = ReadFloat(&m_lastViews[i].fov.angleRight);
+                view.fov.angleUp = ReadFloat(&m_lastViews[i].fov.angleUp);
+                view.fov.angleDown = ReadFloat(&m_lastViews[i].fov.angleDown);
+            }
+            break;
+        }
+        case RecordKind::SpaceLocation: {
+            record->SpaceId = (uint32_t)ReadVarint();
+            CHECK_MSG(record->SpaceId <= m_lastSpacePoses.size(), "Corrupt trace");
+            if (record->SpaceId == m_lastSpacePoses.size()) {
+                m_lastSpacePoses.push_back({});
+                m_lastSpaceVelocities.push_back({XR_TYPE_SPACE_VELOCITY});
+            }
+            record->SpaceLocation = {XR_TYPE_SPACE_LOCATION};
+            record->SpaceLocation.locationFlags = ReadVarint();
+            ReadPose(&record->SpaceLocation.pose, &m_lastSpacePoses[record->SpaceId]);
+
+            XrSpaceVelocity& lastVelocity = m_lastSpaceVelocities[record->SpaceId];
+            record->SpaceVelocity = {XR_TYPE_SPACE_VELOCITY};
+            record->SpaceVelocity.velocityFlags = m_version >= 2 ? ReadVarint() : 0;
+            if (record->SpaceVelocity.velocityFlags & XR_SPACE_VELOCITY_LINEAR_VALID_BIT) {
+                ReadVector(&record->SpaceVelocity.linearVelocity, &lastVelocity.linearVelocity);
+            }
+            if (record->SpaceVelocity.velocityFlags & XR_SPACE_VELOCITY_ANGULAR_VALID_BIT) {
+                ReadVector(&record->SpaceVelocity.angularVelocity, &lastVelocity.angularVelocity);
+            }
+            break;
+        }
+        case RecordKind::ActionChange: {
+            input::ActionChange& change = record->ActionChange;
+            change = {};
+            change.Kind = (input::ActionChange::ActionKind)ReadVarint();
+            change.Index = (uint32_t)ReadVarint();
+
+            float zero = 0;
+            switch (change.Kind) {
+            case input::ActionChange::ActionKind::Boolean:
+                change.Boolean = {XR_TYPE_ACTION_STATE_BOOLEAN};
+                change.Boolean.currentState = (XrBool32)ReadVarint();
+                change.Boolean.changedSinceLastSync = (XrBool32)ReadVarint();
+                change.Boolean.lastChangeTime = record->Time + UnZigZag(ReadVarint());
+                change.Boolean.isActive = (XrBool32)ReadVarint();
+                break;
+            case input::ActionChange::ActionKind::Float:
+                change.Float = {XR_TYPE_ACTION_STATE_FLOAT};
+                change.Float.currentState = ReadFloat(&zero);
+                change.Float.changedSinceLastSync = (XrBool32)ReadVarint();
+                change.Float.lastChangeTime = record->Time + UnZigZag(ReadVarint());
+                change.Float.isActive = (XrBool32)ReadVarint();
+                break;
+            case input::ActionChange::ActionKind::Vector2f:
+                change.Vector2f = {XR_TYPE_ACTION_STATE_VECTOR2F};
+                change.Vector2f.currentState.x = ReadFloat(&zero);
+                zero = 0;
+                change.Vector2f.currentState.y = ReadFloat(&zero);
+                change.Vector2f.changedSinceLastSync = (XrBool32)ReadVarint();
+                change.Vector2f.lastChangeTime = record->Time + UnZigZag(ReadVarint());
+                change.Vector2f.isActive = (XrBool32)ReadVarint();
+                break;
+            case input::ActionChange::ActionKind::Pose:
+                change.Pose = {XR_TYPE_ACTION_STATE_POSE};
+                change.Pose.isActive = (XrBool32)ReadVarint();
+                break;
+            default:
+                THROW("Corrupt trace");
+            }
+            break;
+        }
+        case RecordKind::Event: {
+            const XrStructureType type = (XrStructureType)ReadVarint();
+            const uint64_t size = ReadVarint();
+            CHECK_MSG(size >= sizeof(XrEventDataBaseHeader) && size <= sizeof(XrEventDataBuffer) && size <= m_size - m_offset,
+                      "Corrupt trace");
+
+            record->Event = {XR_TYPE_EVENT_DATA_BUFFER};
+            std::memcpy(&record->Event, m_data + m_offset, size);
+            m_offset += size;
+
+            // Handles and pointers in the event belonged to the recorded process.
+            XrEventDataBaseHeader* header = reinterpret_cast<XrEventDataBaseHeader*>(&record->Event);
+            header->type = type;
+            header->next = nullptr;
+            break;
+        }
+        default:
+            THROW("Corrupt trace");
+        }
+
+        return true;
+    }
+
+    uint64_t TraceReader::ReadVarint() {
+        uint64_t value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            CHECK_MSG(m_offset < m_size, "Truncated trace");
+            const uint8_t byte = m_data[m_offset++];
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        THROW("Corrupt trace");
+    }
+
+    float TraceReader::ReadFloat(float* previous) {
+        *previous = BitsFloat((uint32_t)ReadVarint() ^ FloatBits(*previous));
+        return *previous;
+    }
+
+    void TraceReader::ReadPose(XrPosef* pose, XrPosef* previous) {
+        pose->orientation.x = ReadFloat(&previous->orientation.x);
+        pose->orientation.y = ReadFloat(&previous->orientation.y);
+        pose->orientation.z = ReadFloat(&previous->orientation.z);
+        pose->orientation.w = ReadFloat(&previous->orientation.w);
+        pose->position.x = ReadFloat(&previous->position.x);
+        pose->position.y = ReadFloat(&previous->position.y);
+        pose->position.z = ReadFloat(&previous->position.z);
+    }
+
+    void TraceReader::ReadVector(XrVector3f* vector, XrVector3f* previous) {
+        vector->x = ReadFloat(&previous->x);
+        vector->y = ReadFloat(&previous->y);
+        vector->z = ReadFloat(&previous->z);
+    }
+
+    TraceReplayer::TraceReplayer(const std::wstring& path, Pace pace)
+        : m_reader(path)
+        , m_pace(pace) {
+    }
+
+    TraceReplayer::Result TraceReplayer::Run(const std::function<void(const Record&)>& target) {
+        Result result;
+        Record record;
+        std::optional<XrTime> firstTime;
+        const auto start = std::chrono::steady_clock::now();
+
+        while (m_reader.Next(&record)) {
+            if (m_pace == Pace::Original) {
+                // Record times are runtime display times in nanoseconds, replay them relative to the first record.
+                if (!firstTime) {
+                    firstTime = record.Time;
+                }
+                std::this_thread::sleep_until(start + std::chrono::nanoseconds(record.Time - firstTime.value()));
+            }
+
+            target(record);
+
+            result.Records++;
+            if (record.Kind == RecordKind::FrameState) {
+                result.Frames++;
+            }
+        }
+
+        result.Duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        return result;
+    }
+} // namespace sample::trace
@@ -0,0 +1,162 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include "ActionCache.h"
+
+namespace sample::trace {
+
+    enum class RecordKind : uint8_t {
+        FrameState = 1, // xrWaitFrame result
+        Views = 2,      // xrLocateViews result
+        SpaceLocation = 3,
+        ActionChange = 4, // Action state dispatched to the app
+        Event = 5,        // Event returned by xrPollEvent
+    };
+
+    // One decoded trace record. Only the members of its Kind are valid.
+    struct Record {
+        RecordKind Kind{};
+        XrTime Time{0};
+        XrFrameState FrameState{XR_TYPE_FRAME_STATE};
+        XrViewState ViewState{XR_TYPE_VIEW_STATE};
+        std::vector<XrView> Views;
+        uint32_t SpaceId{0}; // Spaces are numbered in the order they were declared or first recorded
+        XrSpaceLocation SpaceLocation{XR_TYPE_SPACE_LOCATION};
+        XrSpaceVelocity SpaceVelocity{XR_TYPE_SPACE_VELOCITY}; // No valid bit when located without a velocity
+        input::ActionChange ActionChange{};
+        XrEventDataBuffer Event{XR_TYPE_EVENT_DATA_BUFFER};
+    };
+
+    // Appends everything the app consumes from the runtime to a memory-mapped file, mapped with Win32 or POSIX mmap.
+    // Times are stored as varint deltas to the previous record, and floats as the XOR of their bits with the same
+    // value in the previous record of that kind, so unchanged or slowly changing values take one or two bytes.
+    // Not thread safe. Call from the render thread only.
+    class TraceWriter {
+    public:
+        explicit TraceWriter(const std::wstring& path);
+        ~TraceWriter();
+
+        TraceWriter(const TraceWriter&) = delete;
+        TraceWriter& operator=(const TraceWriter&) = delete;
+
+        void RecordFrameState(const XrFrameState& frameState);
+        void RecordViews(XrTime displayTime, const XrViewState& viewState, const XrView* views, uint32_t viewCount);
+        void RecordSpaceLocation(XrTime time, XrSpace space, const XrSpaceLocation& location, const XrSpaceVelocity* velocity = nullptr);
+
+        // Gives a space a fixed id ahead of its first location, so a replay can tell spaces apart by how they were created.
+        // The id is either taken already, e.g. by the same hand in a previous session, or the next free one.
+        void DeclareSpace(XrSpace space, uint32_t spaceId);
+
+        // Action changes and events carry no display time, they are recorded at the time of the previous record.
+        void RecordActionChange(const input::ActionChange& change);
+        void RecordEvent(const XrEventDataBuffer& event);
+
+        uint64_t Size() const {
+            return m_size;
+        }
+
+    private:
+        void BeginRecord(RecordKind kind, XrTime time, size_t maxPayloadSize = 0);
+        void EndRecord();
+        void WriteVarint(uint64_t value);
+        void WriteFloat(float value, float* previous);
+        void WritePose(const XrPosef& pose, XrPosef* previous);
+        void WriteVector(const XrVector3f& vector, XrVector3f* previous);
+        void Reserve(size_t bytes);
+        void Map(uint64_t capacity);
+        void Unmap();
+
+#ifdef _WIN32
+        HANDLE m_file{INVALID_HANDLE_VALUE};
+        HANDLE m_mapping{nullptr};
+#else
+        int m_file{-1};
+#endif
+        uint8_t* m_data{nullptr};
+        uint64_t m_capacity{0};
+        uint64_t m_size{0};
+
+        XrTime m_lastTime{0};
+        XrDuration m_lastPeriod{0};
+        std::vector<XrView> m_lastViews;
+        std::unordered_map<XrSpace, uint32_t> m_spaceIds;
+        std::vector<XrPosef> m_lastSpacePoses;
+        std::vector<XrSpaceVelocity> m_lastSpaceVelocities; // Parallel to m_lastSpacePoses
+    };
+
+    // Decodes a trace written by TraceWriter from a read-only mapping of the file.
+    class TraceReader {
+    public:
+        explicit TraceReader(const std::wstring& path);
+        ~TraceReader();
+
+        TraceReader(const TraceReader&) = delete;
+        TraceReader& operator=(const TraceReader&) = delete;
+
+        // Returns false at the end of the trace.
+        bool Next(Record* record);
+
+    private:
+        uint64_t ReadVarint();
+        float ReadFloat(float* previous);
+        void ReadPose(XrPosef* pose, XrPosef* previous);
+        void ReadVector(XrVector3f* vector, XrVector3f* previous);
+
+#ifdef _WIN32
+        HANDLE m_file{INVALID_HANDLE_VALUE};
+        HANDLE m_mapping{nullptr};
+#else
+        int m_file{-1};
+        uint64_t m_mappedSize{0};
+#endif
+        const uint8_t* m_data{nullptr};
+        uint64_t m_size{0};
+        uint64_t m_offset{0};
+        uint32_t m_version{0}; // Version 1 traces have no velocities
+
+        XrTime m_lastTime{0};
+        XrDuration m_lastPeriod{0};
+        std::vector<XrView> m_lastViews;
+        std::vector<XrPosef> m_lastSpacePoses;
+        std::vector<XrSpaceVelocity> m_lastSpaceVelocities; // Parallel to m_lastSpacePoses
+    };
+
+    // Feeds a recorded trace back to the app without a runtime, either at the recorded pace or as fast as possible.
+    class TraceReplayer {
+    public:
+        enum class Pace {
+            Original,
+            AsFastAsPossible,
+        };
+
+        struct Result {
+            uint64_t Records{0};
+            uint64_t Frames{0};
+            std::chrono::microseconds Duration{0};
+        };
+
+        TraceReplayer(const std::wstring& path, Pace pace);
+
+        // Calls target for every record in order, on the calling thread.
+        Result Run(const std::function<void(const Record&)>& target);
+
+    private:
+        TraceReader m_reader;
+        const Pace m_pace;
+    };
+
+} // namespace sample::trace
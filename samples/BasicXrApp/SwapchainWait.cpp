@@ -0,0 +1,95 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "SwapchainWait.h"
+
+namespace {
+    std::chrono::microseconds ElapsedSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    }
+} // namespace
+
+namespace sample::swapchain {
+    ImageWaiter::ImageWaiter(const dispatch::DispatchTable& dispatch, Options options)
+        : m_dispatch(dispatch)
+        , m_options(options) {
+        m_pending.reserve(2); // Color and depth
+    }
+
+    uint32_t ImageWaiter::Acquire(XrSwapchain swapchain) {
+        uint32_t imageIndex;
+        XrSwapchainImageAcquireInfo acquireInfo{XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO};
+        CHECK_XRCMD(m_dispatch.xrAcquireSwapchainImage(swapchain, &acquireInfo, &imageIndex));
+        m_pending.push_back({swapchain, false});
+        return imageIndex;
+    }
+
+    bool ImageWaiter::Poll() {
+        bool allReady = true;
+        for (Pending& pending : m_pending) {
+            if (pending.Ready) {
+                continue;
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            if (TryWait(pending, m_options.PollTimeout)) {
+                m_stats.ImagesReadyEarly++;
+            } else {
+                allReady = false;
+            }
+            m_stats.PollTime += ElapsedSince(start);
+        }
+        return allReady;
+    }
+
+    void ImageWaiter::Wait() {
+        const auto start = std::chrono::steady_clock::now();
+        bool blocked = false;
+        for (Pending& pending : m_pending) {
+            if (pending.Ready) {
+                continue;
+            }
+
+            blocked = true;
+            m_stats.ImagesWaited++;
+            while (!TryWait(pending, m_options.WaitTimeout)) {
+            }
+        }
+        m_pending.clear();
+
+        m_stats.Frames++;
+        if (blocked) {
+            const std::chrono::microseconds blockedTime = ElapsedSince(start);
+            m_stats.BlockedTime += blockedTime;
+            m_stats.MaxBlockedTime = std::max(m_stats.MaxBlockedTime, blockedTime);
+        }
+    }
+
+    WaitStats ImageWaiter::TakeStats() {
+        const WaitStats stats = m_stats;
+        m_stats = {};
+        return stats;
+    }
+
+    bool ImageWaiter::TryWait(Pending& pending, XrDuration timeout) {
+        // An expired wait is retried on the same image by the next call.
+        XrSwapchainImageWaitInfo waitInfo{XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO};
+        waitInfo.timeout = timeout;
+        const XrResult result = CHECK_XRCMD(m_dispatch.xrWaitSwapchainImage(pending.Swapchain, &waitInfo));
+        pending.Ready = result != XR_TIMEOUT_EXPIRED;
+        return pending.Ready;
+    }
+} // namespace sample::swapchain
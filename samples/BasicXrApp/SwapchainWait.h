@@ -0,0 +1,69 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include "XrDispatch.h"
+
+namespace sample::swapchain {
+
+    struct WaitStats {
+        uint64_t Frames{0};
+        uint64_t ImagesReadyEarly{0};                // Found ready by a poll, before the frame needed them
+        uint64_t ImagesWaited{0};                    // Still being read by the compositor when the frame needed them
+        std::chrono::microseconds BlockedTime{0};    // Waiting for those, dead time on the render thread
+        std::chrono::microseconds MaxBlockedTime{0}; // Of one frame
+        std::chrono::microseconds PollTime{0};       // Spent in polls, the cost of overlapping
+    };
+
+    // Swapchain images are acquired as soon as the frame knows it renders, then polled without blocking between the
+    // stages of its CPU work. The render thread only blocks for what is left of the compositor's reads once that work is
+    // done, and always with a short timeout, so a stall shows up in the stats rather than as a hang.
+    class ImageWaiter {
+    public:
+        struct Options {
+            XrDuration PollTimeout{0};         // Only checks whether the image is ready
+            XrDuration WaitTimeout{1'000'000}; // 1 ms, the wait is retried until the image is ready
+        };
+
+        ImageWaiter(const dispatch::DispatchTable& dispatch, Options options);
+
+        // Acquires the next image of the swapchain. Its index may only be rendered to after Wait.
+        uint32_t Acquire(XrSwapchain swapchain);
+
+        // Waits without blocking on the acquired images that are not ready yet. Returns true once all are ready.
+        bool Poll();
+
+        // Blocks until every image acquired since the last Wait is ready, right before rendering into them.
+        void Wait();
+
+        // Stats since the previous call.
+        WaitStats TakeStats();
+
+    private:
+        struct Pending {
+            XrSwapchain Swapchain;
+            bool Ready;
+        };
+
+        bool TryWait(Pending& pending, XrDuration timeout);
+
+        const dispatch::DispatchTable& m_dispatch;
+        const Options m_options;
+        std::vector<Pending> m_pending;
+        WaitStats m_stats;
+    };
+
+} // namespace sample::swapchain
@@ -0,0 +1,157 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+// Checks the CPU mesh passes on a grid: deduplication merges the per-triangle copies of its vertices, cache
+// optimization of shuffled triangles lowers ACMR without losing a triangle, and FloatToHalf rounds like the hardware.
+
+namespace {
+    using namespace sample::mesh;
+
+    int g_failures = 0;
+
+    void Expect(bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "FAILED: %s\n", what);
+            g_failures++;
+        }
+    }
+
+    constexpr uint32_t GridSize = 32;
+
+    // Two triangles per cell, each with its own three vertices, as an exporter writing flat triangle lists would.
+    void MakeUnindexedGrid(std::vector<SourceVertex>& vertices, std::vector<uint32_t>& indices) {
+        auto AddVertex = [&](uint32_t x, uint32_t y) {
+            indices.push_back((uint32_t)vertices.size());
+            vertices.push_back({{(float)x, (float)y, 0}, {x / (float)GridSize, y / (float)GridSize, 1}});
+        };
+        for (uint32_t y = 0; y < GridSize; y++) {
+            for (uint32_t x = 0; x < GridSize; x++) {
+                AddVertex(x, y), AddVertex(x + 1, y), AddVertex(x, y + 1);
+                AddVertex(x + 1, y), AddVertex(x + 1, y + 1), AddVertex(x, y + 1);
+            }
+        }
+    }
+
+    // Rotates each triangle so its smallest index comes first, which keeps its winding, then sorts the triangles.
+    std::vector<std::array<uint32_t, 3>> CanonicalTriangles(const std::vector<uint32_t>& indices) {
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            std::array<uint32_t, 3> triangle{indices[i], indices[i + 1], indices[i + 2]};
+            std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+            triangles.push_back(triangle);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    void TestDeduplicate() {
+        std::vector<SourceVertex> vertices;
+        std::vector<uint32_t> indices;
+        MakeUnindexedGrid(vertices, indices);
+        const std::vector<SourceVertex> original = vertices;
+        const std::vector<uint32_t> originalIndices = indices;
+
+        const uint32_t unique = DeduplicateVertices(vertices, indices);
+        Expect(unique == (GridSize + 1) * (GridSize + 1), "dedup leaves one vertex per grid point");
+        Expect(vertices.size() == unique, "dedup shrinks the vertex buffer to the unique count");
+        Expect(indices.size() == originalIndices.size(), "dedup keeps every index");
+
+        bool samePositions = true;
+        for (size_t i = 0; i < indices.size(); i++) {
+            samePositions &= indices[i] < vertices.size() &&
+                             std::memcmp(&vertices[indices[i]], &original[originalIndices[i]], sizeof(SourceVertex)) == 0;
+        }
+        Expect(samePositions, "dedup keeps every triangle's vertices");
+    }
+
+    void TestVertexCacheOrder() {
+        std::vector<SourceVertex> vertices;
+        std::vector<uint32_t> indices;
+        MakeUnindexedGrid(vertices, indices);
+        DeduplicateVertices(vertices, indices);
+        const uint32_t vertexCount = (uint32_t)vertices.size();
+
+        // Shuffled triangles defeat the cache, so there is something to win back.
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            triangles.push_back({indices[i], indices[i + 1], indices[i + 2]});
+        }
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(7));
+        indices.clear();
+        for (const auto& triangle : triangles) {
+            indices.insert(indices.end(), triangle.begin(), triangle.end());
+        }
+
+        const CacheStats before = AnalyzeVertexCache(indices, vertexCount, 16);
+        const auto trianglesBefore = CanonicalTriangles(indices);
+        OptimizeVertexCache(indices, vertexCount);
+        const CacheStats after = AnalyzeVertexCache(indices, vertexCount, 16);
+
+        Expect(CanonicalTriangles(indices) == trianglesBefore, "cache optimization keeps every triangle and its winding");
+        Expect(after.Acmr < before.Acmr * 0.5f, "cache optimization at least halves the ACMR of shuffled triangles");
+        Expect(after.Acmr < 0.8f, "cache optimization of a grid gets below 0.8 misses per triangle");
+    }
+
+    void TestFloatToHalf() {
+        Expect(FloatToHalf(0.0f) == 0x0000, "half of 0");
+        Expect(FloatToHalf(-0.0f) == 0x8000, "half of -0 keeps the sign");
+        Expect(FloatToHalf(1.0f) == 0x3C00, "half of 1");
+        Expect(FloatToHalf(-2.0f) == 0xC000, "half of -2");
+        Expect(FloatToHalf(65504.0f) == 0x7BFF, "largest finite half");
+
+        // Halfway cases round to the even mantissa.
+        Expect(FloatToHalf(1.0f + std::ldexp(1.0f, -11)) == 0x3C00, "halfway above 1 rounds down to even");
+        Expect(FloatToHalf(1.0f + 3 * std::ldexp(1.0f, -11)) == 0x3C02, "halfway above 1 + ulp rounds up to even");
+        Expect(FloatToHalf(1.0f + 1.5f * std::ldexp(1.0f, -11)) == 0x3C01, "above halfway rounds up");
+        Expect(FloatToHalf(2.0f - std::ldexp(1.0f, -12)) == 0x4000, "rounding carries into the exponent");
+
+        Expect(FloatToHalf(65520.0f) == 0x7C00, "halfway past the largest half rounds to infinity");
+        Expect(FloatToHalf(1e6f) == 0x7C00, "overflow to infinity");
+        Expect(FloatToHalf(-INFINITY) == 0xFC00, "negative infinity");
+        Expect((FloatToHalf(NAN) & 0x7C00) == 0x7C00 && (FloatToHalf(NAN) & 0x3FF) != 0, "NaN stays NaN");
+
+        Expect(FloatToHalf(std::ldexp(1.0f, -14)) == 0x0400, "smallest normal half");
+        Expect(FloatToHalf(std::ldexp(1.0f, -24)) == 0x0001, "smallest denormal half");
+        Expect(FloatToHalf(3 * std::ldexp(1.0f, -25)) == 0x0002, "halfway denormal rounds up to even");
+        Expect(FloatToHalf(std::ldexp(1.0f, -25)) == 0x0000, "half the smallest denormal rounds down to even zero");
+        Expect(FloatToHalf(std::ldexp(1.0f, -30)) == 0x0000, "underflow to zero");
+    }
+} // namespace
+
+int main() {
+    try {
+        TestDeduplicate();
+        TestVertexCacheOrder();
+        TestFloatToHalf();
+    } catch (const std::exception& ex) {
+        std::fprintf(stderr, "FAILED: %s\n", ex.what());
+        return 1;
+    }
+
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,201 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "OcclusionCuller.h"
+
+#include <cstdio>
+#include <random>
+
+// Checks that the occlusion culler never hides a sphere either eye can see. Random scenes of boxes and spheres are seen
+// from two canted eyes, and every culled sphere is ray cast from both eyes: points sampled on it that are inside an
+// eye's frustum and not behind any box prove it visible. Sampling can miss visible points, never invent them, so a
+// reported false cull is always real. Pass a scene count to run more than the default.
+
+namespace {
+    using namespace sample::occlusion;
+
+    int g_failures = 0;
+
+    void Expect(bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "FAILED: %s\n", what);
+            g_failures++;
+        }
+    }
+
+    constexpr xr::math::NearFar ViewNearFar{20.f, 0.1f}; // Reversed-Z, as the views are rendered
+    constexpr uint32_t SpheresPerScene = 1000;
+    constexpr uint32_t SpherePoints = 64;
+
+    struct Box {
+        XrPosef Pose;
+        XrVector3f HalfExtents;
+    };
+
+    XrVector3f Add(const XrVector3f& a, const XrVector3f& b) {
+        return {a.x + b.x, a.y + b.y, a.z + b.z};
+    }
+
+    XrVector3f Scale(const XrVector3f& v, float s) {
+        return {v.x * s, v.y * s, v.z * s};
+    }
+
+    XrVector3f Transform(const XrPosef& pose, const XrVector3f& point) {
+        return Add(xr::math::Quaternion::Rotate(pose.orientation, point), pose.position);
+    }
+
+    // Eyes 64 mm apart, rotated outward by a few degrees like canted displays, with asymmetric fields of view.
+    std::vector<XrView> MakeCantedViews(float headYaw) {
+        constexpr float Cant = 0.08f;
+        std::vector<XrView> views(2, {XR_TYPE_VIEW});
+        const XrQuaternionf head = xr::math::Quaternion::RotationAxisAngle({0, 1, 0}, headYaw);
+        for (uint32_t i = 0; i < views.size(); i++) {
+            const float side = i == 0 ? -1.f : 1.f;
+            const XrPosef eye{xr::math::Quaternion::RotationAxisAngle({0, 1, 0}, -side * Cant), {side * 0.032f, 0, 0}};
+            views[i].pose = xr::math::Pose::Multiply(eye, {head, {0, 0, 0}});
+            views[i].fov = i == 0 ? XrFovf{-0.85f, 0.7f, 0.75f, -0.8f} : XrFovf{-0.7f, 0.85f, 0.75f, -0.8f};
+        }
+        return views;
+    }
+
+    bool InFrustum(const XrView& view, const XrVector3f& point) {
+        const XrVector3f p = Transform(xr::math::Pose::Invert(view.pose), point);
+        const float distance = -p.z;
+        if (distance < ViewNearFar.Far || distance > ViewNearFar.Near) {
+            return false;
+        }
+        return p.x >= std::tan(view.fov.angleLeft) * distance && p.x <= std::tan(view.fov.angleRight) * distance &&
+               p.y >= std::tan(view.fov.angleDown) * distance && p.y <= std::tan(view.fov.angleUp) * distance;
+    }
+
+    // Whether the segment from the eye to the point passes through the box, with the slab test in box space.
+    bool Blocks(const Box& box, const XrVector3f& eye, const XrVector3f& point) {
+        const XrPosef toBox = xr::math::Pose::Invert(box.Pose);
+        const XrVector3f origin = Transform(toBox, eye);
+        const XrVector3f end = Transform(toBox, point);
+        const float o[3]{origin.x, origin.y, origin.z};
+        const float d[3]{end.x - origin.x, end.y - origin.y, end.z - origin.z};
+        const float h[3]{box.HalfExtents.x, box.HalfExtents.y, box.HalfExtents.z};
+        float enter = 0, exit = 1;
+        for (int axis = 0; axis < 3; axis++) {
+            if (std::abs(d[axis]) < 1e-9f) {
+                if (std::abs(o[axis]) > h[axis]) {
+                    return false;
+                }
+                continue;
+            }
+            float t0 = (-h[axis] - o[axis]) / d[axis];
+            float t1 = (h[axis] - o[axis]) / d[axis];
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            enter = std::max(enter, t0);
+            exit = std::min(exit, t1);
+        }
+        // Touching the box at the point itself does not hide it.
+        return enter < exit && enter < 1 - 1e-4f;
+    }
+
+    bool SeenByAnyEye(const std::vector<XrView>& views, const std::vector<Box>& boxes, const XrVector3f& center, float radius) {
+        // Points spread evenly over the sphere on a Fibonacci spiral, plus its center.
+        for (uint32_t i = 0; i <= SpherePoints; i++) {
+            XrVector3f point = center;
+            if (i < SpherePoints) {
+                const float y = 1 - 2 * (i + 0.5f) / SpherePoints;
+                const float ring = std::sqrt(1 - y * y);
+                const float angle = 2.39996323f * i; // Golden angle
+                point = Add(center, Scale({ring * std::cos(angle), y, ring * std::sin(angle)}, radius));
+            }
+            for (const XrView& view : views) {
+                if (!InFrustum(view, point)) {
+                    continue;
+                }
+                const bool blocked =
+                    std::any_of(boxes.begin(), boxes.end(), [&](const Box& box) { return Blocks(box, view.pose.position, point); });
+                if (!blocked) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void TestRandomScene(std::mt19937& random, uint32_t* tested, uint32_t* culled, uint32_t* falseCulls) {
+        std::uniform_real_distribution<float> unit(0, 1);
+        const std::vector<XrView> views = MakeCantedViews(0.3f * unit(random) - 0.15f);
+
+        // Boxes in front of the eyes, a few of them close, up to the number the culler rasterizes.
+        std::vector<Box> boxes(1 + random() % 32);
+        for (Box& box : boxes) {
+            const XrVector3f axis{unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f};
+            const float length = std::sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+            box.Pose = {xr::math::Quaternion::RotationAxisAngle(Scale(axis, 1 / length), 6.2831853f * unit(random)),
+                        {3 * unit(random) - 1.5f, 2 * unit(random) - 1, -0.4f - 3.5f * unit(random)}};
+            box.HalfExtents = {0.05f + 0.4f * unit(random), 0.05f + 0.4f * unit(random), 0.05f + 0.4f * unit(random)};
+        }
+
+        OcclusionCuller culler({});
+        culler.BeginFrame(views.data(), (uint32_t)views.size(), ViewNearFar);
+        for (const Box& box : boxes) {
+            culler.AddOccluder(box.Pose, box.HalfExtents);
+        }
+        culler.Rasterize();
+
+        for (uint32_t i = 0; i < SpheresPerScene; i++) {
+            const XrVector3f center{10 * unit(random) - 5, 6 * unit(random) - 3, -0.2f - 12 * unit(random)};
+            const float radius = 0.01f + 0.3f * unit(random);
+            (*tested)++;
+            if (!culler.IsVisible(center, radius)) {
+                (*culled)++;
+                if (SeenByAnyEye(views, boxes, center, radius)) {
+                    (*falseCulls)++;
+                    std::fprintf(stderr,
+                                 "False cull: sphere at (%.3f, %.3f, %.3f) radius %.3f behind %zu boxes\n",
+                                 center.x,
+                                 center.y,
+                                 center.z,
+                                 radius,
+                                 boxes.size());
+                }
+            }
+        }
+    }
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const uint32_t sceneCount = argc > 1 ? (uint32_t)std::stoul(argv[1]) : 100;
+        std::mt19937 random(42);
+        uint32_t tested = 0, culled = 0, falseCulls = 0;
+        for (uint32_t scene = 0; scene < sceneCount; scene++) {
+            TestRandomScene(random, &tested, &culled, &falseCulls);
+        }
+        std::printf("%u spheres tested, %u culled, %u false culls\n", tested, culled, falseCulls);
+        Expect(falseCulls == 0, "no sphere either eye sees is culled");
+        Expect(culled > tested / 10, "boxes hide a fair share of the spheres, so the check is not vacuous");
+    } catch (const std::exception& ex) {
+        std::fprintf(stderr, "FAILED: %s\n", ex.what());
+        return 1;
+    }
+
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
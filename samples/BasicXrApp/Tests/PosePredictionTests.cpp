@@ -0,0 +1,307 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "PosePrediction.h"
+#include "SessionTrace.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+// Checks VelocityFilter, Extrapolate and LocateAndPredict on their own, then replays the hand locations and velocities of
+// a recorded trace through LocateAndPredict and checks that predicting one display period ahead lands closer to the next
+// recorded pose than not predicting at all.
+// Pass the path of a trace recorded with --record to use it, otherwise a synthesized hand motion is recorded first.
+
+namespace {
+    using namespace sample::prediction;
+
+    int g_failures = 0;
+
+    void Expect(bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "FAILED: %s\n", what);
+            g_failures++;
+        }
+    }
+
+    bool Near(float a, float b, float tolerance = 1e-4f) {
+        return std::abs(a - b) <= tolerance;
+    }
+
+    float Distance(const XrVector3f& a, const XrVector3f& b) {
+        return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+    }
+
+    float AngleBetween(const XrQuaternionf& a, const XrQuaternionf& b) {
+        const float dot = std::abs(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+        return 2 * std::acos(std::min(dot, 1.f));
+    }
+
+    XrSpaceVelocity MakeVelocity(const XrVector3f& linear, const XrVector3f& angular) {
+        XrSpaceVelocity velocity{XR_TYPE_SPACE_VELOCITY};
+        velocity.velocityFlags = XR_SPACE_VELOCITY_LINEAR_VALID_BIT | XR_SPACE_VELOCITY_ANGULAR_VALID_BIT;
+        velocity.linearVelocity = linear;
+        velocity.angularVelocity = angular;
+        return velocity;
+    }
+
+    constexpr XrDuration Milliseconds(int64_t milliseconds) {
+        return milliseconds * 1'000'000;
+    }
+
+    void TestExtrapolateLinear() {
+        VelocityFilter filter;
+        filter.Update(MakeVelocity({1, 0, -2}, {0, 0, 0}), 1);
+
+        const XrPosef pose = Extrapolate(xr::math::Pose::Translation({0, 1, 0}), filter, Milliseconds(100));
+        Expect(Near(pose.position.x, 0.1f) && Near(pose.position.y, 1) && Near(pose.position.z, -0.2f), "linear extrapolation");
+        Expect(AngleBetween(pose.orientation, xr::math::Quaternion::Identity()) < 1e-3f, "no rotation without angular velocity");
+    }
+
+    void TestExtrapolateAngular() {
+        constexpr float HalfPi = 1.57079633f;
+        VelocityFilter filter;
+        filter.Update(MakeVelocity({0, 0, 0}, {0, HalfPi, 0}), 1);
+
+        // A quarter turn about +Y in the base space, applied after the pose's own rotation about +X.
+        const XrPosef start{xr::math::Quaternion::RotationAxisAngle({1, 0, 0}, HalfPi), {0, 0, 0}};
+        const XrPosef pose = Extrapolate(start, filter, Milliseconds(1000));
+        const XrQuaternionf expected =
+            xr::math::Quaternion::Multiply(start.orientation, xr::math::Quaternion::RotationAxisAngle({0, 1, 0}, HalfPi));
+        Expect(AngleBetween(pose.orientation, expected) < 1e-3f, "angular velocity rotates in the base space");
+
+        const XrVector3f forward = xr::math::Quaternion::Rotate(pose.orientation, {1, 0, 0});
+        Expect(Near(forward.x, 0, 1e-3f) && Near(forward.z, -1, 1e-3f), "quarter turn about +Y maps +X to -Z");
+    }
+
+    // A location as a runtime reports it. Handles of the stub dispatch table below are pointers to these.
+    struct Sample {
+        XrTime Time;
+        XrSpaceLocationFlags Flags;
+        XrPosef Pose;
+        XrSpaceVelocity Velocity;
+    };
+
+    XrResult XRAPI_CALL LocateSample(XrSpace space, XrSpace, XrTime, XrSpaceLocation* location) {
+        const Sample& located = *reinterpret_cast<const Sample*>(space);
+        location->locationFlags = located.Flags;
+        location->pose = located.Pose;
+        for (auto next = reinterpret_cast<XrBaseOutStructure*>(location->next); next != nullptr; next = next->next) {
+            if (next->type == XR_TYPE_SPACE_VELOCITY) {
+                auto* velocity = reinterpret_cast<XrSpaceVelocity*>(next);
+                velocity->velocityFlags = located.Velocity.velocityFlags;
+                velocity->linearVelocity = located.Velocity.linearVelocity;
+                velocity->angularVelocity = located.Velocity.angularVelocity;
+            }
+        }
+        return XR_SUCCESS;
+    }
+
+    sample::dispatch::DispatchTable MakeSampleDispatch() {
+        sample::dispatch::DispatchTable dispatch;
+        dispatch.xrLocateSpace = LocateSample;
+        return dispatch;
+    }
+
+    XrSpace ToSpace(const Sample& sample) {
+        return reinterpret_cast<XrSpace>(const_cast<Sample*>(&sample));
+    }
+
+    constexpr XrSpaceLocationFlags TrackedFlags = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT |
+                                                  XR_SPACE_LOCATION_POSITION_TRACKED_BIT | XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT;
+
+    void TestLocateAndPredict() {
+        const sample::dispatch::DispatchTable dispatch = MakeSampleDispatch();
+        const PredictionOptions options{};
+        const Sample moving{Milliseconds(1000), TrackedFlags, xr::math::Pose::Translation({0, 1, 0}), MakeVelocity({1, 0, 0}, {0, 0, 0})};
+
+        VelocityFilter filter;
+        XrSpaceLocation location;
+        XrSpaceVelocity velocity;
+        XrPosef pose;
+        XrSpaceLocationFlags flags = LocateAndPredict(
+            dispatch, ToSpace(moving), XR_NULL_HANDLE, moving.Time, moving.Time + Milliseconds(20), options, filter, &location, &velocity, &pose);
+        Expect(flags == TrackedFlags && location.locationFlags == TrackedFlags, "location flags are returned as located");
+        Expect(Near(pose.position.x, 0.02f) && Near(pose.position.y, 1), "located velocity extrapolates to the display time");
+        Expect(Near(location.pose.position.x, 0) && location.next == nullptr, "location holds the located pose without a next chain");
+        Expect(velocity.velocityFlags == moving.Velocity.velocityFlags && Near(velocity.linearVelocity.x, 1), "velocity holds the located velocity");
+
+        LocateAndPredict(
+            dispatch, ToSpace(moving), XR_NULL_HANDLE, moving.Time, moving.Time + Milliseconds(200), options, filter, &location, &velocity, &pose);
+        Expect(Near(pose.position.x, 0.05f), "extrapolation is clamped to MaxExtrapolation");
+
+        LocateAndPredict(
+            dispatch, ToSpace(moving), XR_NULL_HANDLE, moving.Time, moving.Time - Milliseconds(20), options, filter, &location, &velocity, &pose);
+        Expect(Near(pose.position.x, 0), "never extrapolates backward");
+
+        const Sample lost{Milliseconds(1011), 0, xr::math::Pose::Identity(), MakeVelocity({1, 0, 0}, {0, 0, 0})};
+        flags = LocateAndPredict(
+            dispatch, ToSpace(lost), XR_NULL_HANDLE, lost.Time, lost.Time + Milliseconds(20), options, filter, &location, &velocity, &pose);
+        Expect(flags == 0 && !filter.LinearValid && !filter.AngularValid, "lost tracking resets the filter");
+    }
+
+    void TestFilter() {
+        VelocityFilter filter;
+        filter.Update(MakeVelocity({1, 0, 0}, {0, 0, 2}), 0.25f);
+        Expect(Near(filter.LinearVelocity.x, 1) && Near(filter.AngularVelocity.z, 2), "first sample is taken as is");
+
+        filter.Update(MakeVelocity({3, 0, 0}, {0, 0, 0}), 0.25f);
+        Expect(Near(filter.LinearVelocity.x, 1.5f) && Near(filter.AngularVelocity.z, 1.5f), "later samples are smoothed");
+
+        XrSpaceVelocity lost{XR_TYPE_SPACE_VELOCITY};
+        lost.velocityFlags = XR_SPACE_VELOCITY_ANGULAR_VALID_BIT;
+        lost.angularVelocity = {0, 0, 1};
+        filter.Update(lost, 0.25f);
+        Expect(!filter.LinearValid && filter.AngularValid, "invalid linear velocity is dropped");
+
+        const XrPosef pose = Extrapolate(xr::math::Pose::Translation({1, 2, 3}), filter, Milliseconds(20));
+        Expect(Near(pose.position.x, 1) && Near(pose.position.y, 2) && Near(pose.position.z, 3), "no translation without linear velocity");
+
+        filter.Reset();
+        Expect(!filter.LinearValid && !filter.AngularValid, "reset drops both velocities");
+    }
+
+    // Records a hand sweeping in front of the user and turning the wrist, sampled once per display period like the
+    // frame loop does, with tracking noise on the position and the velocities the runtime reports with it.
+    void RecordHandMotion(const std::wstring& path) {
+        constexpr XrDuration DisplayPeriod = 11'111'111; // 90Hz
+        constexpr int FrameCount = 900;
+        constexpr float TwoPi = 6.28318531f;
+
+        std::mt19937 random(42);
+        std::normal_distribution<float> noise(0, 0.0002f);
+        std::normal_distribution<float> velocityNoise(0, 0.01f);
+
+        sample::trace::TraceWriter writer(path);
+        const XrSpace hand = reinterpret_cast<XrSpace>(uintptr_t{1});
+        writer.DeclareSpace(hand, 0);
+        for (int frame = 0; frame < FrameCount; frame++) {
+            const XrTime time = 1'000'000'000 + frame * DisplayPeriod;
+            const float t = frame * DisplayPeriod * 1e-9f;
+
+            XrSpaceLocation location{XR_TYPE_SPACE_LOCATION};
+            location.locationFlags = TrackedFlags;
+            location.pose.position = {0.3f * std::sin(TwoPi * 0.5f * t) + noise(random),
+                                      -0.2f + 0.1f * std::sin(TwoPi * 0.8f * t) + noise(random),
+                                      -0.4f + noise(random)};
+            const float roll = 0.8f * std::sin(TwoPi * 0.7f * t);
+            const float yaw = 0.5f * std::sin(TwoPi * 0.3f * t);
+            const XrQuaternionf yawRotation = xr::math::Quaternion::RotationAxisAngle({0, 1, 0}, yaw);
+            location.pose.orientation =
+                xr::math::Quaternion::Multiply(xr::math::Quaternion::RotationAxisAngle({0, 0, 1}, roll), yawRotation);
+
+            // The derivatives of the motion above. The roll axis is turned by the yaw applied after it.
+            const float rollRate = 0.8f * TwoPi * 0.7f * std::cos(TwoPi * 0.7f * t);
+            const float yawRate = 0.5f * TwoPi * 0.3f * std::cos(TwoPi * 0.3f * t);
+            const XrVector3f rollAxis = xr::math::Quaternion::Rotate(yawRotation, {0, 0, 1});
+            const XrSpaceVelocity velocity = MakeVelocity(
+                {0.3f * TwoPi * 0.5f * std::cos(TwoPi * 0.5f * t) + velocityNoise(random),
+                 0.1f * TwoPi * 0.8f * std::cos(TwoPi * 0.8f * t) + velocityNoise(random),
+                 velocityNoise(random)},
+                {rollRate * rollAxis.x + velocityNoise(random), rollRate * rollAxis.y + yawRate, rollRate * rollAxis.z + velocityNoise(random)});
+
+            // Tracking is lost for a moment halfway through, as when the hand leaves the cameras' view.
+            if (frame >= FrameCount / 2 && frame < FrameCount / 2 + 10) {
+                location.locationFlags = 0;
+            }
+            writer.RecordSpaceLocation(time, hand, location, location.locationFlags != 0 ? &velocity : nullptr);
+        }
+    }
+
+    void TestRecordedTrace(const std::wstring& path) {
+        std::vector<Sample> samples;
+        sample::trace::TraceReader reader(path);
+        sample::trace::Record record;
+        while (reader.Next(&record)) {
+            // Space 0 is the left hand, declared before the app locates anything else.
+            if (record.Kind == sample::trace::RecordKind::SpaceLocation && record.SpaceId == 0) {
+                samples.push_back({record.Time, record.SpaceLocation.locationFlags, record.SpaceLocation.pose, record.SpaceVelocity});
+            }
+        }
+        Expect(samples.size() > 100, "trace holds enough hand locations");
+        Expect(std::any_of(samples.begin(), samples.end(), [](const Sample& sample) { return sample.Velocity.velocityFlags != 0; }),
+               "trace holds hand velocities");
+
+        // Like the frame loop, locate at one display time and predict to the next one, one period of extra latency,
+        // with the velocities the runtime reported.
+        const sample::dispatch::DispatchTable dispatch = MakeSampleDispatch();
+        const PredictionOptions options{};
+        VelocityFilter filter;
+        double predictedPositionError = 0, stillPositionError = 0;
+        double predictedAngleError = 0, stillAngleError = 0;
+        size_t predictions = 0;
+        for (size_t i = 0; i + 1 < samples.size(); i++) {
+            const Sample& current = samples[i];
+            const Sample& next = samples[i + 1];
+            XrSpaceLocation location;
+            XrSpaceVelocity velocity;
+            XrPosef predicted;
+            const XrSpaceLocationFlags flags = LocateAndPredict(
+                dispatch, ToSpace(current), XR_NULL_HANDLE, current.Time, next.Time, options, filter, &location, &velocity, &predicted);
+            if (!xr::math::Pose::IsPoseValid(flags) || !xr::math::Pose::IsPoseValid(next.Flags)) {
+                continue;
+            }
+
+            predictedPositionError += Distance(predicted.position, next.Pose.position);
+            stillPositionError += Distance(current.Pose.position, next.Pose.position);
+            predictedAngleError += AngleBetween(predicted.orientation, next.Pose.orientation);
+            stillAngleError += AngleBetween(current.Pose.orientation, next.Pose.orientation);
+            predictions++;
+        }
+
+        Expect(predictions > 0, "trace holds consecutive valid hand locations");
+        if (predictions > 0) {
+            std::printf("Mean position error %.2fmm predicted, %.2fmm without prediction\n",
+                        predictedPositionError / predictions * 1000,
+                        stillPositionError / predictions * 1000);
+            std::printf("Mean orientation error %.3f degrees predicted, %.3f degrees without prediction\n",
+                        predictedAngleError / predictions * 57.29578,
+                        stillAngleError / predictions * 57.29578);
+        }
+        Expect(predictedPositionError < 0.5 * stillPositionError, "prediction halves the position error");
+        Expect(predictedAngleError < 0.5 * stillAngleError, "prediction halves the orientation error");
+    }
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        TestExtrapolateLinear();
+        TestExtrapolateAngular();
+        TestFilter();
+        TestLocateAndPredict();
+
+        if (argc > 1) {
+            TestRecordedTrace(std::filesystem::path(argv[1]).wstring());
+        } else {
+            const std::filesystem::path path = std::filesystem::temp_directory_path() / "PosePredictionTests.trace";
+            RecordHandMotion(path.wstring());
+            TestRecordedTrace(path.wstring());
+            std::filesystem::remove(path);
+        }
+    } catch (const std::exception& ex) {
+        std::fprintf(stderr, "FAILED: %s\n", ex.what());
+        return 1;
+    }
+
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
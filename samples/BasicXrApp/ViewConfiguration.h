@@ -0,0 +1,81 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <array>
+#include <utility>
+
+namespace sample::views {
+
+    // Largest view count the render path is compiled for, the quad views of a headset with a focus display per eye.
+    constexpr uint32_t MaxViewCount = 4;
+
+    // View configurations the render path is specialized for, most detailed first.
+    constexpr XrViewConfigurationType SupportedViewConfigurations[] = {
+        XR_VIEW_CONFIGURATION_TYPE_PRIMARY_QUAD_VARJO,
+        XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO,
+        XR_VIEW_CONFIGURATION_TYPE_PRIMARY_MONO,
+    };
+
+    // Views of a configuration, fixed by the OpenXR specification. Zero for configurations the render path lacks.
+    constexpr uint32_t ViewCountOf(XrViewConfigurationType viewConfigurationType) {
+        switch (viewConfigurationType) {
+        case XR_VIEW_CONFIGURATION_TYPE_PRIMARY_MONO:
+            return 1;
+        case XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO:
+            return 2;
+        case XR_VIEW_CONFIGURATION_TYPE_PRIMARY_QUAD_VARJO:
+            return 4; // Left and right context views, then left and right focus views
+        default:
+            return 0;
+        }
+    }
+
+    // Every per-view structure a frame fills, sized by the configuration at compile time. Allocated once per session,
+    // so the frame loop neither allocates nor checks sizes.
+    template <uint32_t Count>
+    struct FrameViews {
+        static_assert(Count > 0 && Count <= MaxViewCount);
+        constexpr static uint32_t ViewCount = Count;
+
+        std::array<XrView, Count> Views;
+        std::array<XrViewConfigurationView, Count> ConfigViews;
+        std::array<xr::math::ViewProjection, Count> ViewProjections;
+        std::array<XrCompositionLayerProjectionView, Count> ProjectionLayerViews;
+        std::array<XrCompositionLayerDepthInfoKHR, Count> DepthInfoViews;
+
+        FrameViews() {
+            Views.fill({XR_TYPE_VIEW});
+            ConfigViews.fill({XR_TYPE_VIEW_CONFIGURATION_VIEW});
+            ProjectionLayerViews.fill({XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW});
+            DepthInfoViews.fill({XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR});
+        }
+    };
+
+    namespace detail {
+        template <typename Function, uint32_t... Index>
+        void ForEachView(Function& function, std::integer_sequence<uint32_t, Index...>) {
+            (function(Index), ...);
+        }
+    } // namespace detail
+
+    // Calls function(viewIndex) for each of Count views, unrolled at compile time.
+    template <uint32_t Count, typename Function>
+    void ForEachView(Function&& function) {
+        detail::ForEachView(function, std::make_integer_sequence<uint32_t, Count>{});
+    }
+
+} // namespace sample::views
@@ -0,0 +1,36 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "pch.h"
+#include "XrDispatch.h"
+
+namespace sample::dispatch {
+    void DispatchTable::Load(XrInstance instance) {
+        CHECK(instance != XR_NULL_HANDLE);
+
+#define SAMPLE_XR_LOAD_CORE_FUNCTION(name) \
+    CHECK_XRCMD(xrGetInstanceProcAddr(instance, #name, reinterpret_cast<PFN_xrVoidFunction*>(&name)));
+        SAMPLE_XR_CORE_FUNCTIONS(SAMPLE_XR_LOAD_CORE_FUNCTION)
+#undef SAMPLE_XR_LOAD_CORE_FUNCTION
+
+        // Functions of extensions that are not enabled are unsupported, and stay null.
+#define SAMPLE_XR_LOAD_EXTENSION_FUNCTION(name)                                                                \
+    if (XR_FAILED(xrGetInstanceProcAddr(instance, #name, reinterpret_cast<PFN_xrVoidFunction*>(&name)))) { \
+        name = nullptr;                                                                                        \
+    }
+        SAMPLE_XR_EXTENSION_FUNCTIONS(SAMPLE_XR_LOAD_EXTENSION_FUNCTION)
+#undef SAMPLE_XR_LOAD_EXTENSION_FUNCTION
+    }
+} // namespace sample::dispatch
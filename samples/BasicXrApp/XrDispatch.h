@@ -0,0 +1,104 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+// OpenXR functions this app calls once the instance exists. xrCreateInstance, xrDestroyInstance and the functions
+// enumerating extensions and layers stay on the loader, which must see them.
+// clang-format off
+#define SAMPLE_XR_CORE_FUNCTIONS(_)            \
+    _(xrPollEvent)                             \
+    _(xrStringToPath)                          \
+    _(xrGetSystem)                             \
+    _(xrGetSystemProperties)                   \
+    _(xrEnumerateEnvironmentBlendModes)        \
+    _(xrEnumerateViewConfigurations)           \
+    _(xrEnumerateViewConfigurationViews)       \
+    _(xrCreateSession)                         \
+    _(xrDestroySession)                        \
+    _(xrBeginSession)                          \
+    _(xrEndSession)                            \
+    _(xrRequestExitSession)                    \
+    _(xrCreateReferenceSpace)                  \
+    _(xrCreateActionSpace)                     \
+    _(xrLocateSpace)                           \
+    _(xrDestroySpace)                          \
+    _(xrEnumerateSwapchainFormats)             \
+    _(xrCreateSwapchain)                       \
+    _(xrDestroySwapchain)                      \
+    _(xrEnumerateSwapchainImages)              \
+    _(xrAcquireSwapchainImage)                 \
+    _(xrWaitSwapchainImage)                    \
+    _(xrReleaseSwapchainImage)                 \
+    _(xrWaitFrame)                             \
+    _(xrBeginFrame)                            \
+    _(xrEndFrame)                              \
+    _(xrLocateViews)                           \
+    _(xrCreateActionSet)                       \
+    _(xrDestroyActionSet)                      \
+    _(xrCreateAction)                          \
+    _(xrDestroyAction)                         \
+    _(xrSuggestInteractionProfileBindings)     \
+    _(xrAttachSessionActionSets)               \
+    _(xrSyncActions)                           \
+    _(xrGetActionStateBoolean)                 \
+    _(xrGetActionStateFloat)                   \
+    _(xrGetActionStateVector2f)                \
+    _(xrGetActionStatePose)                    \
+    _(xrApplyHapticFeedback)
+
+// Functions of extensions that only exist with their graphics API or platform.
+#ifdef XR_USE_GRAPHICS_API_D3D11
+#define SAMPLE_XR_D3D11_FUNCTIONS(_) _(xrGetD3D11GraphicsRequirementsKHR)
+#else
+#define SAMPLE_XR_D3D11_FUNCTIONS(_)
+#endif
+#ifdef XR_USE_PLATFORM_WIN32
+#define SAMPLE_XR_WIN32_FUNCTIONS(_) _(xrConvertWin32PerformanceCounterToTimeKHR)
+#else
+#define SAMPLE_XR_WIN32_FUNCTIONS(_)
+#endif
+
+// Functions of extensions. They stay null unless their extension is enabled on the instance.
+#define SAMPLE_XR_EXTENSION_FUNCTIONS(_)             \
+    SAMPLE_XR_D3D11_FUNCTIONS(_)                     \
+    SAMPLE_XR_WIN32_FUNCTIONS(_)                     \
+    _(xrCreateSpatialAnchorMSFT)                     \
+    _(xrCreateSpatialAnchorSpaceMSFT)                \
+    _(xrDestroySpatialAnchorMSFT)                    \
+    _(xrCreateSpatialAnchorStoreConnectionMSFT)      \
+    _(xrDestroySpatialAnchorStoreConnectionMSFT)     \
+    _(xrPersistSpatialAnchorMSFT)                    \
+    _(xrEnumeratePersistedSpatialAnchorNamesMSFT)    \
+    _(xrCreateSpatialAnchorFromPersistedNameMSFT)    \
+    _(xrUnpersistSpatialAnchorMSFT)
+// clang-format on
+
+namespace sample::dispatch {
+
+    // Entry points of one instance, resolved once after xrCreateInstance. The functions the loader exports look up the
+    // dispatch table of their handle on every call, these go straight to the first API layer or the runtime.
+    // Read only once loaded, so any thread may call through it.
+    struct DispatchTable {
+#define SAMPLE_XR_DECLARE_FUNCTION(name) PFN_##name name{nullptr};
+        SAMPLE_XR_CORE_FUNCTIONS(SAMPLE_XR_DECLARE_FUNCTION)
+        SAMPLE_XR_EXTENSION_FUNCTIONS(SAMPLE_XR_DECLARE_FUNCTION)
+#undef SAMPLE_XR_DECLARE_FUNCTION
+
+        // Throws if a core function is missing. Handles of the instance must only be used through this table after.
+        void Load(XrInstance instance);
+    };
+
+} // namespace sample::dispatch
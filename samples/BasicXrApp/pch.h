@@ -25,24 +25,35 @@
 #include <array>
 #include <map>
 #include <list>
+#include <optional>
+#include <functional>
 #include <unordered_map>
 #include <algorithm>
 #include <assert.h>
 
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
+
+// The app is Win32 and D3D11 only. Its runtime independent parts, e.g. traces and their replay, also build elsewhere.
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
 #include <windows.h>
 
-#include <d3d11.h>
+#include <d3d11_1.h>
 
 #define XR_USE_PLATFORM_WIN32
 #define XR_USE_GRAPHICS_API_D3D11
+#endif
 #include <openxr/openxr.h>
 #include <openxr/openxr_platform.h>
 
-/*#include "../XrUtility/XrError.h"
+#include "../XrUtility/XrError.h"
 #include "../XrUtility/XrHandle.h"
 #include "../XrUtility/XrMath.h"
-#include "../XrUtility/XrString.h"*/
+#include "../XrUtility/XrString.h"
 
+#ifdef _WIN32
 #include <winrt/base.h>                // winrt::com_ptr
+#endif
@@ -0,0 +1,257 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+// Receives the frames BasicXrApp streams with --capture-port, to check the capture path end to end:
+//     CaptureReceiver [--port P] [--frames N] [--dump PATH]
+// Listens on the loopback port, maps the shared memory section of that port and decodes every frame. Prints the frame
+// rate, decode time and frames the app dropped once a second. With a dump path, the slices of the last frame received
+// are written as raw pixels to PATH.<slice>.raw.
+
+#include "../BasicXrApp/pch.h"
+#include "../BasicXrApp/CaptureProtocol.h"
+#include "../BasicXrApp/FrameCodec.h"
+#include <cstdio>
+#include <fstream>
+#include <winsock2.h>
+#pragma comment(lib, "Ws2_32.lib")
+
+namespace {
+    using namespace sample::capture;
+
+    SOCKET ListenLoopback(uint16_t port) {
+        SOCKET listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        CHECK_MSG(listener != INVALID_SOCKET, "socket failed");
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+            listen(listener, 1) == SOCKET_ERROR) {
+            closesocket(listener);
+            THROW("Cannot listen on the capture port");
+        }
+        return listener;
+    }
+
+    bool ReceiveAll(SOCKET socket, void* data, size_t size) {
+        char* bytes = static_cast<char*>(data);
+        while (size > 0) {
+            const int received = recv(socket, bytes, (int)size, 0);
+            if (received <= 0) {
+                return false;
+            }
+            bytes += received;
+            size -= received;
+        }
+        return true;
+    }
+
+    // Read-write view of the section FrameCapture created for the port. The app creates it before sending the first
+    // frame, so it is opened when that frame arrives, and again for each connection since the app may have restarted.
+    class SharedRing {
+    public:
+        explicit SharedRing(uint16_t port) {
+            m_mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, SharedMemoryName(port).c_str());
+            CHECK_MSG(m_mapping != nullptr, "OpenFileMapping failed");
+            m_header = static_cast<SharedRingHeader*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+            CHECK_MSG(m_header != nullptr, "MapViewOfFile failed");
+
+            MEMORY_BASIC_INFORMATION info{};
+            VirtualQuery(m_header, &info, sizeof(info));
+            CHECK_MSG(m_header->Magic == SharedRingMagic, "Not a capture section");
+            std::atomic_thread_fence(std::memory_order_acquire);
+            CHECK_MSG(m_header->SlotCount <= MaxSharedSlots, "Too many slots in the capture section");
+            CHECK_MSG(m_header->DataOffset + m_header->SlotCount * m_header->SlotSize <= info.RegionSize,
+                      "Capture section smaller than its slots");
+        }
+
+        ~SharedRing() {
+            UnmapViewOfFile(m_header);
+            CloseHandle(m_mapping);
+        }
+
+        SharedRing(const SharedRing&) = delete;
+        SharedRing& operator=(const SharedRing&) = delete;
+
+        const SharedRingHeader& Header() const {
+            return *m_header;
+        }
+
+        const uint8_t* SlotData(uint32_t slot) const {
+            return reinterpret_cast<const uint8_t*>(m_header) + m_header->DataOffset + slot * m_header->SlotSize;
+        }
+
+        // Hands the slot back to the app, which reuses it for a later frame.
+        void Release(uint32_t slot) {
+            m_header->SlotStates[slot].store(SlotFree, std::memory_order_release);
+        }
+
+    private:
+        HANDLE m_mapping{nullptr};
+        SharedRingHeader* m_header{nullptr};
+    };
+
+    // Returns why the message cannot be decoded, or nullptr.
+    const char* Validate(const FrameMessage& message, const SharedRingHeader& header) {
+        if (message.Magic != FrameMessageMagic) {
+            return "Not a frame message";
+        }
+        if (message.Slot >= header.SlotCount) {
+            return "Slot out of range";
+        }
+        if (message.ArraySize == 0 || message.ArraySize > MaxCaptureViews) {
+            return "Unsupported array size";
+        }
+        if (!IsCaptureFormat(message.Format)) {
+            return "Format is not 4 bytes per pixel";
+        }
+        uint64_t encodedSize = 0;
+        for (uint32_t slice = 0; slice < message.ArraySize; slice++) {
+            encodedSize += message.EncodedSizes[slice];
+        }
+        if (encodedSize > header.SlotSize) {
+            return "Encoded frame larger than its slot";
+        }
+        return nullptr;
+    }
+
+    struct Stats {
+        uint64_t Frames{0};
+        uint64_t DroppedFrames{0};
+        double DecodeMilliseconds{0};
+        std::chrono::steady_clock::time_point Start{std::chrono::steady_clock::now()};
+    };
+
+    void Report(Stats& stats) {
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(now - stats.Start).count();
+        if (stats.Frames > 0) {
+            printf("%.1f frames/s, %.2f ms decode, %llu dropped by the app\n",
+                   stats.Frames / seconds,
+                   stats.DecodeMilliseconds / stats.Frames,
+                   (unsigned long long)stats.DroppedFrames);
+        }
+        stats = {};
+    }
+} // namespace
+
+int main(int argc, char** argv) {
+    uint16_t port = DefaultCapturePort;
+    uint64_t frameLimit = 0;
+    std::string dumpPath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string argument = argv[i];
+        if (argument == "--port") {
+            port = (uint16_t)std::stoul(argv[i + 1]);
+        } else if (argument == "--frames") {
+            frameLimit = std::stoull(argv[i + 1]);
+        } else if (argument == "--dump") {
+            dumpPath = argv[i + 1];
+        }
+    }
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        fprintf(stderr, "WSAStartup failed\n");
+        return 1;
+    }
+
+    try {
+        const SOCKET listener = ListenLoopback(port);
+        printf("Listening on port %u\n", port);
+
+        std::vector<uint8_t> pixels;
+        FrameMessage lastMessage{};
+        uint64_t frameCount = 0;
+        Stats stats;
+        while (frameLimit == 0 || frameCount < frameLimit) {
+            const SOCKET connection = accept(listener, nullptr, nullptr);
+            if (connection == INVALID_SOCKET) {
+                break;
+            }
+
+            std::optional<SharedRing> ring;
+            std::optional<uint64_t> lastFrameIndex;
+            FrameMessage message;
+            while ((frameLimit == 0 || frameCount < frameLimit) && ReceiveAll(connection, &message, sizeof(message))) {
+                if (!ring) {
+                    ring.emplace(port);
+                }
+                if (const char* error = Validate(message, ring->Header())) {
+                    // Closing the connection makes the app take back the slots it sent.
+                    fprintf(stderr, "Frame %llu: %s\n", (unsigned long long)message.FrameIndex, error);
+                    break;
+                }
+
+                const auto decodeStart = std::chrono::steady_clock::now();
+                const size_t sliceBytes = (size_t)message.Width * message.Height * 4;
+                pixels.resize(sliceBytes * message.ArraySize);
+                const uint8_t* data = ring->SlotData(message.Slot);
+                bool decoded = true;
+                for (uint32_t slice = 0; slice < message.ArraySize && decoded; slice++) {
+                    decoded = sample::capture::DecodeLossless(
+                        data, message.EncodedSizes[slice], message.Width, message.Height, pixels.data() + slice * sliceBytes);
+                    data += message.EncodedSizes[slice];
+                }
+                ring->Release(message.Slot);
+                if (!decoded) {
+                    fprintf(stderr, "Frame %llu: malformed encoded data\n", (unsigned long long)message.FrameIndex);
+                    break;
+                }
+                stats.DecodeMilliseconds +=
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decodeStart).count();
+
+                if (lastFrameIndex && message.FrameIndex > *lastFrameIndex + 1) {
+                    stats.DroppedFrames += message.FrameIndex - *lastFrameIndex - 1;
+                }
+                lastFrameIndex = message.FrameIndex;
+                lastMessage = message;
+                frameCount++;
+                stats.Frames++;
+                if (std::chrono::steady_clock::now() - stats.Start >= std::chrono::seconds(1)) {
+                    Report(stats);
+                }
+            }
+            closesocket(connection);
+        }
+        Report(stats);
+        closesocket(listener);
+
+        if (!dumpPath.empty() && frameCount > 0) {
+            const size_t sliceBytes = (size_t)lastMessage.Width * lastMessage.Height * 4;
+            for (uint32_t slice = 0; slice < lastMessage.ArraySize; slice++) {
+                const std::string path = dumpPath + "." + std::to_string(slice) + ".raw";
+                std::ofstream(path, std::ios::binary)
+                    .write(reinterpret_cast<const char*>(pixels.data() + slice * sliceBytes), (std::streamsize)sliceBytes);
+                printf("Frame %llu slice %u: %ux%u, DXGI format %u, %s\n",
+                       (unsigned long long)lastMessage.FrameIndex,
+                       slice,
+                       lastMessage.Width,
+                       lastMessage.Height,
+                       lastMessage.Format,
+                       path.c_str());
+            }
+        }
+    } catch (const std::exception& ex) {
+        fprintf(stderr, "%s\n", ex.what());
+        WSACleanup();
+        return 1;
+    }
+
+    WSACleanup();
+    return 0;
+}
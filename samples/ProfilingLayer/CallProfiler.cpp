@@ -0,0 +1,261 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#include "CallProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+    constexpr int JsonSchemaVersion = 1;
+
+    // The profiler whose xrWaitFrame this thread calls, so its other calls count against the frame.
+    thread_local const void* t_frameThreadOf = nullptr;
+
+    std::atomic<uint32_t> g_nextThreadIndex{1};
+    thread_local const uint32_t t_threadIndex = g_nextThreadIndex++;
+
+    uint32_t Bucket(uint64_t nanoseconds) {
+        uint64_t microseconds = nanoseconds / 1000;
+        uint32_t bucket = 0;
+        while (microseconds > 0 && bucket < sample::profiling::HistogramBuckets - 1) {
+            microseconds >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    template <typename T>
+    void UpdateMax(std::atomic<T>& max, T value) {
+        T current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Nanoseconds(sample::profiling::Clock::duration duration) {
+        return (uint64_t)std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    double Average(uint64_t total, uint64_t count) {
+        return count > 0 ? (double)total / count : 0.0;
+    }
+} // namespace
+
+namespace sample::profiling {
+    CallProfiler::CallProfiler(std::vector<const char*> functionNames, Options options)
+        : m_functionNames(std::move(functionNames))
+        , m_options(options)
+        , m_created(Clock::now())
+        , m_counters(new FunctionCounters[m_functionNames.size()]) {
+        m_trace.resize(m_options.TraceCapacity);
+    }
+
+    void CallProfiler::Record(uint32_t function, Clock::time_point start, Clock::time_point end) {
+        const uint64_t nanoseconds = Nanoseconds(end - start);
+        Count(function, nanoseconds);
+        if (t_frameThreadOf == this) {
+            m_frameThreadRuntimeNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        } else {
+            m_otherThreadsRuntimeNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        }
+        AddTraceEvent(function, start, end);
+    }
+
+    void CallProfiler::RecordInfiniteWait(uint32_t function) {
+        m_counters[function].InfiniteWaits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void CallProfiler::RecordWaitFrame(uint32_t function,
+                                       Clock::time_point start,
+                                       Clock::time_point end,
+                                       std::chrono::nanoseconds displayPeriod) {
+        t_frameThreadOf = this;
+
+        // Blocking is what xrWaitFrame is for, only frames that overran count against it.
+        const uint64_t waitNanoseconds = Nanoseconds(end - start);
+        FunctionCounters& counters = m_counters[function];
+        counters.Calls.fetch_add(1, std::memory_order_relaxed);
+        counters.CallsThisFrame.fetch_add(1, std::memory_order_relaxed);
+        counters.TotalNanoseconds.fetch_add(waitNanoseconds, std::memory_order_relaxed);
+        UpdateMax(counters.MaxNanoseconds, waitNanoseconds);
+        counters.Histogram[Bucket(waitNanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        AddTraceEvent(function, start, end);
+
+        std::lock_guard lock(m_frameMutex);
+        const uint64_t runtimeNanoseconds = m_frameThreadRuntimeNanoseconds.exchange(0, std::memory_order_relaxed);
+        if (m_lastWaitFrameEnd != Clock::time_point{}) {
+            // The frame ends when the app comes back for the next one.
+            const uint64_t frameNanoseconds = Nanoseconds(start - m_lastWaitFrameEnd);
+            const uint64_t appNanoseconds = frameNanoseconds - std::min(frameNanoseconds, runtimeNanoseconds);
+            m_frames.Frames++;
+            m_frames.AppNanoseconds += appNanoseconds;
+            m_frames.MaxAppNanoseconds = std::max(m_frames.MaxAppNanoseconds, appNanoseconds);
+            m_frames.RuntimeNanoseconds += runtimeNanoseconds;
+            m_frames.MaxRuntimeNanoseconds = std::max(m_frames.MaxRuntimeNanoseconds, runtimeNanoseconds);
+            m_frames.WaitFrameNanoseconds += waitNanoseconds;
+            if (m_lastDisplayPeriod.count() > 0 && frameNanoseconds > (uint64_t)m_lastDisplayPeriod.count()) {
+                m_frames.Overruns++;
+            }
+        }
+        m_frames.OtherThreadsRuntimeNanoseconds = m_otherThreadsRuntimeNanoseconds.load(std::memory_order_relaxed);
+        m_lastWaitFrameEnd = end;
+        m_lastDisplayPeriod = displayPeriod;
+
+        // Calls on other threads land in whichever frame is current when they return.
+        for (size_t i = 0; i < m_functionNames.size(); i++) {
+            const uint32_t calls = m_counters[i].CallsThisFrame.exchange(0, std::memory_order_relaxed);
+            m_counters[i].MaxCallsPerFrame = std::max(m_counters[i].MaxCallsPerFrame, calls);
+        }
+    }
+
+    void CallProfiler::Count(uint32_t function, uint64_t nanoseconds) {
+        FunctionCounters& counters = m_counters[function];
+        counters.Calls.fetch_add(1, std::memory_order_relaxed);
+        counters.CallsThisFrame.fetch_add(1, std::memory_order_relaxed);
+        counters.TotalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        UpdateMax(counters.MaxNanoseconds, nanoseconds);
+        counters.Histogram[Bucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        if (nanoseconds > (uint64_t)m_options.BlockThreshold.count()) {
+            counters.BlockedCalls.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void CallProfiler::AddTraceEvent(uint32_t function, Clock::time_point start, Clock::time_point end) {
+        if (m_trace.empty()) {
+            return;
+        }
+
+        const TraceEvent event{function,
+                               t_threadIndex,
+                               std::chrono::duration_cast<std::chrono::nanoseconds>(start - m_created).count(),
+                               (int64_t)Nanoseconds(end - start)};
+        std::lock_guard lock(m_traceMutex);
+        m_trace[m_traceCount % m_trace.size()] = event;
+        m_traceCount++;
+    }
+
+    Report CallProfiler::GetReport() const {
+        Report report;
+        std::lock_guard lock(m_frameMutex);
+        for (size_t i = 0; i < m_functionNames.size(); i++) {
+            const FunctionCounters& counters = m_counters[i];
+            if (counters.Calls.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+
+            FunctionStats& stats = report.Functions.emplace_back();
+            stats.Name = m_functionNames[i];
+            stats.Calls = counters.Calls.load(std::memory_order_relaxed);
+            stats.TotalNanoseconds = counters.TotalNanoseconds.load(std::memory_order_relaxed);
+            stats.MaxNanoseconds = counters.MaxNanoseconds.load(std::memory_order_relaxed);
+            stats.BlockedCalls = counters.BlockedCalls.load(std::memory_order_relaxed);
+            stats.InfiniteWaits = counters.InfiniteWaits.load(std::memory_order_relaxed);
+            stats.MaxCallsPerFrame = counters.MaxCallsPerFrame;
+            for (uint32_t bucket = 0; bucket < HistogramBuckets; bucket++) {
+                stats.Histogram[bucket] = counters.Histogram[bucket].load(std::memory_order_relaxed);
+            }
+        }
+        report.Frames = m_frames;
+        return report;
+    }
+
+    bool CallProfiler::WriteJson(const std::string& path) const {
+        const Report report = GetReport();
+        std::ofstream file(path, std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+
+        // Function names only contain [A-Za-z0-9], so they need no escaping.
+        char line[1024];
+        const FrameStats& frames = report.Frames;
+        file << "{\n  \"schema\": " << JsonSchemaVersion << ",\n";
+        file << "  \"block_threshold_ns\": " << m_options.BlockThreshold.count() << ",\n";
+        snprintf(line,
+                 sizeof(line),
+                 "  \"frames\": {\"count\": %llu, \"overruns\": %llu, \"app_ns_avg\": %.0f, \"app_ns_max\": %llu, "
+                 "\"runtime_ns_avg\": %.0f, \"runtime_ns_max\": %llu, \"wait_frame_ns_avg\": %.0f, \"other_threads_runtime_ns\": %llu},\n",
+                 (unsigned long long)frames.Frames,
+                 (unsigned long long)frames.Overruns,
+                 Average(frames.AppNanoseconds, frames.Frames),
+                 (unsigned long long)frames.MaxAppNanoseconds,
+                 Average(frames.RuntimeNanoseconds, frames.Frames),
+                 (unsigned long long)frames.MaxRuntimeNanoseconds,
+                 Average(frames.WaitFrameNanoseconds, frames.Frames),
+                 (unsigned long long)frames.OtherThreadsRuntimeNanoseconds);
+        file << line;
+
+        file << "  \"histogram_upper_bounds_us\": [";
+        for (uint32_t bucket = 0; bucket + 1 < HistogramBuckets; bucket++) {
+            file << (bucket == 0 ? "" : ", ") << (1ull << bucket);
+        }
+        file << ", null],\n";
+
+        file << "  \"functions\": {";
+        for (size_t i = 0; i < report.Functions.size(); i++) {
+            const FunctionStats& stats = report.Functions[i];
+            snprintf(line,
+                     sizeof(line),
+                     "%s\n    \"%s\": {\"calls\": %llu, \"calls_per_frame_avg\": %.2f, \"calls_per_frame_max\": %u, \"total_ns\": %llu, "
+                     "\"avg_ns\": %.0f, \"max_ns\": %llu, \"blocked_calls\": %llu, \"infinite_waits\": %llu, \"histogram\": [",
+                     i == 0 ? "" : ",",
+                     stats.Name.c_str(),
+                     (unsigned long long)stats.Calls,
+                     Average(stats.Calls, frames.Frames),
+                     stats.MaxCallsPerFrame,
+                     (unsigned long long)stats.TotalNanoseconds,
+                     Average(stats.TotalNanoseconds, stats.Calls),
+                     (unsigned long long)stats.MaxNanoseconds,
+                     (unsigned long long)stats.BlockedCalls,
+                     (unsigned long long)stats.InfiniteWaits);
+            file << line;
+            for (uint32_t bucket = 0; bucket < HistogramBuckets; bucket++) {
+                file << (bucket == 0 ? "" : ", ") << stats.Histogram[bucket];
+            }
+            file << "]}";
+        }
+        file << "\n  }\n}\n";
+        return (bool)file;
+    }
+
+    bool CallProfiler::WriteTrace(const std::string& path) const {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+
+        std::lock_guard lock(m_traceMutex);
+        const uint64_t count = std::min<uint64_t>(m_traceCount, m_trace.size());
+        char line[256];
+        file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        for (uint64_t i = 0; i < count; i++) {
+            // Oldest first, once the ring has wrapped the oldest event is the one after the newest.
+            const TraceEvent& event = m_trace[(m_traceCount - count + i) % m_trace.size()];
+            snprintf(line,
+                     sizeof(line),
+                     "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                     i == 0 ? "" : ",",
+                     m_functionNames[event.Function],
+                     event.Thread,
+                     event.StartNanoseconds / 1000.0,
+                     event.DurationNanoseconds / 1000.0);
+            file << line;
+        }
+        file << "\n]}\n";
+        return (bool)file;
+    }
+
+} // namespace sample::profiling
@@ -0,0 +1,133 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sample::profiling {
+
+    using Clock = std::chrono::steady_clock;
+
+    // Bucket 0 counts calls under 1us, bucket i calls in [2^(i-1), 2^i) us, and the last bucket everything longer.
+    constexpr uint32_t HistogramBuckets = 24;
+
+    struct FunctionStats {
+        std::string Name;
+        uint64_t Calls{0};
+        uint64_t TotalNanoseconds{0};
+        uint64_t MaxNanoseconds{0};
+        uint64_t BlockedCalls{0};   // Longer than BlockThreshold
+        uint64_t InfiniteWaits{0};  // Given XR_INFINITE_DURATION, so the app cannot do other work meanwhile
+        uint32_t MaxCallsPerFrame{0};
+        std::array<uint64_t, HistogramBuckets> Histogram{};
+    };
+
+    // Where the time between two xrWaitFrame calls went on the thread calling xrWaitFrame. App time is what is left once
+    // the time inside xr* calls is taken out, so it is the app's own cost whatever the runtime.
+    struct FrameStats {
+        uint64_t Frames{0};
+        uint64_t Overruns{0}; // Frames whose app and runtime time exceeded the predicted display period
+        uint64_t AppNanoseconds{0};
+        uint64_t MaxAppNanoseconds{0};
+        uint64_t RuntimeNanoseconds{0}; // Inside xr* calls other than xrWaitFrame
+        uint64_t MaxRuntimeNanoseconds{0};
+        uint64_t WaitFrameNanoseconds{0};
+        uint64_t OtherThreadsRuntimeNanoseconds{0}; // Inside xr* calls on other threads, e.g. an input thread
+    };
+
+    struct Report {
+        std::vector<FunctionStats> Functions; // Only the functions that were called, in the order of the names
+        FrameStats Frames;
+    };
+
+    // Accumulates the timing of every intercepted call: latency histograms, counts per frame and calls that blocked.
+    // Recording is lock free unless the trace is enabled, so several threads calling the runtime are not serialized.
+    class CallProfiler {
+    public:
+        struct Options {
+            std::chrono::nanoseconds BlockThreshold{std::chrono::milliseconds(2)};
+            uint32_t TraceCapacity{0}; // Most recent calls kept as trace events, none when zero
+        };
+
+        // Functions are then named by their index in functionNames, which must outlive the profiler.
+        CallProfiler(std::vector<const char*> functionNames, Options options);
+
+        CallProfiler(const CallProfiler&) = delete;
+        CallProfiler& operator=(const CallProfiler&) = delete;
+
+        // Any thread.
+        void Record(uint32_t function, Clock::time_point start, Clock::time_point end);
+        void RecordInfiniteWait(uint32_t function);
+
+        // Frame thread, for each xrWaitFrame. The display period is the one returned in its frame state.
+        void RecordWaitFrame(uint32_t function, Clock::time_point start, Clock::time_point end, std::chrono::nanoseconds displayPeriod);
+
+        Report GetReport() const;
+
+        // Writes the report as JSON, one object per called function keyed by its name. Returns false if writing failed.
+        bool WriteJson(const std::string& path) const;
+
+        // Writes the calls kept for the trace as Chrome trace events, to open in chrome://tracing or Perfetto.
+        bool WriteTrace(const std::string& path) const;
+
+    private:
+        struct FunctionCounters {
+            std::atomic<uint64_t> Calls{0};
+            std::atomic<uint64_t> TotalNanoseconds{0};
+            std::atomic<uint64_t> MaxNanoseconds{0};
+            std::atomic<uint64_t> BlockedCalls{0};
+            std::atomic<uint64_t> InfiniteWaits{0};
+            std::atomic<uint32_t> CallsThisFrame{0};
+            uint32_t MaxCallsPerFrame{0}; // Guarded by m_frameMutex
+            std::array<std::atomic<uint64_t>, HistogramBuckets> Histogram{};
+        };
+
+        struct TraceEvent {
+            uint32_t Function;
+            uint32_t Thread;
+            int64_t StartNanoseconds; // Since the profiler was created
+            int64_t DurationNanoseconds;
+        };
+
+        void Count(uint32_t function, uint64_t nanoseconds);
+        void AddTraceEvent(uint32_t function, Clock::time_point start, Clock::time_point end);
+
+        const std::vector<const char*> m_functionNames;
+        const Options m_options;
+        const Clock::time_point m_created;
+        std::unique_ptr<FunctionCounters[]> m_counters;
+
+        std::atomic<uint64_t> m_frameThreadRuntimeNanoseconds{0}; // Since the last xrWaitFrame
+        std::atomic<uint64_t> m_otherThreadsRuntimeNanoseconds{0};
+
+        mutable std::mutex m_frameMutex;
+        FrameStats m_frames;
+        Clock::time_point m_lastWaitFrameEnd{};
+        std::chrono::nanoseconds m_lastDisplayPeriod{0};
+
+        mutable std::mutex m_traceMutex;
+        std::vector<TraceEvent> m_trace; // Ring of TraceCapacity events
+        uint64_t m_traceCount{0};
+    };
+
+} // namespace sample::profiling
@@ -0,0 +1,347 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+// XR_APILAYER_SAMPLE_profiling times every call the app makes to the runtime below it, whatever the runtime, and writes
+// the report when the instance is destroyed, or when the process receives SIGUSR1 (SIGBREAK on Windows).
+// It only depends on the loader interface, so it builds with CMakeLists.txt on Linux as well as with ProfilingLayer.vcxproj.
+// Enable it with XR_API_LAYER_PATH set to the folder of its manifest and XR_ENABLE_API_LAYERS=XR_APILAYER_SAMPLE_profiling.
+// Environment variables:
+//     XR_PROFILING_LAYER_OUTPUT       Report path without extension, "xr_profile" by default
+//     XR_PROFILING_LAYER_BLOCK_US     Calls longer than this count as blocked, 2000 by default
+//     XR_PROFILING_LAYER_TRACE_CALLS  Most recent calls written as trace events to <output>.trace.json, 0 by default
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <openxr/openxr.h>
+#include <openxr/openxr_loader_negotiation.h>
+
+#include "CallProfiler.h"
+
+#if defined(_WIN32)
+#define SAMPLE_LAYER_EXPORT extern "C" __declspec(dllexport)
+#else
+#define SAMPLE_LAYER_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// Functions timed by the layer. Functions of other extensions are passed through untimed, their signatures are unknown.
+// xrGetInstanceProcAddr and xrDestroyInstance are always intercepted, and the loader handles the functions that come
+// before an instance exists.
+// clang-format off
+#define SAMPLE_PROFILED_FUNCTIONS(_)                 \
+    _(xrGetInstanceProperties)                       \
+    _(xrPollEvent)                                   \
+    _(xrResultToString)                              \
+    _(xrStructureTypeToString)                       \
+    _(xrGetSystem)                                   \
+    _(xrGetSystemProperties)                         \
+    _(xrEnumerateEnvironmentBlendModes)              \
+    _(xrCreateSession)                               \
+    _(xrDestroySession)                              \
+    _(xrEnumerateReferenceSpaces)                    \
+    _(xrCreateReferenceSpace)                        \
+    _(xrGetReferenceSpaceBoundsRect)                 \
+    _(xrCreateActionSpace)                           \
+    _(xrLocateSpace)                                 \
+    _(xrDestroySpace)                                \
+    _(xrEnumerateViewConfigurations)                 \
+    _(xrGetViewConfigurationProperties)              \
+    _(xrEnumerateViewConfigurationViews)             \
+    _(xrEnumerateSwapchainFormats)                   \
+    _(xrCreateSwapchain)                             \
+    _(xrDestroySwapchain)                            \
+    _(xrEnumerateSwapchainImages)                    \
+    _(xrAcquireSwapchainImage)                       \
+    _(xrWaitSwapchainImage)                          \
+    _(xrReleaseSwapchainImage)                       \
+    _(xrBeginSession)                                \
+    _(xrEndSession)                                  \
+    _(xrRequestExitSession)                          \
+    _(xrWaitFrame)                                   \
+    _(xrBeginFrame)                                  \
+    _(xrEndFrame)                                    \
+    _(xrLocateViews)                                 \
+    _(xrStringToPath)                                \
+    _(xrPathToString)                                \
+    _(xrCreateActionSet)                             \
+    _(xrDestroyActionSet)                            \
+    _(xrCreateAction)                                \
+    _(xrDestroyAction)                               \
+    _(xrSuggestInteractionProfileBindings)           \
+    _(xrAttachSessionActionSets)                     \
+    _(xrGetCurrentInteractionProfile)                \
+    _(xrGetActionStateBoolean)                       \
+    _(xrGetActionStateFloat)                         \
+    _(xrGetActionStateVector2f)                      \
+    _(xrGetActionStatePose)                          \
+    _(xrSyncActions)                                 \
+    _(xrEnumerateBoundSourcesForAction)              \
+    _(xrGetInputSourceLocalizedName)                 \
+    _(xrApplyHapticFeedback)                         \
+    _(xrStopHapticFeedback)                          \
+    _(xrCreateSpatialAnchorMSFT)                     \
+    _(xrCreateSpatialAnchorSpaceMSFT)                \
+    _(xrDestroySpatialAnchorMSFT)                    \
+    _(xrCreateSpatialAnchorStoreConnectionMSFT)      \
+    _(xrDestroySpatialAnchorStoreConnectionMSFT)     \
+    _(xrPersistSpatialAnchorMSFT)                    \
+    _(xrEnumeratePersistedSpatialAnchorNamesMSFT)    \
+    _(xrCreateSpatialAnchorFromPersistedNameMSFT)    \
+    _(xrUnpersistSpatialAnchorMSFT)
+// clang-format on
+
+namespace {
+    using sample::profiling::CallProfiler;
+    using sample::profiling::Clock;
+
+    constexpr const char* LayerName = "XR_APILAYER_SAMPLE_profiling";
+
+    enum FunctionId : uint32_t {
+#define SAMPLE_FUNCTION_ID(name) Id_##name,
+        SAMPLE_PROFILED_FUNCTIONS(SAMPLE_FUNCTION_ID)
+#undef SAMPLE_FUNCTION_ID
+        FunctionCount
+    };
+
+    const char* const FunctionNames[] = {
+#define SAMPLE_FUNCTION_NAME(name) #name,
+        SAMPLE_PROFILED_FUNCTIONS(SAMPLE_FUNCTION_NAME)
+#undef SAMPLE_FUNCTION_NAME
+    };
+
+    // One instance at a time, which is all an app needs. Written when the instance is created and destroyed only.
+    struct LayerState {
+        XrInstance Instance{XR_NULL_HANDLE};
+        PFN_xrGetInstanceProcAddr NextGetInstanceProcAddr{nullptr};
+        PFN_xrDestroyInstance NextDestroyInstance{nullptr};
+        PFN_xrVoidFunction Next[FunctionCount]{}; // Null when the layers or runtime below do not support the function
+        std::unique_ptr<CallProfiler> Profiler;
+        std::string OutputPath;
+    } g_layer;
+
+    static_assert(std::atomic<bool>::is_always_lock_free, "Set from a signal handler");
+    std::atomic<bool> g_reportRequested{false};
+
+    extern "C" void OnReportSignal(int) {
+        g_reportRequested = true;
+    }
+
+    std::string GetEnvironmentVariable(const char* name) {
+#if defined(_WIN32)
+        char* value = nullptr;
+        size_t size = 0;
+        std::string result;
+        if (_dupenv_s(&value, &size, name) == 0 && value != nullptr) {
+            result = value;
+        }
+        free(value);
+        return result;
+#else
+        const char* value = std::getenv(name);
+        return value != nullptr ? value : "";
+#endif
+    }
+
+    void WriteReports() {
+        // Reported through the files only, the layer has no other channel to the user than the app's own logs.
+        g_layer.Profiler->WriteJson(g_layer.OutputPath + ".json");
+        g_layer.Profiler->WriteTrace(g_layer.OutputPath + ".trace.json");
+    }
+
+    // Calls the next layer or the runtime and records how long it took.
+    template <uint32_t Id, typename Function>
+    struct Timed;
+
+    template <uint32_t Id, typename... Args>
+    struct Timed<Id, XrResult(XRAPI_PTR*)(Args...)> {
+        static XrResult XRAPI_CALL Call(Args... args) {
+            const auto next = reinterpret_cast<XrResult(XRAPI_PTR*)(Args...)>(g_layer.Next[Id]);
+            const Clock::time_point start = Clock::now();
+            const XrResult result = next(args...);
+            g_layer.Profiler->Record(Id, start, Clock::now());
+            return result;
+        }
+    };
+
+    // xrWaitFrame ends the previous frame. It is also where requested reports are written, on the frame thread.
+    template <>
+    struct Timed<Id_xrWaitFrame, PFN_xrWaitFrame> {
+        static XrResult XRAPI_CALL Call(XrSession session, const XrFrameWaitInfo* frameWaitInfo, XrFrameState* frameState) {
+            const auto next = reinterpret_cast<PFN_xrWaitFrame>(g_layer.Next[Id_xrWaitFrame]);
+            const Clock::time_point start = Clock::now();
+            const XrResult result = next(session, frameWaitInfo, frameState);
+            const Clock::time_point end = Clock::now();
+            const std::chrono::nanoseconds displayPeriod(XR_SUCCEEDED(result) ? frameState->predictedDisplayPeriod : 0);
+            g_layer.Profiler->RecordWaitFrame(Id_xrWaitFrame, start, end, displayPeriod);
+
+            if (g_reportRequested.exchange(false)) {
+                WriteReports();
+            }
+            return result;
+        }
+    };
+
+    // An infinite wait keeps the app from doing anything else until the compositor releases the image.
+    template <>
+    struct Timed<Id_xrWaitSwapchainImage, PFN_xrWaitSwapchainImage> {
+        static XrResult XRAPI_CALL Call(XrSwapchain swapchain, const XrSwapchainImageWaitInfo* waitInfo) {
+            const auto next = reinterpret_cast<PFN_xrWaitSwapchainImage>(g_layer.Next[Id_xrWaitSwapchainImage]);
+            const Clock::time_point start = Clock::now();
+            const XrResult result = next(swapchain, waitInfo);
+            g_layer.Profiler->Record(Id_xrWaitSwapchainImage, start, Clock::now());
+            if (waitInfo != nullptr && waitInfo->timeout == XR_INFINITE_DURATION) {
+                g_layer.Profiler->RecordInfiniteWait(Id_xrWaitSwapchainImage);
+            }
+            return result;
+        }
+    };
+
+    const PFN_xrVoidFunction Wrappers[] = {
+#define SAMPLE_FUNCTION_WRAPPER(name) reinterpret_cast<PFN_xrVoidFunction>(&Timed<Id_##name, PFN_##name>::Call),
+        SAMPLE_PROFILED_FUNCTIONS(SAMPLE_FUNCTION_WRAPPER)
+#undef SAMPLE_FUNCTION_WRAPPER
+    };
+
+    XrResult XRAPI_CALL LayerDestroyInstance(XrInstance instance) {
+        if (instance != g_layer.Instance || g_layer.NextDestroyInstance == nullptr) {
+            return XR_ERROR_HANDLE_INVALID;
+        }
+
+        WriteReports();
+        const XrResult result = g_layer.NextDestroyInstance(instance);
+        g_layer = {};
+        return result;
+    }
+
+    XrResult XRAPI_CALL LayerGetInstanceProcAddr(XrInstance instance, const char* name, PFN_xrVoidFunction* function) {
+        if (name == nullptr || function == nullptr) {
+            return XR_ERROR_VALIDATION_FAILURE;
+        }
+        if (strcmp(name, "xrGetInstanceProcAddr") == 0) {
+            *function = reinterpret_cast<PFN_xrVoidFunction>(&LayerGetInstanceProcAddr);
+            return XR_SUCCESS;
+        }
+        if (g_layer.NextGetInstanceProcAddr == nullptr) {
+            *function = nullptr;
+            return XR_ERROR_FUNCTION_UNSUPPORTED;
+        }
+
+        const XrResult result = g_layer.NextGetInstanceProcAddr(instance, name, function);
+        if (XR_FAILED(result) || instance != g_layer.Instance) {
+            return result;
+        }
+        if (strcmp(name, "xrDestroyInstance") == 0) {
+            *function = reinterpret_cast<PFN_xrVoidFunction>(&LayerDestroyInstance);
+            return XR_SUCCESS;
+        }
+        for (uint32_t i = 0; i < FunctionCount; i++) {
+            if (strcmp(name, FunctionNames[i]) == 0 && g_layer.Next[i] != nullptr) {
+                *function = Wrappers[i];
+                break;
+            }
+        }
+        return result;
+    }
+
+    XrResult XRAPI_CALL LayerCreateApiLayerInstance(const XrInstanceCreateInfo* info,
+                                                    const XrApiLayerCreateInfo* apiLayerInfo,
+                                                    XrInstance* instance) {
+        if (apiLayerInfo == nullptr || apiLayerInfo->nextInfo == nullptr || strcmp(apiLayerInfo->nextInfo->layerName, LayerName) != 0) {
+            return XR_ERROR_INITIALIZATION_FAILED;
+        }
+        if (g_layer.Instance != XR_NULL_HANDLE) {
+            return XR_ERROR_LIMIT_REACHED;
+        }
+
+        // The layers below see the chain without this one.
+        XrApiLayerCreateInfo nextApiLayerInfo = *apiLayerInfo;
+        nextApiLayerInfo.nextInfo = apiLayerInfo->nextInfo->next;
+        const XrResult result = apiLayerInfo->nextInfo->nextCreateApiLayerInstance(info, &nextApiLayerInfo, instance);
+        if (XR_FAILED(result)) {
+            return result;
+        }
+
+        try {
+            g_layer.Instance = *instance;
+            g_layer.NextGetInstanceProcAddr = apiLayerInfo->nextInfo->nextGetInstanceProcAddr;
+            g_layer.NextGetInstanceProcAddr(
+                *instance, "xrDestroyInstance", reinterpret_cast<PFN_xrVoidFunction*>(&g_layer.NextDestroyInstance));
+            for (uint32_t i = 0; i < FunctionCount; i++) {
+                if (XR_FAILED(g_layer.NextGetInstanceProcAddr(*instance, FunctionNames[i], &g_layer.Next[i]))) {
+                    g_layer.Next[i] = nullptr; // Functions of extensions that are not enabled
+                }
+            }
+
+            CallProfiler::Options options;
+            const std::string blockMicroseconds = GetEnvironmentVariable("XR_PROFILING_LAYER_BLOCK_US");
+            if (!blockMicroseconds.empty()) {
+                options.BlockThreshold = std::chrono::microseconds(std::stoll(blockMicroseconds));
+            }
+            const std::string traceCalls = GetEnvironmentVariable("XR_PROFILING_LAYER_TRACE_CALLS");
+            if (!traceCalls.empty()) {
+                options.TraceCapacity = (uint32_t)std::stoul(traceCalls);
+            }
+            g_layer.OutputPath = GetEnvironmentVariable("XR_PROFILING_LAYER_OUTPUT");
+            if (g_layer.OutputPath.empty()) {
+                g_layer.OutputPath = "xr_profile";
+            }
+            g_layer.Profiler = std::make_unique<CallProfiler>(std::vector<const char*>(std::begin(FunctionNames), std::end(FunctionNames)),
+                                                              options);
+        } catch (const std::exception&) {
+            // E.g. a malformed environment variable. The instance is unusable without the layer, so undo its creation.
+            if (g_layer.NextDestroyInstance != nullptr) {
+                g_layer.NextDestroyInstance(*instance);
+            }
+            g_layer = {};
+            *instance = XR_NULL_HANDLE;
+            return XR_ERROR_INITIALIZATION_FAILED;
+        }
+
+#if defined(SIGUSR1)
+        std::signal(SIGUSR1, OnReportSignal);
+#elif defined(SIGBREAK)
+        std::signal(SIGBREAK, OnReportSignal);
+#endif
+        return XR_SUCCESS;
+    }
+} // namespace
+
+SAMPLE_LAYER_EXPORT XrResult XRAPI_CALL xrNegotiateLoaderApiLayerInterface(const XrNegotiateLoaderInfo* loaderInfo,
+                                                                            const char* layerName,
+                                                                            XrNegotiateApiLayerRequest* apiLayerRequest) {
+    if (loaderInfo == nullptr || loaderInfo->structType != XR_LOADER_INTERFACE_STRUCT_LOADER_INFO ||
+        loaderInfo->structVersion != XR_LOADER_INFO_STRUCT_VERSION || loaderInfo->structSize != sizeof(XrNegotiateLoaderInfo)) {
+        return XR_ERROR_INITIALIZATION_FAILED;
+    }
+    if (apiLayerRequest == nullptr || apiLayerRequest->structType != XR_LOADER_INTERFACE_STRUCT_API_LAYER_REQUEST ||
+        apiLayerRequest->structVersion != XR_API_LAYER_INFO_STRUCT_VERSION ||
+        apiLayerRequest->structSize != sizeof(XrNegotiateApiLayerRequest)) {
+        return XR_ERROR_INITIALIZATION_FAILED;
+    }
+    if (layerName == nullptr || strcmp(layerName, LayerName) != 0 ||
+        loaderInfo->minInterfaceVersion > XR_CURRENT_LOADER_API_LAYER_VERSION ||
+        loaderInfo->maxInterfaceVersion < XR_CURRENT_LOADER_API_LAYER_VERSION) {
+        return XR_ERROR_INITIALIZATION_FAILED;
+    }
+
+    apiLayerRequest->layerInterfaceVersion = XR_CURRENT_LOADER_API_LAYER_VERSION;
+    apiLayerRequest->layerApiVersion = XR_CURRENT_API_VERSION;
+    apiLayerRequest->getInstanceProcAddr = LayerGetInstanceProcAddr;
+    apiLayerRequest->createApiLayerInstance = LayerCreateApiLayerInstance;
+    return XR_SUCCESS;
+}
@@ -0,0 +1,83 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#pragma once
+
+#include <utility>
+
+#include <openxr/openxr.h>
+
+namespace xr {
+    template <typename HandleType>
+    class UniqueHandle {
+    public:
+        using DestroyFunction = XrResult(XRAPI_PTR*)(HandleType);
+
+        UniqueHandle() = default;
+        UniqueHandle(const UniqueHandle&) = delete;
+        UniqueHandle(UniqueHandle&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        ~UniqueHandle() noexcept {
+            Reset();
+        }
+
+        UniqueHandle& operator=(const UniqueHandle&) = delete;
+        UniqueHandle& operator=(UniqueHandle&& other) noexcept {
+            if (m_handle != other.m_handle) {
+                Reset();
+
+                m_handle = other.m_handle;
+                m_destroy = other.m_destroy;
+                other.m_handle = XR_NULL_HANDLE;
+            }
+            return *this;
+        }
+
+        HandleType Get() const noexcept {
+            return m_handle;
+        }
+
+        // The handle written to is destroyed with destroy, the function of the instance's dispatch table.
+        HandleType* Put(DestroyFunction destroy) noexcept {
+            Reset();
+            m_destroy = destroy;
+            return &m_handle;
+        }
+
+        void Reset() noexcept {
+            if (m_handle != XR_NULL_HANDLE) {
+                m_destroy(m_handle);
+            }
+            m_handle = XR_NULL_HANDLE;
+        }
+
+    private:
+        HandleType m_handle{XR_NULL_HANDLE};
+        DestroyFunction m_destroy{nullptr};
+    };
+
+    using ActionHandle = UniqueHandle<XrAction>;
+    using ActionSetHandle = UniqueHandle<XrActionSet>;
+    using InstanceHandle = UniqueHandle<XrInstance>;
+    using SessionHandle = UniqueHandle<XrSession>;
+    using SpaceHandle = UniqueHandle<XrSpace>;
+    using SwapchainHandle = UniqueHandle<XrSwapchain>;
+#ifdef XR_MSFT_spatial_anchor
+    using SpatialAnchorHandle = UniqueHandle<XrSpatialAnchorMSFT>;
+#endif
+} // namespace xr
@@ -0,0 +1,132 @@
+//*********************************************************
+//    Copyright (c) Microsoft. All rights reserved.
+//
+//    Apache 2.0 License
+//
+//    You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//    implied. See the License for the specific language governing
+//    permissions and limitations under the License.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cmath>
+
+#include <openxr/openxr.h>
+
+#ifdef _WIN32
+#include <DirectXMath.h>
+#endif
+
+namespace xr::math {
+    struct NearFar {
+        float Near;
+        float Far;
+    };
+
+    struct ViewProjection {
+        XrPosef Pose;
+        XrFovf Fov;
+        xr::math::NearFar NearFar;
+    };
+
+    namespace Quaternion {
+        constexpr XrQuaternionf Identity() {
+            return {0, 0, 0, 1};
+        }
+
+        // The axis must be normalized.
+        inline XrQuaternionf RotationAxisAngle(const XrVector3f& axis, float angleInRadians) {
+            const float s = std::sin(angleInRadians * 0.5f);
+            return {axis.x * s, axis.y * s, axis.z * s, std::cos(angleInRadians * 0.5f)};
+        }
+
+        // Rotation by a followed by b, like XMQuaternionMultiply.
+        constexpr XrQuaternionf Multiply(const XrQuaternionf& a, const XrQuaternionf& b) {
+            return {b.w * a.x + b.x * a.w + b.y * a.z - b.z * a.y,
+                    b.w * a.y - b.x * a.z + b.y * a.w + b.z * a.x,
+                    b.w * a.z + b.x * a.y - b.y * a.x + b.z * a.w,
+                    b.w * a.w - b.x * a.x - b.y * a.y - b.z * a.z};
+        }
+
+        constexpr XrQuaternionf Conjugate(const XrQuaternionf& q) {
+            return {-q.x, -q.y, -q.z, q.w};
+        }
+
+        // The quaternion must be normalized.
+        constexpr XrVector3f Rotate(const XrQuaternionf& q, const XrVector3f& v) {
+            // v + 2w(u x v) + 2u x (u x v), with u the vector part of q.
+            const XrVector3f t{2 * (q.y * v.z - q.z * v.y), 2 * (q.z * v.x - q.x * v.z), 2 * (q.x * v.y - q.y * v.x)};
+            return {v.x + q.w * t.x + (q.y * t.z - q.z * t.y),
+                    v.y + q.w * t.y + (q.z * t.x - q.x * t.z),
+                    v.z + q.w * t.z + (q.x * t.y - q.y * t.x)};
+        }
+    } // namespace Quaternion
+
+    namespace Pose {
+        constexpr XrPosef Identity() {
+            return {{0, 0, 0, 1}, {0, 0, 0}};
+        }
+
+        constexpr XrPosef Translation(const XrVector3f& translation) {
+            return {{0, 0, 0, 1}, translation};
+        }
+
+        // Pose a followed by pose b. With a relative to b's space and b relative to a base space, returns a relative to
+        // the base space.
+        constexpr XrPosef Multiply(const XrPosef& a, const XrPosef& b) {
+            const XrVector3f position = Quaternion::Rotate(b.orientation, a.position);
+            return {Quaternion::Multiply(a.orientation, b.orientation),
+                    {position.x + b.position.x, position.y + b.position.y, position.z + b.position.z}};
+        }
+
+        constexpr XrPosef Invert(const XrPosef& pose) {
+            const XrQuaternionf orientation = Quaternion::Conjugate(pose.orientation);
+            const XrVector3f position = Quaternion::Rotate(orientation, pose.position);
+            return {orientation, {-position.x, -position.y, -position.z}};
+        }
+
+        constexpr bool IsPoseValid(XrSpaceLocationFlags locationFlags) {
+            constexpr XrSpaceLocationFlags PoseValidFlags =
+                XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT;
+            return (locationFlags & PoseValidFlags) == PoseValidFlags;
+        }
+
+        constexpr bool IsPoseValid(const XrSpaceLocation& location) {
+            return IsPoseValid(location.locationFlags);
+        }
+
+        constexpr bool IsPoseValid(const XrViewState& viewState) {
+            constexpr XrViewStateFlags PoseValidFlags = XR_VIEW_STATE_POSITION_VALID_BIT | XR_VIEW_STATE_ORIENTATION_VALID_BIT;
+            return (viewState.viewStateFlags & PoseValidFlags) == PoseValidFlags;
+        }
+    } // namespace Pose
+
+#ifdef _WIN32
+    inline DirectX::XMMATRIX XM_CALLCONV LoadXrPose(const XrPosef& pose) {
+        return DirectX::XMMatrixAffineTransformation(DirectX::g_XMOne,
+                                                     DirectX::g_XMZero,
+                                                     DirectX::XMLoadFloat4(reinterpret_cast<const DirectX::XMFLOAT4*>(&pose.orientation)),
+                                                     DirectX::XMLoadFloat3(reinterpret_cast<const DirectX::XMFLOAT3*>(&pose.position)));
+    }
+
+    inline DirectX::XMMATRIX XM_CALLCONV LoadInvertedXrPose(const XrPosef& pose) {
+        return LoadXrPose(Pose::Invert(pose));
+    }
+
+    // Right handed projection of the field of view. Near may be greater than far for reversed Z.
+    inline DirectX::XMMATRIX XM_CALLCONV ComposeProjectionMatrix(const XrFovf& fov, const NearFar& nearFar) {
+        const float left = nearFar.Near * std::tan(fov.angleLeft);
+        const float right = nearFar.Near * std::tan(fov.angleRight);
+        const float down = nearFar.Near * std::tan(fov.angleDown);
+        const float up = nearFar.Near * std::tan(fov.angleUp);
+        return DirectX::XMMatrixPerspectiveOffCenterRH(left, right, down, up, nearFar.Near, nearFar.Far);
+    }
+#endif
+} // namespace xr::math